@@ -12,6 +12,7 @@ ConfigString configPathIntermediate("cage-asset-database/path/intermediate", Ass
 ConfigString configPathByNames("cage-asset-database/path/listByNames", AssetsDatabaseCreateConfig().outputListByNames);
 ConfigString configPathByIds("cage-asset-database/path/listByIds", AssetsDatabaseCreateConfig().outputListByIds);
 ConfigString configPathOutput("cage-asset-database/path/output", AssetsDatabaseCreateConfig().outputPath);
+ConfigString configPathCache("cage-asset-database/path/cache", AssetsDatabaseCreateConfig().cachePath);
 ConfigBool configOutputArchive("cage-asset-database/database/outputArchive", AssetsDatabaseCreateConfig().outputArchive);
 ConfigString configPathSchemes("cage-asset-database/path/schemes", "schemes");
 ConfigString configPathInjectedNames("cage-asset-database/path/injectNames", "");
@@ -57,6 +58,7 @@ int main(int argc, const char *args[])
 			cfg.outputListByNames = configPathByNames;
 			cfg.outputListByIds = configPathByIds;
 			cfg.outputPath = configPathOutput;
+			cfg.cachePath = configPathCache;
 			cfg.outputArchive = configOutputArchive;
 			try
 			{
@@ -2,32 +2,11 @@
 
 Holder<const AssetProcessor> processor;
 
-int main(int argc, const char *args[])
+namespace
 {
-	try
+	Delegate<void()> processFunction(const String &component)
 	{
-		Holder<AssetProcessor> ap = newAssetProcessor();
-		processor = ap.share();
-
-		if (argc == 3 && String(args[1]) == "analyze")
-		{
-			AssetProcessor::initializeSecondaryLog(pathJoin(configGetString("cage-asset-processor/analyzeLog/path", "analyze-log"), pathReplaceInvalidCharacters(args[2]) + ".log"));
-			CAGE_LOG(SeverityEnum::Info, "assetProcessor", Stringizer() + "analyzing input: " + args[2]);
-			ap->inputDirectory = pathExtractDirectory(args[2]);
-			ap->inputName = pathExtractFilename(args[2]);
-			ap->derivedProperties();
-			return processAnalyze();
-		}
-
-		if (argc != 2)
-			CAGE_THROW_ERROR(Exception, "missing asset type parameter");
-
-		ap->loadProperties();
-		ap->initializeSecondaryLog(pathJoin(configGetString("cage-asset-processor/processLog/path", "process-log"), pathReplaceInvalidCharacters(ap->inputName) + ".log"));
-		ap->logProperties();
-
 		Delegate<void()> func;
-		String component = String(args[1]);
 		if (component == "texture")
 			func.bind<processTexture>();
 		else if (component == "shader")
@@ -54,6 +33,66 @@ int main(int argc, const char *args[])
 			func.bind<processRaw>();
 		else
 			CAGE_THROW_ERROR(Exception, "invalid asset type parameter");
+		return func;
+	}
+
+	// processes many assets, each one is introduced by cage-asset line, until cage-quit is received
+	// any error terminates the worker, the database will start a new one
+	int processWorker(const String &component)
+	{
+		const Delegate<void()> func = processFunction(component);
+		while (true)
+		{
+			const String cmd = AssetProcessor::readLine();
+			if (cmd == "cage-quit")
+				return 0;
+			if (cmd != "cage-asset")
+			{
+				CAGE_LOG_THROW(Stringizer() + "line: " + cmd);
+				CAGE_THROW_ERROR(Exception, "unexpected worker command");
+			}
+
+			Holder<AssetProcessor> ap = newAssetProcessor();
+			processor = ap.share();
+			ap->loadProperties();
+			ap->initializeSecondaryLog(pathJoin(configGetString("cage-asset-processor/processLog/path", "process-log"), pathReplaceInvalidCharacters(ap->inputName) + ".log"));
+			ap->logProperties();
+
+			ap->writeLine("cage-begin");
+			func();
+			ap->writeLine("cage-end");
+			processor.clear();
+		}
+	}
+}
+
+int main(int argc, const char *args[])
+{
+	try
+	{
+		Holder<AssetProcessor> ap = newAssetProcessor();
+		processor = ap.share();
+
+		if (argc == 3 && String(args[1]) == "analyze")
+		{
+			AssetProcessor::initializeSecondaryLog(pathJoin(configGetString("cage-asset-processor/analyzeLog/path", "analyze-log"), pathReplaceInvalidCharacters(args[2]) + ".log"));
+			CAGE_LOG(SeverityEnum::Info, "assetProcessor", Stringizer() + "analyzing input: " + args[2]);
+			ap->inputDirectory = pathExtractDirectory(args[2]);
+			ap->inputName = pathExtractFilename(args[2]);
+			ap->derivedProperties();
+			return processAnalyze();
+		}
+
+		if (argc == 3 && String(args[2]) == "worker")
+			return processWorker(String(args[1]));
+
+		if (argc != 2)
+			CAGE_THROW_ERROR(Exception, "missing asset type parameter");
+
+		const Delegate<void()> func = processFunction(String(args[1]));
+		ap->loadProperties();
+		ap->initializeSecondaryLog(pathJoin(configGetString("cage-asset-processor/processLog/path", "process-log"), pathReplaceInvalidCharacters(ap->inputName) + ".log"));
+		ap->logProperties();
 
 		ap->writeLine("cage-begin");
 		func();
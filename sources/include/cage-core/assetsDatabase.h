@@ -83,6 +83,7 @@ namespace cage
 		String outputListByNames = "byName.txt";
 		String outputListByIds = "byId.txt";
 		String outputPath = "assets.carch";
+		String cachePath; // processed assets keyed by hash of their inputs, kept across databases, empty to disable
 		bool outputArchive = true;
 	};
 
@@ -32,8 +32,12 @@ namespace cage
 
 		// begin thread-safe methods
 
-		void load(uint32 assetId);
+		// assets with higher priority are fetched sooner, loading an asset again may only raise its priority
+		// negative priority marks background loading, which is limited by backgroundBandwidth
+		void load(uint32 assetId, sint32 priority = 0);
 		void unload(uint32 assetId);
+		// changes priority of an asset that is still waiting to be fetched
+		void prioritize(uint32 assetId, sint32 priority);
 		void reload(uint32 assetId);
 		void reloadAll();
 
@@ -95,6 +99,7 @@ namespace cage
 	{
 		String assetsFolderName = "assets.carch";
 		uint32 diskLoadingThreads = 2;
+		uint64 backgroundBandwidth = 0; // bytes per second for fetching assets with negative priority, 0 = unlimited
 		uint32 customProcessingThreads = 5;
 		uint32 schemesMaxCount = 100; // 0..49 for engine and 50..99 for the game
 	};
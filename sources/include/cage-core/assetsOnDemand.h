@@ -27,8 +27,9 @@ namespace cage
 			return get2_(detail::typeHash<T>(), assetId, autoLoad).template cast<T>();
 		}
 
-		void preload(uint32 assetId);
-		void preload(PointerRange<const uint32> assetsIds);
+		// priority is the highest of all requests for the asset since the last process call, see AssetsManager::load
+		void preload(uint32 assetId, sint32 priority = 0);
+		void preload(PointerRange<const uint32> assetsIds, sint32 priority = 0);
 
 		void process();
 		void clear();
@@ -54,6 +54,16 @@ namespace cage
 	};
 
 	CAGE_CORE_API Holder<Audio> newAudio();
+
+	// keeps compressed streams open between calls
+	// consecutive calls continue decoding without seeking, other calls seek as needed
+	class CAGE_CORE_API AudioDecoder : private Immovable
+	{
+	public:
+		void decode(uintPtr startFrame, PointerRange<float> buffer);
+	};
+
+	CAGE_CORE_API Holder<AudioDecoder> newAudioDecoder(Holder<const Audio> audio);
 }
 
 #endif // guard_audio_h_C930FD49904A491DBB9CF3D0AE972EB2
@@ -1,7 +1,7 @@
 #ifndef guard_audioChannelsConverter_h_56dtj4ew89a
 #define guard_audioChannelsConverter_h_56dtj4ew89a
 
-#include <cage-core/core.h>
+#include <cage-core/math.h>
 
 namespace cage
 {
@@ -9,6 +9,9 @@ namespace cage
 	{
 	public:
 		void convert(PointerRange<const float> src, PointerRange<float> dst, uint32 srcChannels, uint32 dstChannels);
+
+		// adds the converted samples multiplied by gain to the dst
+		void accumulate(PointerRange<const float> src, PointerRange<float> dst, uint32 srcChannels, uint32 dstChannels, Real gain = 1);
 	};
 
 	CAGE_CORE_API Holder<AudioChannelsConverter> newAudioChannelsConverter();
@@ -18,6 +18,9 @@ namespace cage
 		uint32 channels() const;
 
 		void process(PointerRange<const float> srcMono, PointerRange<float> dstPoly, const AudioDirectionalProcessConfig &config);
+
+		// adds the result multiplied by gain to the dstPoly
+		void accumulate(PointerRange<const float> srcMono, PointerRange<float> dstPoly, const AudioDirectionalProcessConfig &config, Real gain = 1);
 	};
 
 	struct CAGE_CORE_API AudioDirectionalConverterCreateConfig
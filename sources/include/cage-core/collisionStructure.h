@@ -9,6 +9,13 @@ namespace cage
 	struct CollisionPair;
 	struct SpatialStructureCreateConfig;
 
+	struct CollisionStructurePair
+	{
+		Holder<PointerRange<CollisionPair>> collisionPairs; // empty if the exact phase was not requested
+		uint32 a = m; // a < b
+		uint32 b = m;
+	};
+
 	class CAGE_CORE_API CollisionQuery : private Immovable
 	{
 	public:
@@ -34,6 +41,12 @@ namespace cage
 		bool query(Aabb shape);
 		bool query(Cone shape);
 		bool query(const Frustum &shape);
+
+		// finds all pairs of colliders in the structure that collide with each other
+		// with exact == false, returns all pairs whose bounding boxes overlap, without running the collision detection
+		// parallel runs the broad phase and the collision detection using the tasks threads
+		bool queryPairs(bool exact = true, bool parallel = false);
+		PointerRange<CollisionStructurePair> structurePairs() const;
 	};
 
 	class CAGE_CORE_API CollisionStructure : private Immovable
@@ -1,6 +1,11 @@
 #ifndef guard_concurrentQueue_h_F17509C840DB4228AF89C97FCD8EC1E5
 #define guard_concurrentQueue_h_F17509C840DB4228AF89C97FCD8EC1E5
 
+#include <atomic>
+#include <bit>
+#include <new>
+#include <vector>
+
 #include <cage-core/concurrent.h>
 
 namespace cage
@@ -152,6 +157,236 @@ namespace cage
 				items.erase(items.begin());
 		}
 	};
+
+	// lock-free bounded queue with the same interface as ConcurrentQueue
+	// the capacity is rounded up to power of two
+	// push/pop spin briefly and park the thread only when the queue is full/empty
+	// the SingleProducerSingleConsumer variant must be used by at most one producing and one consuming thread at a time
+	// moving the items must not throw
+	template<class T, bool SingleProducerSingleConsumer = false>
+	class ConcurrentBoundedQueue : private Immovable
+	{
+	public:
+		explicit ConcurrentBoundedQueue(uint32 maxItems = 1024) : cells(std::bit_ceil(maxItems < 2 ? 2u : maxItems)), mask(cells.size() - 1)
+		{
+			CAGE_ASSERT(maxItems != m);
+			for (uintPtr i = 0; i < cells.size(); i++)
+				cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		~ConcurrentBoundedQueue()
+		{
+			T tmp;
+			while (tryPopImpl(tmp))
+				;
+		}
+
+		void push(const T &value, bool ignoreStop = false) { push(T(value), ignoreStop); }
+
+		void push(T &&value, bool ignoreStop = false)
+		{
+			while (true)
+			{
+				checkStop(ignoreStop);
+				for (uint32 i = 0; i < SpinAttempts; i++)
+				{
+					if (tryPushImpl(value))
+						return;
+					threadPause();
+				}
+				writersParked = true;
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const uint32 ticket = popsCounter.load();
+				const bool ok = tryPushImpl(value);
+				if (!ok && (ignoreStop || !stop))
+					popsCounter.wait(ticket);
+				if (ok)
+					return;
+			}
+		}
+
+		bool tryPush(const T &value, bool ignoreStop = false)
+		{
+			checkStop(ignoreStop);
+			T tmp(value);
+			return tryPushImpl(tmp);
+		}
+
+		bool tryPush(T &&value, bool ignoreStop = false)
+		{
+			checkStop(ignoreStop);
+			return tryPushImpl(value);
+		}
+
+		void pop(T &value, bool ignoreStop = false)
+		{
+			while (true)
+			{
+				checkStop(ignoreStop);
+				for (uint32 i = 0; i < SpinAttempts; i++)
+				{
+					if (tryPopImpl(value))
+						return;
+					threadPause();
+				}
+				readersParked = true;
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const uint32 ticket = pushesCounter.load();
+				const bool ok = tryPopImpl(value);
+				if (!ok && (ignoreStop || !stop))
+					pushesCounter.wait(ticket);
+				if (ok)
+					return;
+			}
+		}
+
+		bool tryPop(T &value, bool ignoreStop = false)
+		{
+			checkStop(ignoreStop);
+			return tryPopImpl(value);
+		}
+
+		void terminate()
+		{
+			stop = true;
+			pushesCounter++;
+			popsCounter++;
+			pushesCounter.notify_all();
+			popsCounter.notify_all();
+		}
+
+		CAGE_FORCE_INLINE bool stopped() const { return stop; }
+
+		CAGE_FORCE_INLINE uint32 estimatedSize() const noexcept
+		{
+			const uintPtr e = enqueuePos.load(std::memory_order_relaxed);
+			const uintPtr d = dequeuePos.load(std::memory_order_relaxed);
+			return e > d ? numeric_cast<uint32>(e - d) : 0;
+		}
+
+		CAGE_FORCE_INLINE uint32 capacity() const noexcept { return numeric_cast<uint32>(cells.size()); }
+
+	protected:
+		static constexpr uint32 SpinAttempts = 50;
+
+		struct Cell
+		{
+			std::atomic<uintPtr> sequence = 0; // unused in single producer single consumer mode
+			alignas(T) char storage[sizeof(T)];
+
+			CAGE_FORCE_INLINE T *item() { return std::launder(reinterpret_cast<T *>(storage)); }
+		};
+
+		std::vector<Cell> cells;
+		const uintPtr mask = 0;
+		alignas(64) std::atomic<uintPtr> enqueuePos = 0;
+		uintPtr dequeueCache = 0; // producer only (single producer single consumer mode)
+		alignas(64) std::atomic<uintPtr> dequeuePos = 0;
+		uintPtr enqueueCache = 0; // consumer only (single producer single consumer mode)
+		alignas(64) std::atomic<uint32> pushesCounter = 0;
+		std::atomic<uint32> popsCounter = 0;
+		std::atomic<bool> readersParked = false;
+		std::atomic<bool> writersParked = false;
+		std::atomic<bool> stop = false;
+
+		CAGE_FORCE_INLINE void checkStop(bool ignoreStop) const
+		{
+			if (stop.load(std::memory_order_relaxed) && !ignoreStop)
+				CAGE_THROW_SILENT(ConcurrentQueueTerminated, "concurrent queue terminated");
+		}
+
+		bool tryPushImpl(T &value)
+		{
+			uintPtr pos = enqueuePos.load(std::memory_order_relaxed);
+			Cell *cell = nullptr;
+			if constexpr (SingleProducerSingleConsumer)
+			{
+				if (pos - dequeueCache > mask)
+				{
+					dequeueCache = dequeuePos.load(std::memory_order_acquire);
+					if (pos - dequeueCache > mask)
+						return false;
+				}
+				cell = &cells[pos & mask];
+				new (cell->storage) T(std::move(value));
+				enqueuePos.store(pos + 1, std::memory_order_release);
+			}
+			else
+			{
+				while (true)
+				{
+					cell = &cells[pos & mask];
+					const uintPtr seq = cell->sequence.load(std::memory_order_acquire);
+					const sintPtr dif = (sintPtr)seq - (sintPtr)pos;
+					if (dif == 0)
+					{
+						if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (dif < 0)
+						return false; // full
+					else
+						pos = enqueuePos.load(std::memory_order_relaxed);
+				}
+				new (cell->storage) T(std::move(value));
+				cell->sequence.store(pos + 1, std::memory_order_release);
+			}
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (readersParked.load(std::memory_order_relaxed) && readersParked.exchange(false))
+			{
+				pushesCounter++;
+				pushesCounter.notify_all();
+			}
+			return true;
+		}
+
+		bool tryPopImpl(T &value)
+		{
+			uintPtr pos = dequeuePos.load(std::memory_order_relaxed);
+			Cell *cell = nullptr;
+			if constexpr (SingleProducerSingleConsumer)
+			{
+				if (pos == enqueueCache)
+				{
+					enqueueCache = enqueuePos.load(std::memory_order_acquire);
+					if (pos == enqueueCache)
+						return false;
+				}
+				cell = &cells[pos & mask];
+				value = std::move(*cell->item());
+				cell->item()->~T();
+				dequeuePos.store(pos + 1, std::memory_order_release);
+			}
+			else
+			{
+				while (true)
+				{
+					cell = &cells[pos & mask];
+					const uintPtr seq = cell->sequence.load(std::memory_order_acquire);
+					const sintPtr dif = (sintPtr)seq - (sintPtr)(pos + 1);
+					if (dif == 0)
+					{
+						if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+							break;
+					}
+					else if (dif < 0)
+						return false; // empty
+					else
+						pos = dequeuePos.load(std::memory_order_relaxed);
+				}
+				value = std::move(*cell->item());
+				cell->item()->~T();
+				cell->sequence.store(pos + mask + 1, std::memory_order_release);
+			}
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (writersParked.load(std::memory_order_relaxed) && writersParked.exchange(false))
+			{
+				popsCounter++;
+				popsCounter.notify_all();
+			}
+			return true;
+		}
+	};
 }
 
 #endif // guard_concurrentQueue_h_F17509C840DB4228AF89C97FCD8EC1E5
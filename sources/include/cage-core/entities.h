@@ -9,6 +9,7 @@ namespace cage
 	class EntityManager;
 	class EntityComponent;
 	class Entity;
+	struct EntitiesChunk;
 
 	template<class T>
 	concept ComponentConcept = std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T> && std::is_same_v<std::remove_cvref_t<T>, T>;
@@ -47,6 +48,16 @@ namespace cage
 		void destroy(); // destroy all entities
 		void purge(); // destroy all entities (without any callbacks)
 
+		bool archetypes() const;
+		// requires archetypes storage
+		// chunks of all entities that have all the listed components
+		Holder<PointerRange<EntitiesChunk>> chunks(PointerRange<const EntityComponent *const> components) const;
+
+		// changes tracking: values written after this call are stamped with a newer version
+		// returns the version to pass to EntityComponent::changed next time to enumerate entities changed since now
+		// must not be called concurrently with modifications of any entities
+		uint32 changesCheckpoint();
+
 		EventDispatcher<bool(Entity *)> entityAdded;
 		EventDispatcher<bool(Entity *)> entityRemoved;
 
@@ -57,6 +68,7 @@ namespace cage
 	struct CAGE_CORE_API EntityManagerCreateConfig
 	{
 		bool linearAllocators = false; // much faster purge, but destroying entities or components will keep the memory allocated until purged
+		bool archetypes = false; // entities with same set of components store their values together in contiguous chunks - much faster iteration, but adding/removing components or destroying entities may move values of other entities
 	};
 
 	CAGE_CORE_API Holder<EntityManager> newEntityManager(const EntityManagerCreateConfig &config = {});
@@ -68,10 +80,34 @@ namespace cage
 		uint32 definitionIndex() const;
 		uint32 typeIndex() const;
 
-		PointerRange<Entity *const> entities() const;
+		PointerRange<Entity *const> entities() const; // with archetypes storage, the entities are grouped by archetypes (the list is lazily rebuilt after changes, do not call concurrently)
 		CAGE_FORCE_INLINE uint32 count() const { return numeric_cast<uint32>(entities().size()); }
 
 		void destroy(); // destroy all entities with this component
+
+		// opt-in, must be enabled before any entities are created
+		// entities are stamped when the component is added or marked as changed (see Entity::write)
+		void enableChangesTracking();
+		bool changesTracking() const;
+		// entities with this component that were changed after the checkpoint (use 0 to get all)
+		Holder<PointerRange<Entity *>> changed(uint32 since) const;
+	};
+
+	// entities from one archetype with their values stored in contiguous arrays
+	struct CAGE_CORE_API EntitiesChunk
+	{
+		PointerRange<Entity *const> entities;
+		const void *archetype = nullptr;
+		uint32 index = 0;
+
+		// array of values, in the same order as the entities
+		void *unsafeValues(const EntityComponent *component) const;
+		template<ComponentConcept T>
+		CAGE_FORCE_INLINE T *values(const EntityComponent *component) const
+		{
+			CAGE_ASSERT(component->typeIndex() == detail::typeIndex<T>());
+			return (T *)unsafeValues(component);
+		}
 	};
 
 	class CAGE_CORE_API Entity : private Immovable
@@ -143,6 +179,22 @@ namespace cage
 		}
 		void *unsafeValue(EntityComponent *component);
 
+		// write access that marks the value as changed for components with changes tracking
+		// marking is safe in parallel visitors, when each entity is accessed by one thread only
+		void markChanged(EntityComponent *component);
+		template<ComponentConcept T>
+		CAGE_FORCE_INLINE T &write(EntityComponent *component)
+		{
+			T &v = value<T>(component);
+			markChanged(component);
+			return v;
+		}
+		template<ComponentConcept T>
+		CAGE_FORCE_INLINE T &write()
+		{
+			return write<T>(component_<T>());
+		}
+
 		void destroy();
 
 	private:
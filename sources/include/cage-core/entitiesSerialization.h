@@ -11,6 +11,25 @@ namespace cage
 
 	CAGE_CORE_API Holder<PointerRange<char>> entitiesExportBuffer(PointerRange<Entity *const> entities, EntityComponent *component);
 	CAGE_CORE_API void entitiesImportBuffer(PointerRange<const char> buffer, EntityManager *manager);
+
+	// keeps a baseline of previously exported values and exports only the differences (changed parts of values, added/removed components, created/destroyed entities)
+	// the first export (and the first after reset) is a snapshot: it contains all values, and the importer destroys named entities and removes components that are not in it
+	// each delta must be imported exactly once, in the same order as exported, into a manager with the same components defined
+	class CAGE_CORE_API EntitiesDeltaExporter : private Immovable
+	{
+	public:
+		Holder<PointerRange<char>> exportBuffer(PointerRange<Entity *const> entities, PointerRange<EntityComponent *const> components); // returns empty buffer if there are no changes
+		void reset(); // forget the baseline, the next export is a snapshot
+	};
+
+	struct CAGE_CORE_API EntitiesDeltaExporterCreateConfig
+	{
+		bool compress = false; // compress the deltas with memoryCompress
+	};
+
+	CAGE_CORE_API Holder<EntitiesDeltaExporter> newEntitiesDeltaExporter(const EntitiesDeltaExporterCreateConfig &config = {});
+
+	CAGE_CORE_API void entitiesImportDelta(PointerRange<const char> buffer, EntityManager *manager);
 }
 
 #endif // guard_entitiesSerialization_sdrgdfzj5hsdet
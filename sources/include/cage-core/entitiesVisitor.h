@@ -5,7 +5,9 @@
 #include <tuple>
 #include <vector>
 
+#include <cage-core/concurrent.h>
 #include <cage-core/entities.h>
+#include <cage-core/tasks.h>
 
 namespace cage
 {
@@ -61,6 +63,15 @@ namespace cage
 				visitor(((e->value<std::decay_t<std::tuple_element_t<I, Types>>>(components[I])))...);
 		}
 
+		template<bool UseEnt, class Visitor, class Types, std::size_t... I>
+		CAGE_FORCE_INLINE void invokeVisitorChunk(const Visitor &visitor, void *values[], Entity *e, uint32 i, std::index_sequence<I...>)
+		{
+			if constexpr (UseEnt)
+				visitor(e, (((std::decay_t<std::tuple_element_t<I, Types>> *)values[I])[i])...);
+			else
+				visitor((((std::decay_t<std::tuple_element_t<I, Types>> *)values[I])[i])...);
+		}
+
 		template<bool ArrayCopy>
 		struct VectorOrNothing
 		{};
@@ -106,6 +117,25 @@ namespace cage
 				EntityComponent *cmps[typesCount - offset] = {};
 				for (uint32 i = 0; i < typesCount - offset; i++)
 					cmps[i] = components[i + offset];
+
+				if constexpr (!ArrayCopy)
+				{
+					if (ents->archetypes())
+					{
+						const auto chunks = ents->chunks(PointerRange<EntityComponent *>(std::begin(cmps), std::end(cmps)).template cast<const EntityComponent *const>());
+						for (const EntitiesChunk &ch : chunks)
+						{
+							void *values[typesCount] = {};
+							for (uint32 i = offset; i < typesCount; i++)
+								values[i] = ch.unsafeValues(components[i]);
+							const uint32 cnt = numeric_cast<uint32>(ch.entities.size());
+							for (uint32 i = 0; i < cnt; i++)
+								invokeVisitorChunk<useEnt, Visitor, Types>(visitor, values, ch.entities[i], i, Sequence());
+						}
+						return;
+					}
+				}
+
 				std::sort(std::begin(cmps), std::end(cmps), [](EntityComponent *a, EntityComponent *b) { return a->count() < b->count(); });
 				PointerRange conds = PointerRange(std::begin(cmps) + 1, std::end(cmps)).template cast<const EntityComponent *>();
 
@@ -124,9 +154,109 @@ namespace cage
 				}
 			}
 		}
+
+		template<class Visitor>
+		void entitiesVisitorParallel(const Visitor &visitor, const EntityManager *ents, uint32 minGroupSize)
+		{
+			using Types = typename LambdaParamsPack<Visitor>::Params;
+			static constexpr uint32 typesCount = std::tuple_size_v<Types>;
+			static_assert(typesCount > 0);
+			static constexpr bool useEnt = std::is_same_v<std::tuple_element_t<0, Types>, Entity *>;
+			static constexpr std::size_t offset = useEnt ? 1 : 0;
+			using Sequence = offset_sequence_t<offset, std::make_index_sequence<typesCount - offset>>;
+
+			struct Job
+			{
+				const Visitor &visitor;
+				EntityComponent *components[typesCount] = {};
+				PointerRange<const EntityComponent *> conds;
+				PointerRange<Entity *const> range;
+				PointerRange<const EntitiesChunk> chunks;
+				uint32 groups = 0;
+
+				Job(const Visitor &visitor) : visitor(visitor) {}
+
+				void operator()(uint32 idx)
+				{
+					if constexpr (useEnt && typesCount == 1)
+					{
+						const auto r = tasksSplit(idx, groups, numeric_cast<uint32>(range.size()));
+						for (uint32 i = r.first; i < r.second; i++)
+							visitor(range[i]);
+					}
+					else if (!chunks.empty())
+					{
+						const auto r = tasksSplit(idx, groups, numeric_cast<uint32>(chunks.size()));
+						for (uint32 c = r.first; c < r.second; c++)
+						{
+							const EntitiesChunk &ch = chunks[c];
+							void *values[typesCount] = {};
+							for (uint32 i = offset; i < typesCount; i++)
+								values[i] = ch.unsafeValues(components[i]);
+							const uint32 cnt = numeric_cast<uint32>(ch.entities.size());
+							for (uint32 i = 0; i < cnt; i++)
+								invokeVisitorChunk<useEnt, Visitor, Types>(visitor, values, ch.entities[i], i, Sequence());
+						}
+					}
+					else
+					{
+						const auto r = tasksSplit(idx, groups, numeric_cast<uint32>(range.size()));
+						for (uint32 i = r.first; i < r.second; i++)
+						{
+							Entity *e = range[i];
+							if (!e->has(conds))
+								continue;
+							invokeVisitor<useEnt, Visitor, Types>(visitor, components, e, Sequence());
+						}
+					}
+				}
+			};
+
+			Job job(visitor);
+			uint32 items = 0;
+			Holder<PointerRange<EntitiesChunk>> chunks;
+			EntityComponent *cmps[typesCount] = {};
+
+			if constexpr (useEnt && typesCount == 1)
+			{
+				job.range = ents->entities();
+				items = numeric_cast<uint32>(job.range.size());
+			}
+			else
+			{
+				fillComponentsArray<Types>(ents, job.components, Sequence());
+				for (uint32 i = 0; i < typesCount - offset; i++)
+					cmps[i] = job.components[i + offset];
+				const PointerRange<EntityComponent *> cs = { std::begin(cmps), std::begin(cmps) + typesCount - offset };
+				if (ents->archetypes())
+				{
+					chunks = ents->chunks(cs.template cast<const EntityComponent *const>());
+					job.chunks = *chunks;
+					items = numeric_cast<uint32>(job.chunks.size());
+					minGroupSize = 1; // each chunk already contains many entities
+				}
+				else
+				{
+					std::sort(cs.begin(), cs.end(), [](EntityComponent *a, EntityComponent *b) { return a->count() < b->count(); });
+					job.conds = PointerRange(cs.begin() + 1, cs.end()).template cast<const EntityComponent *>();
+					job.range = cs[0]->entities();
+					items = numeric_cast<uint32>(job.range.size());
+				}
+			}
+
+			minGroupSize = std::max(minGroupSize, 1u);
+			job.groups = std::min((items + minGroupSize - 1) / minGroupSize, processorsCount() * 4);
+			if (job.groups == 0)
+				return;
+			if (job.groups == 1)
+				job(0);
+			else
+				cage::tasksRunBlocking<Job>("entities visitor", job, job.groups);
+		}
 	}
 
 	// arrayCopy == true makes copy of the array to iterate over thus allowing to add/destroy entities or components
+	// with archetypes storage and arrayCopy == false, the values are accessed directly in the chunks
 	template<class Visitor>
 	CAGE_FORCE_INLINE void entitiesVisitor(const Visitor &visitor, const EntityManager *ents, bool arrayCopy)
 	{
@@ -135,6 +265,17 @@ namespace cage
 		else
 			privat::entitiesVisitor<false>(visitor, ents);
 	}
+
+	// invokes the visitor on multiple threads (using the tasks system), the entities are split into groups of at least minGroupSize entities
+	// the visitor may read and write values of the visited entity only
+	// the visitor must not add/remove components, create/destroy entities, or access values of other entities, unless synchronized externally
+	// the visitor is invoked concurrently, the order of entities is unspecified
+	// returns after all entities were visited, exceptions from the visitor are rethrown
+	template<class Visitor>
+	CAGE_FORCE_INLINE void entitiesVisitorParallel(const Visitor &visitor, const EntityManager *ents, uint32 minGroupSize = 256)
+	{
+		privat::entitiesVisitorParallel(visitor, ents, minGroupSize);
+	}
 }
 
 #endif // guard_entitiesVisitor_h_m1nb54v6sre8t
@@ -74,6 +74,18 @@ namespace cage
 	CAGE_CORE_API Holder<File> newFileBuffer(MemoryBuffer &&buffer, FileMode mode = FileMode(true, true));
 	CAGE_CORE_API Holder<File> newFileBuffer();
 
+	struct CAGE_CORE_API FileReadRequest
+	{
+		File *file = nullptr;
+		PointerRange<char> buffer;
+		uint64 at = 0; // position in the file, the current position of the file is not changed
+	};
+
+	// performs multiple reads at once, the files must stay open until it returns
+	// reads from real files, including unmodified files in carch archives, are submitted together through io_uring on linux, when available
+	// other reads are done one after another
+	CAGE_CORE_API void filesReadBatch(PointerRange<const FileReadRequest> requests);
+
 	// receive operating system issued notifications about filesystem changes
 	// use registerPath to add a folder (and all of its subdirectories) to the watch list
 	// (has limited support for virtual file redirections)
@@ -16,6 +16,14 @@ namespace cage
 	CAGE_CORE_API Holder<PointerRange<char>> imageBc4Encode(const Image *image, const ImageBcnEncodeConfig &config = {});
 	CAGE_CORE_API Holder<PointerRange<char>> imageBc5Encode(const Image *image, const ImageBcnEncodeConfig &config = {});
 	CAGE_CORE_API Holder<PointerRange<char>> imageBc7Encode(const Image *image, const ImageBcnEncodeConfig &config = {});
+
+	// encodes multiple images at once (eg. mipmap levels or array layers), all blocks are processed in parallel
+	CAGE_CORE_API Holder<PointerRange<Holder<PointerRange<char>>>> imageBc1Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config = {});
+	CAGE_CORE_API Holder<PointerRange<Holder<PointerRange<char>>>> imageBc3Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config = {});
+	CAGE_CORE_API Holder<PointerRange<Holder<PointerRange<char>>>> imageBc4Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config = {});
+	CAGE_CORE_API Holder<PointerRange<Holder<PointerRange<char>>>> imageBc5Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config = {});
+	CAGE_CORE_API Holder<PointerRange<Holder<PointerRange<char>>>> imageBc7Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config = {});
+
 	CAGE_CORE_API Holder<Image> imageBc1Decode(PointerRange<const char> buffer, const Vec2i &resolution);
 	CAGE_CORE_API Holder<Image> imageBc2Decode(PointerRange<const char> buffer, const Vec2i &resolution);
 	CAGE_CORE_API Holder<Image> imageBc3Decode(PointerRange<const char> buffer, const Vec2i &resolution);
@@ -6,13 +6,14 @@
 namespace cage
 {
 	// fastest memory allocator
-	// individual deallocations are forbidden
+	// individual deallocations are forbidden (or ignored)
 	// always use flush to clear all allocations
-	// allocations can have any sizes and alignments (within the block size)
+	// allocations can have any sizes and alignments (allocations larger than the block size get dedicated blocks)
 
 	struct CAGE_CORE_API MemoryAllocatorLinearCreateConfig
 	{
 		uintPtr blockSize = 4 * 1024 * 1024;
+		bool ignoreDeallocations = false; // deallocations do nothing instead of throwing, allows use in std containers (eg. for per-frame temporary data)
 	};
 
 	CAGE_CORE_API Holder<MemoryArena> newMemoryAllocatorLinear(const MemoryAllocatorLinearCreateConfig &config);
@@ -12,6 +12,52 @@ namespace cage
 	CAGE_CORE_API void memoryCompress(PointerRange<const char> input, PointerRange<char> &output, sint32 preference = 90);
 	CAGE_CORE_API void memoryDecompress(PointerRange<const char> input, PointerRange<char> &output);
 	CAGE_CORE_API uintPtr compressionBound(uintPtr size);
+
+	struct MemoryBuffer;
+
+	// dictionaries improve compression of many small buffers of similar kind (texts, small meshes, snapshots, etc.)
+	// train the dictionary from representative samples; the same dictionary is required for both compression and decompression
+	CAGE_CORE_API Holder<PointerRange<char>> memoryCompressionTrainDictionary(PointerRange<const PointerRange<const char>> samples, uintPtr maxSize = 100 * 1024);
+
+	struct CompressorCreateConfig
+	{
+		PointerRange<const char> dictionary; // optional, the dictionary is copied
+		sint32 preference = 90;
+	};
+
+	// reusable compression context avoids repeated allocations
+	// not thread-safe
+	class CAGE_CORE_API Compressor : private Immovable
+	{
+	public:
+		Holder<PointerRange<char>> compress(PointerRange<const char> input);
+		Holder<PointerRange<char>> decompress(PointerRange<const char> input, uintPtr outputSize);
+		void compress(PointerRange<const char> input, PointerRange<char> &output);
+		void decompress(PointerRange<const char> input, PointerRange<char> &output);
+	};
+
+	CAGE_CORE_API Holder<Compressor> newCompressor(const CompressorCreateConfig &config = {});
+
+	// compresses data fed in arbitrary chunks, using bounded memory
+	// not thread-safe
+	class CAGE_CORE_API CompressionStream : private Immovable
+	{
+	public:
+		void compress(PointerRange<const char> input, MemoryBuffer &output); // appends available compressed data to the output, some data may be retained internally
+		void finish(MemoryBuffer &output); // appends all remaining data and ends the frame, the stream may be used to compress another frame afterwards
+	};
+
+	CAGE_CORE_API Holder<CompressionStream> newCompressionStream(const CompressorCreateConfig &config = {});
+
+	// decompresses data fed in arbitrary chunks, using bounded memory
+	// not thread-safe
+	class CAGE_CORE_API DecompressionStream : private Immovable
+	{
+	public:
+		bool decompress(PointerRange<const char> input, MemoryBuffer &output); // appends decompressed data to the output, returns true if all frames in the input so far are complete
+	};
+
+	CAGE_CORE_API Holder<DecompressionStream> newDecompressionStream(const CompressorCreateConfig &config = {}); // the preference is ignored
 }
 
 #endif // guard_memoryCompression_h_edrz4gh6ret54zh6r4t
@@ -1,6 +1,7 @@
 #ifndef guard_networkGinnel_h_yxdrz748wq
 #define guard_networkGinnel_h_yxdrz748wq
 
+#include <cage-core/math.h>
 #include <cage-core/networkUtils.h>
 
 namespace cage
@@ -33,6 +34,23 @@ namespace cage
 		uint64 ppsDelivered() const;
 	};
 
+	// simulated network conditions, applied to outgoing packets of a connection
+	// all random decisions are made by a generator initialized from the seed, therefore the same sequence of packets is affected the same way in every run
+	// delayed packets are sent during updates of the connection, therefore the delays are rounded up to the update period
+	// if all values are zero, the simulation is configured by the config variables cage/ginnel/simulation/*
+	struct CAGE_CORE_API GinnelSimulationConfig
+	{
+		uint64 seed = 0;
+		uint64 latency = 0; // one way delay (in microseconds)
+		uint64 jitter = 0; // maximum random additional delay (in microseconds), preserves order of packets
+		uint64 reorderDelay = 0; // additional delay (in microseconds) of packets chosen by reorderChance
+		uint64 bandwidth = 0; // bytes per second, 0 = unlimited
+		uint64 queueSize = 64 * 1024; // bytes waiting for the bandwidth, additional packets are dropped
+		Real lossChance = 0;
+		Real duplicateChance = 0;
+		Real reorderChance = 0;
+	};
+
 	struct CAGE_CORE_API GinnelRemoteInfo
 	{
 		String address;
@@ -55,7 +73,7 @@ namespace cage
 		// update also manages timeouts and resending, therefore it should be called periodically even if you wrote nothing
 		void update();
 
-		const GinnelStatistics &statistics() const;
+		GinnelStatistics statistics() const;
 
 		// successfully completed connection initialization
 		bool established() const;
@@ -66,6 +84,7 @@ namespace cage
 	// non-zero timeout will block the caller for up to the specified time to ensure that the connection is established and throw an exception otherwise
 	// zero timeout will return immediately and the connection will be established progressively as you use it
 	CAGE_CORE_API Holder<GinnelConnection> newGinnelConnection(const String &address, uint16 port, uint64 timeout);
+	CAGE_CORE_API Holder<GinnelConnection> newGinnelConnection(const String &address, uint16 port, uint64 timeout, const GinnelSimulationConfig &simulation);
 
 	class CAGE_CORE_API GinnelServer : private Immovable
 	{
@@ -74,8 +93,29 @@ namespace cage
 
 		// returns empty holder if no new peer has connected
 		Holder<GinnelConnection> accept(); // non-blocking
+
+		// requires ioThreads > 0
+		// blocks until any accepted connection has messages to read, a new peer is waiting to be accepted, or the timeout (in microseconds) expires
+		// returns the connections that have messages to read (or were disconnected), call accept separately
+		Holder<PointerRange<GinnelConnection *>> wait(uint64 timeout);
+	};
+
+	struct CAGE_CORE_API GinnelServerCreateConfig
+	{
+		uint16 port = 0;
+
+		// number of threads that update all accepted connections in the background
+		// 0 = the application must call update on each connection
+		// connections accepted by a server with io threads are thread-safe, and calling update on them is optional
+		uint32 ioThreads = 0;
+
+		uint64 activePeriod = 10'000; // update period for connections with data in flight (in microseconds)
+		uint64 idlePeriod = 100'000; // update period for the other connections (in microseconds)
+
+		GinnelSimulationConfig simulation; // applied to all accepted connections
 	};
 
+	CAGE_CORE_API Holder<GinnelServer> newGinnelServer(const GinnelServerCreateConfig &config); // non-blocking
 	CAGE_CORE_API Holder<GinnelServer> newGinnelServer(uint16 port); // non-blocking
 }
 
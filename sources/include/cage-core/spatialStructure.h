@@ -9,6 +9,7 @@ namespace cage
 	{
 	public:
 		PointerRange<uint32> result() const;
+		PointerRange<uint32> result(uint32 batchIndex) const; // results of one shape of the last batched query
 
 		bool intersection(Vec3 shape);
 		bool intersection(Line shape);
@@ -18,6 +19,34 @@ namespace cage
 		bool intersection(Aabb shape);
 		bool intersection(Cone shape);
 		bool intersection(const Frustum &shape);
+
+		// batched queries traverse the tree with packets of several shapes at once
+		// result() returns results of all shapes concatenated, result(index) returns results of one shape
+		// parallel distributes the packets among the tasks threads
+		bool intersection(PointerRange<const Line> shapes, bool parallel = false);
+		bool intersection(PointerRange<const Sphere> shapes, bool parallel = false);
+		bool intersection(PointerRange<const Aabb> shapes, bool parallel = false);
+		bool intersection(PointerRange<const Frustum> shapes, bool parallel = false);
+
+		// finds all pairs of items whose bounding boxes overlap (broad phase)
+		// result() returns the names of the pairs interleaved (a0, b0, a1, b1, ...), with a < b in each pair
+		// each pair is reported once, the order of the pairs is unspecified
+		bool pairs(bool parallel = false);
+	};
+
+	struct CAGE_CORE_API SpatialStructureStatistics
+	{
+		Real sahCost; // surface area heuristic cost of the tree relative to the root, lower is better
+		uint64 lastRebuildDuration = 0; // microseconds
+		uint32 items = 0;
+		uint32 nodes = 0; // nodes reachable from the root
+		uint32 leafs = 0;
+		uint32 depth = 0;
+		uint32 garbageNodes = 0; // nodes left unused after subtree rebuilds
+		uint32 fullRebuilds = 0;
+		uint32 incrementalRebuilds = 0;
+		uint32 subtreeRebuilds = 0;
+		uint32 lastRefittedNodes = 0;
 	};
 
 	class CAGE_CORE_API SpatialStructure : private Immovable
@@ -32,11 +61,21 @@ namespace cage
 		void remove(uint32 name);
 		void clear();
 		void rebuild();
+		SpatialStructureStatistics statistics() const;
 	};
 
 	struct CAGE_CORE_API SpatialStructureCreateConfig
 	{
 		uint32 reserve = 0;
+
+		// nodes with more items are built using multiple threads
+		uint32 parallelBuildThreshold = 50'000;
+
+		// incremental mode: rebuild after updating existing items only refits the bounding boxes of the affected nodes
+		// subtrees whose surface grew by more than the threshold (relative to when they were built) are rebuilt
+		// adding or removing items still requires full rebuild
+		Real subtreeRebuildThreshold = 2;
+		bool incremental = false;
 	};
 
 	CAGE_CORE_API Holder<SpatialStructure> newSpatialStructure(const SpatialStructureCreateConfig &config);
@@ -22,6 +22,8 @@ namespace cage
 		LodSelection(Vec3 center, const CameraComponent &cam, sint32 screenHeightPx);
 
 		uint32 selectLod(const Vec3 position, const RenderObject *object) const;
+		// objects larger on screen have higher priority, priority is negative (background loading) when another lod is available
+		sint32 loadPriority(const Vec3 position, const RenderObject *object, bool fallbackAvailable) const;
 		void selectModels(std::vector<Holder<Model>> &outModels, const Vec3 position, const RenderObject *object, AssetsOnDemand *assets) const;
 		void selectModels(std::vector<Holder<Model>> &outModels, const Vec3 position, const RenderObject *object, const AssetsManager *assets) const;
 	};
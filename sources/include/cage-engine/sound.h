@@ -6,6 +6,7 @@
 namespace cage
 {
 	class Audio;
+	class AudioDecoder;
 
 	class CAGE_ENGINE_API Sound : private Immovable
 	{
@@ -21,7 +22,9 @@ namespace cage
 		uint32 sampleRate() const;
 		uint64 duration() const; // microseconds
 
-		void decode(sintPtr startFrame, PointerRange<float> buffer, bool loop) const;
+		// the decoder keeps the stream open between consecutive calls, use one decoder per playing voice
+		Holder<AudioDecoder> newDecoder() const;
+		void decode(sintPtr startFrame, PointerRange<float> buffer, bool loop, AudioDecoder *decoder = nullptr) const;
 
 		// requires matching sample rate and channels
 		void process(const SoundCallbackData &data, bool loop) const;
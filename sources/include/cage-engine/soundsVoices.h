@@ -31,6 +31,7 @@ namespace cage
 		uint32 maxSounds = 30;
 		Real maxGain = Real::Infinity(); // all sounds will have proportionally reduced gain when number of sounds reaches this threshold
 		Real gain = 1; // linear amplitude multiplier
+		uint32 parallelVoices = 0; // mix the voices using the tasks system when there are at least this many voices, 0 to disable; voice callbacks are invoked concurrently then
 
 		Holder<Voice> newVoice();
 
@@ -1,4 +1,4 @@
-#include <cstdio> // fgets, ferror
+#include <cstdio> // fgets, ferror, fflush
 #include <cstring> // strlen
 
 #include <unordered_dense.h>
@@ -158,6 +158,12 @@ namespace cage
 		}
 		if (fprintf(stdout, "%s\n", other.c_str()) < 0)
 			CAGE_THROW_ERROR(SystemError, "fprintf", ferror(stdout));
+		if (other == "cage-end" || other == "cage-error")
+		{
+			// the database waits for the end of the response, which stays in the buffer of a persistent worker otherwise
+			if (fflush(stdout) != 0)
+				CAGE_THROW_ERROR(SystemError, "fflush", ferror(stdout));
+		}
 	}
 
 	void AssetProcessor::initializeSecondaryLog(const String &path)
@@ -17,6 +17,7 @@
 #include <cage-core/hashString.h>
 #include <cage-core/logger.h>
 #include <cage-core/math.h>
+#include <cage-core/memoryBuffer.h>
 #include <cage-core/memoryCompression.h>
 #include <cage-core/networkTcp.h>
 #include <cage-core/pointerRangeHolder.h>
@@ -59,6 +60,8 @@ namespace cage
 		struct Asset : public AssetContext
 		{
 			Holder<void> ref; // the application receives shares of the ref, its destructor will call a method in the AssetsManager to schedule the asset for unloading
+			Holder<File> prefetched; // file opened (and possibly read) ahead of fetching
+			std::atomic<sint32> priority = 0;
 			bool failed = false;
 			bool unloading = false;
 
@@ -75,6 +78,7 @@ namespace cage
 		{
 			ankerl::svector<Holder<Asset>, 1> versions;
 			sint32 references = 0; // how many times was the asset added in the api
+			sint32 priority = 0; // priority for new versions of the asset
 			bool fabricated = false; // once a fabricated asset is added to the collection, all future requests for reload are ignored
 		};
 
@@ -87,6 +91,7 @@ namespace cage
 			Work(Work &&other) { std::swap(asset, other.asset); }
 			Work &operator=(Work &&other)
 			{
+				finish();
 				std::swap(asset, other.asset);
 				return *this;
 			}
@@ -110,6 +115,118 @@ namespace cage
 			~Waiting();
 		};
 
+		// fetch requests ordered by priority, and by order of arrival within same priority
+		// requests with negative priority are paced to not exceed the bandwidth
+		class FetchQueue : private Immovable
+		{
+			struct Item
+			{
+				Work work;
+				sint32 priority = 0;
+				uint64 sequence = 0;
+
+				bool operator<(const Item &other) const
+				{
+					if (priority != other.priority)
+						return priority < other.priority;
+					return sequence > other.sequence;
+				}
+			};
+
+			Holder<Mutex> mut = newMutex();
+			Holder<ConditionalVariable> cond = newConditionalVariable();
+			std::vector<Item> items; // heap
+			const uint64 bandwidth = 0;
+			uint64 sequence = 0;
+			uint64 pacedUntil = 0; // background requests must wait until this time
+			bool reorder = false;
+			bool stop = false;
+
+			static constexpr uint64 BurstDuration = 100'000;
+			static constexpr uint64 MaxSleep = 5'000;
+
+		public:
+			explicit FetchQueue(uint64 bandwidth) : bandwidth(bandwidth) {}
+
+			void push(Work &&work)
+			{
+				ScopeLock sl(mut);
+				if (stop)
+					CAGE_THROW_SILENT(ConcurrentQueueTerminated, "fetch queue terminated");
+				const sint32 p = work.asset->priority;
+				items.push_back(Item{ std::move(work), p, sequence++ });
+				std::push_heap(items.begin(), items.end());
+				cond->signal();
+			}
+
+			// pops at least one request, and more of those immediately available, up to maxCount
+			// background requests are popped one at a time to allow pacing
+			void pop(std::vector<Work> &out, uint32 maxCount)
+			{
+				while (true)
+				{
+					uint64 delay = 0;
+					{
+						ScopeLock sl(mut);
+						if (stop)
+							CAGE_THROW_SILENT(ConcurrentQueueTerminated, "fetch queue terminated");
+						if (items.empty())
+						{
+							cond->wait(sl);
+							continue;
+						}
+						if (reorder)
+						{
+							for (Item &it : items)
+								it.priority = it.work.asset->priority;
+							std::make_heap(items.begin(), items.end());
+							reorder = false;
+						}
+						const uint64 now = bandwidth && items.front().priority < 0 ? applicationTime() : m;
+						if (now < pacedUntil)
+							delay = min(pacedUntil - now, MaxSleep);
+						else
+						{
+							do
+							{
+								std::pop_heap(items.begin(), items.end());
+								out.push_back(std::move(items.back().work));
+								items.pop_back();
+							} while (out.size() < maxCount && !items.empty() && !(bandwidth && items.front().priority < 0));
+							return;
+						}
+					}
+					threadSleep(delay); // sleep without the lock, more important requests may arrive meanwhile
+				}
+			}
+
+			// the priority of some requests has changed
+			void invalidate()
+			{
+				ScopeLock sl(mut);
+				reorder = true;
+			}
+
+			// account for bytes fetched by a background request
+			void consume(uint64 bytes)
+			{
+				if (!bandwidth)
+					return;
+				ScopeLock sl(mut);
+				const uint64 now = applicationTime();
+				pacedUntil = max(pacedUntil, now > BurstDuration ? now - BurstDuration : 0) + bytes * 1'000'000 / bandwidth;
+			}
+
+			void terminate()
+			{
+				ScopeLock sl(mut);
+				stop = true;
+				cond->broadcast();
+			}
+		};
+
+		void prefetch(PointerRange<Work> works);
+
 		class KeepOpen : private Immovable
 		{
 			Holder<Mutex> mut = newMutex();
@@ -174,11 +291,11 @@ namespace cage
 			ankerl::unordered_dense::map<uint32, std::vector<Holder<Waiting>>> waitingIndex;
 			std::vector<Holder<ConcurrentQueue<Work, RingBuffer>>> customProcessingQueues;
 			ConcurrentQueue<Holder<AsyncTask>, RingBuffer> tasksCleanupQueue;
-			ConcurrentQueue<Work, RingBuffer> fetchQueue;
+			FetchQueue fetchQueue;
 			std::vector<Holder<Thread>> fetchThreads;
 			Holder<void> listener;
 
-			AssetsManagerImpl(const AssetsManagerCreateConfig &config) : path(findAssetsFolderPath(config))
+			AssetsManagerImpl(const AssetsManagerCreateConfig &config) : path(findAssetsFolderPath(config)), fetchQueue(config.backgroundBandwidth)
 			{
 				CAGE_LOG(SeverityEnum::Info, "assetsManager", Stringizer() + "using assets path: " + path);
 				schemes.resize(config.schemesMaxCount);
@@ -202,6 +319,9 @@ namespace cage
 
 			void diskLoadingEntry()
 			{
+				static constexpr uint32 MaxFetchBatch = 32;
+				std::vector<Work> works;
+				works.reserve(MaxFetchBatch);
 				try
 				{
 					while (true)
@@ -217,11 +337,11 @@ namespace cage
 								break;
 							}
 						}
-						{
-							Work w;
-							fetchQueue.pop(w);
+						fetchQueue.pop(works, MaxFetchBatch);
+						prefetch(works);
+						for (Work &w : works)
 							w.doFetch();
-						}
+						works.clear();
 					}
 				}
 				catch (const ConcurrentQueueTerminated &)
@@ -421,8 +541,11 @@ namespace cage
 			CAGE_ASSERT(asset->scheme < asset->impl()->schemes.size());
 			CAGE_ASSERT(asset->threadIndex == m || asset->threadIndex < asset->impl()->customProcessingQueues.size());
 
+			if (asset->priority < 0)
+				asset->impl()->fetchQueue.consume(asset->compressedData ? asset->compressedData.size() : asset->originalData ? asset->originalData.size() : 0);
+
 			for (uint32 n : asset->dependencies)
-				asset->impl()->load(n);
+				asset->impl()->load(n, asset->priority); // dependencies inherit the priority
 
 			if (asset->decompress && asset->compressedData.size())
 				asset->impl()->enqueueDecompress(asset.share());
@@ -555,7 +678,7 @@ namespace cage
 		}
 	}
 
-	void AssetsManager::load(uint32 assetId)
+	void AssetsManager::load(uint32 assetId, sint32 priority)
 	{
 		CAGE_ASSERT(assetId != 0 && assetId != m);
 		AssetsManagerImpl *impl = (AssetsManagerImpl *)this;
@@ -563,11 +686,18 @@ namespace cage
 		auto &c = impl->privateIndex[assetId];
 		if (c.references++ == 0)
 		{
+			c.priority = priority;
 			Holder<Asset> asset = systemMemory().createHolder<Asset>(impl, assetId);
+			asset->priority = priority;
 			c.versions.insert(c.versions.begin(), asset.share());
 			lock.clear();
 			impl->fetchQueue.push(std::move(asset));
 		}
+		else if (priority > c.priority)
+		{
+			lock.clear();
+			prioritize(assetId, priority);
+		}
 	}
 
 	void AssetsManager::unload(uint32 assetId)
@@ -588,6 +718,22 @@ namespace cage
 		}
 	}
 
+	void AssetsManager::prioritize(uint32 assetId, sint32 priority)
+	{
+		CAGE_ASSERT(assetId != 0 && assetId != m);
+		AssetsManagerImpl *impl = (AssetsManagerImpl *)this;
+		{
+			ScopeLock lock(impl->privateMutex);
+			auto it = impl->privateIndex.find(assetId);
+			if (it == impl->privateIndex.end() || it->second.priority == priority)
+				return;
+			it->second.priority = priority;
+			for (const auto &v : it->second.versions)
+				v->priority = priority;
+		}
+		impl->fetchQueue.invalidate();
+	}
+
 	void AssetsManager::reload(uint32 assetId)
 	{
 		CAGE_ASSERT(assetId != 0 && assetId != m);
@@ -600,6 +746,7 @@ namespace cage
 		if (!c.fabricated && c.references > 0)
 		{
 			Holder<Asset> asset = systemMemory().createHolder<Asset>(impl, assetId);
+			asset->priority = c.priority;
 			c.versions.insert(c.versions.begin(), asset.share());
 			lock.clear();
 			impl->fetchQueue.push(std::move(asset));
@@ -615,6 +762,7 @@ namespace cage
 			if (it.second.fabricated || it.second.references <= 0)
 				continue;
 			Holder<Asset> asset = systemMemory().createHolder<Asset>(impl, it.first);
+			asset->priority = it.second.priority;
 			it.second.versions.insert(it.second.versions.begin(), asset.share());
 			impl->fetchQueue.push(std::move(asset));
 		}
@@ -862,28 +1010,81 @@ namespace cage
 	{
 		constexpr uint32 CurrentAssetVersion = 4;
 
-		void defaultFetch(AssetContext *asset)
+		Holder<File> findAssetFile(AssetsManagerImpl *impl, uint32 assetId)
 		{
-			AssetsManagerImpl *impl = ((Asset *)asset)->impl();
-
 			Holder<File> file;
+			String foundName;
+			if (impl->findAsset.dispatch(assetId, foundName, file))
 			{
-				String foundName;
-				if (impl->findAsset.dispatch(asset->assetId, foundName, file))
-				{
-					if (!file && !foundName.empty())
-						file = readFile(foundName);
-				}
-				else
-				{
-					CAGE_ASSERT(!file && foundName.empty());
-					foundName = pathJoin(impl->path, Stringizer() + asset->assetId);
+				if (!file && !foundName.empty())
 					file = readFile(foundName);
-				}
-				if (!foundName.empty())
-					impl->keepOpen.add(foundName);
 			}
+			else
+			{
+				CAGE_ASSERT(!file && foundName.empty());
+				foundName = pathJoin(impl->path, Stringizer() + assetId);
+				file = readFile(foundName);
+			}
+			if (!foundName.empty())
+				impl->keepOpen.add(foundName);
 			CAGE_ASSERT(file);
+			return file;
+		}
+
+		// small files are read whole, all at once
+		void prefetch(PointerRange<Work> works)
+		{
+			static constexpr uint64 MaxPrefetchSize = 64 * 1024; // larger files are mapped
+			if (works.size() < 2)
+				return;
+			std::vector<FileReadRequest> requests;
+			std::vector<std::pair<Asset *, MemoryBuffer>> buffers;
+			requests.reserve(works.size());
+			buffers.reserve(works.size());
+			{
+				detail::OverrideException oe; // any errors are reported when fetching the asset again
+				for (Work &w : works)
+				{
+					Asset *a = +w.asset;
+					if (a->fetch != AssetDelegate().bind<defaultFetch>())
+						continue;
+					try
+					{
+						a->prefetched = findAssetFile(a->impl(), a->assetId);
+						const uint64 size = a->prefetched->size();
+						if (size > MaxPrefetchSize)
+							continue; // the file is kept open
+						buffers.emplace_back(a, MemoryBuffer(size));
+						requests.push_back({ +a->prefetched, buffers.back().second, 0 });
+					}
+					catch (...)
+					{
+						a->prefetched.clear();
+					}
+				}
+			}
+			try
+			{
+				detail::OverrideException oe;
+				filesReadBatch(requests);
+			}
+			catch (...)
+			{
+				for (auto &it : buffers)
+					it.first->prefetched.clear();
+				return;
+			}
+			for (auto &it : buffers)
+				it.first->prefetched = newFileBuffer(std::move(it.second), FileMode(true, false));
+		}
+
+		void defaultFetch(AssetContext *asset)
+		{
+			AssetsManagerImpl *impl = ((Asset *)asset)->impl();
+
+			Holder<File> file = std::move(((Asset *)asset)->prefetched);
+			if (!file)
+				file = findAssetFile(impl, asset->assetId);
 
 			AssetHeader h;
 			file->read(bufferView<char>(h));
@@ -907,12 +1108,15 @@ namespace cage
 				asset->dependencies = std::move(deps);
 			}
 
+			// the file may provide a view directly into the (memory mapped) archive instead of a copy
 			if (h.compressedSize)
-				asset->compressedData = systemMemory().createBuffer(h.compressedSize);
-			if (h.originalSize)
-				asset->originalData = systemMemory().createBuffer(h.originalSize);
-			if (h.compressedSize || h.originalSize)
-				file->read(h.compressedSize ? asset->compressedData : asset->originalData);
+			{
+				asset->compressedData = file->read(h.compressedSize);
+				if (h.originalSize)
+					asset->originalData = systemMemory().createBuffer(h.originalSize);
+			}
+			else if (h.originalSize)
+				asset->originalData = file->read(h.originalSize);
 
 			CAGE_ASSERT(file->tell() == file->size());
 
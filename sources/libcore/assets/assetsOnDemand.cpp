@@ -10,12 +10,19 @@ namespace cage
 {
 	namespace
 	{
+		struct Usage
+		{
+			uint32 tick = 0; // last use
+			uint32 priorityTick = 0; // when was the priority requested
+			sint32 priority = 0;
+		};
+
 		class AssetOnDemandImpl : public AssetsOnDemand
 		{
 		public:
 			AssetsManager *assets = nullptr;
 			Holder<RwMutex> mut = newRwMutex();
-			ankerl::unordered_dense::map<uint32, uint32> lastUse;
+			ankerl::unordered_dense::map<uint32, Usage> lastUse;
 			uint32 tick = 0;
 
 			AssetOnDemandImpl(AssetsManager *assets) : assets(assets) {}
@@ -33,7 +40,7 @@ namespace cage
 				auto it = lastUse.begin();
 				while (it != lastUse.end())
 				{
-					if (tick - it->second > 60 * 5) // 5 seconds at 60 fps
+					if (tick - it->second.tick > 60 * 5) // 5 seconds at 60 fps
 					{
 						assets->unload(it->first);
 						it = lastUse.erase(it);
@@ -60,7 +67,7 @@ namespace cage
 					auto it = lastUse.find(assetId);
 					if (it != lastUse.end())
 					{
-						it->second = tick;
+						it->second.tick = tick;
 						return;
 					}
 				}
@@ -69,40 +76,65 @@ namespace cage
 					ScopeLock lock(mut, WriteLockTag());
 					if (lastUse.count(assetId) == 0) // check again after reacquiring the lock
 					{
-						lastUse[assetId] = tick;
+						lastUse[assetId] = Usage{ tick, tick, 0 };
 						assets->load(assetId);
 					}
 				}
 			}
 
-			void preload(PointerRange<const uint32> assetsIds)
+			void preload(uint32 assetId, sint32 priority)
+			{
+				{
+					ScopeLock lock(mut, ReadLockTag());
+					auto it = lastUse.find(assetId);
+					if (it != lastUse.end() && it->second.priorityTick == tick && it->second.priority >= priority)
+					{
+						it->second.tick = tick;
+						return;
+					}
+				}
+				preload(PointerRange<const uint32>(&assetId, &assetId + 1), priority);
+			}
+
+			void preload(PointerRange<const uint32> assetsIds, sint32 priority)
 			{
 				ScopeLock lock(mut, WriteLockTag());
 				for (uint32 id : assetsIds)
 				{
 					auto it = lastUse.find(id);
 					if (it != lastUse.end())
-						it->second = tick;
+					{
+						Usage &u = it->second;
+						u.tick = tick;
+						// requests from previous ticks are forgotten, which allows lowering the priority
+						const sint32 p = u.priorityTick == tick ? std::max(u.priority, priority) : priority;
+						u.priorityTick = tick;
+						if (p != u.priority)
+						{
+							u.priority = p;
+							assets->prioritize(id, p);
+						}
+					}
 					else
 					{
-						lastUse[id] = tick;
-						assets->load(id);
+						lastUse[id] = Usage{ tick, tick, priority };
+						assets->load(id, priority);
 					}
 				}
 			}
 		};
 	}
 
-	void AssetsOnDemand::preload(uint32 assetId)
+	void AssetsOnDemand::preload(uint32 assetId, sint32 priority)
 	{
 		AssetOnDemandImpl *impl = (AssetOnDemandImpl *)this;
-		impl->update(assetId, true);
+		impl->preload(assetId, priority);
 	}
 
-	void AssetsOnDemand::preload(PointerRange<const uint32> assetsIds)
+	void AssetsOnDemand::preload(PointerRange<const uint32> assetsIds, sint32 priority)
 	{
 		AssetOnDemandImpl *impl = (AssetOnDemandImpl *)this;
-		impl->preload(assetsIds);
+		impl->preload(assetsIds, priority);
 	}
 
 	void AssetsOnDemand::process()
@@ -39,6 +39,7 @@ namespace cage
 		String processor;
 		std::map<String, SchemeField> schemeFields;
 		uint32 schemeIndex = m;
+		bool worker = false; // the processor supports persistent worker mode
 
 		void parse(const Ini *ini);
 		bool applyOnAsset(DatabaseAssetImpl &ass);
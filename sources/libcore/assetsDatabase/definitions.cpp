@@ -17,6 +17,7 @@ namespace cage
 		config.outputListByIds = pathSimplify(config.outputListByIds);
 		config.outputListByNames = pathSimplify(config.outputListByNames);
 		config.outputPath = pathSimplify(config.outputPath);
+		config.cachePath = pathSimplify(config.cachePath);
 	}
 
 	void AssetsDatabaseImpl::updateStatus()
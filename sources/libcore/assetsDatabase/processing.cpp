@@ -1,9 +1,15 @@
+#include <algorithm>
+#include <array>
 #include <vector>
 
 #include "database.h"
 
+#include <cage-core/concurrent.h>
+#include <cage-core/containerSerialization.h>
 #include <cage-core/debug.h>
 #include <cage-core/files.h>
+#include <cage-core/hashes.h>
+#include <cage-core/memoryBuffer.h>
 #include <cage-core/process.h>
 #include <cage-core/tasks.h>
 
@@ -22,10 +28,233 @@ namespace cage
 
 	namespace
 	{
+		constexpr String cacheBegin = "cage-asset-cache-begin";
+		constexpr String cacheVersion = "1";
+		constexpr String cacheEnd = "cage-asset-cache-end";
+
+		using CacheKey = std::array<uint8, 32>;
+
+		using VersionsCache = std::map<String, String, StringComparatorFast>; // path -> hash
+
+		String fileHash(const String &path, VersionsCache &cache)
+		{
+			auto it = cache.find(path);
+			if (it == cache.end())
+				it = cache.emplace(path, hashToHexadecimal(hashSha2_256(readFile(path)->readAll()))).first;
+			return it->second;
+		}
+
+		bool isSharedLibrary(const String &path)
+		{
+			const String name = pathExtractFilename(path);
+			return isPattern(name, "", "", ".so") || isPattern(name, "", ".so.", "") || isPattern(name, "", "", ".dll") || isPattern(name, "", "", ".dylib");
+		}
+
+		// hash of the processor executable and the shared libraries next to it (eg. cage-core), changes whenever the processor is rebuilt
+		// empty when the executable cannot be located, which disables the cache for the scheme
+		String processorVersion(const String &processor, const String &workingDir, VersionsCache &cache)
+		{
+			String cmd = trim(processor);
+			const String exe = split(cmd);
+			const String dirs[] = { workingDir.empty() ? pathWorkingDir() : pathToAbs(workingDir), pathExtractDirectory(detail::pathExecutable()) };
+			for (const String &dir : dirs)
+			{
+				const String names[] = { exe, exe + ".exe" };
+				for (const String &name : names)
+				{
+					const String path = pathJoin(dir, name);
+					if (!pathIsFile(path))
+						continue;
+					MemoryBuffer buf;
+					Serializer ser(buf);
+					ser << fileHash(path, cache);
+					const String libsDir = pathExtractDirectory(path);
+					auto libs = pathListDirectory(libsDir);
+					std::sort(libs.begin(), libs.end(), StringComparatorFast());
+					for (const String &lib : libs)
+						if (isSharedLibrary(lib) && pathIsFile(lib))
+							ser << pathExtractFilename(lib) << fileHash(lib, cache);
+					return hashToHexadecimal(hashSha2_256(buf));
+				}
+			}
+			return "";
+		}
+
+		void writeAtomically(const String &path, PointerRange<const char> buffer)
+		{
+			const String tmp = Stringizer() + path + "." + currentProcessId() + "." + currentThreadId() + ".tmp"; // unique among concurrent writers
+			{
+				Holder<File> f = writeFile(tmp);
+				f->write(buffer);
+				f->close();
+			}
+			pathMove(tmp, path);
+		}
+
+		// persistent processes shared by assets with the same processor
+		// saves the process startup and initialization of the processor libraries for each asset
+		struct Workers : private Immovable
+		{
+			Holder<Mutex> mutex = newMutex();
+			std::map<String, std::vector<Holder<Process>>, StringComparatorFast> idle; // processor command -> workers
+
+			~Workers()
+			{
+				for (auto &it : idle)
+				{
+					for (auto &prg : it.second)
+					{
+						try
+						{
+							prg->writeLine("cage-quit");
+							prg->wait();
+						}
+						catch (...)
+						{
+							prg->terminate();
+						}
+					}
+				}
+			}
+		};
+
+		// the worker is terminated unless returned back to the pool, it may be in an inconsistent state
+		struct WorkerLease : private Immovable
+		{
+			Workers *workers = nullptr;
+			String processor;
+			Holder<Process> prg;
+
+			WorkerLease(Workers *workers, const String &processor, const String &workingDir) : workers(workers), processor(processor)
+			{
+				{
+					ScopeLock lock(workers->mutex);
+					auto &v = workers->idle[processor];
+					if (!v.empty())
+					{
+						prg = std::move(v.back());
+						v.pop_back();
+					}
+				}
+				if (!prg)
+					prg = newProcess(ProcessCreateConfig(processor + " worker", workingDir));
+			}
+
+			~WorkerLease()
+			{
+				if (prg)
+					prg->terminate();
+			}
+
+			void release()
+			{
+				ScopeLock lock(workers->mutex);
+				workers->idle[processor].push_back(std::move(prg));
+			}
+		};
+
 		struct Processor
 		{
 			const AssetsDatabaseImpl *impl = nullptr;
 			std::vector<DatabaseAssetImpl *> asses;
+			std::map<String, String, StringComparatorFast> versions; // scheme name -> processor version
+			Holder<Workers> workers = systemMemory().createHolder<Workers>();
+
+			String outputDirectory() const { return impl->config.intermediatePath.empty() ? impl->config.outputPath : impl->config.intermediatePath; }
+
+			// the first level key covers everything known before running the processor
+			CacheKey definitionKey(const DatabaseAssetImpl &ass, const Scheme &scheme, const String &version) const
+			{
+				MemoryBuffer buf;
+				Serializer ser(buf);
+				ser << cacheVersion << version << scheme.processor << scheme.schemeIndex;
+				ser << ass.name << ass.id << ass.fields;
+				return hashSha2_256(buf);
+			}
+
+			// the second level key adds contents of the files used by the processor
+			// returns false if any of the files is missing
+			bool contentKey(const CacheKey &definition, const std::set<String, StringComparatorFast> &files, CacheKey &result) const
+			{
+				MemoryBuffer buf;
+				Serializer ser(buf);
+				ser << definition;
+				for (const String &f : files)
+				{
+					const String path = pathJoin(impl->config.inputPath, f);
+					if (!pathIsFile(path))
+						return false;
+					ser << f << hashSha2_256(readFile(path)->readAll());
+				}
+				result = hashSha2_256(buf);
+				return true;
+			}
+
+			String cachePath(const CacheKey &key) const { return pathJoin(impl->config.cachePath, hashToHexadecimal(key)); }
+
+			bool cacheRestore(DatabaseAssetImpl &ass, const CacheKey &definition) const
+			{
+				const String manifestPath = cachePath(definition) + ".manifest";
+				if (!pathIsFile(manifestPath))
+					return false;
+				std::set<String, StringComparatorFast> files;
+				{
+					const auto buf = readFile(manifestPath)->readAll();
+					Deserializer des(buf);
+					des >> files;
+				}
+				CacheKey content;
+				if (!contentKey(definition, files, content))
+					return false;
+				const String entryPath = cachePath(content);
+				if (!pathIsFile(entryPath))
+					return false;
+				const auto buf = readFile(entryPath)->readAll();
+				Deserializer des(buf);
+				String b;
+				des >> b;
+				if (b != cacheBegin)
+					return false;
+				des >> b;
+				if (b != cacheVersion)
+					return false;
+				std::set<String, StringComparatorFast> references;
+				des >> references;
+				uint64 size = 0;
+				des >> size;
+				const PointerRange<const char> payload = des.read(size);
+				des >> b;
+				if (b != cacheEnd)
+					return false;
+				writeFile(pathJoin(outputDirectory(), Stringizer() + ass.id))->write(payload);
+				ass.files = std::move(files);
+				ass.references = std::move(references);
+				return true;
+			}
+
+			void cacheStore(const DatabaseAssetImpl &ass, const CacheKey &definition) const
+			{
+				CacheKey content;
+				if (!contentKey(definition, ass.files, content))
+					return;
+				const auto payload = readFile(pathJoin(outputDirectory(), Stringizer() + ass.id))->readAll();
+				{
+					MemoryBuffer buf;
+					Serializer ser(buf);
+					ser << cacheBegin << cacheVersion;
+					ser << ass.references;
+					ser << (uint64)payload.size();
+					ser.write(payload);
+					ser << cacheEnd;
+					writeAtomically(cachePath(content), buf);
+				}
+				{
+					MemoryBuffer buf;
+					Serializer ser(buf);
+					ser << ass.files;
+					writeAtomically(cachePath(definition) + ".manifest", buf);
+				}
+			}
 
 			void processAsset(DatabaseAssetImpl &ass) const
 			{
@@ -41,10 +270,43 @@ namespace cage
 					if (!scheme->applyOnAsset(ass))
 						CAGE_THROW_ERROR(Exception, "asset has invalid configuration");
 
-					Holder<Process> prg = newProcess(ProcessCreateConfig(scheme->processor, impl->config.processorWorkingDir));
+					CacheKey definition = {};
+					const String &version = versions.at(ass.scheme);
+					const bool cached = !impl->config.cachePath.empty() && !version.empty();
+					if (cached)
+					{
+						definition = definitionKey(ass, *scheme, version);
+						try
+						{
+							if (cacheRestore(ass, definition))
+							{
+								CAGE_LOG(SeverityEnum::Info, "asset", Stringizer() + "restored from cache: " + ass.name);
+								ass.corrupted = false;
+								ass.modified = true;
+								return;
+							}
+						}
+						catch (const Exception &)
+						{
+							CAGE_LOG(SeverityEnum::Warning, "database", Stringizer() + "failed reading cache for asset: " + ass.name);
+						}
+						ass.files.clear();
+						ass.references.clear();
+					}
+
+					Holder<WorkerLease> lease;
+					Holder<Process> prg;
+					if (scheme->worker)
+					{
+						lease = systemMemory().createHolder<WorkerLease>(+workers, scheme->processor, impl->config.processorWorkingDir);
+						prg = lease->prg.share();
+						prg->writeLine("cage-asset");
+					}
+					else
+						prg = newProcess(ProcessCreateConfig(scheme->processor, impl->config.processorWorkingDir));
 					prg->writeLine(Stringizer() + "inputDirectory=" + pathToAbs(impl->config.inputPath)); // inputDirectory
 					prg->writeLine(Stringizer() + "inputName=" + ass.name); // inputName
-					prg->writeLine(Stringizer() + "outputDirectory=" + pathToAbs(impl->config.intermediatePath.empty() ? impl->config.outputPath : impl->config.intermediatePath)); // outputDirectory
+					prg->writeLine(Stringizer() + "outputDirectory=" + pathToAbs(outputDirectory())); // outputDirectory
 					prg->writeLine(Stringizer() + "outputName=" + ass.id); // outputName
 					prg->writeLine(Stringizer() + "schemeIndex=" + scheme->schemeIndex); // schemeIndex
 					for (const auto &it : ass.fields)
@@ -102,15 +364,35 @@ namespace cage
 							CAGE_LOG(SeverityEnum::Note, "processor", line);
 					}
 
-					const sint32 ret = prg->wait();
-					if (ret != 0)
-						CAGE_THROW_ERROR(SystemError, "process returned error code", ret);
+					if (lease)
+					{
+						prg.clear();
+						lease->release();
+					}
+					else
+					{
+						const sint32 ret = prg->wait();
+						if (ret != 0)
+							CAGE_THROW_ERROR(SystemError, "process returned error code", ret);
+					}
 
 					if (ass.files.empty())
 						CAGE_THROW_ERROR(Exception, "asset reported no used files");
 
 					ass.corrupted = false;
 					ass.modified = true;
+
+					if (cached)
+					{
+						try
+						{
+							cacheStore(ass, definition);
+						}
+						catch (const Exception &)
+						{
+							CAGE_LOG(SeverityEnum::Warning, "database", Stringizer() + "failed storing cache for asset: " + ass.name);
+						}
+					}
 				}
 				catch (const Exception &e)
 				{
@@ -143,6 +425,11 @@ namespace cage
 			for (const auto &it : assets)
 				if (it.second->corrupted)
 					processor.asses.push_back(+it.second);
+			VersionsCache cache;
+			for (const auto &it : schemes)
+				processor.versions[it.first] = config.cachePath.empty() ? String() : processorVersion(it.second->processor, config.processorWorkingDir, cache);
+			if (!config.cachePath.empty())
+				pathCreateDirectories(config.cachePath);
 			tasksRunBlocking("processing", processor, processor.asses.size());
 		}
 
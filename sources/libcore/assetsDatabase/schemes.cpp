@@ -19,6 +19,7 @@ namespace cage
 			CAGE_LOG_THROW(Stringizer() + "scheme: " + name);
 			CAGE_THROW_ERROR(Exception, "empty scheme index field");
 		}
+		worker = ini->getBool("scheme", "worker", false);
 
 		for (const String &section : ini->sections())
 		{
@@ -50,14 +50,14 @@ namespace cage
 
 	Serializer &operator<<(Serializer &ser, const Scheme &s)
 	{
-		ser << s.name << s.processor << s.schemeIndex;
+		ser << s.name << s.processor << s.schemeIndex << s.worker;
 		ser << s.schemeFields;
 		return ser;
 	}
 
 	Deserializer &operator>>(Deserializer &des, Scheme &s)
 	{
-		des >> s.name >> s.processor >> s.schemeIndex;
+		des >> s.name >> s.processor >> s.schemeIndex >> s.worker;
 		des >> s.schemeFields;
 		return des;
 	}
@@ -65,7 +65,7 @@ namespace cage
 	namespace
 	{
 		constexpr String databaseBegin = "cage-asset-database-begin";
-		constexpr String databaseVersion = "12";
+		constexpr String databaseVersion = "13";
 		constexpr String databaseEnd = "cage-asset-database-end";
 	}
 
@@ -1,9 +1,60 @@
+#include <vector>
+
 #include "vorbis.h"
 
 #include <cage-core/audioAlgorithms.h>
+#include <cage-core/math.h>
 
 namespace cage
 {
+	namespace
+	{
+		class AudioDecoderImpl : public AudioDecoder
+		{
+		public:
+			static constexpr uintPtr MaxSkipFrames = 4096; // decoding short gaps is cheaper than seeking
+
+			Holder<const Audio> audio;
+			Holder<VorbisDecoder> vorbis;
+			std::vector<float> skipped;
+			uintPtr position = 0;
+
+			AudioDecoderImpl(Holder<const Audio> &&audio_) : audio(std::move(audio_))
+			{
+				const AudioImpl *impl = (const AudioImpl *)+audio;
+				if (impl->format == AudioFormatEnum::Vorbis)
+					vorbis = systemMemory().createHolder<VorbisDecoder>(newFileBuffer(Holder<const MemoryBuffer>(&impl->mem, nullptr)));
+			}
+
+			void decode(uintPtr startFrame, PointerRange<float> buffer)
+			{
+				if (!vorbis)
+					return audio->decode(startFrame, buffer);
+
+				const uint32 channels = vorbis->channels;
+				CAGE_ASSERT((buffer.size() % channels) == 0);
+				const uintPtr frames = buffer.size() / channels;
+				if (frames == 0)
+					return;
+
+				const uintPtr previous = position;
+				position = m; // in case of exception
+				if (startFrame != previous)
+				{
+					if (startFrame > previous && startFrame - previous <= MaxSkipFrames)
+					{
+						skipped.resize((startFrame - previous) * channels);
+						vorbis->decode(skipped);
+					}
+					else
+						vorbis->seek(startFrame);
+				}
+				vorbis->decode(buffer);
+				position = startFrame + frames;
+			}
+		};
+	}
+
 	void Audio::decode(uintPtr startFrame, PointerRange<float> buffer) const
 	{
 		const AudioImpl *impl = (const AudioImpl *)this;
@@ -75,4 +126,16 @@ namespace cage
 		dec.decode(bufferCast<float, char>(dst->mem));
 		return poly;
 	}
+
+	void AudioDecoder::decode(uintPtr startFrame, PointerRange<float> buffer)
+	{
+		AudioDecoderImpl *impl = (AudioDecoderImpl *)this;
+		impl->decode(startFrame, buffer);
+	}
+
+	Holder<AudioDecoder> newAudioDecoder(Holder<const Audio> audio)
+	{
+		CAGE_ASSERT(audio);
+		return systemMemory().createImpl<AudioDecoder, AudioDecoderImpl>(std::move(audio));
+	}
 }
@@ -1,6 +1,8 @@
 #include <cage-core/audioChannelsConverter.h>
 #include <cage-core/math.h>
 
+#include "../geometry/simd.h"
+
 namespace cage
 {
 	namespace
@@ -2531,30 +2533,113 @@ namespace cage
 
 	namespace
 	{
-		class AudioChannelsConverterImpl : public AudioChannelsConverter
+		using privat::F4;
+
+		// dst = src * gain, or dst += src * gain
+		template<bool Accumulate>
+		void scaleKernel(const float *src, float *dst, uintPtr count, float gain)
 		{
-		public:
-			void convert(PointerRange<const float> src, PointerRange<float> dst, uint32 srcChannels, uint32 dstChannels)
+			const F4 g = F4(Real(gain));
+			uintPtr i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const F4 v = F4::loadUnaligned(src + i) * g;
+				if constexpr (Accumulate)
+					(F4::loadUnaligned(dst + i) + v).store(dst + i);
+				else
+					v.store(dst + i);
+			}
+			for (; i < count; i++)
+			{
+				if constexpr (Accumulate)
+					dst[i] += src[i] * gain;
+				else
+					dst[i] = src[i] * gain;
+			}
+		}
+
+		// compile-time channel counts let the compiler unroll and vectorize the matrix multiplication
+		template<uint32 S, uint32 D, bool Accumulate>
+		void mixKernel(const float *src, float *dst, uintPtr frames, const float *matrix, float gain)
+		{
+			float m[D][S];
+			for (uint32 o = 0; o < D; o++)
+				for (uint32 i = 0; i < S; i++)
+					m[o][i] = matrix[o * 8 + i] * gain;
+			for (uintPtr f = 0; f < frames; f++)
 			{
-				CAGE_ASSERT(src.size() % srcChannels == 0);
-				CAGE_ASSERT(dst.size() % dstChannels == 0);
-				CAGE_ASSERT(src.size() * dstChannels == dst.size() * srcChannels);
+				const float *in = src + f * S;
+				float *out = dst + f * D;
+				for (uint32 o = 0; o < D; o++)
+				{
+					float res = 0;
+					for (uint32 i = 0; i < S; i++)
+						res += m[o][i] * in[i];
+					if constexpr (Accumulate)
+						out[o] += res;
+					else
+						out[o] = res;
+				}
+			}
+		}
 
-				const uintPtr frames = src.size() / srcChannels;
-				const float *m = DefaultMixingMatrices[srcChannels - 1][dstChannels - 1];
-				for (uintPtr f = 0; f < frames; f++)
-				{
-					const float *in = src.data() + f * srcChannels;
-					float *out = dst.data() + f * dstChannels;
-					for (uint32 cout = 0; cout < dstChannels; cout++)
-					{
-						float res = 0;
-						for (uint32 cin = 0; cin < srcChannels; cin++)
-							res += m[cout * 8 + cin] * in[cin];
-						out[cout] = res;
-					}
+		template<bool Accumulate>
+		void mixGeneric(const float *src, float *dst, uintPtr frames, uint32 srcChannels, uint32 dstChannels, const float *matrix, float gain)
+		{
+			for (uintPtr f = 0; f < frames; f++)
+			{
+				const float *in = src + f * srcChannels;
+				float *out = dst + f * dstChannels;
+				for (uint32 o = 0; o < dstChannels; o++)
+				{
+					float res = 0;
+					for (uint32 i = 0; i < srcChannels; i++)
+						res += matrix[o * 8 + i] * in[i];
+					if constexpr (Accumulate)
+						out[o] += res * gain;
+					else
+						out[o] = res * gain;
 				}
 			}
+		}
+
+		template<bool Accumulate>
+		void mix(PointerRange<const float> src, PointerRange<float> dst, uint32 srcChannels, uint32 dstChannels, float gain)
+		{
+			CAGE_ASSERT(srcChannels > 0 && srcChannels <= 8 && dstChannels > 0 && dstChannels <= 8);
+			CAGE_ASSERT(src.size() % srcChannels == 0);
+			CAGE_ASSERT(dst.size() % dstChannels == 0);
+			CAGE_ASSERT(src.size() * dstChannels == dst.size() * srcChannels);
+
+			const uintPtr frames = src.size() / srcChannels;
+			const float *m = DefaultMixingMatrices[srcChannels - 1][dstChannels - 1];
+			if (srcChannels == dstChannels)
+				return scaleKernel<Accumulate>(src.data(), dst.data(), src.size(), gain); // identity matrices
+			switch (srcChannels * 10 + dstChannels)
+			{
+				case 12:
+					return mixKernel<1, 2, Accumulate>(src.data(), dst.data(), frames, m, gain);
+				case 21:
+					return mixKernel<2, 1, Accumulate>(src.data(), dst.data(), frames, m, gain);
+				case 16:
+					return mixKernel<1, 6, Accumulate>(src.data(), dst.data(), frames, m, gain);
+				case 26:
+					return mixKernel<2, 6, Accumulate>(src.data(), dst.data(), frames, m, gain);
+				case 62:
+					return mixKernel<6, 2, Accumulate>(src.data(), dst.data(), frames, m, gain);
+				case 82:
+					return mixKernel<8, 2, Accumulate>(src.data(), dst.data(), frames, m, gain);
+				default:
+					return mixGeneric<Accumulate>(src.data(), dst.data(), frames, srcChannels, dstChannels, m, gain);
+			}
+		}
+
+		class AudioChannelsConverterImpl : public AudioChannelsConverter
+		{
+		public:
+			void convert(PointerRange<const float> src, PointerRange<float> dst, uint32 srcChannels, uint32 dstChannels) { mix<false>(src, dst, srcChannels, dstChannels, 1); }
+
+			void accumulate(PointerRange<const float> src, PointerRange<float> dst, uint32 srcChannels, uint32 dstChannels, Real gain) { mix<true>(src, dst, srcChannels, dstChannels, gain.value); }
 		};
 	}
 
@@ -2564,6 +2649,12 @@ namespace cage
 		impl->convert(src, dst, srcChannels, dstChannels);
 	}
 
+	void AudioChannelsConverter::accumulate(PointerRange<const float> src, PointerRange<float> dst, uint32 srcChannels, uint32 dstChannels, Real gain)
+	{
+		AudioChannelsConverterImpl *impl = (AudioChannelsConverterImpl *)this;
+		impl->accumulate(src, dst, srcChannels, dstChannels, gain);
+	}
+
 	Holder<AudioChannelsConverter> newAudioChannelsConverter()
 	{
 		return systemMemory().createImpl<AudioChannelsConverter, AudioChannelsConverterImpl>();
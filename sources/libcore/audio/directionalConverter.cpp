@@ -1,5 +1,7 @@
 #include <cage-core/audioDirectionalConverter.h>
 
+#include "../geometry/simd.h"
+
 namespace cage
 {
 	namespace
@@ -74,27 +76,79 @@ namespace cage
 
 			AudioDirectionalConverterImpl(const AudioDirectionalConverterCreateConfig &config) : config(config) { CAGE_ASSERT(config.channels > 0 && config.channels <= 8); }
 
-			void process(PointerRange<const float> srcMono, PointerRange<float> dstPoly, const AudioDirectionalProcessConfig &data)
+			void factors(const AudioDirectionalProcessConfig &data, float gain, float *result) const
+			{
+				const Vec3 direction = normalize(conjugate(data.listenerOrientation) * (data.sourcePosition - data.listenerPosition));
+				const Real mono = 0.3;
+				for (uint32 ch = 0; ch < config.channels; ch++)
+				{
+					Real f = dot(direction, DefaultSpeakerDirections[config.channels - 1][ch]) * 0.5 + 0.5;
+					f = mono + f * (1 - mono);
+					result[ch] = f.value * gain;
+				}
+			}
+
+			template<bool Accumulate>
+			CAGE_FORCE_INLINE static void store(float *dst, privat::F4 v)
 			{
+				if constexpr (Accumulate)
+					v = privat::F4::loadUnaligned(dst) + v;
+				v.store(dst);
+			}
+
+			template<bool Accumulate>
+			void apply(PointerRange<const float> srcMono, PointerRange<float> dstPoly, const AudioDirectionalProcessConfig &data, float gain)
+			{
+				using privat::F4;
 				CAGE_ASSERT((dstPoly.size() % config.channels) == 0);
 				CAGE_ASSERT(srcMono.size() * config.channels == dstPoly.size());
 
-				Real factors[8];
+				float fs[8] = {};
+				factors(data, gain, fs);
+
+				const float *src = srcMono.begin();
+				const uintPtr frames = srcMono.size();
+				float *dst = dstPoly.begin();
+				uintPtr f = 0;
+				switch (config.channels)
 				{
-					const Vec3 direction = normalize(conjugate(data.listenerOrientation) * (data.sourcePosition - data.listenerPosition));
-					const Real mono = 0.3;
-					for (uint32 ch = 0; ch < config.channels; ch++)
+					case 2:
 					{
-						factors[ch] = dot(direction, DefaultSpeakerDirections[config.channels][ch]) * 0.5 + 0.5;
-						factors[ch] = mono + factors[ch] * (1 - mono);
+						const F4 fac = F4(fs[0], fs[1], fs[0], fs[1]);
+						for (; f + 2 <= frames; f += 2, dst += 4)
+							store<Accumulate>(dst, F4(src[f], src[f], src[f + 1], src[f + 1]) * fac);
+						break;
+					}
+					case 4:
+					{
+						const F4 fac = F4(fs[0], fs[1], fs[2], fs[3]);
+						for (; f < frames; f++, dst += 4)
+							store<Accumulate>(dst, F4(Real(src[f])) * fac);
+						break;
+					}
+					case 8:
+					{
+						const F4 fac1 = F4(fs[0], fs[1], fs[2], fs[3]);
+						const F4 fac2 = F4(fs[4], fs[5], fs[6], fs[7]);
+						for (; f < frames; f++, dst += 8)
+						{
+							const F4 s = F4(Real(src[f]));
+							store<Accumulate>(dst, s * fac1);
+							store<Accumulate>(dst + 4, s * fac2);
+						}
+						break;
 					}
 				}
-
-				float *dst = dstPoly.begin();
-				for (float src : srcMono)
+				// remaining frames and other channel counts
+				for (; f < frames; f++)
 				{
 					for (uint32 ch = 0; ch < config.channels; ch++)
-						*dst++ = src * factors[ch].value;
+					{
+						if constexpr (Accumulate)
+							*dst++ += src[f] * fs[ch];
+						else
+							*dst++ = src[f] * fs[ch];
+					}
 				}
 				CAGE_ASSERT(dst == dstPoly.end());
 			}
@@ -110,7 +164,13 @@ namespace cage
 	void AudioDirectionalConverter::process(PointerRange<const float> srcMono, PointerRange<float> dstPoly, const AudioDirectionalProcessConfig &data)
 	{
 		AudioDirectionalConverterImpl *impl = (AudioDirectionalConverterImpl *)this;
-		impl->process(srcMono, dstPoly, data);
+		impl->apply<false>(srcMono, dstPoly, data, 1);
+	}
+
+	void AudioDirectionalConverter::accumulate(PointerRange<const float> srcMono, PointerRange<float> dstPoly, const AudioDirectionalProcessConfig &data, Real gain)
+	{
+		AudioDirectionalConverterImpl *impl = (AudioDirectionalConverterImpl *)this;
+		impl->apply<true>(srcMono, dstPoly, data, gain.value);
 	}
 
 	Holder<AudioDirectionalConverter> newAudioDirectionalConverter(const AudioDirectionalConverterCreateConfig &config)
@@ -17,10 +17,14 @@ namespace cage
 		std::atomic<uint64> globalNextTaskId = 1;
 		static_assert(std::atomic<uint64>::is_always_lock_free);
 
+		struct WorkDeque;
+
 		struct ThreadData
 		{
 			uint64 currentTaskId = 0;
-			bool taskingThread = false;
+			WorkDeque *deque = nullptr; // non-null in tasking threads only
+			uint32 threadIndex = m;
+			uint32 stealOffset = 0;
 		};
 
 		thread_local ThreadData threadData;
@@ -37,8 +41,9 @@ namespace cage
 			const uint64 parentTaskId = threadData.currentTaskId;
 			const uint64 myTaskId = globalNextTaskId.fetch_add(1, std::memory_order_relaxed);
 			std::exception_ptr storedException;
-			std::atomic<uint32> enqueued = 0; // number of times pushed into the queue
-			std::atomic<uint32> executing = 0; // number of times the task started executing (this is the next invocation index)
+			Holder<TaskImpl> self; // keeps the task alive while there are any pending work items
+			std::atomic<uint32> pending = 0; // number of work items (ranges of invocations) not yet processed
+			std::atomic<uint32> executing = 0; // number of times the task started executing
 			std::atomic<uint32> finished = 0; // number of times the execution has successfully finished
 			std::atomic<bool> completed = false; // all invocations finished, or exception was thrown, or the task was aborted
 
@@ -62,12 +67,12 @@ namespace cage
 				}
 			}
 
-			void execute()
+			void execute(uint32 idx)
 			{
 				if (completed)
 					return;
 				ProfilingScope profiling(config.name);
-				const uint32 idx = executing++;
+				executing++;
 				CAGE_ASSERT(idx < config.invocations);
 				profiling.set(Stringizer() + "task invocation: " + idx + " / " + config.invocations);
 				try
@@ -91,13 +96,20 @@ namespace cage
 					complete();
 			}
 
+			void release()
+			{
+				if (--pending == 0)
+				{
+					Holder<TaskImpl> tmp = std::move(self); // this may destroy the task
+				}
+			}
+
 			bool done() const { return completed; }
 
 			void wait();
 
 			void complete()
 			{
-				enqueued = config.invocations; // avoid any further enqueues
 				completed = true;
 				completed.notify_all();
 			}
@@ -117,122 +129,302 @@ namespace cage
 			}
 		};
 
-		struct TasksQueue : public ConcurrentQueue<Holder<TaskImpl>, SlidingBuffer>
+		// range of invocations of a single task
+		struct WorkItem
 		{
-			bool tryPopFilter(Holder<TaskImpl> &value)
-			{
-				const uint64 filterId = threadData.currentTaskId;
-				ScopeLock sl(mut);
-				if (stop)
-					CAGE_THROW_SILENT(ConcurrentQueueTerminated, "tasks concurrent queue terminated");
-				for (auto it = items.begin(); it != items.end(); it++)
-				{
-					if ((*it)->parentTaskId != filterId)
-						continue; // prevent the parent task from being blocked by potentially long-lasting unrelated task
-					value = std::move(*it);
-					items.erase(it);
-					writer->signal();
-					return true;
-				}
-				return false;
-			}
+			TaskImpl *task = nullptr;
+			uint64 parentTaskId = 0;
+			uint32 begin = 0;
+			uint32 end = 0;
 		};
 
-		TasksQueue &queue()
+		// chase-lev work-stealing deque
+		// the owning thread pushes and takes items at the bottom, any other thread may steal items from the top
+		// the filter limits taking/stealing to items of tasks with the given parent (m disables the filter)
+		struct WorkDeque : private Immovable
 		{
-			static TasksQueue *q = new TasksQueue();
-			return *q;
-		}
+			static constexpr sint64 Capacity = 1024;
 
-		void enqueue(Holder<TaskImpl> &&tsk)
-		{
-			CAGE_ASSERT(tsk);
-			if (tsk->enqueued++ < tsk->config.invocations)
-				queue().push(std::move(tsk));
-		}
+			struct Slot
+			{
+				// the fields are atomic because a thief may read a slot while it is being overwritten (the subsequent cas then fails)
+				std::atomic<TaskImpl *> task = nullptr;
+				std::atomic<uint64> parentTaskId = 0;
+				std::atomic<uint32> begin = 0;
+				std::atomic<uint32> end = 0;
+			};
 
-		void TaskImpl::wait()
-		{
-			ProfilingScope profiling("waiting for task");
-			profiling.set(String(config.name));
-			if (threadData.taskingThread)
+			alignas(64) std::atomic<sint64> top = 0;
+			alignas(64) std::atomic<sint64> bottom = 0;
+			alignas(64) Slot slots[Capacity];
+
+			void store(sint64 index, const WorkItem &w)
 			{
-				TasksQueue &q = queue();
-				while (!completed)
+				Slot &s = slots[index % Capacity];
+				s.task.store(w.task, std::memory_order_relaxed);
+				s.parentTaskId.store(w.parentTaskId, std::memory_order_relaxed);
+				s.begin.store(w.begin, std::memory_order_relaxed);
+				s.end.store(w.end, std::memory_order_relaxed);
+			}
+
+			WorkItem load(sint64 index) const
+			{
+				const Slot &s = slots[index % Capacity];
+				return { s.task.load(std::memory_order_relaxed), s.parentTaskId.load(std::memory_order_relaxed), s.begin.load(std::memory_order_relaxed), s.end.load(std::memory_order_relaxed) };
+			}
+
+			// owner only, returns false when full
+			bool push(const WorkItem &w)
+			{
+				const sint64 b = bottom.load(std::memory_order_relaxed);
+				const sint64 t = top.load(std::memory_order_acquire);
+				if (b - t >= Capacity)
+					return false;
+				store(b, w);
+				std::atomic_thread_fence(std::memory_order_release);
+				bottom.store(b + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			// owner only
+			bool take(WorkItem &w, uint64 filter)
+			{
+				const sint64 b = bottom.load(std::memory_order_relaxed) - 1;
+				bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				sint64 t = top.load(std::memory_order_relaxed);
+				if (t > b)
 				{
-					Holder<TaskImpl> t;
-					if (q.tryPopFilter(t))
-					{
-						enqueue(t.share());
-						t->execute();
-					}
-					else
-						threadYield();
+					bottom.store(b + 1, std::memory_order_relaxed);
+					return false;
+				}
+				w = load(b);
+				if (filter != m && w.parentTaskId != filter)
+				{
+					bottom.store(b + 1, std::memory_order_relaxed);
+					return false;
 				}
+				if (t == b)
+				{
+					// last item, race against thieves
+					const bool ok = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+					bottom.store(b + 1, std::memory_order_relaxed);
+					return ok;
+				}
+				return true;
 			}
-			else
+
+			bool steal(WorkItem &w, uint64 filter)
 			{
-				while (!completed)
-					completed.wait(false);
+				sint64 t = top.load(std::memory_order_acquire);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				const sint64 b = bottom.load(std::memory_order_acquire);
+				if (t >= b)
+					return false;
+				w = load(t);
+				if (filter != m && w.parentTaskId != filter)
+					return false;
+				return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
 			}
+		};
 
-			CAGE_ASSERT(completed);
-			ScopeLock lock(exceptionsMutex());
-			if (storedException)
-				std::rethrow_exception(storedException);
-			else
+		struct InjectedQueue : public ConcurrentQueue<WorkItem, SlidingBuffer>
+		{
+			bool tryPopFilter(WorkItem &value, uint64 filter)
 			{
-				CAGE_ASSERT(enqueued >= config.invocations);
-				CAGE_ASSERT(executing == config.invocations);
-				CAGE_ASSERT(finished == config.invocations);
+				ScopeLock sl(mut);
+				for (auto it = items.begin(); it != items.end(); it++)
+				{
+					if (filter != m && it->parentTaskId != filter)
+						continue;
+					value = *it;
+					items.erase(it);
+					writer->signal();
+					return true;
+				}
+				return false;
 			}
-		}
+		};
 
 		struct Executor : private Immovable
 		{
+			std::vector<Holder<WorkDeque>> deques;
 			std::vector<Holder<Thread>> threads;
+			InjectedQueue injected; // tasks submitted from non-tasking threads or overflowing the deques
+			std::atomic<uint32> injectedCount = 0;
+			std::atomic<uint32> wakeups = 0; // incremented to wake sleeping threads
+			std::atomic<uint32> sleeping = 0;
+			std::atomic<uint32> threadIndexInitializer = 0;
+			std::atomic<bool> stopping = false;
 
 			Executor()
 			{
-				threads.resize(processorsCount());
+				const uint32 cnt = processorsCount();
+				deques.resize(cnt);
+				for (auto &it : deques)
+					it = systemMemory().createHolder<WorkDeque>();
+				threads.resize(cnt);
 				uint32 index = 0;
 				for (auto &it : threads)
 				{
 					// using ~ in the name to move the threads to bottom in the profiler
-					it = newThread(&threadEntry, Stringizer() + "~ tasks " + index++);
+					it = newThread(Delegate<void()>().bind<Executor, &Executor::threadEntry>(this), Stringizer() + "~ tasks " + index++);
 				}
 			}
 
 			~Executor()
 			{
-				queue().terminate();
+				stopping = true;
+				wakeups++;
+				wakeups.notify_all();
 				threads.clear();
 			}
 
-			static void threadEntry()
+			void wakeup()
 			{
-				threadData.taskingThread = true;
-				try
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (sleeping.load(std::memory_order_relaxed) > 0)
 				{
-					TasksQueue &q = queue();
-					while (true)
+					wakeups++;
+					wakeups.notify_one();
+				}
+			}
+
+			void submit(const WorkItem &w)
+			{
+				if (!threadData.deque || !threadData.deque->push(w))
+				{
+					injected.push(w);
+					injectedCount++;
+				}
+				wakeup();
+			}
+
+			bool findWork(WorkItem &w, uint64 filter)
+			{
+				if (threadData.deque->take(w, filter))
+					return true;
+				if (injectedCount > 0 && injected.tryPopFilter(w, filter))
+				{
+					injectedCount--;
+					return true;
+				}
+				const uint32 cnt = numeric_cast<uint32>(deques.size());
+				const uint32 off = threadData.threadIndex + threadData.stealOffset++;
+				for (uint32 i = 1; i < cnt; i++)
+				{
+					if (deques[(off + i) % cnt]->steal(w, filter))
+						return true;
+				}
+				if (filter != m)
+					return spill(w, filter);
+				return false;
+			}
+
+			// moves unrelated items from the own deque into the injected queue, uncovering the children of the waiting task hidden below them
+			// the injected queue is searched by the filter in full
+			bool spill(WorkItem &w, uint64 filter)
+			{
+				while (threadData.deque->take(w, m))
+				{
+					if (w.parentTaskId == filter)
+						return true;
+					injected.push(w);
+					injectedCount++;
+					wakeup();
+				}
+				return false;
+			}
+
+			// splits the range in halves, pushing the upper halves into the own deque (to be stolen by other threads), and executes the remaining invocation
+			void process(WorkItem w)
+			{
+				TaskImpl *t = w.task;
+				while (w.end - w.begin > 1 && !t->completed)
+				{
+					const uint32 mid = w.begin + (w.end - w.begin) / 2;
+					t->pending++;
+					if (!threadData.deque->push({ t, w.parentTaskId, mid, w.end }))
 					{
-						Holder<TaskImpl> t;
-						q.pop(t);
-						enqueue(t.share());
-						t->execute();
+						t->pending--;
+						break; // execute the whole remaining range
 					}
+					wakeup();
+					w.end = mid;
 				}
-				catch (const ConcurrentQueueTerminated &)
+				for (uint32 i = w.begin; i < w.end; i++)
+					t->execute(i);
+				t->release();
+			}
+
+			void threadEntry()
+			{
+				threadData.threadIndex = threadIndexInitializer++;
+				threadData.deque = +deques[threadData.threadIndex];
+				while (!stopping)
 				{
-					// nothing
+					WorkItem w;
+					bool found = false;
+					for (uint32 attempt = 0; attempt < 50 && !found; attempt++)
+					{
+						found = findWork(w, m);
+						if (!found)
+							threadPause();
+					}
+					if (!found)
+					{
+						sleeping++;
+						const uint32 ticket = wakeups;
+						found = findWork(w, m);
+						if (!found && !stopping)
+							wakeups.wait(ticket);
+						sleeping--;
+					}
+					if (found)
+						process(w);
 				}
 			}
 		};
 
-		void executorInitialization()
+		Executor &executor()
 		{
 			static Executor executor;
+			return executor;
+		}
+
+		void TaskImpl::wait()
+		{
+			ProfilingScope profiling("waiting for task");
+			profiling.set(String(config.name));
+			if (threadData.deque)
+			{
+				// execute only children of the current task, to prevent it from being blocked by potentially long-lasting unrelated task
+				Executor &ex = executor();
+				const uint64 filter = threadData.currentTaskId;
+				while (!completed)
+				{
+					WorkItem w;
+					if (ex.findWork(w, filter))
+						ex.process(w);
+					else
+						threadYield();
+				}
+			}
+			else
+			{
+				while (!completed)
+					completed.wait(false);
+			}
+
+			CAGE_ASSERT(completed);
+			ScopeLock lock(exceptionsMutex());
+			if (storedException)
+				std::rethrow_exception(storedException);
+			else
+			{
+				CAGE_ASSERT(executing == config.invocations);
+				CAGE_ASSERT(finished == config.invocations);
+			}
 		}
 	}
 
@@ -267,9 +459,14 @@ namespace cage
 
 		Holder<AsyncTask> tasksRunAsync(TaskCreateConfig &&task)
 		{
-			executorInitialization();
+			Executor &ex = executor();
 			Holder<TaskImpl> impl = systemMemory().createHolder<TaskImpl>(std::move(task));
-			enqueue(impl.share());
+			if (impl->config.invocations > 0)
+			{
+				impl->pending = 1;
+				impl->self = impl.share();
+				ex.submit({ +impl, impl->parentTaskId, 0, impl->config.invocations });
+			}
 			return std::move(impl).cast<AsyncTask>();
 		}
 
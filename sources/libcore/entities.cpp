@@ -5,6 +5,7 @@
 
 #include <cage-core/entities.h>
 #include <cage-core/flatBag.h>
+#include <cage-core/hashBuffer.h>
 #include <cage-core/memoryAllocators.h>
 #include <cage-core/pointerRangeHolder.h>
 
@@ -15,17 +16,59 @@ namespace cage
 		class EntityManagerImpl;
 		class ComponentImpl;
 		class EntityImpl;
+		class ArchetypeImpl;
 
 		class EntityImpl : public Entity
 		{
 		public:
 			EntityManagerImpl *const manager = nullptr;
 			const uint32 id = m;
+			ArchetypeImpl *archetype = nullptr; // nullptr for entities without any components (or without archetypes storage)
+			uint32 row = 0;
 
 			EntityImpl(EntityManagerImpl *manager, uint32 id);
 			~EntityImpl();
 
 			void *&comp(uint32 i) const;
+			uint32 &version(uint32 trackingIndex) const;
+		};
+
+		// all entities with exactly the same set of components
+		// values are stored in chunks, each chunk has one contiguous array (column) for each component
+		class ArchetypeImpl : private Immovable
+		{
+		public:
+			std::vector<uint32> columns; // column index for each component definition, or m
+			std::vector<uint32> definitions; // component definition index for each column
+			std::vector<uint32> sizes; // type size for each column
+			std::vector<uint32> offsets; // offset of each column within a chunk
+			std::vector<Holder<PointerRange<char>>> chunks;
+			std::vector<EntityImpl *> entities; // ordered by rows
+			std::vector<ArchetypeImpl *> edgesAdd, edgesRemove; // cached transitions, indexed by component definition
+			uint32 chunkShift = 0; // number of entities in a chunk is power of two
+			uint32 chunkBytes = 0;
+			uint32 chunkAlignment = 16;
+
+			ArchetypeImpl(const EntityManagerImpl *manager, std::vector<uint32> &&definitions);
+
+			CAGE_FORCE_INLINE void *value(uint32 row, uint32 column) const
+			{
+				CAGE_ASSERT(column < definitions.size());
+				CAGE_ASSERT((row >> chunkShift) < chunks.size());
+				const uint32 mask = (1u << chunkShift) - 1;
+				return chunks[row >> chunkShift]->data() + offsets[column] + (row & mask) * sizes[column];
+			}
+
+			uint32 pushRow(EntityImpl *e)
+			{
+				const uint32 row = numeric_cast<uint32>(entities.size());
+				if (!definitions.empty() && (row >> chunkShift) >= chunks.size())
+					chunks.push_back(systemMemory().createBuffer(chunkBytes, chunkAlignment));
+				entities.push_back(e);
+				return row;
+			}
+
+			void eraseRow(uint32 row);
 		};
 
 		class EntityManagerImpl : public EntityManager
@@ -37,10 +80,15 @@ namespace cage
 			std::vector<EntityComponent *> componentsByTypes;
 			ankerl::unordered_dense::map<uint32, Entity *> namedEntities;
 			FlatBag<Entity *> allEntities;
+			std::vector<Holder<ArchetypeImpl>> archetypes;
+			ankerl::unordered_dense::map<uint32, std::vector<ArchetypeImpl *>> archetypesByHash;
+			Holder<ArchetypeImpl> archetypeEmpty; // root for transitions, never contains any entities
 			uint32 generateId = 0;
 			uint32 entSize = 0;
+			uint32 trackedCount = 0; // number of components with changes tracking
+			uint32 currentVersion = 1;
 
-			EntityManagerImpl(const EntityManagerCreateConfig &config) : config(config) {}
+			EntityManagerImpl(const EntityManagerCreateConfig &config) : config(config) { archetypesReset(); }
 
 			~EntityManagerImpl()
 			{
@@ -81,6 +129,54 @@ namespace cage
 				else
 					arena->destroy<EntityImpl>(e);
 			}
+
+			ArchetypeImpl *archetypeFind(std::vector<uint32> &&definitions);
+
+			ArchetypeImpl *archetypeAdd(ArchetypeImpl *a, uint32 definition)
+			{
+				if (!a)
+					a = +archetypeEmpty;
+				CAGE_ASSERT(a->columns[definition] == m);
+				ArchetypeImpl *&r = a->edgesAdd[definition];
+				if (!r)
+				{
+					std::vector<uint32> defs = a->definitions;
+					defs.insert(std::lower_bound(defs.begin(), defs.end(), definition), definition);
+					r = archetypeFind(std::move(defs));
+				}
+				return r;
+			}
+
+			ArchetypeImpl *archetypeRemove(ArchetypeImpl *a, uint32 definition)
+			{
+				CAGE_ASSERT(a && a->columns[definition] != m);
+				if (a->definitions.size() == 1)
+					return nullptr;
+				ArchetypeImpl *&r = a->edgesRemove[definition];
+				if (!r)
+				{
+					std::vector<uint32> defs = a->definitions;
+					defs.erase(std::find(defs.begin(), defs.end(), definition));
+					r = archetypeFind(std::move(defs));
+				}
+				return r;
+			}
+
+			// values of components present in both archetypes are preserved, values of new components are left uninitialized
+			void archetypeMove(EntityImpl *e, ArchetypeImpl *dst);
+
+			void archetypesReset();
+
+			// must be called without any entities
+			void resetEntitiesArena()
+			{
+				CAGE_ASSERT(count() == 0);
+				entSize = sizeof(EntityImpl) + components.size() * sizeof(void *) + trackedCount * sizeof(uint32);
+				if (config.linearAllocators)
+					arena = newMemoryAllocatorLinear({});
+				else
+					arena = newMemoryAllocatorPool({ entSize, alignof(EntityImpl) });
+			}
 		};
 
 		class ComponentImpl : public EntityComponent
@@ -94,6 +190,10 @@ namespace cage
 			const uint32 typeSize = m;
 			const uint32 typeAlignment = m;
 			const uint32 definitionIndex = m;
+			uint32 trackingIndex = m; // index into versions of each entity, or m if changes are not tracked
+			std::vector<ArchetypeImpl *> archetypes; // all archetypes that contain this component
+			mutable std::vector<Entity *> archetypeEntities;
+			mutable bool archetypeDirty = true;
 
 			ComponentImpl(EntityManagerImpl *manager, uint32 typeIndex, const void *prototype_) : manager(manager), typeIndex(typeIndex), typeSize(detail::typeSizeByIndex(typeIndex)), typeAlignment(detail::typeAlignmentByIndex(typeIndex)), definitionIndex(numeric_cast<uint32>(manager->components.size()))
 			{
@@ -113,12 +213,146 @@ namespace cage
 				if (!manager->config.linearAllocators)
 					arena->deallocate(v);
 			}
+
+			CAGE_FORCE_INLINE void markChanged(const EntityImpl *e) const
+			{
+				if (trackingIndex != m)
+					e->version(trackingIndex) = manager->currentVersion;
+			}
+
+			// entities grouped by archetypes, so that accessing their values is sequential in memory
+			void archetypeRebuild() const
+			{
+				if (!archetypeDirty)
+					return;
+				archetypeEntities.clear();
+				for (const ArchetypeImpl *a : archetypes)
+					archetypeEntities.insert(archetypeEntities.end(), a->entities.begin(), a->entities.end());
+				archetypeDirty = false;
+			}
 		};
 
+		ArchetypeImpl::ArchetypeImpl(const EntityManagerImpl *manager, std::vector<uint32> &&definitions_) : definitions(std::move(definitions_))
+		{
+			static constexpr uint32 TargetChunkBytes = 16 * 1024;
+			const uint32 cnt = numeric_cast<uint32>(manager->components.size());
+			columns.resize(cnt, m);
+			edgesAdd.resize(cnt, nullptr);
+			edgesRemove.resize(cnt, nullptr);
+			uint32 rowBytes = 0;
+			for (uint32 c = 0; c < definitions.size(); c++)
+			{
+				const ComponentImpl *ci = +manager->components[definitions[c]];
+				columns[definitions[c]] = c;
+				sizes.push_back(ci->typeSize);
+				rowBytes += ci->typeSize;
+				chunkAlignment = std::max(chunkAlignment, ci->typeAlignment);
+			}
+			if (definitions.empty())
+				return;
+			while (chunkShift < 16 && (rowBytes << (chunkShift + 1)) <= TargetChunkBytes)
+				chunkShift++;
+			const uint32 capacity = 1u << chunkShift;
+			for (uint32 c = 0; c < definitions.size(); c++)
+			{
+				const uint32 align = manager->components[definitions[c]]->typeAlignment;
+				chunkBytes = (chunkBytes + align - 1) / align * align;
+				offsets.push_back(chunkBytes);
+				chunkBytes += sizes[c] * capacity;
+			}
+		}
+
+		void ArchetypeImpl::eraseRow(uint32 row)
+		{
+			CAGE_ASSERT(row < entities.size());
+			const uint32 last = numeric_cast<uint32>(entities.size() - 1);
+			if (row != last)
+			{
+				// move the last entity into the hole
+				EntityImpl *o = entities[last];
+				for (uint32 c = 0; c < definitions.size(); c++)
+				{
+					void *p = value(row, c);
+					detail::memcpy(p, value(last, c), sizes[c]);
+					o->comp(definitions[c]) = p;
+				}
+				o->row = row;
+				entities[row] = o;
+			}
+			entities.pop_back();
+			// keep one spare chunk to avoid thrashing, but release all memory of empty archetypes
+			const uint32 used = numeric_cast<uint32>((entities.size() + (1u << chunkShift) - 1) >> chunkShift);
+			while (chunks.size() > used + (used > 0))
+				chunks.pop_back();
+		}
+
+		ArchetypeImpl *EntityManagerImpl::archetypeFind(std::vector<uint32> &&definitions)
+		{
+			auto &bucket = archetypesByHash[hashBuffer({ (const char *)definitions.data(), (const char *)(definitions.data() + definitions.size()) })];
+			for (ArchetypeImpl *a : bucket)
+				if (a->definitions == definitions)
+					return a;
+			archetypes.push_back(systemMemory().createHolder<ArchetypeImpl>(this, std::move(definitions)));
+			ArchetypeImpl *a = +archetypes.back();
+			bucket.push_back(a);
+			for (uint32 d : a->definitions)
+			{
+				components[d]->archetypes.push_back(a);
+				components[d]->archetypeDirty = true;
+			}
+			return a;
+		}
+
+		void EntityManagerImpl::archetypesReset()
+		{
+			archetypes.clear();
+			archetypesByHash.clear();
+			for (const auto &c : components)
+			{
+				c->archetypes.clear();
+				c->archetypeDirty = true;
+			}
+			archetypeEmpty = systemMemory().createHolder<ArchetypeImpl>(this, std::vector<uint32>());
+		}
+
+		void EntityManagerImpl::archetypeMove(EntityImpl *e, ArchetypeImpl *dst)
+		{
+			ArchetypeImpl *src = e->archetype;
+			CAGE_ASSERT(src != dst);
+			uint32 row = 0;
+			if (dst)
+			{
+				row = dst->pushRow(e);
+				for (uint32 c = 0; c < dst->definitions.size(); c++)
+				{
+					const uint32 d = dst->definitions[c];
+					void *p = dst->value(row, c);
+					if (src && src->columns[d] != m)
+						detail::memcpy(p, src->value(e->row, src->columns[d]), dst->sizes[c]);
+					e->comp(d) = p;
+					components[d]->archetypeDirty = true;
+				}
+			}
+			if (src)
+			{
+				for (uint32 d : src->definitions)
+				{
+					if (!dst || dst->columns[d] == m)
+						e->comp(d) = nullptr;
+					components[d]->archetypeDirty = true;
+				}
+				src->eraseRow(e->row);
+			}
+			e->archetype = dst;
+			e->row = row;
+		}
+
 		EntityImpl::EntityImpl(EntityManagerImpl *manager, uint32 id) : manager(manager), id(id)
 		{
 			for (uint32 i = 0; i < manager->components.size(); i++)
 				comp(i) = nullptr;
+			for (uint32 i = 0; i < manager->trackedCount; i++)
+				version(i) = 0;
 			manager->allEntities.insert(this);
 			if (id != 0)
 				manager->namedEntities.emplace(id, this);
@@ -131,6 +365,12 @@ namespace cage
 			if (id != 0)
 				manager->namedEntities.erase(id);
 			manager->allEntities.erase(this);
+			if (manager->config.archetypes)
+			{
+				if (archetype)
+					manager->archetypeMove(this, nullptr);
+				return;
+			}
 			for (uint32 i = 0; i < manager->components.size(); i++)
 				if (comp(i))
 					remove(+manager->components[i]);
@@ -142,6 +382,13 @@ namespace cage
 			void **arr = (void **)(((char *)this) + sizeof(EntityImpl));
 			return arr[i];
 		}
+
+		CAGE_FORCE_INLINE uint32 &EntityImpl::version(uint32 i) const
+		{
+			CAGE_ASSERT(i < manager->trackedCount);
+			uint32 *arr = (uint32 *)(((char *)this) + sizeof(EntityImpl) + manager->components.size() * sizeof(void *));
+			return arr[i];
+		}
 	}
 
 	EntityComponent *EntityManager::componentByDefinition(uint32 definitionIndex) const
@@ -278,6 +525,12 @@ namespace cage
 		{
 			it->componentEntities.clear();
 			it->arena->flush();
+			it->archetypeDirty = true;
+		}
+		for (const auto &it : impl->archetypes)
+		{
+			it->entities.clear();
+			it->chunks.clear();
 		}
 	}
 
@@ -298,11 +551,8 @@ namespace cage
 		}
 		ComponentImpl *c = +h;
 		impl->components.push_back(std::move(h));
-		impl->entSize = sizeof(EntityImpl) + impl->components.size() * sizeof(void *);
-		if (impl->config.linearAllocators)
-			impl->arena = newMemoryAllocatorLinear({});
-		else
-			impl->arena = newMemoryAllocatorPool({ impl->entSize, alignof(EntityImpl) });
+		impl->archetypesReset(); // archetypes are sized by the number of components
+		impl->resetEntitiesArena();
 		return c;
 	}
 
@@ -311,6 +561,70 @@ namespace cage
 		return defineComponent_(source->typeIndex(), +((ComponentImpl *)source)->prototype);
 	}
 
+	uint32 EntityManager::changesCheckpoint()
+	{
+		EntityManagerImpl *impl = (EntityManagerImpl *)this;
+		return impl->currentVersion++;
+	}
+
+	bool EntityManager::archetypes() const
+	{
+		const EntityManagerImpl *impl = (const EntityManagerImpl *)this;
+		return impl->config.archetypes;
+	}
+
+	Holder<PointerRange<EntitiesChunk>> EntityManager::chunks(PointerRange<const EntityComponent *const> components) const
+	{
+		const EntityManagerImpl *impl = (const EntityManagerImpl *)this;
+		if (!impl->config.archetypes)
+			CAGE_THROW_CRITICAL(Exception, "entities chunks require archetypes storage");
+		PointerRangeHolder<EntitiesChunk> res;
+		const auto &process = [&](const ArchetypeImpl *a)
+		{
+			if (a->entities.empty())
+				return;
+			bool all = true;
+			for (const EntityComponent *c : components)
+			{
+				CAGE_ASSERT(c->manager() == this);
+				all = all && a->columns[c->definitionIndex()] != m;
+			}
+			if (!all)
+				return;
+			const uint32 total = numeric_cast<uint32>(a->entities.size());
+			const uint32 capacity = 1u << a->chunkShift;
+			Entity *const *ents = (Entity *const *)a->entities.data();
+			for (uint32 i = 0; i < total; i += capacity)
+			{
+				EntitiesChunk c;
+				c.entities = { ents + i, ents + std::min(i + capacity, total) };
+				c.archetype = a;
+				c.index = i >> a->chunkShift;
+				res.push_back(c);
+			}
+		};
+		if (components.empty())
+		{
+			for (const auto &a : impl->archetypes)
+				process(+a);
+		}
+		else
+		{
+			for (const ArchetypeImpl *a : ((const ComponentImpl *)components[0])->archetypes)
+				process(a);
+		}
+		return res;
+	}
+
+	void *EntitiesChunk::unsafeValues(const EntityComponent *component) const
+	{
+		const ArchetypeImpl *a = (const ArchetypeImpl *)archetype;
+		CAGE_ASSERT(a);
+		const uint32 column = a->columns[component->definitionIndex()];
+		CAGE_ASSERT(column != m);
+		return a->value(index << a->chunkShift, column);
+	}
+
 	Holder<EntityManager> newEntityManager(const EntityManagerCreateConfig &config)
 	{
 		return systemMemory().createImpl<EntityManager, EntityManagerImpl>(config);
@@ -337,12 +651,61 @@ namespace cage
 	PointerRange<Entity *const> EntityComponent::entities() const
 	{
 		const ComponentImpl *impl = (const ComponentImpl *)this;
+		if (impl->manager->config.archetypes)
+		{
+			impl->archetypeRebuild();
+			return impl->archetypeEntities;
+		}
 		return impl->componentEntities;
 	}
 
+	void EntityComponent::enableChangesTracking()
+	{
+		ComponentImpl *impl = (ComponentImpl *)this;
+		if (impl->trackingIndex != m)
+			return;
+		if (impl->manager->count())
+		{
+			CAGE_THROW_CRITICAL(Exception, "cannot enable changes tracking with already existing entities");
+		}
+		impl->trackingIndex = impl->manager->trackedCount++;
+		impl->manager->resetEntitiesArena();
+	}
+
+	bool EntityComponent::changesTracking() const
+	{
+		const ComponentImpl *impl = (const ComponentImpl *)this;
+		return impl->trackingIndex != m;
+	}
+
+	Holder<PointerRange<Entity *>> EntityComponent::changed(uint32 since) const
+	{
+		const ComponentImpl *impl = (const ComponentImpl *)this;
+		if (impl->trackingIndex == m)
+		{
+			CAGE_THROW_CRITICAL(Exception, "entities component does not have changes tracking enabled");
+		}
+		PointerRangeHolder<Entity *> res;
+		for (Entity *e : entities())
+			if (((const EntityImpl *)e)->version(impl->trackingIndex) > since)
+				res.push_back(e);
+		return res;
+	}
+
 	void EntityComponent::destroy()
 	{
 		ComponentImpl *impl = (ComponentImpl *)this;
+		if (impl->manager->config.archetypes)
+		{
+			// the list of archetypes may change in callbacks
+			for (uint32 i = 0; i < impl->archetypes.size(); i++)
+			{
+				ArchetypeImpl *a = impl->archetypes[i];
+				while (!a->entities.empty())
+					a->entities.back()->destroy();
+			}
+			return;
+		}
 		while (!impl->componentEntities.empty())
 			impl->componentEntities.unsafeData().back()->destroy();
 	}
@@ -366,6 +729,11 @@ namespace cage
 		void *&ptr = impl->comp(ci->definitionIndex);
 		if (ptr == nullptr)
 			return;
+		if (impl->manager->config.archetypes)
+		{
+			impl->manager->archetypeMove(impl, impl->manager->archetypeRemove(impl->archetype, ci->definitionIndex));
+			return;
+		}
 		ci->componentEntities.erase(this);
 		ci->desVal(ptr);
 		ptr = nullptr;
@@ -399,13 +767,29 @@ namespace cage
 		void *&ptr = impl->comp(ci->definitionIndex);
 		if (ptr == nullptr)
 		{
+			if (impl->manager->config.archetypes)
+			{
+				impl->manager->archetypeMove(impl, impl->manager->archetypeAdd(impl->archetype, ci->definitionIndex));
+				CAGE_ASSERT(ptr);
+				detail::memcpy(ptr, +ci->prototype, ci->typeSize);
+				ci->markChanged(impl);
+				return ptr;
+			}
 			ptr = ci->newVal();
 			detail::memcpy(ptr, +ci->prototype, ci->typeSize);
 			ci->componentEntities.insert(this);
+			ci->markChanged(impl);
 		}
 		return ptr;
 	}
 
+	void Entity::markChanged(EntityComponent *component)
+	{
+		CAGE_ASSERT(component->manager() == manager());
+		CAGE_ASSERT(has(component));
+		((ComponentImpl *)component)->markChanged((EntityImpl *)this);
+	}
+
 	void Entity::destroy()
 	{
 		CAGE_ASSERT(this); // calling free/delete on null is ok, but calling the destroy METHOD is not, and some compilers totally ignored that issue
@@ -443,6 +827,8 @@ namespace cage
 						config.destination->defineComponent(sc);
 					cbts = config.destination->componentsByType(sc->typeIndex());
 				}
+				if (sc->changesTracking())
+					cbts[idx]->enableChangesTracking();
 				res.push_back({ sc, cbts[idx] });
 			}
 			return res;
@@ -482,6 +868,33 @@ namespace cage
 				dst->namedEntities.emplace(e->id(), e);
 		}
 
+		if (dst->config.archetypes)
+		{
+			// place each entity directly into its final archetype
+			for (Entity *e : src->allEntities)
+			{
+				const EntityImpl *se = (const EntityImpl *)e;
+				ArchetypeImpl *a = nullptr;
+				for (const auto &it : mp)
+					if (se->comp(it.sc->definitionIndex()))
+						a = dst->archetypeAdd(a, it.dc->definitionIndex());
+				if (!a)
+					continue;
+				EntityImpl *de = ents[e];
+				dst->archetypeMove(de, a);
+				for (const auto &it : mp)
+				{
+					const void *v = se->comp(it.sc->definitionIndex());
+					if (v)
+					{
+						detail::memcpy(de->comp(it.dc->definitionIndex()), v, ((ComponentImpl *)it.dc)->typeSize);
+						((ComponentImpl *)it.dc)->markChanged(de);
+					}
+				}
+			}
+			return;
+		}
+
 		for (const auto &it : mp)
 		{
 			const auto sz = detail::typeSizeByIndex(it.sc->typeIndex());
@@ -492,6 +905,7 @@ namespace cage
 			{
 				EntityImpl *de = ents[se];
 				detail::memcpy(de->comp(di) = dc->newVal(), se->comp(si), sz);
+				dc->markChanged(de);
 				dc->componentEntities.unsafeData().push_back(de);
 			}
 			if (config.rebuildIndices)
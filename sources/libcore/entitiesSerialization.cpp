@@ -1,6 +1,12 @@
+#include <vector>
+
+#include <unordered_dense.h>
+
 #include <cage-core/entities.h>
 #include <cage-core/entitiesSerialization.h>
+#include <cage-core/math.h>
 #include <cage-core/memoryBuffer.h>
+#include <cage-core/memoryCompression.h>
 #include <cage-core/serialization.h>
 
 namespace cage
@@ -60,4 +66,374 @@ namespace cage
 			des.readInto({ u, u + typeSize });
 		}
 	}
+
+	namespace
+	{
+		// values are compared in words of 4 bytes, each changed word is flagged by a bit in a mask
+		constexpr uintPtr WordSize = 4;
+
+		CAGE_FORCE_INLINE uintPtr wordsCount(uintPtr typeSize)
+		{
+			return (typeSize + WordSize - 1) / WordSize;
+		}
+
+		CAGE_FORCE_INLINE uintPtr maskBytes(uintPtr typeSize)
+		{
+			return (wordsCount(typeSize) + 7) / 8;
+		}
+
+		struct Baseline : private Noncopyable
+		{
+			MemoryBuffer values; // typeSize bytes per slot
+			ankerl::unordered_dense::map<uint32, uint32> slots; // entity id -> slot
+			std::vector<uint32> frames; // frame of last export for each slot
+			std::vector<uint32> freeSlots;
+			uintPtr typeSize = 0;
+
+			uint32 allocate()
+			{
+				if (!freeSlots.empty())
+				{
+					const uint32 s = freeSlots.back();
+					freeSlots.pop_back();
+					return s;
+				}
+				const uint32 s = numeric_cast<uint32>(frames.size());
+				frames.push_back(0);
+				values.resize(values.size() + typeSize);
+				return s;
+			}
+
+			char *value(uint32 slot) { return values.data() + slot * typeSize; }
+		};
+
+		enum class DeltaFlags : uint8
+		{
+			None = 0,
+			Compressed = 1,
+		};
+
+		class EntitiesDeltaExporterImpl : public EntitiesDeltaExporter
+		{
+		public:
+			const EntitiesDeltaExporterCreateConfig config;
+			std::vector<Baseline> baselines; // indexed by component definition index
+			ankerl::unordered_dense::map<uint32, uint32> entities; // entity id -> frame of last export
+			MemoryBuffer changes, mask;
+			Holder<Compressor> compressor;
+			uint32 frame = 0;
+			bool snapshot = true; // the next export replaces all state in the importer
+
+			EntitiesDeltaExporterImpl(const EntitiesDeltaExporterCreateConfig &config) : config(config)
+			{
+				if (config.compress)
+				{
+					CompressorCreateConfig cfg;
+					cfg.preference = 10; // prefer speed, deltas are exported often
+					compressor = newCompressor(cfg);
+				}
+			}
+
+			void reset()
+			{
+				baselines.clear();
+				entities.clear();
+				snapshot = true;
+			}
+
+			// returns number of changed entities
+			uint32 exportChanges(PointerRange<Entity *const> ents, EntityComponent *component, Baseline &b)
+			{
+				const uintPtr words = wordsCount(b.typeSize);
+				changes.clear();
+				Serializer ser(changes);
+				uint32 cnt = 0;
+				for (Entity *e : ents)
+				{
+					const uint32 id = e->id();
+					if (id == 0 || !e->has(component))
+						continue;
+					const char *u = (const char *)e->unsafeValue(component);
+					auto it = b.slots.find(id);
+					const bool added = it == b.slots.end();
+					if (added)
+						it = b.slots.insert({ id, b.allocate() }).first;
+					char *base = b.value(it->second);
+					b.frames[it->second] = frame;
+					mask.resize(maskBytes(b.typeSize));
+					mask.zero();
+					bool any = added;
+					for (uintPtr w = 0; w < words; w++)
+					{
+						const uintPtr off = w * WordSize;
+						const uintPtr len = min(WordSize, b.typeSize - off);
+						if (added || detail::memcmp(base + off, u + off, len) != 0)
+						{
+							mask.data()[w / 8] |= 1 << (w % 8);
+							any = true;
+						}
+					}
+					if (!any)
+						continue;
+					cnt++;
+					ser << id;
+					ser.write(mask);
+					for (uintPtr w = 0; w < words; w++)
+					{
+						if ((mask.data()[w / 8] & (1 << (w % 8))) == 0)
+							continue;
+						const uintPtr off = w * WordSize;
+						const uintPtr len = min(WordSize, b.typeSize - off);
+						ser.write({ u + off, u + off + len });
+					}
+					detail::memcpy(base, u, b.typeSize);
+				}
+				return cnt;
+			}
+
+			// returns ids of entities that lost the component since the last export, and removes them from the baseline
+			std::vector<uint32> removedComponents(Baseline &b)
+			{
+				std::vector<uint32> removed, forgotten;
+				for (const auto &it : b.slots)
+				{
+					if (b.frames[it.second] == frame)
+						continue;
+					forgotten.push_back(it.first);
+					auto e = entities.find(it.first);
+					if (e != entities.end() && e->second == frame)
+						removed.push_back(it.first); // the entity still exists
+				}
+				for (uint32 id : forgotten)
+				{
+					auto it = b.slots.find(id);
+					b.freeSlots.push_back(it->second);
+					b.slots.erase(it);
+				}
+				return removed;
+			}
+
+			Holder<PointerRange<char>> exportBuffer(PointerRange<Entity *const> ents, PointerRange<EntityComponent *const> components)
+			{
+				frame++;
+				uint32 total = 0;
+				MemoryBuffer buffer;
+				Serializer ser(buffer);
+				ser << snapshot;
+
+				{ // created and destroyed entities
+					std::vector<uint32> created;
+					for (Entity *e : ents)
+					{
+						if (e->id() == 0)
+							continue;
+						const auto r = entities.insert({ e->id(), frame });
+						if (r.second)
+							created.push_back(e->id()); // entities without any components are not exported otherwise
+						else
+							r.first->second = frame;
+					}
+					ser << numeric_cast<uint32>(created.size());
+					for (uint32 id : created)
+						ser << id;
+					total += numeric_cast<uint32>(created.size());
+					std::vector<uint32> destroyed;
+					for (const auto &it : entities)
+						if (it.second != frame)
+							destroyed.push_back(it.first);
+					for (uint32 id : destroyed)
+						entities.erase(id);
+					ser << numeric_cast<uint32>(destroyed.size());
+					for (uint32 id : destroyed)
+						ser << id;
+					total += numeric_cast<uint32>(destroyed.size());
+				}
+
+				Serializer componentsPlaceholder = ser.reserve(sizeof(uint32));
+				uint32 componentsCount = 0;
+				for (EntityComponent *component : components)
+				{
+					const uint32 index = component->definitionIndex();
+					if (index >= baselines.size())
+						baselines.resize(index + 1);
+					Baseline &b = baselines[index];
+					b.typeSize = detail::typeSizeByIndex(component->typeIndex());
+					const uint32 changed = exportChanges(ents, component, b);
+					const std::vector<uint32> removed = removedComponents(b);
+					if (changed == 0 && removed.empty() && !snapshot)
+						continue;
+					componentsCount++;
+					total += changed + numeric_cast<uint32>(removed.size());
+					ser << index << (uint64)b.typeSize;
+					ser << numeric_cast<uint32>(removed.size());
+					for (uint32 id : removed)
+						ser << id;
+					ser << changed;
+					ser.write(changes);
+				}
+				componentsPlaceholder << componentsCount;
+
+				if (total == 0 && !snapshot)
+					return {};
+				snapshot = false;
+
+				MemoryBuffer result;
+				Serializer res(result);
+				if (compressor)
+				{
+					res << DeltaFlags::Compressed << (uint64)buffer.size();
+					res.write(compressor->compress(buffer));
+				}
+				else
+				{
+					res << DeltaFlags::None;
+					res.write(buffer);
+				}
+				return std::move(result);
+			}
+		};
+
+		// removes state that is not present in the snapshot (entities destroyed or components removed before the exporter was reset)
+		void removeMissing(PointerRange<Entity *const> ents, const ankerl::unordered_dense::set<uint32> &present, EntityComponent *component)
+		{
+			std::vector<Entity *> missing;
+			for (Entity *e : ents)
+				if (e->id() != 0 && !present.contains(e->id()))
+					missing.push_back(e);
+			for (Entity *e : missing)
+			{
+				if (component)
+					e->remove(component);
+				else
+					e->destroy();
+			}
+		}
+
+		void importDelta(Deserializer &des, EntityManager *manager)
+		{
+			bool snapshot;
+			des >> snapshot;
+			ankerl::unordered_dense::set<uint32> present;
+
+			uint32 created;
+			des >> created;
+			while (created--)
+			{
+				uint32 id;
+				des >> id;
+				if (id == 0 || id == m)
+					CAGE_THROW_ERROR(Exception, "cannot import anonymous entity");
+				manager->getOrCreate(id);
+				if (snapshot)
+					present.insert(id);
+			}
+			if (snapshot)
+				removeMissing(manager->entities(), present, nullptr);
+
+			uint32 destroyed;
+			des >> destroyed;
+			while (destroyed--)
+			{
+				uint32 id;
+				des >> id;
+				if (Entity *e = manager->tryGet(id))
+					e->destroy();
+			}
+
+			uint32 componentsCount;
+			des >> componentsCount;
+			while (componentsCount--)
+			{
+				uint32 componentIndex;
+				des >> componentIndex;
+				if (componentIndex >= manager->componentsCount())
+					CAGE_THROW_ERROR(Exception, "incompatible component (different index)");
+				EntityComponent *component = manager->componentByDefinition(componentIndex);
+				uint64 typeSize;
+				des >> typeSize;
+				if (detail::typeSizeByIndex(component->typeIndex()) != typeSize)
+					CAGE_THROW_ERROR(Exception, "incompatible component (different size)");
+
+				uint32 removed;
+				des >> removed;
+				while (removed--)
+				{
+					uint32 id;
+					des >> id;
+					if (Entity *e = manager->tryGet(id))
+						e->remove(component);
+				}
+
+				const uintPtr words = wordsCount(typeSize);
+				uint32 changed;
+				des >> changed;
+				present.clear();
+				while (changed--)
+				{
+					uint32 id;
+					des >> id;
+					if (id == 0 || id == m)
+						CAGE_THROW_ERROR(Exception, "cannot import anonymous entity");
+					if (snapshot)
+						present.insert(id);
+					const PointerRange<const char> mask = des.read(maskBytes(typeSize));
+					Entity *e = manager->getOrCreate(id);
+					char *u = (char *)e->unsafeValue(component);
+					for (uintPtr w = 0; w < words; w++)
+					{
+						if ((mask[w / 8] & (1 << (w % 8))) == 0)
+							continue;
+						const uintPtr off = w * WordSize;
+						const uintPtr len = min(WordSize, uintPtr(typeSize - off));
+						des.readInto({ u + off, u + off + len });
+					}
+				}
+				if (snapshot)
+					removeMissing(component->entities(), present, component);
+			}
+		}
+	}
+
+	Holder<PointerRange<char>> EntitiesDeltaExporter::exportBuffer(PointerRange<Entity *const> entities, PointerRange<EntityComponent *const> components)
+	{
+		EntitiesDeltaExporterImpl *impl = (EntitiesDeltaExporterImpl *)this;
+		return impl->exportBuffer(entities, components);
+	}
+
+	void EntitiesDeltaExporter::reset()
+	{
+		EntitiesDeltaExporterImpl *impl = (EntitiesDeltaExporterImpl *)this;
+		impl->reset();
+	}
+
+	Holder<EntitiesDeltaExporter> newEntitiesDeltaExporter(const EntitiesDeltaExporterCreateConfig &config)
+	{
+		return systemMemory().createImpl<EntitiesDeltaExporter, EntitiesDeltaExporterImpl>(config);
+	}
+
+	void entitiesImportDelta(PointerRange<const char> buffer, EntityManager *manager)
+	{
+		if (buffer.empty())
+			return;
+		Deserializer des(buffer);
+		DeltaFlags flags;
+		des >> flags;
+		switch (flags)
+		{
+			case DeltaFlags::None:
+				importDelta(des, manager);
+				break;
+			case DeltaFlags::Compressed:
+			{
+				uint64 size;
+				des >> size;
+				Holder<PointerRange<char>> data = memoryDecompress(des.read(des.available()), numeric_cast<uintPtr>(size));
+				Deserializer d(data);
+				importDelta(d, manager);
+				break;
+			}
+			default:
+				CAGE_THROW_ERROR(Exception, "invalid entities delta buffer");
+		}
+	}
 }
@@ -176,6 +176,16 @@ namespace cage
 		CAGE_THROW_CRITICAL(Exception, "reading with offset from abstract file");
 	}
 
+	Holder<PointerRange<char>> FileAbstract::mapAt(uint64 at, uint64 size)
+	{
+		return {};
+	}
+
+	FILE *FileAbstract::nativeAt(uint64 &at)
+	{
+		return nullptr;
+	}
+
 	Holder<PointerRange<char>> FileAbstract::readAll()
 	{
 		ScopeLock lock(fsMutex());
@@ -62,9 +62,7 @@ namespace cage
 		CAGE_ASSERT(s < uintPtr(m) / 2);
 		if (!s)
 			return {};
-		MemoryBuffer r(s);
-		read(r);
-		return std::move(r);
+		return read(s); // allows the file to provide a view instead of a copy
 	}
 
 	String File::readLine()
@@ -521,7 +521,13 @@ namespace cage
 				ScopeLock lock(fsMutex());
 				CAGE_ASSERT(myMode.read);
 				CAGE_ASSERT(src);
-				class_cast<FileAbstract *>(+src)->readAt(buffer, at);
+				if (FileAbstract *s = dynamic_cast<FileAbstract *>(+src))
+					return s->readAt(buffer, at);
+				// the file content is in memory
+				const uint64 orig = src->tell();
+				src->seek(at);
+				src->read(buffer);
+				src->seek(orig);
 			}
 
 			void read(PointerRange<char> buffer) override
@@ -532,6 +538,39 @@ namespace cage
 				src->read(buffer);
 			}
 
+			Holder<PointerRange<char>> mapAt(uint64 at, uint64 size) override
+			{
+				ScopeLock lock(fsMutex());
+				CAGE_ASSERT(myMode.read);
+				CAGE_ASSERT(src);
+				if (modified)
+					return {};
+				if (FileAbstract *s = dynamic_cast<FileAbstract *>(+src))
+					return s->mapAt(at, size);
+				return {};
+			}
+
+			FILE *nativeAt(uint64 &at) override
+			{
+				ScopeLock lock(fsMutex());
+				CAGE_ASSERT(myMode.read);
+				CAGE_ASSERT(src);
+				if (modified)
+					return nullptr;
+				if (FileAbstract *s = dynamic_cast<FileAbstract *>(+src))
+					return s->nativeAt(at);
+				return nullptr; // the file content is in memory
+			}
+
+			// unmodified files are served directly from a mapping of the archive, when possible
+			Holder<PointerRange<char>> read(uint64 size) override
+			{
+				ScopeLock lock(fsMutex());
+				CAGE_ASSERT(myMode.read);
+				CAGE_ASSERT(src);
+				return src->read(size);
+			}
+
 			void write(PointerRange<const char> buffer) override
 			{
 				ScopeLock lock(fsMutex());
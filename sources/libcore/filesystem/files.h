@@ -1,6 +1,7 @@
 #ifndef guard_files_h_sdrgds45rfgt
 #define guard_files_h_sdrgds45rfgt
 
+#include <cstdio>
 #include <memory>
 
 #include <cage-core/concurrent.h>
@@ -19,6 +20,8 @@ namespace cage
 
 		virtual void reopenForModification();
 		virtual void readAt(PointerRange<char> buffer, uint64 at);
+		virtual Holder<PointerRange<char>> mapAt(uint64 at, uint64 size); // private (copy-on-write) view of the file contents, returns empty holder if not available (or if the range exceeds the file), the view is not affected by later modifications of the file in this process, but truncating or rewriting the file by other processes while the view is alive is undefined (may crash), therefore it is used for archives only
+		virtual FILE *nativeAt(uint64 &at); // real file that holds the contents (at is updated to position in that file), returns null if not available
 		Holder<PointerRange<char>> readAll() override; // override with additional check
 		FileMode mode() const final;
 	};
@@ -32,6 +32,34 @@ namespace cage
 			off += buffer.size();
 		}
 
+		Holder<PointerRange<char>> mapAt(uint64 at, uint64 size) override
+		{
+			ScopeLock lock(fsMutex());
+			CAGE_ASSERT(f);
+			CAGE_ASSERT(size <= capacity - at);
+			return f->mapAt(start + at, size);
+		}
+
+		FILE *nativeAt(uint64 &at) override
+		{
+			ScopeLock lock(fsMutex());
+			CAGE_ASSERT(f);
+			at += start;
+			return f->nativeAt(at);
+		}
+
+		Holder<PointerRange<char>> read(uint64 size) override
+		{
+			ScopeLock lock(fsMutex());
+			CAGE_ASSERT(f);
+			CAGE_ASSERT(size <= capacity - off);
+			Holder<PointerRange<char>> r = f->mapAt(start + off, size);
+			if (!r)
+				return FileAbstract::read(size);
+			off += size;
+			return r;
+		}
+
 		void seek(uint64 position) override
 		{
 			ScopeLock lock(fsMutex());
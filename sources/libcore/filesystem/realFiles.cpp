@@ -1,4 +1,6 @@
+#include <atomic>
 #include <cstdlib>
+#include <exception>
 #include <filesystem>
 #include <string>
 #include <vector>
@@ -16,7 +18,10 @@
 #ifdef CAGE_SYSTEM_LINUX
 	#define _FILE_OFFSET_BITS 64
 	#include <dirent.h>
+	#include <linux/io_uring.h>
+	#include <sys/mman.h>
 	#include <sys/stat.h>
+	#include <sys/syscall.h>
 	#include <unistd.h>
 	#define fseek64 fseeko64
 	#define ftell64 ftello64
@@ -26,6 +31,7 @@
 	#define _FILE_OFFSET_BITS 64
 	#include <dirent.h>
 	#include <mach-o/dyld.h>
+	#include <sys/mman.h>
 	#include <sys/stat.h>
 	#include <unistd.h>
 	#define fseek64 fseeko
@@ -228,6 +234,132 @@ namespace cage
 #endif
 		}
 
+		// smaller reads are faster with plain copy than with setting up the mapping
+		constexpr uint64 MapThreshold = 64 * 1024;
+
+		struct FileMapping;
+
+		// all views that are still alive
+		// the copy-on-write views are private to writes through the views only, changes made to the file itself may appear in the views (or cause SIGBUS after truncation)
+		// therefore the views are detached from the file before it is opened for modification in this process
+		// modifications of the file by other processes are not detected
+		struct FileMappings : private Immovable
+		{
+			Holder<Mutex> mutex = newMutex();
+			std::vector<FileMapping *> views;
+
+			void detach(const String &path);
+		};
+
+		FileMappings &fileMappings()
+		{
+			static FileMappings *m = new FileMappings(); // intentional leak - views may outlive static destruction
+			return *m;
+		}
+
+		struct FileMapping : private Immovable
+		{
+			void *base = nullptr;
+			uint64 length = 0;
+			PointerRange<char> range;
+			String path;
+
+			// writing to every page makes a private copy of it, which is no longer backed by the file
+			void detach()
+			{
+				static constexpr uint64 PageSize = 4096; // touching more often than necessary is harmless
+				char *p = (char *)base;
+				for (uint64 i = 0; i < length; i += PageSize)
+					std::atomic_ref<char>(p[i]).fetch_or(0, std::memory_order_relaxed); // the views may be read concurrently
+			}
+
+			~FileMapping()
+			{
+				if (!base)
+					return;
+				{
+					FileMappings &fm = fileMappings();
+					ScopeLock lock(fm.mutex);
+					std::erase(fm.views, this);
+				}
+#ifdef CAGE_SYSTEM_WINDOWS
+				UnmapViewOfFile(base);
+#else
+				munmap(base, length);
+#endif
+			}
+		};
+
+		uint64 mapGranularity()
+		{
+			static const uint64 g = []() -> uint64
+			{
+#ifdef CAGE_SYSTEM_WINDOWS
+				SYSTEM_INFO info;
+				GetSystemInfo(&info);
+				return info.dwAllocationGranularity;
+#else
+				return sysconf(_SC_PAGESIZE);
+#endif
+			}();
+			return g;
+		}
+
+		void FileMappings::detach(const String &path)
+		{
+			ScopeLock lock(mutex);
+			for (FileMapping *v : views)
+				if (v->path == path)
+					v->detach();
+		}
+
+		// the mapping is private, modifications to the memory are not written back to the file, nor visible to other views
+		Holder<PointerRange<char>> mapAtImpl(const uint64 at, const uint64 size, FILE *f, const String &path)
+		{
+			CAGE_ASSERT(f);
+			const uint64 g = mapGranularity();
+			const uint64 begin = at / g * g;
+			const uint64 length = at + size - begin;
+			if (length > uint64(m) / 2)
+				return {};
+			// touching pages past the end of the file would fault, the copy path reports the error instead
+#ifdef CAGE_SYSTEM_WINDOWS
+			const HANDLE handle = (HANDLE)_get_osfhandle(_fileno(f));
+			LARGE_INTEGER fileSize;
+			if (!GetFileSizeEx(handle, &fileSize) || at + size > uint64(fileSize.QuadPart))
+				return {};
+#else
+			struct stat st;
+			if (fstat(fileno(f), &st) != 0 || at + size > uint64(st.st_size))
+				return {};
+#endif
+			Holder<FileMapping> h = systemMemory().createHolder<FileMapping>();
+#ifdef CAGE_SYSTEM_WINDOWS
+			const HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+			if (!mapping)
+				return {};
+			void *p = MapViewOfFile(mapping, FILE_MAP_COPY, (DWORD)(begin >> 32), (DWORD)begin, numeric_cast<SIZE_T>(length));
+			CloseHandle(mapping); // the view keeps the mapping alive
+			if (!p)
+				return {};
+#else
+			void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileno(f), begin);
+			if (p == MAP_FAILED)
+				return {};
+#endif
+			h->base = p;
+			h->length = length;
+			h->path = path;
+			{
+				FileMappings &fm = fileMappings();
+				ScopeLock lock(fm.mutex);
+				fm.views.push_back(+h);
+			}
+			char *b = (char *)p + (at - begin);
+			h->range = { b, b + size };
+			return Holder<PointerRange<char>>(&h->range, std::move(h));
+		}
+
 		void writeAtImpl(PointerRange<const char> buffer, const uint64 at, FILE *f)
 		{
 			CAGE_ASSERT(f);
@@ -273,7 +405,10 @@ namespace cage
 			{
 				CAGE_ASSERT(mode.valid());
 				if (mode.write)
+				{
 					realCreateDirectories(pathJoin(path, ".."));
+					fileMappings().detach(path); // opening for writing may truncate the file
+				}
 #ifdef CAGE_SYSTEM_WINDOWS
 				f = _wfopen(Widen(path), Widen(mode.mode()));
 #else
@@ -389,6 +524,7 @@ namespace cage
 				ScopeLock lock(fsMutex());
 				CAGE_ASSERT(myMode.read && !myMode.write);
 				CAGE_ASSERT(f);
+				fileMappings().detach(myPath); // subsequent writes must not be observed by the existing views
 				FileMode newMode = myMode;
 				newMode.write = true;
 #ifdef CAGE_SYSTEM_WINDOWS
@@ -419,6 +555,28 @@ namespace cage
 				readAtImpl(buffer, at, ff);
 			}
 
+			FILE *nativeAt(uint64 &at) override
+			{
+				ScopeLock lock(fsMutex());
+				CAGE_ASSERT(f);
+				CAGE_ASSERT(myMode.read);
+				if (myMode.write)
+					return nullptr; // buffered writes would not be observed
+				return f;
+			}
+
+			Holder<PointerRange<char>> mapAt(uint64 at, uint64 size) override
+			{
+				if (size < MapThreshold)
+					return {};
+				ScopeLock lock(fsMutex()); // the view must be registered before the file can be reopened for modification
+				CAGE_ASSERT(f);
+				CAGE_ASSERT(myMode.read);
+				if (myMode.write)
+					return {}; // the view could observe subsequent writes
+				return mapAtImpl(at, size, f, myPath);
+			}
+
 			void read(PointerRange<char> buffer) override
 			{
 				if (buffer.size() == 0)
@@ -528,6 +686,256 @@ namespace cage
 			}
 		};
 
+		struct NativeRead
+		{
+			FILE *f = nullptr;
+			PointerRange<char> buffer;
+			uint64 at = 0;
+		};
+
+#ifdef CAGE_SYSTEM_LINUX
+		// minimal io_uring, only for reading files
+		// submission and completion rings are accessed by a single thread
+		struct IoUring : private Immovable
+		{
+			static constexpr uint32 Entries = 64;
+
+			int fd = -1;
+			void *sqRing = nullptr;
+			void *cqRing = nullptr;
+			uint64 sqRingSize = 0;
+			uint64 cqRingSize = 0;
+			io_uring_sqe *sqes = nullptr;
+			uint64 sqesSize = 0;
+			uint32 *sqTail = nullptr;
+			uint32 *sqArray = nullptr;
+			uint32 sqMask = 0;
+			uint32 *cqHead = nullptr;
+			uint32 *cqTail = nullptr;
+			io_uring_cqe *cqes = nullptr;
+			uint32 cqMask = 0;
+			uint32 capacity = 0;
+
+			static inline std::atomic<bool> unavailable = false;
+
+			IoUring()
+			{
+				if (unavailable)
+					return;
+				io_uring_params p = {};
+				fd = numeric_cast<int>(syscall(__NR_io_uring_setup, Entries, &p));
+				if (fd < 0)
+				{
+					unavailable = true; // eg. old kernel or forbidden in a container
+					return;
+				}
+				sqRingSize = p.sq_off.array + p.sq_entries * sizeof(uint32);
+				cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+				const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+				if (single)
+					sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+				sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+				if (sqRing == MAP_FAILED)
+				{
+					sqRing = nullptr;
+					destroy();
+					return;
+				}
+				if (single)
+					cqRing = sqRing;
+				else
+				{
+					cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+					if (cqRing == MAP_FAILED)
+					{
+						cqRing = nullptr;
+						destroy();
+						return;
+					}
+				}
+				sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+				void *s = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+				if (s == MAP_FAILED)
+				{
+					destroy();
+					return;
+				}
+				sqes = (io_uring_sqe *)s;
+				char *sq = (char *)sqRing;
+				char *cq = (char *)cqRing;
+				sqTail = (uint32 *)(sq + p.sq_off.tail);
+				sqArray = (uint32 *)(sq + p.sq_off.array);
+				sqMask = *(uint32 *)(sq + p.sq_off.ring_mask);
+				cqHead = (uint32 *)(cq + p.cq_off.head);
+				cqTail = (uint32 *)(cq + p.cq_off.tail);
+				cqes = (io_uring_cqe *)(cq + p.cq_off.cqes);
+				cqMask = *(uint32 *)(cq + p.cq_off.ring_mask);
+				capacity = min(p.sq_entries, p.cq_entries);
+			}
+
+			~IoUring() { destroy(); }
+
+			void destroy()
+			{
+				if (sqes)
+					munmap(sqes, sqesSize);
+				if (cqRing && cqRing != sqRing)
+					munmap(cqRing, cqRingSize);
+				if (sqRing)
+					munmap(sqRing, sqRingSize);
+				if (fd >= 0)
+					close(fd);
+				fd = -1;
+				sqRing = cqRing = nullptr;
+				sqes = nullptr;
+			}
+
+			bool valid() const { return !!sqes; }
+
+			// returns false if the ring cannot be used, no reads were submitted in that case
+			bool process(PointerRange<const NativeRead> reads)
+			{
+				CAGE_ASSERT(reads.size() <= capacity);
+				const uint32 cnt = numeric_cast<uint32>(reads.size());
+				uint32 tail = *sqTail; // only this thread writes the tail
+				for (uint32 i = 0; i < cnt; i++)
+				{
+					const NativeRead &r = reads[i];
+					const uint32 index = tail & sqMask;
+					io_uring_sqe &sqe = sqes[index];
+					detail::memset(&sqe, 0, sizeof(sqe));
+					sqe.opcode = IORING_OP_READ;
+					sqe.fd = fileno(r.f);
+					sqe.off = r.at;
+					sqe.addr = (uint64)r.buffer.data();
+					sqe.len = numeric_cast<uint32>(r.buffer.size());
+					sqe.user_data = i;
+					sqArray[index] = index;
+					tail++;
+				}
+				std::atomic_ref(*sqTail).store(tail, std::memory_order_release);
+
+				// the kernel consumes the entries in order
+				uint32 submitted = 0;
+				while (submitted < cnt)
+				{
+					const long k = syscall(__NR_io_uring_enter, fd, cnt - submitted, 0, 0, nullptr, 0);
+					if (k < 0)
+					{
+						if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+							continue;
+						if (submitted == 0)
+							return false; // the ring is closed afterwards, which discards the entries
+						break; // the remaining entries are read below
+					}
+					submitted += numeric_cast<uint32>(k);
+				}
+
+				// all submitted reads must complete before any exception is thrown, the kernel writes into the buffers
+				std::exception_ptr exception;
+				const auto fallbackRead = [&](PointerRange<char> buffer, uint64 at, FILE *f)
+				{
+					try
+					{
+						readAtImpl(buffer, at, f);
+					}
+					catch (...)
+					{
+						if (!exception)
+							exception = std::current_exception();
+					}
+				};
+				int error = 0;
+				uint32 completed = 0;
+				while (completed < submitted)
+				{
+					uint32 head = *cqHead; // only this thread writes the head
+					const uint32 available = std::atomic_ref(*cqTail).load(std::memory_order_acquire);
+					if (head == available)
+					{
+						// keep waiting even if the waiting fails, the completions are posted regardless
+						if (syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR && !error)
+							error = errno;
+						continue;
+					}
+					while (head != available)
+					{
+						const io_uring_cqe &cqe = cqes[head & cqMask];
+						const NativeRead &r = reads[cqe.user_data];
+						if (cqe.res < 0)
+						{
+							if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP)
+								fallbackRead(r.buffer, r.at, r.f); // the read operation is not supported by the kernel
+							else if (!error)
+								error = -cqe.res;
+						}
+						else if (uint64(cqe.res) < r.buffer.size())
+						{
+							// finish short read
+							const PointerRange<char> rest = { r.buffer.data() + cqe.res, r.buffer.end() };
+							fallbackRead(rest, r.at + cqe.res, r.f);
+						}
+						head++;
+						completed++;
+					}
+					std::atomic_ref(*cqHead).store(head, std::memory_order_release);
+				}
+
+				if (submitted < cnt)
+				{
+					// closing the ring discards the entries not consumed by the kernel
+					unavailable = true;
+					destroy();
+					for (uint32 i = submitted; i < cnt; i++)
+						fallbackRead(reads[i].buffer, reads[i].at, reads[i].f);
+				}
+
+				if (exception)
+					std::rethrow_exception(exception);
+				if (error)
+					CAGE_THROW_ERROR(SystemError, "io_uring read", error);
+				return true;
+			}
+		};
+
+		// one ring per thread, created on first use
+		thread_local IoUring threadRing;
+#endif // CAGE_SYSTEM_LINUX
+
+		void readBatchImpl(PointerRange<const NativeRead> reads)
+		{
+			uint32 i = 0;
+#ifdef CAGE_SYSTEM_LINUX
+			static constexpr uint64 MaxRingRead = 1024 * 1024 * 1024;
+			if (reads.size() > 1 && !IoUring::unavailable)
+			{
+				std::vector<NativeRead> chunk;
+				while (threadRing.valid() && i < reads.size())
+				{
+					chunk.clear();
+					uint32 j = i;
+					while (j < reads.size() && chunk.size() < threadRing.capacity)
+					{
+						const NativeRead &r = reads[j++];
+						if (r.buffer.size() > MaxRingRead)
+							readAtImpl(r.buffer, r.at, r.f);
+						else
+							chunk.push_back(r);
+					}
+					if (!threadRing.process(chunk))
+					{
+						IoUring::unavailable = true;
+						threadRing.destroy();
+						break; // the remaining reads, including this chunk, are done below
+					}
+					i = j;
+				}
+			}
+#endif // CAGE_SYSTEM_LINUX
+			for (; i < reads.size(); i++)
+				readAtImpl(reads[i].buffer, reads[i].at, reads[i].f);
+		}
+
 		bool linuxSameDevice(const String &pa, const String &pb)
 		{
 #ifdef CAGE_SYSTEM_WINDOWS
@@ -814,6 +1222,35 @@ namespace cage
 		}
 	}
 
+	void filesReadBatch(PointerRange<const FileReadRequest> requests)
+	{
+		std::vector<NativeRead> natives;
+		natives.reserve(requests.size());
+		for (const FileReadRequest &r : requests)
+		{
+			CAGE_ASSERT(r.file);
+			if (r.buffer.empty())
+				continue;
+			if (FileAbstract *a = dynamic_cast<FileAbstract *>(r.file))
+			{
+				uint64 at = r.at;
+				if (FILE *f = a->nativeAt(at))
+					natives.push_back({ f, r.buffer, at });
+				else
+					a->readAt(r.buffer, r.at);
+			}
+			else
+			{
+				// eg. memory files
+				const uint64 orig = r.file->tell();
+				r.file->seek(r.at);
+				r.file->read(r.buffer);
+				r.file->seek(orig);
+			}
+		}
+		readBatchImpl(natives);
+	}
+
 	std::shared_ptr<ArchiveAbstract> archiveOpenReal(const String &path)
 	{
 		return std::make_shared<ArchiveReal>(path);
@@ -1,5 +1,8 @@
 #include <algorithm>
 #include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
 #include <vector>
 
 #include <cage-core/collider.h>
@@ -10,13 +13,39 @@
 #include <cage-core/pointerRangeHolder.h>
 #include <cage-core/serialization.h>
 
+#include "simd.h"
+
 namespace cage
 {
 	namespace
 	{
+		using privat::F4;
+
 		class ColliderImpl : public Collider
 		{
 		public:
+			// 4-wide node with child boxes quantized relative to the bounding box of the whole collider
+			struct Node4
+			{
+				uint16 low[3][4] = {}; // [axis][child]
+				uint16 high[3][4] = {};
+
+				// m - unused slot
+				// LeafFlag - leaf: index of first triangle << LeafShift | triangles count
+				// otherwise - index of child node
+				uint32 children[4] = { m, m, m, m };
+			};
+			static_assert(sizeof(Node4) == 64);
+
+			static constexpr uint32 LeafFlag = 1u << 31;
+			static constexpr uint32 LeafShift = 4;
+			static constexpr uint32 LeafMaxTriangles = (1u << LeafShift) - 1;
+
+			CAGE_FORCE_INLINE static bool isLeaf(uint32 child) { return (child & LeafFlag) != 0; }
+			CAGE_FORCE_INLINE static uint32 leafFirst(uint32 child) { return (child & ~LeafFlag) >> LeafShift; }
+			CAGE_FORCE_INLINE static uint32 leafCount(uint32 child) { return child & LeafMaxTriangles; }
+
+			// binary node used during building only
 			struct Node
 			{
 				// for leaf - index of first triangle in this node
@@ -29,10 +58,15 @@ namespace cage
 			};
 
 			std::vector<Triangle> tris;
-			std::vector<Aabb> boxes;
-			std::vector<Node> nodes;
+			std::vector<Node4> nodes;
+			Aabb bounds;
+			Vec3 quantOrigin;
+			Vec3 quantStep;
 			bool dirty = true;
 
+			std::vector<Aabb> buildBoxes;
+			std::vector<Node> buildNodes;
+
 			ColliderImpl() { ((Collider *)this)->rebuild(); }
 
 			void buildLeaf(std::vector<Triangle> &ts)
@@ -41,7 +75,7 @@ namespace cage
 				n.left = numeric_cast<uint32>(tris.size());
 				n.right = n.left + numeric_cast<uint32>(ts.size());
 				tris.insert(tris.end(), ts.begin(), ts.end());
-				nodes.push_back(n);
+				buildNodes.push_back(n);
 			}
 
 			void build(std::vector<Triangle> &ts, uint32 level)
@@ -50,7 +84,7 @@ namespace cage
 				Aabb b;
 				for (const auto &it : ts)
 					b += Aabb(it);
-				boxes.push_back(b);
+				buildBoxes.push_back(b);
 
 				// primitive nodes form leaves
 				if (ts.size() <= 10)
@@ -123,8 +157,14 @@ namespace cage
 
 				if (axis == m) // found no split
 				{
-					buildLeaf(ts);
-					return;
+					if (ts.size() <= LeafMaxTriangles)
+					{
+						buildLeaf(ts);
+						return;
+					}
+					// the leaf would be too large, split it arbitrarily
+					axis = 0;
+					split = numeric_cast<uint32>(ts.size()) / 2;
 				}
 
 				// actually split the triangles
@@ -135,30 +175,147 @@ namespace cage
 				std::vector<Triangle> right(ts.begin() + split, ts.end());
 
 				// build the node and recurse
-				uint32 idx = numeric_cast<uint32>(nodes.size());
-				nodes.push_back(Node());
+				uint32 idx = numeric_cast<uint32>(buildNodes.size());
+				buildNodes.push_back(Node());
 				build(left, level + 1);
-				nodes[idx].right = numeric_cast<uint32>(nodes.size());
+				buildNodes[idx].right = numeric_cast<uint32>(buildNodes.size());
 				build(right, level + 1);
 			}
 
+			CAGE_FORCE_INLINE Real dequantize(uint16 q, uint32 axis) const { return float(q) * quantStep[axis].value + quantOrigin[axis].value; }
+
+			// the dequantized boxes must enclose the original boxes, even if the computations are fused or reordered
+			Real slack(uint32 axis) const { return (abs(bounds.a[axis]) + abs(bounds.b[axis])) * 1e-6; }
+
+			void prepareQuantization()
+			{
+				quantOrigin = quantStep = Vec3();
+				if (bounds.empty())
+					return;
+				for (uint32 axis = 0; axis < 3; axis++)
+				{
+					quantOrigin[axis] = bounds.a[axis];
+					const Real target = bounds.b[axis] + slack(axis);
+					quantStep[axis] = (target - bounds.a[axis]) / 65535;
+					while (dequantize(65535, axis) < target)
+						quantStep[axis] = std::nextafter(quantStep[axis].value, std::numeric_limits<float>::infinity());
+				}
+			}
+
+			uint16 quantizeLow(Real v, uint32 axis) const
+			{
+				if (quantStep[axis] == 0)
+					return 0;
+				const Real t = v - slack(axis);
+				uint32 q = numeric_cast<uint32>(clamp(floor((t - quantOrigin[axis]) / quantStep[axis]), 0, 65535));
+				while (q > 0 && dequantize(q, axis) > t)
+					q--;
+				return numeric_cast<uint16>(q);
+			}
+
+			uint16 quantizeHigh(Real v, uint32 axis) const
+			{
+				if (quantStep[axis] == 0)
+					return 0;
+				const Real t = v + slack(axis);
+				uint32 q = numeric_cast<uint32>(clamp(ceil((t - quantOrigin[axis]) / quantStep[axis]), 0, 65535));
+				while (q < 65535 && dequantize(q, axis) < t)
+					q++;
+				return numeric_cast<uint16>(q);
+			}
+
+			Aabb childBox(const Node4 &n, uint32 slot) const
+			{
+				CAGE_ASSERT(n.children[slot] != m);
+				Aabb r;
+				for (uint32 axis = 0; axis < 3; axis++)
+				{
+					r.a[axis] = dequantize(n.low[axis][slot], axis);
+					r.b[axis] = dequantize(n.high[axis][slot], axis);
+				}
+				return r;
+			}
+
+			uint32 encodeChild(uint32 buildIndex)
+			{
+				const Node &bn = buildNodes[buildIndex];
+				if (bn.left == m)
+					return flatten(buildIndex);
+				const uint32 cnt = bn.right - bn.left;
+				CAGE_ASSERT(cnt <= LeafMaxTriangles);
+				if (bn.left >= (LeafFlag >> LeafShift))
+					CAGE_THROW_ERROR(Exception, "collider has too many triangles");
+				return LeafFlag | (bn.left << LeafShift) | cnt;
+			}
+
+			// collapses binary nodes into 4-wide nodes
+			uint32 flatten(uint32 buildIndex)
+			{
+				CAGE_ASSERT(buildNodes[buildIndex].left == m);
+				uint32 cs[4] = { buildIndex + 1, buildNodes[buildIndex].right, m, m };
+				uint32 cnt = 2;
+				while (cnt < 4)
+				{
+					// open the inner child with largest surface
+					uint32 best = m;
+					Real bestSurface = -1;
+					for (uint32 i = 0; i < cnt; i++)
+					{
+						if (buildNodes[cs[i]].left != m)
+							continue;
+						const Real s = buildBoxes[cs[i]].surface();
+						if (s > bestSurface)
+						{
+							bestSurface = s;
+							best = i;
+						}
+					}
+					if (best == m)
+						break;
+					const uint32 c = cs[best];
+					cs[best] = c + 1;
+					cs[cnt++] = buildNodes[c].right;
+				}
+
+				const uint32 idx = numeric_cast<uint32>(nodes.size());
+				nodes.push_back(Node4());
+				for (uint32 i = 0; i < cnt; i++)
+				{
+					const Aabb b = buildBoxes[cs[i]];
+					const uint32 child = encodeChild(cs[i]);
+					Node4 &n = nodes[idx];
+					for (uint32 axis = 0; axis < 3; axis++)
+					{
+						n.low[axis][i] = quantizeLow(b.a[axis], axis);
+						n.high[axis][i] = quantizeHigh(b.b[axis], axis);
+					}
+					n.children[i] = child;
+				}
+				return idx;
+			}
+
 			void validate(uint32 idx)
 			{
 				CAGE_ASSERT(idx < nodes.size());
-				const Node &n = nodes[idx];
-				if (n.left == m)
-				{ // node
-					CAGE_ASSERT(intersection(boxes[idx], boxes[idx + 1]) == boxes[idx + 1]);
-					CAGE_ASSERT(intersection(boxes[idx], boxes[n.right]) == boxes[n.right]);
-					validate(idx + 1);
-					validate(n.right);
-				}
-				else
-				{ // leaf
-					for (uint32 i = n.left; i < n.right; i++)
+				const Node4 &n = nodes[idx];
+				for (uint32 i = 0; i < 4; i++)
+				{
+					const uint32 c = n.children[i];
+					if (c == m)
+						continue;
+					const Aabb b = childBox(n, i);
+					if (isLeaf(c))
+					{
+						for (uint32 t = leafFirst(c), e = t + leafCount(c); t < e; t++)
+						{
+							const Aabb tb = Aabb(tris[t]);
+							CAGE_ASSERT(intersection(b, tb) == tb);
+						}
+					}
+					else
 					{
-						Triangle t = tris[i];
-						CAGE_ASSERT(intersection(boxes[idx], Aabb(t)) == Aabb(t));
+						CAGE_ASSERT(c > idx);
+						validate(c);
 					}
 				}
 			}
@@ -166,16 +323,36 @@ namespace cage
 			void rebuild()
 			{
 				const uint32 trisCount = numeric_cast<uint32>(tris.size());
-				boxes.clear();
-				boxes.reserve(trisCount / 5);
+				buildBoxes.clear();
+				buildBoxes.reserve(trisCount / 5);
+				buildNodes.clear();
+				buildNodes.reserve(trisCount / 5);
 				nodes.clear();
-				nodes.reserve(trisCount / 5);
+				nodes.reserve(trisCount / 15);
 				std::vector<Triangle> ts;
 				ts.reserve(trisCount);
 				ts.swap(tris);
 				build(ts, 0);
 				CAGE_ASSERT(tris.size() == trisCount);
-				CAGE_ASSERT(boxes.size() == nodes.size());
+				CAGE_ASSERT(buildBoxes.size() == buildNodes.size());
+				bounds = buildBoxes[0];
+				prepareQuantization();
+				if (buildNodes[0].left == m)
+					flatten(0);
+				else
+				{
+					Node4 n;
+					for (uint32 axis = 0; axis < 3; axis++)
+					{
+						n.low[axis][0] = quantizeLow(bounds.a[axis], axis);
+						n.high[axis][0] = quantizeHigh(bounds.b[axis], axis);
+					}
+					if (trisCount > 0)
+						n.children[0] = encodeChild(0);
+					nodes.push_back(n);
+				}
+				buildBoxes = {};
+				buildNodes = {};
 #ifdef CAGE_DEBUG
 				validate(0);
 #endif // CAGE_DEBUG
@@ -183,6 +360,13 @@ namespace cage
 		};
 	}
 
+	namespace serialization
+	{
+		template<>
+		struct Memcpyable<ColliderImpl::Node4> : std::true_type
+		{};
+	}
+
 	PointerRange<const Triangle> Collider::triangles() const
 	{
 		const ColliderImpl *impl = (const ColliderImpl *)this;
@@ -238,8 +422,8 @@ namespace cage
 	{
 		ColliderImpl *impl = (ColliderImpl *)this;
 		impl->tris.clear();
-		impl->boxes.clear();
 		impl->nodes.clear();
+		impl->bounds = Aabb();
 		impl->dirty = true;
 	}
 
@@ -269,7 +453,7 @@ namespace cage
 	{
 		CAGE_ASSERT(!needsRebuild());
 		const ColliderImpl *impl = (const ColliderImpl *)this;
-		return impl->boxes[0];
+		return impl->bounds;
 	}
 
 	namespace
@@ -277,7 +461,7 @@ namespace cage
 		struct ColliderHeader
 		{
 			std::array<char, 12> cageName = { "cageColider" };
-			uint32 version = 3;
+			uint32 version = 4;
 			bool dirty;
 		};
 	}
@@ -289,11 +473,34 @@ namespace cage
 		Deserializer des(buffer);
 		ColliderHeader header;
 		des >> header;
-		if (header.cageName != ColliderHeader().cageName || header.version != ColliderHeader().version)
-			CAGE_THROW_ERROR(Exception, "invalid magic or version in collider deserialization");
+		if (header.cageName != ColliderHeader().cageName)
+			CAGE_THROW_ERROR(Exception, "invalid magic in collider deserialization");
+		if (header.version == 3)
+		{
+			// older format with binary tree, the triangles are reused and the tree is rebuilt
+			struct Node
+			{
+				uint32 left = m;
+				uint32 right = m;
+			};
+			std::vector<Aabb> boxes;
+			std::vector<Node> nodes;
+			des >> impl->tris;
+			des >> boxes;
+			des >> nodes;
+			CAGE_ASSERT(des.available() == 0);
+			impl->dirty = true;
+			if (!header.dirty)
+				rebuild();
+			return;
+		}
+		if (header.version != ColliderHeader().version)
+			CAGE_THROW_ERROR(Exception, "invalid version in collider deserialization");
 		impl->dirty = header.dirty;
 		des >> impl->tris;
-		des >> impl->boxes;
+		des >> impl->bounds;
+		des >> impl->quantOrigin;
+		des >> impl->quantStep;
 		des >> impl->nodes;
 		CAGE_ASSERT(des.available() == 0);
 	}
@@ -335,7 +542,9 @@ namespace cage
 		header.dirty = impl->dirty;
 		ser << header;
 		ser << impl->tris;
-		ser << impl->boxes;
+		ser << impl->bounds;
+		ser << impl->quantOrigin;
+		ser << impl->quantStep;
 		ser << impl->nodes;
 		return std::move(buffer);
 	}
@@ -394,80 +603,198 @@ namespace cage
 			CAGE_FORCE_INLINE T operator[](uint32 idx) const { return original[idx]; }
 		};
 
+		// boxes of children of the 4-wide nodes
+		template<bool Transform>
+		class LazyBoxes
+		{};
+
+		template<>
+		class LazyBoxes<true>
+		{
+		public:
+			std::vector<Aabb> data;
+			std::vector<bool> flags;
+			const ColliderImpl *const col = nullptr;
+			const Transform tr;
+
+			LazyBoxes(const ColliderImpl *col, Transform tr) : col(col), tr(tr)
+			{
+				data.resize(col->nodes.size() * 4);
+				flags.resize(col->nodes.size() * 4, false);
+			}
+
+			CAGE_FORCE_INLINE Aabb operator()(uint32 node, uint32 slot)
+			{
+				const uint32 idx = node * 4 + slot;
+				CAGE_ASSERT(idx < data.size());
+				if (!flags[idx])
+				{
+					data[idx] = col->childBox(col->nodes[node], slot) * tr;
+					flags[idx] = true;
+				}
+				return data[idx];
+			}
+
+			Aabb bounds() const { return col->bounds * tr; }
+		};
+
+		template<>
+		class LazyBoxes<false>
+		{
+		public:
+			const ColliderImpl *const col = nullptr;
+
+			LazyBoxes(const ColliderImpl *col, Transform m) : col(col) { CAGE_ASSERT(m == Transform()); }
+
+			CAGE_FORCE_INLINE Aabb operator()(uint32 node, uint32 slot) const { return col->childBox(col->nodes[node], slot); }
+
+			Aabb bounds() const { return col->bounds; }
+		};
+
+		// converts the quantized child boxes of a node into floats
+		struct Dequantizer
+		{
+			F4 origin[3];
+			F4 step[3];
+
+			Dequantizer(const ColliderImpl *col)
+			{
+				for (uint32 axis = 0; axis < 3; axis++)
+				{
+					origin[axis] = F4(col->quantOrigin[axis]);
+					step[axis] = F4(col->quantStep[axis]);
+				}
+			}
+
+			CAGE_FORCE_INLINE void operator()(const ColliderImpl::Node4 &n, F4 low[3], F4 high[3]) const
+			{
+				for (uint32 axis = 0; axis < 3; axis++)
+				{
+					low[axis] = F4::load(n.low[axis]) * step[axis] + origin[axis];
+					high[axis] = F4::load(n.high[axis]) * step[axis] + origin[axis];
+				}
+			}
+		};
+
+		CAGE_FORCE_INLINE uint32 usedChildren(const ColliderImpl::Node4 &n)
+		{
+			return uint32(n.children[0] != m) | (uint32(n.children[1] != m) << 1) | (uint32(n.children[2] != m) << 2) | (uint32(n.children[3] != m) << 3);
+		}
+
+		CAGE_FORCE_INLINE uint32 overlaps(const F4 low[3], const F4 high[3], const Aabb &b)
+		{
+			F4 r = lessEqual(low[0], F4(b.b[0])) & greaterEqual(high[0], F4(b.a[0]));
+			r = r & lessEqual(low[1], F4(b.b[1])) & greaterEqual(high[1], F4(b.a[1]));
+			r = r & lessEqual(low[2], F4(b.b[2])) & greaterEqual(high[2], F4(b.a[2]));
+			return r.mask();
+		}
+
+		CAGE_FORCE_INLINE uint32 lowestBit(uint32 mask)
+		{
+			CAGE_ASSERT(mask != 0);
+			return std::countr_zero(mask);
+		}
+
 		template<bool Swap>
 		class CollisionDetector
 		{
 		public:
 			LazyData<Triangle, Swap> ats;
 			LazyData<Triangle, !Swap> bts;
-			LazyData<Aabb, Swap> abs;
-			LazyData<Aabb, !Swap> bbs;
+			LazyBoxes<Swap> abs;
+			LazyBoxes<!Swap> bbs;
+			const Dequantizer deq; // for the collider that is not transformed
 
 			const ColliderImpl *const ao = nullptr;
 			const ColliderImpl *const bo = nullptr;
 			Holder<PointerRange<CollisionPair>> &outputBuffer;
 			PointerRangeHolder<CollisionPair> collisions;
 
-			CollisionDetector(const ColliderImpl *ao, const ColliderImpl *bo, Transform am, Transform bm, Holder<PointerRange<CollisionPair>> &outputBuffer) : ats(ao->tris.data(), numeric_cast<uint32>(ao->tris.size()), am), bts(bo->tris.data(), numeric_cast<uint32>(bo->tris.size()), bm), abs(ao->boxes.data(), numeric_cast<uint32>(ao->boxes.size()), am), bbs(bo->boxes.data(), numeric_cast<uint32>(bo->boxes.size()), bm), ao(ao), bo(bo), outputBuffer(outputBuffer) {}
+			CollisionDetector(const ColliderImpl *ao, const ColliderImpl *bo, Transform am, Transform bm, Holder<PointerRange<CollisionPair>> &outputBuffer) : ats(ao->tris.data(), numeric_cast<uint32>(ao->tris.size()), am), bts(bo->tris.data(), numeric_cast<uint32>(bo->tris.size()), bm), abs(ao, am), bbs(bo, bm), deq(Swap ? bo : ao), ao(ao), bo(bo), outputBuffer(outputBuffer) {}
 
 		private:
-			void process(uint32 a, uint32 b)
+			void leafs(uint32 a, uint32 b, const Aabb &bb)
 			{
-				CAGE_ASSERT(a < ao->nodes.size());
-				CAGE_ASSERT(b < bo->nodes.size());
-
-				if (!intersects(abs[a], bbs[b]))
-					return;
-
-				const ColliderImpl::Node &an = ao->nodes[a];
-				const ColliderImpl::Node &bn = bo->nodes[b];
-
-				if (an.left != m && bn.left != m)
+				for (uint32 ai = ColliderImpl::leafFirst(a), ae = ai + ColliderImpl::leafCount(a); ai < ae; ai++)
 				{
-					for (uint32 ai = an.left; ai < an.right; ai++)
+					const Triangle at = ats[ai];
+					if (!intersects(Aabb(at), bb))
+						continue;
+					for (uint32 bi = ColliderImpl::leafFirst(b), be = bi + ColliderImpl::leafCount(b); bi < be; bi++)
 					{
-						Triangle at = ats[ai];
-						for (uint32 bi = bn.left; bi < bn.right; bi++)
+						const Triangle bt = bts[bi];
+						if (intersects(at, bt))
 						{
-							Triangle bt = bts[bi];
-							if (intersects(at, bt))
-							{
-								CollisionPair p;
-								p.a = ai;
-								p.b = bi;
-								collisions.push_back(p);
-							}
+							CollisionPair p;
+							p.a = ai;
+							p.b = bi;
+							collisions.push_back(p);
 						}
 					}
-					return;
 				}
+			}
 
-				if (an.left == m && bn.left == m)
+			// expands the node (of either collider) and returns the mask of its children overlapping the other box
+			template<bool Transformed, class Boxes>
+			CAGE_FORCE_INLINE uint32 children(const ColliderImpl *col, Boxes &boxes, uint32 node, const Aabb &other)
+			{
+				const ColliderImpl::Node4 &n = col->nodes[node];
+				if constexpr (Transformed)
 				{
-					process(a + 1, b + 1);
-					process(a + 1, bn.right);
-					process(an.right, b + 1);
-					process(an.right, bn.right);
-					return;
+					uint32 mask = 0;
+					for (uint32 i = 0; i < 4; i++)
+						if (n.children[i] != m && intersects(boxes(node, i), other))
+							mask |= 1u << i;
+					return mask;
 				}
-
-				if (an.left == m)
+				else
 				{
-					process(a + 1, b);
-					process(an.right, b);
+					F4 low[3], high[3];
+					deq(n, low, high);
+					return usedChildren(n) & overlaps(low, high, other);
 				}
+			}
 
-				if (bn.left == m)
+			// a and b are child references: leaf or node index
+			void process(uint32 a, const Aabb &ab, uint32 b, const Aabb &bb)
+			{
+				const bool al = ColliderImpl::isLeaf(a);
+				const bool bl = ColliderImpl::isLeaf(b);
+				if (al && bl)
+					return leafs(a, b, bb);
+
+				if (!al && (bl || ab.surface() >= bb.surface()))
 				{
-					process(a, b + 1);
-					process(a, bn.right);
+					uint32 mask = children<Swap>(ao, abs, a, bb);
+					while (mask)
+					{
+						const uint32 i = lowestBit(mask);
+						mask &= mask - 1;
+						process(ao->nodes[a].children[i], abs(a, i), b, bb);
+					}
+				}
+				else
+				{
+					uint32 mask = children<!Swap>(bo, bbs, b, ab);
+					while (mask)
+					{
+						const uint32 i = lowestBit(mask);
+						mask &= mask - 1;
+						process(a, ab, bo->nodes[b].children[i], bbs(b, i));
+					}
 				}
 			}
 
 		public:
 			void process()
 			{
-				process(0, 0);
+				if (!ao->tris.empty() && !bo->tris.empty())
+				{
+					const Aabb ab = abs.bounds();
+					const Aabb bb = bbs.bounds();
+					if (intersects(ab, bb))
+						process(0, ab, 0, bb);
+				}
 				outputBuffer = std::move(collisions);
 			}
 		};
@@ -496,52 +823,119 @@ namespace cage
 			return min(min(s[0], s[1]), s[2]);
 		}
 
-		Real dist(Line l, Vec3 p)
+		// ray-triangle test of one line against four triangles at once, same as intersection(Line, Triangle)
+		struct TrianglesPacket
 		{
-			CAGE_ASSERT(l.normalized());
-			return dot(p - l.origin, l.direction);
-		}
+			F4 v0[3], e1[3], e2[3];
+			uint32 valid = 0;
+
+			TrianglesPacket(const Triangle *tris, uint32 count)
+			{
+				CAGE_ASSERT(count > 0 && count <= 4);
+				const Triangle *t[4];
+				for (uint32 i = 0; i < 4; i++)
+					t[i] = tris + min(i, count - 1); // unused lanes repeat the last triangle
+				for (uint32 a = 0; a < 3; a++)
+				{
+					v0[a] = F4(t[0]->vertices[0][a].value, t[1]->vertices[0][a].value, t[2]->vertices[0][a].value, t[3]->vertices[0][a].value);
+					const F4 v1 = F4(t[0]->vertices[1][a].value, t[1]->vertices[1][a].value, t[2]->vertices[1][a].value, t[3]->vertices[1][a].value);
+					const F4 v2 = F4(t[0]->vertices[2][a].value, t[1]->vertices[2][a].value, t[2]->vertices[2][a].value, t[3]->vertices[2][a].value);
+					e1[a] = v1 - v0[a];
+					e2[a] = v2 - v0[a];
+				}
+				valid = (1u << count) - 1;
+			}
+
+			// returns mask of hit triangles, and the distances along the line
+			CAGE_FORCE_INLINE uint32 test(const F4 o[3], const F4 d[3], const F4 &tmin, const F4 &tmax, F4 &t) const
+			{
+				const F4 pvec[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+				const F4 det = e1[0] * pvec[0] + e1[1] * pvec[1] + e1[2] * pvec[2];
+				F4 ok = greaterEqual(abs(det), F4(Real(1e-5)));
+				const F4 invDet = F4(Real(1)) / det;
+				const F4 tvec[3] = { o[0] - v0[0], o[1] - v0[1], o[2] - v0[2] };
+				const F4 u = (tvec[0] * pvec[0] + tvec[1] * pvec[1] + tvec[2] * pvec[2]) * invDet;
+				ok = ok & greaterEqual(u, F4()) & lessEqual(u, F4(Real(1)));
+				const F4 qvec[3] = { tvec[1] * e1[2] - tvec[2] * e1[1], tvec[2] * e1[0] - tvec[0] * e1[2], tvec[0] * e1[1] - tvec[1] * e1[0] };
+				const F4 v = (d[0] * qvec[0] + d[1] * qvec[1] + d[2] * qvec[2]) * invDet;
+				ok = ok & greaterEqual(v, F4()) & lessEqual(u + v, F4(Real(1)));
+				t = (e2[0] * qvec[0] + e2[1] * qvec[1] + e2[2] * qvec[2]) * invDet;
+				ok = ok & greaterEqual(t, tmin) & lessEqual(t, tmax);
+				return ok.mask() & valid;
+			}
+		};
 
 		class IntersectionDetector
 		{
 		public:
 			const ColliderImpl *const col;
 			const Transform m;
+			const Dequantizer deq;
 
-			IntersectionDetector(const ColliderImpl *collider, Transform m) : col(collider), m(m) { CAGE_ASSERT(!collider->dirty); }
+			IntersectionDetector(const ColliderImpl *collider, Transform m) : col(collider), m(m), deq(collider) { CAGE_ASSERT(!collider->dirty); }
 
 		private:
+			// the line prepared for testing against four boxes or triangles at once
+			struct LinePacket
+			{
+				F4 o[3], d[3], inv[3];
+				F4 tmin, tmax;
+
+				LinePacket(const Line &l)
+				{
+					CAGE_ASSERT(l.normalized());
+					for (uint32 a = 0; a < 3; a++)
+					{
+						o[a] = F4(l.origin[a]);
+						d[a] = F4(l.direction[a]);
+						inv[a] = F4(1 / l.direction[a]);
+					}
+					tmin = F4(l.minimum);
+					tmax = F4(l.maximum);
+				}
+
+				CAGE_FORCE_INLINE uint32 boxes(const F4 low[3], const F4 high[3]) const
+				{
+					F4 t0 = tmin, t1 = tmax;
+					for (uint32 a = 0; a < 3; a++)
+					{
+						const F4 x = (low[a] - o[a]) * inv[a];
+						const F4 y = (high[a] - o[a]) * inv[a];
+						// nan (line parallel with the box face) does not restrict the range
+						t0 = max(min(x, y), t0);
+						t1 = min(max(x, y), t1);
+					}
+					return lessEqual(t0, t1).mask();
+				}
+			};
+
 			template<class T>
 			Real distance(const T &l, uint32 nodeIdx)
 			{
-				Aabb b = col->boxes[nodeIdx];
-				if (!cage::intersects(l, b))
-					return Real::Nan();
-				const auto &n = col->nodes[nodeIdx];
-				if (n.left == cage::m)
-				{ // node
-					Real c1 = distance(l, nodeIdx + 1);
-					Real c2 = distance(l, n.right);
-					if (c1.valid())
+				const ColliderImpl::Node4 &n = col->nodes[nodeIdx];
+				Real d = Real::Infinity();
+				for (uint32 i = 0; i < 4; i++)
+				{
+					const uint32 c = n.children[i];
+					if (c == cage::m || !cage::intersects(l, col->childBox(n, i)))
+						continue;
+					if (ColliderImpl::isLeaf(c))
 					{
-						if (c2.valid())
-							return min(c1, c2);
-						return c1;
+						for (uint32 ti = ColliderImpl::leafFirst(c), te = ti + ColliderImpl::leafCount(c); ti < te; ti++)
+						{
+							Real p = cage::distance(l, col->tris[ti]);
+							if (p.valid() && p < d)
+								d = p;
+						}
 					}
-					return c2;
-				}
-				else
-				{ // leaf
-					Real d = Real::Infinity();
-					for (uint32 ti = n.left; ti != n.right; ti++)
+					else
 					{
-						Triangle t = col->tris[ti];
-						Real p = cage::distance(l, t);
+						const Real p = distance(l, c);
 						if (p.valid() && p < d)
 							d = p;
 					}
-					return d == Real::Infinity() ? Real::Nan() : d;
 				}
+				return d == Real::Infinity() ? Real::Nan() : d;
 			}
 
 		public:
@@ -555,101 +949,118 @@ namespace cage
 
 		private:
 			template<class T>
-			bool intersects(const T &l, uint32 nodeIdx)
+			bool intersects(const T &l, const Aabb &box, uint32 nodeIdx)
 			{
-				Aabb b = col->boxes[nodeIdx];
-				if (!cage::intersects(l, b))
-					return false;
-				const auto &n = col->nodes[nodeIdx];
-				if (n.left == cage::m)
-				{ // node
-					return intersects(l, nodeIdx + 1) || intersects(l, n.right);
+				const ColliderImpl::Node4 &n = col->nodes[nodeIdx];
+				F4 low[3], high[3];
+				deq(n, low, high);
+				uint32 mask = usedChildren(n) & overlaps(low, high, box);
+				while (mask)
+				{
+					const uint32 i = lowestBit(mask);
+					mask &= mask - 1;
+					if constexpr (!std::is_same_v<T, Aabb>)
+					{
+						if (!cage::intersects(l, col->childBox(n, i)))
+							continue;
+					}
+					const uint32 c = n.children[i];
+					if (ColliderImpl::isLeaf(c))
+					{
+						for (uint32 ti = ColliderImpl::leafFirst(c), te = ti + ColliderImpl::leafCount(c); ti < te; ti++)
+						{
+							const Triangle t = col->tris[ti];
+							if (cage::intersects(Aabb(t), box) && cage::intersects(l, t))
+								return true;
+						}
+					}
+					else if (intersects(l, box, c))
+						return true;
 				}
-				else
-				{ // leaf
-					for (uint32 ti = n.left; ti != n.right; ti++)
+				return false;
+			}
+
+			bool intersects(const LinePacket &p, uint32 nodeIdx)
+			{
+				const ColliderImpl::Node4 &n = col->nodes[nodeIdx];
+				F4 low[3], high[3];
+				deq(n, low, high);
+				uint32 mask = usedChildren(n) & p.boxes(low, high);
+				while (mask)
+				{
+					const uint32 i = lowestBit(mask);
+					mask &= mask - 1;
+					const uint32 c = n.children[i];
+					if (ColliderImpl::isLeaf(c))
 					{
-						Triangle t = col->tris[ti];
-						if (cage::intersects(l, t))
-							return true;
+						const uint32 first = ColliderImpl::leafFirst(c), count = ColliderImpl::leafCount(c);
+						for (uint32 ti = 0; ti < count; ti += 4)
+						{
+							const TrianglesPacket tp(col->tris.data() + first + ti, min(count - ti, 4u));
+							F4 t;
+							if (tp.test(p.o, p.d, p.tmin, p.tmax, t))
+								return true;
+						}
 					}
-					return false;
+					else if (intersects(p, c))
+						return true;
 				}
+				return false;
 			}
 
 		public:
 			template<class T>
 			bool intersects(const T &shape)
 			{
-				return intersects(shape * inverse(m), 0);
+				const T s = shape * inverse(m);
+				return intersects(s, Aabb(s), 0);
+			}
+
+			bool intersects(const Line &shape)
+			{
+				return intersects(LinePacket(shape * inverse(m)), 0);
 			}
 
 		private:
-			bool intersection(Line l, uint32 nodeIdx, Vec3 &point, uint32 &triangleIndex)
+			// finds the closest intersection, the maximum of the packet is shortened with each found intersection
+			void intersection(LinePacket &p, uint32 nodeIdx, Real &best, uint32 &triangleIndex)
 			{
-				const Aabb b = col->boxes[nodeIdx];
-				if (!cage::intersects(l, b))
-					return false;
-				const auto &n = col->nodes[nodeIdx];
-				if (n.left == cage::m)
-				{ // node
-					Vec3 c1, c2;
-					uint32 t1 = 0, t2 = 0;
-					const bool r1 = intersection(l, nodeIdx + 1, c1, t1);
-					const bool r2 = intersection(l, n.right, c2, t2);
-					if (r1)
-					{
-						if (r2)
-						{
-							if (dist(l, c1) < dist(l, c2))
-							{
-								point = c1;
-								triangleIndex = t1;
-								return true;
-							}
-							else
-							{
-								point = c2;
-								triangleIndex = t2;
-								return true;
-							}
-						}
-						else
-						{
-							point = c1;
-							triangleIndex = t1;
-							return true;
-						}
-					}
-					else if (r2)
-					{
-						point = c2;
-						triangleIndex = t2;
-						return true;
-					}
-					return false;
-				}
-				else
-				{ // leaf
-					Real d = Real::Infinity();
-					bool res = false;
-					for (uint32 ti = n.left; ti != n.right; ti++)
+				const ColliderImpl::Node4 &n = col->nodes[nodeIdx];
+				F4 low[3], high[3];
+				deq(n, low, high);
+				uint32 mask = usedChildren(n) & p.boxes(low, high);
+				while (mask)
+				{
+					const uint32 i = lowestBit(mask);
+					mask &= mask - 1;
+					const uint32 c = n.children[i];
+					if (ColliderImpl::isLeaf(c))
 					{
-						Triangle t = col->tris[ti];
-						const Vec3 p = cage::intersection(l, t);
-						if (p.valid())
+						const uint32 first = ColliderImpl::leafFirst(c), count = ColliderImpl::leafCount(c);
+						for (uint32 ti = 0; ti < count; ti += 4)
 						{
-							const Real d1 = dist(l, p);
-							if (d1 < d)
+							const TrianglesPacket tp(col->tris.data() + first + ti, min(count - ti, 4u));
+							F4 t;
+							uint32 hits = tp.test(p.o, p.d, p.tmin, p.tmax, t);
+							if (!hits)
+								continue;
+							alignas(16) float ts[4];
+							t.store(ts);
+							while (hits)
 							{
-								point = p;
-								triangleIndex = ti;
-								d = d1;
+								const uint32 k = lowestBit(hits);
+								hits &= hits - 1;
+								if (ts[k] < best)
+								{
+									best = ts[k];
+									triangleIndex = first + ti + k;
+								}
 							}
-							res = true;
+							p.tmax = F4(best);
 						}
 					}
-					return res;
+					else
+						intersection(p, c, best, triangleIndex);
 				}
 			}
 
@@ -657,15 +1068,16 @@ namespace cage
 			bool intersection(Line l, Vec3 &point, uint32 &triangleIndex)
 			{
 				// p is in the original space of the collider and must be converted back to the space of the shape
-				Vec3 pt;
-				uint32 ti = 0;
-				if (intersection(l * inverse(m), 0, pt, ti))
-				{
-					point = pt * m;
-					triangleIndex = ti;
-					return true;
-				}
-				return false;
+				const Line s = l * inverse(m);
+				LinePacket p(s);
+				Real best = Real::Infinity();
+				uint32 ti = cage::m;
+				intersection(p, 0, best, ti);
+				if (ti == cage::m)
+					return false;
+				point = (s.origin + s.direction * best) * m;
+				triangleIndex = ti;
+				return true;
 			}
 		};
 	}
@@ -1,12 +1,15 @@
 #include <algorithm>
+#include <vector>
 
 #include <unordered_dense.h>
 
 #include <cage-core/collider.h>
 #include <cage-core/collisionStructure.h>
+#include <cage-core/concurrent.h>
 #include <cage-core/geometry.h>
 #include <cage-core/pointerRangeHolder.h>
 #include <cage-core/spatialStructure.h>
+#include <cage-core/tasks.h>
 
 namespace cage
 {
@@ -38,6 +41,7 @@ namespace cage
 			Real resultFractionBefore = Real::Nan();
 			Real resultFractionContact = Real::Nan();
 			Holder<PointerRange<CollisionPair>> resultPairs;
+			std::vector<CollisionStructurePair> resultStructurePairs;
 
 			CollisionQueryImpl(Holder<const CollisionDataImpl> data) : data(std::move(data)) { spatial = newSpatialQuery(this->data->spatial.share()); }
 
@@ -46,6 +50,55 @@ namespace cage
 				resultName = m;
 				resultFractionBefore = resultFractionContact = Real::Nan();
 				resultPairs.clear();
+				resultStructurePairs.clear();
+			}
+
+			struct ExactJob
+			{
+				const CollisionDataImpl *data = nullptr;
+				PointerRange<CollisionStructurePair> pairs;
+				uint32 groups = 0;
+
+				void operator()(uint32 groupIndex)
+				{
+					const auto r = tasksSplit(groupIndex, groups, numeric_cast<uint32>(pairs.size()));
+					for (uint32 i = r.first; i < r.second; i++)
+					{
+						CollisionStructurePair &pr = pairs[i];
+						const Item &a = data->allItems.at(pr.a);
+						const Item &b = data->allItems.at(pr.b);
+						CollisionDetectionConfig p(+a.c, +b.c, a.t, b.t);
+						if (collisionDetection(p))
+							pr.collisionPairs = std::move(p.collisionPairs);
+					}
+				}
+			};
+
+			bool queryPairs(bool exact, bool parallel)
+			{
+				clear();
+				spatial->pairs(parallel); // broad phase
+				const auto names = spatial->result();
+				CAGE_ASSERT((names.size() % 2) == 0);
+				resultStructurePairs.resize(names.size() / 2);
+				for (uint32 i = 0; i < resultStructurePairs.size(); i++)
+				{
+					resultStructurePairs[i].a = names[i * 2 + 0];
+					resultStructurePairs[i].b = names[i * 2 + 1];
+				}
+				if (!exact || resultStructurePairs.empty())
+					return !resultStructurePairs.empty();
+
+				ExactJob job;
+				job.data = +data;
+				job.pairs = resultStructurePairs;
+				job.groups = parallel ? min(numeric_cast<uint32>(resultStructurePairs.size()), processorsCount() * 4) : 1;
+				if (job.groups > 1)
+					tasksRunBlocking<ExactJob>("collision pairs", job, job.groups);
+				else
+					job(0);
+				std::erase_if(resultStructurePairs, [](const CollisionStructurePair &p) { return p.collisionPairs.empty(); });
+				return !resultStructurePairs.empty();
 			}
 
 			bool query(const Collider *collider, Transform t)
@@ -199,6 +252,18 @@ namespace cage
 		return impl->resultPairs;
 	}
 
+	bool CollisionQuery::queryPairs(bool exact, bool parallel)
+	{
+		CollisionQueryImpl *impl = (CollisionQueryImpl *)this;
+		return impl->queryPairs(exact, parallel);
+	}
+
+	PointerRange<CollisionStructurePair> CollisionQuery::structurePairs() const
+	{
+		CollisionQueryImpl *impl = (CollisionQueryImpl *)this;
+		return impl->resultStructurePairs;
+	}
+
 	void CollisionQuery::collider(Holder<const Collider> &c, Transform &t) const
 	{
 		const CollisionQueryImpl *impl = (const CollisionQueryImpl *)this;
@@ -0,0 +1,129 @@
+#ifndef guard_simd_h_4gf8u1k9s2sdf7h5
+#define guard_simd_h_4gf8u1k9s2sdf7h5
+
+#include <cage-core/core.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+	#include <emmintrin.h>
+	#define CAGE_GEOMETRY_SSE
+#endif
+
+namespace cage
+{
+	namespace privat
+	{
+		// four lanes of floats
+		// uses sse2 when available (the baseline on x64), otherwise falls back to scalar code
+		// comparisons produce masks, which are converted to bits by mask()
+		struct F4
+		{
+#ifdef CAGE_GEOMETRY_SSE
+			__m128 v;
+
+			CAGE_FORCE_INLINE F4() : v(_mm_setzero_ps()) {}
+			CAGE_FORCE_INLINE F4(__m128 v) : v(v) {}
+			CAGE_FORCE_INLINE explicit F4(Real s) : v(_mm_set1_ps(s.value)) {}
+			CAGE_FORCE_INLINE explicit F4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+			CAGE_FORCE_INLINE static F4 load(const float *p) { return _mm_load_ps(p); } // aligned
+			CAGE_FORCE_INLINE static F4 loadUnaligned(const float *p) { return _mm_loadu_ps(p); }
+			CAGE_FORCE_INLINE static F4 load(const uint16 *p) { return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128())); }
+			template<int I>
+			CAGE_FORCE_INLINE static F4 splat(const float *p) // aligned
+			{
+				const __m128 t = _mm_load_ps(p);
+				return _mm_shuffle_ps(t, t, _MM_SHUFFLE(I, I, I, I));
+			}
+			CAGE_FORCE_INLINE void store(float *p) const { _mm_storeu_ps(p, v); }
+			CAGE_FORCE_INLINE F4 operator+(F4 o) const { return _mm_add_ps(v, o.v); }
+			CAGE_FORCE_INLINE F4 operator-(F4 o) const { return _mm_sub_ps(v, o.v); }
+			CAGE_FORCE_INLINE F4 operator*(F4 o) const { return _mm_mul_ps(v, o.v); }
+			CAGE_FORCE_INLINE F4 operator/(F4 o) const { return _mm_div_ps(v, o.v); }
+			CAGE_FORCE_INLINE friend F4 min(F4 a, F4 b) { return _mm_min_ps(a.v, b.v); }
+			CAGE_FORCE_INLINE friend F4 max(F4 a, F4 b) { return _mm_max_ps(a.v, b.v); }
+			CAGE_FORCE_INLINE friend F4 abs(F4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+			CAGE_FORCE_INLINE friend F4 less(F4 a, F4 b) { return _mm_cmplt_ps(a.v, b.v); }
+			CAGE_FORCE_INLINE friend F4 lessEqual(F4 a, F4 b) { return _mm_cmple_ps(a.v, b.v); }
+			CAGE_FORCE_INLINE friend F4 greater(F4 a, F4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+			CAGE_FORCE_INLINE friend F4 greaterEqual(F4 a, F4 b) { return _mm_cmpge_ps(a.v, b.v); }
+			CAGE_FORCE_INLINE friend F4 operator&(F4 a, F4 b) { return _mm_and_ps(a.v, b.v); }
+			CAGE_FORCE_INLINE friend F4 select(F4 mask, F4 a, F4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+			CAGE_FORCE_INLINE uint32 mask() const { return _mm_movemask_ps(v); }
+#else
+			union
+			{
+				float f[4];
+				uint32 u[4];
+			};
+
+			CAGE_FORCE_INLINE F4() : f{} {}
+			CAGE_FORCE_INLINE explicit F4(Real s) : f{ s.value, s.value, s.value, s.value } {}
+			CAGE_FORCE_INLINE explicit F4(float a, float b, float c, float d) : f{ a, b, c, d } {}
+			CAGE_FORCE_INLINE static F4 load(const float *p) { return F4(p[0], p[1], p[2], p[3]); }
+			CAGE_FORCE_INLINE static F4 loadUnaligned(const float *p) { return F4(p[0], p[1], p[2], p[3]); }
+			CAGE_FORCE_INLINE static F4 load(const uint16 *p) { return F4(p[0], p[1], p[2], p[3]); }
+			template<int I>
+			CAGE_FORCE_INLINE static F4 splat(const float *p)
+			{
+				return F4(p[I], p[I], p[I], p[I]);
+			}
+			CAGE_FORCE_INLINE void store(float *p) const
+			{
+				for (uint32 i = 0; i < 4; i++)
+					p[i] = f[i];
+			}
+			template<class Op>
+			CAGE_FORCE_INLINE static F4 apply(F4 a, F4 b, Op op)
+			{
+				F4 r;
+				for (uint32 i = 0; i < 4; i++)
+					r.f[i] = op(a.f[i], b.f[i]);
+				return r;
+			}
+			template<class Op>
+			CAGE_FORCE_INLINE static F4 compare(F4 a, F4 b, Op op)
+			{
+				F4 r;
+				for (uint32 i = 0; i < 4; i++)
+					r.u[i] = op(a.f[i], b.f[i]) ? m : 0;
+				return r;
+			}
+			CAGE_FORCE_INLINE F4 operator+(F4 o) const { return apply(*this, o, [](float a, float b) { return a + b; }); }
+			CAGE_FORCE_INLINE F4 operator-(F4 o) const { return apply(*this, o, [](float a, float b) { return a - b; }); }
+			CAGE_FORCE_INLINE F4 operator*(F4 o) const { return apply(*this, o, [](float a, float b) { return a * b; }); }
+			CAGE_FORCE_INLINE F4 operator/(F4 o) const { return apply(*this, o, [](float a, float b) { return a / b; }); }
+			CAGE_FORCE_INLINE friend F4 min(F4 a, F4 b) { return apply(a, b, [](float a, float b) { return a < b ? a : b; }); }
+			CAGE_FORCE_INLINE friend F4 max(F4 a, F4 b) { return apply(a, b, [](float a, float b) { return a > b ? a : b; }); }
+			CAGE_FORCE_INLINE friend F4 abs(F4 a) { return apply(a, a, [](float a, float) { return a < 0 ? -a : a; }); }
+			CAGE_FORCE_INLINE friend F4 less(F4 a, F4 b) { return compare(a, b, [](float a, float b) { return a < b; }); }
+			CAGE_FORCE_INLINE friend F4 lessEqual(F4 a, F4 b) { return compare(a, b, [](float a, float b) { return a <= b; }); }
+			CAGE_FORCE_INLINE friend F4 greater(F4 a, F4 b) { return compare(a, b, [](float a, float b) { return a > b; }); }
+			CAGE_FORCE_INLINE friend F4 greaterEqual(F4 a, F4 b) { return compare(a, b, [](float a, float b) { return a >= b; }); }
+			CAGE_FORCE_INLINE friend F4 operator&(F4 a, F4 b)
+			{
+				F4 r;
+				for (uint32 i = 0; i < 4; i++)
+					r.u[i] = a.u[i] & b.u[i];
+				return r;
+			}
+			CAGE_FORCE_INLINE friend F4 select(F4 mask, F4 a, F4 b)
+			{
+				F4 r;
+				for (uint32 i = 0; i < 4; i++)
+					r.u[i] = (mask.u[i] & a.u[i]) | (~mask.u[i] & b.u[i]);
+				return r;
+			}
+			CAGE_FORCE_INLINE uint32 mask() const { return (u[0] >> 31) | ((u[1] >> 31) << 1) | ((u[2] >> 31) << 2) | ((u[3] >> 31) << 3); }
+#endif // CAGE_GEOMETRY_SSE
+		};
+
+		// structure of arrays of four floats
+		struct alignas(16) Soa4
+		{
+			float v[4] = {};
+
+			CAGE_FORCE_INLINE F4 load() const { return F4::load(v); }
+		};
+	}
+}
+
+#endif // guard_simd_h_4gf8u1k9s2sdf7h5
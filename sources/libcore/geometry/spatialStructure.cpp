@@ -6,9 +6,13 @@
 
 #include <unordered_dense.h>
 
+#include <cage-core/concurrent.h>
 #include <cage-core/geometry.h>
 #include <cage-core/memoryAllocators.h>
 #include <cage-core/spatialStructure.h>
+#include <cage-core/tasks.h>
+
+#include "simd.h"
 
 namespace cage
 {
@@ -86,12 +90,145 @@ namespace cage
 			return !(int(a.high.v4[0] < b.low.v4[0]) | int(a.high.v4[1] < b.low.v4[1]) | int(a.high.v4[2] < b.low.v4[2]) | int(a.low.v4[0] > b.high.v4[0]) | int(a.low.v4[1] > b.high.v4[1]) | int(a.low.v4[2] > b.high.v4[2]));
 		}
 
+		using privat::F4;
+		using privat::Soa4;
+
+		template<int I>
+		CAGE_FORCE_INLINE F4 splat(const FastPoint &p)
+		{
+			return F4::splat<I>(&p.v4.data[0].value);
+		}
+
+		// each packet type prepares the shapes in structure of arrays layout and tests them against a box at once
+		template<class T>
+		struct Packet;
+
+		template<>
+		struct Packet<Line>
+		{
+			Soa4 o[3], inv[3], tmin, tmax;
+
+			void set(uint32 lane, const Line &l)
+			{
+				CAGE_ASSERT(l.normalized());
+				for (uint32 i = 0; i < 3; i++)
+				{
+					o[i].v[lane] = l.origin[i].value;
+					inv[i].v[lane] = 1.0f / l.direction[i].value;
+				}
+				tmin.v[lane] = l.minimum.value;
+				tmax.v[lane] = l.maximum.value;
+			}
+
+			CAGE_FORCE_INLINE uint32 test(const FastBox &b) const
+			{
+				F4 t0 = tmin.load(), t1 = tmax.load();
+				{
+					const F4 a = (splat<0>(b.low) - o[0].load()) * inv[0].load();
+					const F4 c = (splat<0>(b.high) - o[0].load()) * inv[0].load();
+					t0 = max(t0, min(a, c));
+					t1 = min(t1, max(a, c));
+				}
+				{
+					const F4 a = (splat<1>(b.low) - o[1].load()) * inv[1].load();
+					const F4 c = (splat<1>(b.high) - o[1].load()) * inv[1].load();
+					t0 = max(t0, min(a, c));
+					t1 = min(t1, max(a, c));
+				}
+				{
+					const F4 a = (splat<2>(b.low) - o[2].load()) * inv[2].load();
+					const F4 c = (splat<2>(b.high) - o[2].load()) * inv[2].load();
+					t0 = max(t0, min(a, c));
+					t1 = min(t1, max(a, c));
+				}
+				return lessEqual(t0, t1).mask();
+			}
+		};
+
+		template<>
+		struct Packet<Aabb>
+		{
+			Soa4 low[3], high[3];
+
+			void set(uint32 lane, const Aabb &a)
+			{
+				for (uint32 i = 0; i < 3; i++)
+				{
+					low[i].v[lane] = a.a[i].value;
+					high[i].v[lane] = a.b[i].value;
+				}
+			}
+
+			CAGE_FORCE_INLINE uint32 test(const FastBox &b) const
+			{
+				const F4 x = lessEqual(low[0].load(), splat<0>(b.high)) & lessEqual(splat<0>(b.low), high[0].load());
+				const F4 y = lessEqual(low[1].load(), splat<1>(b.high)) & lessEqual(splat<1>(b.low), high[1].load());
+				const F4 z = lessEqual(low[2].load(), splat<2>(b.high)) & lessEqual(splat<2>(b.low), high[2].load());
+				return (x & y & z).mask();
+			}
+		};
+
+		template<>
+		struct Packet<Sphere>
+		{
+			Soa4 c[3], r2;
+
+			void set(uint32 lane, const Sphere &s)
+			{
+				for (uint32 i = 0; i < 3; i++)
+					c[i].v[lane] = s.center[i].value;
+				r2.v[lane] = (s.radius * s.radius).value;
+			}
+
+			CAGE_FORCE_INLINE uint32 test(const FastBox &b) const
+			{
+				const F4 zero;
+				const F4 x = max(splat<0>(b.low) - c[0].load(), zero) + max(c[0].load() - splat<0>(b.high), zero);
+				const F4 y = max(splat<1>(b.low) - c[1].load(), zero) + max(c[1].load() - splat<1>(b.high), zero);
+				const F4 z = max(splat<2>(b.low) - c[2].load(), zero) + max(c[2].load() - splat<2>(b.high), zero);
+				return lessEqual(x * x + y * y + z * z, r2.load()).mask();
+			}
+		};
+
+		template<>
+		struct Packet<Frustum>
+		{
+			Soa4 planes[6][4];
+
+			void set(uint32 lane, const Frustum &f)
+			{
+				for (uint32 p = 0; p < 6; p++)
+					for (uint32 i = 0; i < 4; i++)
+						planes[p][i].v[lane] = f.planes[p][i].value;
+			}
+
+			CAGE_FORCE_INLINE uint32 test(const FastBox &b) const
+			{
+				const F4 zero;
+				const F4 lx = splat<0>(b.low), ly = splat<1>(b.low), lz = splat<2>(b.low);
+				const F4 hx = splat<0>(b.high), hy = splat<1>(b.high), hz = splat<2>(b.high);
+				uint32 res = 15;
+				for (uint32 p = 0; p < 6; p++)
+				{
+					const F4 nx = planes[p][0].load(), ny = planes[p][1].load(), nz = planes[p][2].load();
+					// p-vertex
+					const F4 px = select(greater(nx, zero), hx, lx);
+					const F4 py = select(greater(ny, zero), hy, ly);
+					const F4 pz = select(greater(nz, zero), hz, lz);
+					const F4 d = nx * px + ny * py + nz * pz;
+					res &= lessEqual(zero - planes[p][3].load(), d).mask();
+				}
+				return res;
+			}
+		};
+
 		struct ItemBase
 		{
 			std::variant<Line, Triangle, Sphere, Aabb, Cone> shape;
 			FastBox box;
 			Vec3 center;
 			uint32 name = m;
+			uint32 leaf = m; // index of the leaf node containing this item (valid after rebuild)
 
 			CAGE_FORCE_INLINE explicit ItemBase(uint32 name, auto sh) : shape(sh), name(name)
 			{
@@ -128,36 +265,30 @@ namespace cage
 			CAGE_FORCE_INLINE sint32 b() const { return box.high.s.i; }
 		};
 
-		class SpatialDataImpl : public SpatialStructure
+		// builds binned sah tree into the given nodes
+		// children are always appended after their parent
+		struct Builder
 		{
-		public:
-			Holder<MemoryArena> itemsPool = newMemoryAllocatorPool({ 96, 16 });
-			MemoryArena itemsArena;
-			ankerl::unordered_dense::map<uint32, ItemBase *> itemsTable;
-			std::atomic<bool> dirty = false;
-			std::vector<Node> nodes;
-			std::vector<ItemBase *> indices;
 			static constexpr uint32 BinsCount = 10;
 			std::array<FastBox, BinsCount> leftBinBoxes = {};
 			std::array<FastBox, BinsCount> rightBinBoxes = {};
 			std::array<uint32, BinsCount> leftBinCounts = {};
+			std::vector<Node> &nodes;
+			const PointerRange<ItemBase *> indices;
 
-			SpatialDataImpl(const SpatialStructureCreateConfig &config) : itemsArena(*itemsPool)
+			Builder(std::vector<Node> &nodes, PointerRange<ItemBase *> indices) : nodes(nodes), indices(indices)
 			{
-				CAGE_ASSERT((uintPtr(this) % alignof(FastBox)) == 0);
 				CAGE_ASSERT((uintPtr(leftBinBoxes.data()) % alignof(FastBox)) == 0);
 				CAGE_ASSERT((uintPtr(rightBinBoxes.data()) % alignof(FastBox)) == 0);
-				itemsTable.reserve(config.reserve);
 			}
 
-			~SpatialDataImpl() { clear(); }
-
-			void rebuild(uint32 nodeIndex, uint32 nodeDepth, Real parentSah)
+			// splits the leaf node into two new leafs, returns false if the split is not worth it
+			bool split(uint32 nodeIndex, Real parentSah, Real &resultSah)
 			{
-				Node &node = nodes[nodeIndex];
+				const Node node = nodes[nodeIndex];
 				CAGE_ASSERT(node.a() >= 0 && node.b() >= 0); // is leaf now
 				if (node.b() < 10)
-					return; // leaf node: too few primitives
+					return false; // leaf node: too few primitives
 				uint32 bestAxis = m;
 				uint32 bestSplit = m;
 				uint32 bestItemsCount = 0;
@@ -211,9 +342,9 @@ namespace cage
 				}
 				CAGE_ASSERT(bestSah.valid());
 				if (bestSah >= parentSah)
-					return; // leaf node: split would make no improvement
+					return false; // leaf node: split would make no improvement
 				if (bestItemsCount == 0)
-					return; // leaf node: split cannot separate any objects (they are probably all at one position)
+					return false; // leaf node: split cannot separate any objects (they are probably all at one position)
 				CAGE_ASSERT(bestAxis < 3);
 				CAGE_ASSERT(bestSplit + 1 < BinsCount); // splits count is one less than bins count
 				CAGE_ASSERT(bestItemsCount < numeric_cast<uint32>(node.b()));
@@ -229,12 +360,62 @@ namespace cage
 				}
 				const sint32 leftNodeIndex = numeric_cast<sint32>(nodes.size());
 				nodes.emplace_back(bestBoxLeft, node.a(), bestItemsCount);
-				rebuild(leftNodeIndex, nodeDepth + 1, bestSah);
 				const sint32 rightNodeIndex = numeric_cast<sint32>(nodes.size());
 				nodes.emplace_back(bestBoxRight, node.a() + bestItemsCount, node.b() - bestItemsCount);
-				rebuild(rightNodeIndex, nodeDepth + 1, bestSah);
-				node.a() = -leftNodeIndex;
-				node.b() = -rightNodeIndex;
+				nodes[nodeIndex].a() = -leftNodeIndex;
+				nodes[nodeIndex].b() = -rightNodeIndex;
+				resultSah = bestSah;
+				return true;
+			}
+
+			void build(uint32 nodeIndex, Real parentSah)
+			{
+				Real sah;
+				if (!split(nodeIndex, parentSah, sah))
+					return;
+				const Node node = nodes[nodeIndex];
+				build(-node.a(), sah);
+				build(-node.b(), sah);
+			}
+		};
+
+		class SpatialDataImpl : public SpatialStructure
+		{
+		public:
+			const SpatialStructureCreateConfig config;
+			Holder<MemoryArena> itemsPool = newMemoryAllocatorPool({ sizeof(ItemBase), alignof(ItemBase) });
+			MemoryArena itemsArena;
+			ankerl::unordered_dense::map<uint32, ItemBase *> itemsTable;
+			std::atomic<bool> dirty = false;
+			std::vector<Node> nodes;
+			std::vector<ItemBase *> indices;
+
+			// incremental mode
+			std::vector<uint32> parents;
+			std::vector<Real> buildSurfaces; // surface of each node when it was built
+			std::vector<ItemBase *> moved;
+			std::vector<uint8> marks;
+			uint32 garbageNodes = 0; // nodes not reachable from the root anymore
+			bool structureChanged = true; // items were added or removed, full rebuild is required
+
+			SpatialStructureStatistics stats;
+
+			SpatialDataImpl(const SpatialStructureCreateConfig &config) : config(config), itemsArena(*itemsPool)
+			{
+				CAGE_ASSERT((uintPtr(this) % alignof(FastBox)) == 0);
+				CAGE_ASSERT(config.subtreeRebuildThreshold > 1);
+				itemsTable.reserve(config.reserve);
+			}
+
+			~SpatialDataImpl() { clear(); }
+
+			void clear()
+			{
+				dirty = true;
+				structureChanged = true;
+				moved.clear();
+				itemsArena.flush();
+				itemsTable.clear();
 			}
 
 			static bool similar(FastBox a, FastBox b) { return (length(a.low.s.v3 - b.low.s.v3) + length(a.high.s.v3 - b.high.s.v3)) < 1e-3; }
@@ -260,17 +441,115 @@ namespace cage
 				}
 			}
 
-			void rebuild()
+			// copies nodes built separately into the main array
+			void splice(uint32 rootIndex, const std::vector<Node> &local)
+			{
+				const uint32 offset = numeric_cast<uint32>(nodes.size()) - 1;
+				const auto &remap = [&](sint32 n) -> sint32
+				{
+					CAGE_ASSERT(n > 0);
+					return n + offset;
+				};
+				for (uint32 i = 0; i < local.size(); i++)
+				{
+					Node n = local[i];
+					if (n.a() < 0)
+					{
+						n.a() = -remap(-n.a());
+						n.b() = -remap(-n.b());
+					}
+					if (i == 0)
+						nodes[rootIndex] = n;
+					else
+						nodes.push_back(n);
+				}
+			}
+
+			struct ParallelBuild
+			{
+				SpatialDataImpl *impl = nullptr;
+				std::vector<std::pair<uint32, Real>> tasks; // node index, parent sah
+				std::vector<std::vector<Node>> results;
+
+				void operator()(uint32 idx)
+				{
+					std::vector<Node> &local = results[idx];
+					local.push_back(impl->nodes[tasks[idx].first]);
+					Builder builder(local, impl->indices);
+					builder.build(0, tasks[idx].second);
+				}
+			};
+
+			// builds the subtree at nodeIndex (currently a leaf), using multiple threads for large subtrees
+			void build(uint32 nodeIndex, Real parentSah)
+			{
+				Builder builder(nodes, indices);
+				CAGE_ASSERT(nodes[nodeIndex].a() >= 0);
+				if (numeric_cast<uint32>(nodes[nodeIndex].b()) < config.parallelBuildThreshold)
+				{
+					builder.build(nodeIndex, parentSah);
+					return;
+				}
+
+				// split the top levels sequentially, until there is enough subtrees to distribute among threads
+				ParallelBuild pb;
+				pb.impl = this;
+				std::vector<std::pair<uint32, Real>> open;
+				open.emplace_back(nodeIndex, parentSah);
+				const uint32 targetTasks = processorsCount() * 4;
+				const uint32 minTaskItems = max(config.parallelBuildThreshold / 16, 100u);
+				while (!open.empty() && open.size() + pb.tasks.size() < targetTasks)
+				{
+					// split the largest open node
+					std::sort(open.begin(), open.end(), [&](const auto &a, const auto &b) { return nodes[a.first].b() < nodes[b.first].b(); });
+					const auto [n, sah] = open.back();
+					open.pop_back();
+					Real childSah;
+					if (numeric_cast<uint32>(nodes[n].b()) >= minTaskItems && builder.split(n, sah, childSah))
+					{
+						open.emplace_back(-nodes[n].a(), childSah);
+						open.emplace_back(-nodes[n].b(), childSah);
+					}
+					else
+						pb.tasks.emplace_back(n, sah);
+				}
+				pb.tasks.insert(pb.tasks.end(), open.begin(), open.end());
+
+				pb.results.resize(pb.tasks.size());
+				tasksRunBlocking<ParallelBuild>("spatial build", pb, numeric_cast<uint32>(pb.tasks.size()));
+				for (uint32 i = 0; i < pb.tasks.size(); i++)
+					splice(pb.tasks[i].first, pb.results[i]);
+			}
+
+			// updates parents, build surfaces and leafs of items in the subtree
+			void link(uint32 nodeIndex, uint32 parent)
+			{
+				parents[nodeIndex] = parent;
+				const Node &node = nodes[nodeIndex];
+				buildSurfaces[nodeIndex] = node.box.surface();
+				if (node.a() < 0)
+				{
+					link(-node.a(), nodeIndex);
+					link(-node.b(), nodeIndex);
+				}
+				else
+				{
+					for (uint32 i = node.a(), e = node.a() + node.b(); i < e; i++)
+						indices[i]->leaf = nodeIndex;
+				}
+			}
+
+			void fullRebuild()
 			{
-				dirty = true;
 				nodes.clear();
 				indices.clear();
+				moved.clear();
+				garbageNodes = 0;
+				structureChanged = false;
+				stats.fullRebuilds++;
 				if (itemsTable.size() == 0)
-				{
-					dirty = false;
 					return;
-				}
-				nodes.reserve(itemsTable.size());
+				nodes.reserve(itemsTable.size() * 2);
 				indices.reserve(itemsTable.size());
 				FastBox worldBox;
 				for (const auto &it : itemsTable)
@@ -279,11 +558,126 @@ namespace cage
 					worldBox += it.second->box;
 				}
 				nodes.emplace_back(worldBox, 0, numeric_cast<sint32>(itemsTable.size()));
-				rebuild(0, 0, Real::Infinity());
+				build(0, Real::Infinity());
 				CAGE_ASSERT(uintPtr(nodes.data()) % alignof(Node) == 0);
+				if (config.incremental)
+				{
+					parents.resize(nodes.size());
+					buildSurfaces.resize(nodes.size());
+					link(0, m);
+				}
+			}
+
+			// finds the range of items in the subtree and the number of its nodes
+			void subtreeRange(uint32 nodeIndex, uint32 &first, uint32 &count, uint32 &nodesCount) const
+			{
+				const Node &node = nodes[nodeIndex];
+				nodesCount++;
+				if (node.a() < 0)
+				{
+					subtreeRange(-node.a(), first, count, nodesCount);
+					subtreeRange(-node.b(), first, count, nodesCount);
+				}
+				else
+				{
+					first = min(first, numeric_cast<uint32>(node.a()));
+					count += node.b();
+				}
+			}
+
+			void rebuildSubtree(uint32 nodeIndex)
+			{
+				uint32 first = m, count = 0, nodesCount = 0;
+				subtreeRange(nodeIndex, first, count, nodesCount);
+				garbageNodes += nodesCount - 1;
+				stats.subtreeRebuilds++;
+				nodes[nodeIndex].a() = first;
+				nodes[nodeIndex].b() = count;
+				build(nodeIndex, Real::Infinity());
+				parents.resize(nodes.size());
+				buildSurfaces.resize(nodes.size());
+				link(nodeIndex, parents[nodeIndex]);
+			}
+
+			// rebuilds topmost subtrees that were refitted and whose quality degraded
+			void rebuildDegraded(uint32 nodeIndex)
+			{
+				if (!marks[nodeIndex])
+					return;
+				const Node &node = nodes[nodeIndex];
+				if (node.a() >= 0)
+					return;
+				if (node.box.surface() > buildSurfaces[nodeIndex] * config.subtreeRebuildThreshold)
+				{
+					rebuildSubtree(nodeIndex);
+					return;
+				}
+				const uint32 l = -node.a(), r = -node.b();
+				rebuildDegraded(l);
+				rebuildDegraded(r);
+			}
+
+			void refit()
+			{
+				stats.incrementalRebuilds++;
+				marks.clear();
+				marks.resize(nodes.size(), 0);
+				for (ItemBase *item : moved)
+				{
+					uint32 n = item->leaf;
+					while (n != m && !marks[n])
+					{
+						marks[n] = 1;
+						n = parents[n];
+					}
+				}
+				moved.clear();
+				// children are always after their parents
+				for (uint32 i = numeric_cast<uint32>(nodes.size()); i-- > 0;)
+				{
+					if (!marks[i])
+						continue;
+					Node &node = nodes[i];
+					const sint32 a = node.a(), b = node.b();
+					if (a < 0)
+						node.box = nodes[-a].box + nodes[-b].box;
+					else
+					{
+						FastBox box;
+						for (sint32 j = a, e = a + b; j < e; j++)
+							box += indices[j]->box;
+						node.box = box;
+					}
+					node.a() = a;
+					node.b() = b;
+					stats.lastRefittedNodes++;
+				}
+				if (!marks[0])
+					return;
+				if (nodes[0].box.surface() > buildSurfaces[0] * config.subtreeRebuildThreshold)
+				{
+					fullRebuild();
+					return;
+				}
+				rebuildDegraded(0);
+				if (garbageNodes * 2 > nodes.size())
+					fullRebuild();
+			}
+
+			void rebuild()
+			{
+				dirty = true;
+				const uint64 startTime = applicationTime();
+				stats.lastRefittedNodes = 0;
+				if (!config.incremental || structureChanged || nodes.empty())
+					fullRebuild();
+				else if (!moved.empty())
+					refit();
 #ifdef CAGE_ASSERT_ENABLED
-				validate(0);
+				if (!nodes.empty())
+					validate(0);
 #endif // CAGE_ASSERT_ENABLED
+				stats.lastRebuildDuration = applicationTime() - startTime;
 				dirty = false;
 			}
 
@@ -293,9 +687,66 @@ namespace cage
 				dirty = true;
 				auto it = itemsTable.find(name);
 				if (it != itemsTable.end())
+				{
+					if (config.incremental && !structureChanged)
+					{
+						const uint32 leaf = it->second->leaf;
+						*it->second = ItemBase(name, shape);
+						it->second->leaf = leaf;
+						moved.push_back(it->second);
+						return;
+					}
 					itemsArena.destroy<ItemBase>(it->second);
+				}
+				else
+					structureChanged = true;
 				itemsTable[name] = itemsArena.createObject<ItemBase>(name, shape);
 			}
+
+			void remove(uint32 name)
+			{
+				auto it = itemsTable.find(name);
+				if (it == itemsTable.end())
+					return;
+				dirty = true;
+				structureChanged = true;
+				itemsArena.destroy<ItemBase>(it->second);
+				itemsTable.erase(it);
+			}
+
+			void statsCollect(uint32 nodeIndex, uint32 depth, Real rootSurfaceInv, SpatialStructureStatistics &res) const
+			{
+				const Node &node = nodes[nodeIndex];
+				res.nodes++;
+				res.depth = max(res.depth, depth);
+				const Real s = node.box.surface() * rootSurfaceInv;
+				if (node.a() < 0)
+				{
+					res.sahCost += s;
+					statsCollect(-node.a(), depth + 1, rootSurfaceInv, res);
+					statsCollect(-node.b(), depth + 1, rootSurfaceInv, res);
+				}
+				else
+				{
+					res.leafs++;
+					res.sahCost += s * node.b();
+				}
+			}
+
+			SpatialStructureStatistics statistics() const
+			{
+				SpatialStructureStatistics res = stats;
+				res.items = numeric_cast<uint32>(itemsTable.size());
+				res.nodes = res.leafs = res.depth = 0;
+				res.sahCost = 0;
+				if (!nodes.empty() && !dirty)
+				{
+					const Real rs = nodes[0].box.surface();
+					statsCollect(0, 1, rs > 0 ? 1 / rs : Real(0), res);
+				}
+				res.garbageNodes = garbageNodes;
+				return res;
+			}
 		};
 
 		class SpatialQueryImpl : public SpatialQuery
@@ -303,6 +754,7 @@ namespace cage
 		public:
 			const Holder<const SpatialDataImpl> data;
 			std::vector<uint32> resultNames;
+			std::vector<uint32> resultOffsets; // ranges of results of individual shapes in batched queries
 
 			SpatialQueryImpl(Holder<const SpatialDataImpl> data) : data(std::move(data)) { resultNames.reserve(100); }
 
@@ -361,11 +813,310 @@ namespace cage
 			{
 				CAGE_ASSERT(!data->dirty);
 				clear();
+				resultOffsets.clear();
 				if (data->nodes.empty())
 					return false;
 				Intersector<T> i(+data, resultNames, other);
 				return !resultNames.empty();
 			}
+
+			// traverses the tree once for up to four shapes
+			template<class T>
+			struct PacketIntersector
+			{
+				Packet<T> packet;
+				Packet<Aabb> bounds; // same pruning as the single shape intersector
+				const SpatialDataImpl *const data;
+				const T *shapes = nullptr;
+				std::vector<uint32> results[4];
+
+				PacketIntersector(const SpatialDataImpl *data) : data(data) { CAGE_ASSERT((uintPtr(&packet) % 16) == 0); }
+
+				// the results buffers are reused between packets
+				void run(const T *first, uint32 count)
+				{
+					CAGE_ASSERT(count > 0 && count <= 4);
+					shapes = first;
+					for (uint32 lane = 0; lane < 4; lane++)
+					{
+						const T &shape = shapes[min(lane, count - 1)]; // unused lanes repeat the last shape
+						packet.set(lane, shape);
+						if constexpr (!std::is_same_v<T, Aabb>)
+							bounds.set(lane, Aabb(shape));
+						results[lane].clear();
+					}
+					intersection(0, (1u << count) - 1);
+				}
+
+				void intersection(uint32 nodeIndex, uint32 mask)
+				{
+					const Node &node = data->nodes[nodeIndex];
+					if constexpr (!std::is_same_v<T, Aabb>)
+					{
+						mask &= bounds.test(node.box);
+						if (!mask)
+							return;
+					}
+					mask &= packet.test(node.box);
+					if (!mask)
+						return;
+					if (node.a() < 0)
+					{ // internode
+						intersection(-node.a(), mask);
+						intersection(-node.b(), mask);
+					}
+					else
+					{ // leaf
+						for (uint32 lane = 0; lane < 4; lane++)
+						{
+							if ((mask & (1u << lane)) == 0)
+								continue;
+							const T &other = shapes[lane];
+							for (uint32 i = node.a(), e = node.a() + node.b(); i < e; i++)
+							{
+								ItemBase *item = data->indices[i];
+								if (item->intersects(other))
+									results[lane].push_back(item->name);
+							}
+						}
+					}
+				}
+			};
+
+			template<class T>
+			struct BatchJob
+			{
+				const SpatialDataImpl *data = nullptr;
+				PointerRange<const T> shapes;
+				uint32 groups = 0;
+				std::vector<std::vector<uint32>> names; // per group
+				std::vector<uint32> counts; // per shape
+
+				void operator()(uint32 groupIndex)
+				{
+					const uint32 packets = (numeric_cast<uint32>(shapes.size()) + 3) / 4;
+					const auto r = tasksSplit(groupIndex, groups, packets);
+					PacketIntersector<T> pi(data);
+					std::vector<uint32> &res = names[groupIndex];
+					for (uint32 p = r.first; p < r.second; p++)
+					{
+						const uint32 first = p * 4;
+						const uint32 cnt = min(numeric_cast<uint32>(shapes.size()) - first, 4u);
+						pi.run(shapes.data() + first, cnt);
+						for (uint32 lane = 0; lane < cnt; lane++)
+						{
+							counts[first + lane] = numeric_cast<uint32>(pi.results[lane].size());
+							res.insert(res.end(), pi.results[lane].begin(), pi.results[lane].end());
+						}
+					}
+				}
+			};
+
+			template<class T>
+			bool intersection(PointerRange<const T> shapes, bool parallel)
+			{
+				CAGE_ASSERT(!data->dirty);
+				clear();
+				resultOffsets.clear();
+				resultOffsets.resize(shapes.size() + 1, 0);
+				if (data->nodes.empty() || shapes.empty())
+					return false;
+				BatchJob<T> job;
+				job.data = +data;
+				job.shapes = shapes;
+				job.counts.resize(shapes.size());
+				const uint32 packets = (numeric_cast<uint32>(shapes.size()) + 3) / 4;
+				job.groups = parallel ? min(packets, processorsCount() * 4) : 1;
+				job.names.resize(job.groups);
+				if (job.groups > 1)
+					tasksRunBlocking<BatchJob<T>>("spatial batch query", job, job.groups);
+				else
+					job(0);
+				for (const auto &it : job.names)
+					resultNames.insert(resultNames.end(), it.begin(), it.end());
+				for (uint32 i = 0; i < shapes.size(); i++)
+					resultOffsets[i + 1] = resultOffsets[i] + job.counts[i];
+				CAGE_ASSERT(resultOffsets.back() == resultNames.size());
+				return !resultNames.empty();
+			}
+
+			// simultaneous traversal of the tree against itself
+			struct PairsFinder
+			{
+				const SpatialDataImpl *const data;
+				std::vector<uint32> &out;
+
+				PairsFinder(const SpatialDataImpl *data, std::vector<uint32> &out) : data(data), out(out) {}
+
+				CAGE_FORCE_INLINE void emit(const ItemBase *a, const ItemBase *b)
+				{
+					out.push_back(min(a->name, b->name));
+					out.push_back(max(a->name, b->name));
+				}
+
+				void leafs(const Node &a, const Node &b)
+				{
+					for (uint32 i = a.a(), ie = a.a() + a.b(); i < ie; i++)
+					{
+						const ItemBase *x = data->indices[i];
+						if (!intersects(x->box, b.box))
+							continue;
+						for (uint32 j = b.a(), je = b.a() + b.b(); j < je; j++)
+						{
+							const ItemBase *y = data->indices[j];
+							if (intersects(x->box, y->box))
+								emit(x, y);
+						}
+					}
+				}
+
+				void self(uint32 nodeIndex)
+				{
+					const Node &node = data->nodes[nodeIndex];
+					if (node.a() < 0)
+					{
+						self(-node.a());
+						self(-node.b());
+						cross(-node.a(), -node.b());
+					}
+					else
+					{
+						for (uint32 i = node.a(), e = node.a() + node.b(); i < e; i++)
+						{
+							const ItemBase *x = data->indices[i];
+							for (uint32 j = i + 1; j < e; j++)
+							{
+								const ItemBase *y = data->indices[j];
+								if (intersects(x->box, y->box))
+									emit(x, y);
+							}
+						}
+					}
+				}
+
+				void cross(uint32 ai, uint32 bi)
+				{
+					const Node &a = data->nodes[ai];
+					const Node &b = data->nodes[bi];
+					if (!intersects(a.box, b.box))
+						return;
+					if (a.a() >= 0 && b.a() >= 0)
+						return leafs(a, b);
+					// descend into the larger node
+					if (b.a() >= 0 || (a.a() < 0 && a.box.surface() > b.box.surface()))
+					{
+						cross(-a.a(), bi);
+						cross(-a.b(), bi);
+					}
+					else
+					{
+						cross(ai, -b.a());
+						cross(ai, -b.b());
+					}
+				}
+
+				// a == b means all pairs within the subtree
+				void run(uint32 a, uint32 b)
+				{
+					if (a == b)
+						self(a);
+					else
+						cross(a, b);
+				}
+			};
+
+			struct PairsJob
+			{
+				const SpatialDataImpl *data = nullptr;
+				std::vector<std::pair<uint32, uint32>> work;
+				std::vector<std::vector<uint32>> results; // per group
+
+				void operator()(uint32 groupIndex)
+				{
+					const auto r = tasksSplit(groupIndex, numeric_cast<uint32>(results.size()), numeric_cast<uint32>(work.size()));
+					PairsFinder f(data, results[groupIndex]);
+					for (uint32 i = r.first; i < r.second; i++)
+						f.run(work[i].first, work[i].second);
+				}
+
+				// expand the top of the traversal into independent units of work
+				void expand(uint32 target)
+				{
+					work.push_back({ 0, 0 });
+					bool progress = true;
+					while (progress && work.size() < target)
+					{
+						progress = false;
+						std::vector<std::pair<uint32, uint32>> next;
+						next.reserve(work.size() * 3);
+						for (const auto &w : work)
+						{
+							const Node &a = data->nodes[w.first];
+							const Node &b = data->nodes[w.second];
+							if (w.first == w.second)
+							{
+								if (a.a() < 0)
+								{
+									next.push_back({ -a.a(), -a.a() });
+									next.push_back({ -a.b(), -a.b() });
+									next.push_back({ -a.a(), -a.b() });
+									progress = true;
+								}
+								else
+									next.push_back(w);
+							}
+							else
+							{
+								if (!intersects(a.box, b.box))
+									continue;
+								if (a.a() < 0)
+								{
+									next.push_back({ -a.a(), w.second });
+									next.push_back({ -a.b(), w.second });
+									progress = true;
+								}
+								else if (b.a() < 0)
+								{
+									next.push_back({ w.first, -b.a() });
+									next.push_back({ w.first, -b.b() });
+									progress = true;
+								}
+								else
+									next.push_back(w);
+							}
+						}
+						std::swap(work, next);
+					}
+				}
+			};
+
+			bool pairs(bool parallel)
+			{
+				CAGE_ASSERT(!data->dirty);
+				clear();
+				resultOffsets.clear();
+				if (data->nodes.empty())
+					return false;
+				if (!parallel)
+				{
+					PairsFinder f(+data, resultNames);
+					f.run(0, 0);
+					return !resultNames.empty();
+				}
+				PairsJob job;
+				job.data = +data;
+				job.expand(processorsCount() * 16);
+				job.results.resize(min(numeric_cast<uint32>(job.work.size()), processorsCount() * 4));
+				if (job.results.empty())
+					return false;
+				if (job.results.size() > 1)
+					tasksRunBlocking<PairsJob>("spatial pairs", job, numeric_cast<uint32>(job.results.size()));
+				else
+					job(0);
+				for (const auto &it : job.results)
+					resultNames.insert(resultNames.end(), it.begin(), it.end());
+				return !resultNames.empty();
+			}
 		};
 	}
 
@@ -375,6 +1126,43 @@ namespace cage
 		return impl->resultNames;
 	}
 
+	PointerRange<uint32> SpatialQuery::result(uint32 batchIndex) const
+	{
+		SpatialQueryImpl *impl = (SpatialQueryImpl *)this;
+		CAGE_ASSERT(batchIndex + 1 < impl->resultOffsets.size());
+		return { impl->resultNames.data() + impl->resultOffsets[batchIndex], impl->resultNames.data() + impl->resultOffsets[batchIndex + 1] };
+	}
+
+	bool SpatialQuery::intersection(PointerRange<const Line> shapes, bool parallel)
+	{
+		SpatialQueryImpl *impl = (SpatialQueryImpl *)this;
+		return impl->intersection(shapes, parallel);
+	}
+
+	bool SpatialQuery::intersection(PointerRange<const Sphere> shapes, bool parallel)
+	{
+		SpatialQueryImpl *impl = (SpatialQueryImpl *)this;
+		return impl->intersection(shapes, parallel);
+	}
+
+	bool SpatialQuery::intersection(PointerRange<const Aabb> shapes, bool parallel)
+	{
+		SpatialQueryImpl *impl = (SpatialQueryImpl *)this;
+		return impl->intersection(shapes, parallel);
+	}
+
+	bool SpatialQuery::intersection(PointerRange<const Frustum> shapes, bool parallel)
+	{
+		SpatialQueryImpl *impl = (SpatialQueryImpl *)this;
+		return impl->intersection(shapes, parallel);
+	}
+
+	bool SpatialQuery::pairs(bool parallel)
+	{
+		SpatialQueryImpl *impl = (SpatialQueryImpl *)this;
+		return impl->pairs(parallel);
+	}
+
 	bool SpatialQuery::intersection(Vec3 shape)
 	{
 		return intersection(Aabb(shape, shape));
@@ -470,20 +1258,13 @@ namespace cage
 	{
 		CAGE_ASSERT(name != m);
 		SpatialDataImpl *impl = (SpatialDataImpl *)this;
-		auto it = impl->itemsTable.find(name);
-		if (it == impl->itemsTable.end())
-			return;
-		impl->dirty = true;
-		impl->itemsArena.destroy<ItemBase>(it->second);
-		impl->itemsTable.erase(it);
+		impl->remove(name);
 	}
 
 	void SpatialStructure::clear()
 	{
 		SpatialDataImpl *impl = (SpatialDataImpl *)this;
-		impl->dirty = true;
-		impl->itemsArena.flush();
-		impl->itemsTable.clear();
+		impl->clear();
 	}
 
 	void SpatialStructure::rebuild()
@@ -492,6 +1273,12 @@ namespace cage
 		impl->rebuild();
 	}
 
+	SpatialStructureStatistics SpatialStructure::statistics() const
+	{
+		const SpatialDataImpl *impl = (const SpatialDataImpl *)this;
+		return impl->statistics();
+	}
+
 	Holder<SpatialStructure> newSpatialStructure(const SpatialStructureCreateConfig &config)
 	{
 		return systemMemory().createImpl<SpatialStructure, SpatialDataImpl>(config);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include <bc7enc_rdo/bc7decomp.h>
@@ -6,8 +7,10 @@
 
 #include "image.h"
 
+#include <cage-core/concurrent.h>
 #include <cage-core/imageBlocks.h>
 #include <cage-core/pointerRangeHolder.h>
+#include <cage-core/tasks.h>
 
 namespace cage
 {
@@ -31,65 +34,248 @@ namespace cage
 		};
 		static_assert(sizeof(Color) == 4);
 
-		CAGE_FORCE_INLINE uint32 blockyIndex(uint32 x, uint32 y, uint32 width)
+		CAGE_FORCE_INLINE Vec2i blocksCount(const Vec2i &resolution)
 		{
-			const uint32 bx = x / 4;
-			const uint32 by = y / 4;
-			const uint32 bw = width / 4;
-			const uint32 block = by * bw + bx;
-			const uint32 pixelInBlock = (y % 4) * 4 + (x % 4);
-			return block * 16 + pixelInBlock;
+			return (resolution + 3) / 4; // round up to multiple of 4x4
 		}
 
-		template<uint32 Channels, uint32 BytesPerBlock, class Function>
-		Holder<PointerRange<char>> encoder(const Image *img, const ImageBcnEncodeConfig &config, const Function &function)
+		// gathers one row of 4x4 blocks from the image
+		template<uint32 Channels>
+		void loadBlocksRow(const Image *img, uint32 blockRow, PointerRange<Color> colors)
 		{
-			CAGE_ASSERT(img->channels() == Channels);
-			const Vec2i resolution_ = img->resolution();
-			const Vec2i resolution = 4 * ((resolution_ + 3) / 4); // round up to multiple of 4x4
-			const uint32 blocksRequired = resolution[0] * resolution[1] / 16;
-			std::vector<Color> colors; // todo rewrite to streaming version avoiding this vector
-			colors.resize(blocksRequired * 16);
-			for (uint32 y = 0; y < resolution_[1]; y++)
+			const uint32 w = img->width();
+			const uint32 h = img->height();
+			const uint32 y0 = blockRow * 4;
+			const uint32 y1 = min(y0 + 4, h);
+			CAGE_ASSERT(colors.size() == numeric_cast<uint32>(blocksCount(img->resolution())[0]) * 16);
+			for (Color &c : colors)
+				c = Color();
+			if (img->format() == ImageFormatEnum::U8)
+			{
+				const uint8 *raw = img->rawViewU8().data();
+				for (uint32 y = y0; y < y1; y++)
+				{
+					const uint8 *src = raw + y * w * Channels;
+					for (uint32 x = 0; x < w; x++)
+					{
+						Color &color = colors[(x / 4) * 16 + (y % 4) * 4 + (x % 4)];
+						for (uint32 c = 0; c < Channels; c++)
+							color.rgba[c] = src[x * Channels + c];
+					}
+				}
+			}
+			else
+			{
+				for (uint32 y = y0; y < y1; y++)
+				{
+					for (uint32 x = 0; x < w; x++)
+					{
+						Color &color = colors[(x / 4) * 16 + (y % 4) * 4 + (x % 4)];
+						for (uint32 c = 0; c < Channels; c++)
+							color.rgba[c] = numeric_cast<uint8>(img->value(x, y, c) * 255);
+					}
+				}
+			}
+		}
+
+		// scatters one row of 4x4 blocks into U8 image data
+		template<uint32 Channels>
+		void storeBlocksRow(uint8 *raw, const Vec2i &resolution, uint32 blockRow, PointerRange<const Color> colors)
+		{
+			const uint32 w = resolution[0];
+			const uint32 y0 = blockRow * 4;
+			const uint32 y1 = min(y0 + 4, (uint32)resolution[1]);
+			for (uint32 y = y0; y < y1; y++)
 			{
-				for (uint32 x = 0; x < resolution_[0]; x++)
+				uint8 *dst = raw + y * w * Channels;
+				for (uint32 x = 0; x < w; x++)
 				{
-					Color &color = colors[blockyIndex(x, y, resolution[0])];
+					const Color &color = colors[(x / 4) * 16 + (y % 4) * 4 + (x % 4)];
 					for (uint32 c = 0; c < Channels; c++)
-						color.rgba[c] = numeric_cast<uint8>(img->value(x, y, c) * 255);
+						dst[x * Channels + c] = color.rgba[c];
 				}
 			}
-			PointerRangeHolder<char> buffer;
-			buffer.resize(blocksRequired * BytesPerBlock);
-			for (uint32 bi = 0; bi < blocksRequired; bi++)
-				function(buffer.data() + bi * BytesPerBlock, (colors.data() + bi * 16)->rgba);
-			return buffer;
+		}
+
+		// rows of blocks are distributed among tasks, across all images in the batch
+		template<uint32 BytesPerBlock, class Function>
+		struct EncoderJob
+		{
+			const Function &function;
+			PointerRange<const Image *const> images;
+			std::vector<uint32> rowsOffsets; // prefix sums of block rows per image
+			std::vector<PointerRange<char>> outputs;
+			uint32 groups = 0;
+
+			EncoderJob(const Function &function, PointerRange<const Image *const> images) : function(function), images(images) {}
+
+			template<uint32 Channels>
+			void encodeRow(uint32 imageIndex, uint32 blockRow, std::vector<Color> &colors)
+			{
+				const Image *img = images[imageIndex];
+				const uint32 bw = blocksCount(img->resolution())[0];
+				colors.resize(bw * 16);
+				loadBlocksRow<Channels>(img, blockRow, colors);
+				char *dst = outputs[imageIndex].data() + blockRow * bw * BytesPerBlock;
+				for (uint32 bi = 0; bi < bw; bi++)
+					function(dst + bi * BytesPerBlock, colors[bi * 16].rgba);
+			}
+
+			void operator()(uint32 idx)
+			{
+				const auto r = tasksSplit(idx, groups, rowsOffsets.back());
+				std::vector<Color> colors;
+				uint32 imageIndex = numeric_cast<uint32>(std::upper_bound(rowsOffsets.begin(), rowsOffsets.end(), r.first) - rowsOffsets.begin() - 1);
+				for (uint32 row = r.first; row < r.second; row++)
+				{
+					while (row >= rowsOffsets[imageIndex + 1])
+						imageIndex++;
+					const uint32 blockRow = row - rowsOffsets[imageIndex];
+					switch (images[imageIndex]->channels())
+					{
+						case 1:
+							encodeRow<1>(imageIndex, blockRow, colors);
+							break;
+						case 2:
+							encodeRow<2>(imageIndex, blockRow, colors);
+							break;
+						case 3:
+							encodeRow<3>(imageIndex, blockRow, colors);
+							break;
+						case 4:
+							encodeRow<4>(imageIndex, blockRow, colors);
+							break;
+						default:
+							CAGE_THROW_CRITICAL(Exception, "invalid number of channels for bcn encoding");
+					}
+				}
+			}
+		};
+
+		template<uint32 BytesPerBlock, class Function>
+		Holder<PointerRange<Holder<PointerRange<char>>>> encoder(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config, const Function &function)
+		{
+			EncoderJob<BytesPerBlock, Function> job(function, images);
+			PointerRangeHolder<Holder<PointerRange<char>>> results;
+			results.reserve(images.size());
+			job.rowsOffsets.reserve(images.size() + 1);
+			job.rowsOffsets.push_back(0);
+			for (const Image *img : images)
+			{
+				const Vec2i blocks = blocksCount(img->resolution());
+				Holder<PointerRange<char>> buffer = systemMemory().createBuffer(blocks[0] * blocks[1] * BytesPerBlock);
+				job.outputs.push_back(buffer);
+				results.push_back(std::move(buffer));
+				job.rowsOffsets.push_back(job.rowsOffsets.back() + blocks[1]);
+			}
+			job.groups = min(job.rowsOffsets.back(), processorsCount() * 4);
+			if (job.groups == 1)
+				job(0);
+			else if (job.groups > 1)
+				tasksRunBlocking<decltype(job)>("bcn encode", job, job.groups);
+			return results;
 		}
 
 		template<uint32 Channels, uint32 BytesPerBlock, class Function>
-		Holder<Image> decoder(PointerRange<const char> buffer, const Vec2i &resolution_, const Function &function)
+		Holder<PointerRange<char>> encoder(const Image *img, const ImageBcnEncodeConfig &config, const Function &function)
 		{
-			const Vec2i resolution = 4 * ((resolution_ + 3) / 4); // round up to multiple of 4x4
-			const uint32 blocksRequired = resolution[0] * resolution[1] / 16;
-			if (blocksRequired * BytesPerBlock != buffer.size())
-				CAGE_THROW_ERROR(Exception, "incorrect data size for bcn decoding");
-			std::vector<Color> colors; // todo rewrite to streaming version avoiding this vector
-			colors.resize(blocksRequired * 16);
-			for (uint32 bi = 0; bi < blocksRequired; bi++)
-				function((colors.data() + bi * 16)->rgba, buffer.data() + bi * BytesPerBlock);
-			Holder<Image> img = newImage();
-			img->initialize(resolution_, Channels, ImageFormatEnum::U8);
-			for (uint32 y = 0; y < resolution_[1]; y++)
+			CAGE_ASSERT(img->channels() == Channels);
+			const Image *imgs[1] = { img };
+			return std::move(encoder<BytesPerBlock>(imgs, config, function)[0]);
+		}
+
+		template<uint32 Channels, uint32 BytesPerBlock, class Function>
+		struct DecoderJob
+		{
+			const Function &function;
+			PointerRange<const char> buffer;
+			Vec2i resolution;
+			uint8 *raw = nullptr;
+			uint32 groups = 0;
+
+			DecoderJob(const Function &function) : function(function) {}
+
+			void operator()(uint32 idx)
 			{
-				for (uint32 x = 0; x < resolution_[0]; x++)
+				const Vec2i blocks = blocksCount(resolution);
+				const uint32 bw = numeric_cast<uint32>(blocks[0]);
+				const auto r = tasksSplit(idx, groups, blocks[1]);
+				std::vector<Color> colors;
+				colors.resize(bw * 16);
+				for (uint32 by = r.first; by < r.second; by++)
 				{
-					const Color color = colors[blockyIndex(x, y, resolution[0])];
-					for (uint32 c = 0; c < Channels; c++)
-						img->value(x, y, c, color.rgba[c] / 255.f);
+					const char *src = buffer.data() + by * bw * BytesPerBlock;
+					for (uint32 bi = 0; bi < bw; bi++)
+						function(colors[bi * 16].rgba, src + bi * BytesPerBlock);
+					storeBlocksRow<Channels>(raw, resolution, by, colors);
 				}
 			}
+		};
+
+		// decodes directly into the image memory, without intermediate full-size buffer
+		template<uint32 Channels, uint32 BytesPerBlock, class Function>
+		Holder<Image> decoder(PointerRange<const char> buffer, const Vec2i &resolution, const Function &function)
+		{
+			const Vec2i blocks = blocksCount(resolution);
+			if (blocks[0] * blocks[1] * BytesPerBlock != buffer.size())
+				CAGE_THROW_ERROR(Exception, "incorrect data size for bcn decoding");
+			Holder<Image> img = newImage();
+			img->initialize(resolution, Channels, ImageFormatEnum::U8);
+			DecoderJob<Channels, BytesPerBlock, Function> job(function);
+			job.buffer = buffer;
+			job.resolution = resolution;
+			job.raw = (uint8 *)((ImageImpl *)+img)->mem.data();
+			job.groups = min((uint32)blocks[1], processorsCount() * 4);
+			if (job.groups == 1)
+				job(0);
+			else if (job.groups > 1)
+				tasksRunBlocking<decltype(job)>("bcn decode", job, job.groups);
 			return img;
 		}
+
+		void initBc7enc()
+		{
+			static const int initDummy = []()
+			{
+				bc7enc_compress_block_init();
+				return 0;
+			}();
+			(void)initDummy;
+		}
+
+		struct Bc1Fnc
+		{
+			void operator()(void *dst, const uint8 *src) const { rgbcx::encode_bc1(rgbcx::MAX_LEVEL, dst, src, true, false); }
+		};
+
+		struct Bc3Fnc
+		{
+			void operator()(void *dst, const uint8 *src) const { rgbcx::encode_bc3(rgbcx::MAX_LEVEL, dst, src); }
+		};
+
+		struct Bc4Fnc
+		{
+			void operator()(void *dst, const uint8 *src) const { rgbcx::encode_bc4(dst, src); }
+		};
+
+		struct Bc5Fnc
+		{
+			void operator()(void *dst, const uint8 *src) const { rgbcx::encode_bc5(dst, src); }
+		};
+
+		struct Bc7Fnc
+		{
+			bc7enc_compress_block_params conf;
+			Bc7Fnc() { bc7enc_compress_block_params_init(&conf); }
+			void operator()(void *dst, const uint8 *src) const { bc7enc_compress_block(dst, src, &conf); }
+		};
+
+		void checkChannels(PointerRange<const Image *const> images, uint32 channelsA, uint32 channelsB, StringPointer error)
+		{
+			for (const Image *img : images)
+				if (img->channels() != channelsA && img->channels() != channelsB)
+					CAGE_THROW_ERROR(Exception, error);
+		}
 	}
 
 	Holder<PointerRange<char>> imageBc1Encode(const Image *image, const ImageBcnEncodeConfig &config)
@@ -97,11 +283,7 @@ namespace cage
 		if (image->channels() != 3)
 			CAGE_THROW_ERROR(Exception, "invalid number of channels for bc1 encoding");
 		initRgbcx();
-		struct Fnc
-		{
-			void operator()(void *dst, const uint8 *src) const { rgbcx::encode_bc1(rgbcx::MAX_LEVEL, dst, src, true, false); }
-		};
-		return encoder<3, 8>(image, config, Fnc());
+		return encoder<3, 8>(image, config, Bc1Fnc());
 	}
 
 	Holder<PointerRange<char>> imageBc3Encode(const Image *image, const ImageBcnEncodeConfig &config)
@@ -109,11 +291,7 @@ namespace cage
 		if (image->channels() != 4)
 			CAGE_THROW_ERROR(Exception, "invalid number of channels for bc3 encoding");
 		initRgbcx();
-		struct Fnc
-		{
-			void operator()(void *dst, const uint8 *src) const { rgbcx::encode_bc3(rgbcx::MAX_LEVEL, dst, src); }
-		};
-		return encoder<4, 16>(image, config, Fnc());
+		return encoder<4, 16>(image, config, Bc3Fnc());
 	}
 
 	Holder<PointerRange<char>> imageBc4Encode(const Image *image, const ImageBcnEncodeConfig &config)
@@ -121,11 +299,7 @@ namespace cage
 		if (image->channels() != 1)
 			CAGE_THROW_ERROR(Exception, "invalid number of channels for bc4 encoding");
 		initRgbcx();
-		struct Fnc
-		{
-			void operator()(void *dst, const uint8 *src) const { rgbcx::encode_bc4(dst, src); }
-		};
-		return encoder<1, 8>(image, config, Fnc());
+		return encoder<1, 8>(image, config, Bc4Fnc());
 	}
 
 	Holder<PointerRange<char>> imageBc5Encode(const Image *image, const ImageBcnEncodeConfig &config)
@@ -133,35 +307,52 @@ namespace cage
 		if (image->channels() != 2)
 			CAGE_THROW_ERROR(Exception, "invalid number of channels for bc5 encoding");
 		initRgbcx();
-		struct Fnc
-		{
-			void operator()(void *dst, const uint8 *src) const { rgbcx::encode_bc5(dst, src); }
-		};
-		return encoder<2, 16>(image, config, Fnc());
+		return encoder<2, 16>(image, config, Bc5Fnc());
 	}
 
 	Holder<PointerRange<char>> imageBc7Encode(const Image *image, const ImageBcnEncodeConfig &config)
 	{
 		if (image->channels() != 3 && image->channels() != 4)
 			CAGE_THROW_ERROR(Exception, "invalid number of channels for bc7 encoding");
-		static const int initDummy = []()
-		{
-			bc7enc_compress_block_init();
-			return 0;
-		}();
-		(void)initDummy;
-		struct Fnc
-		{
-			bc7enc_compress_block_params conf;
-			void operator()(void *dst, const uint8 *src) const { bc7enc_compress_block(dst, src, &conf); }
-		};
-		Fnc fnc;
-		bc7enc_compress_block_params_init(&fnc.conf);
+		initBc7enc();
 		if (image->channels() == 3)
-			return encoder<3, 16>(image, config, fnc);
-		if (image->channels() == 4)
-			return encoder<4, 16>(image, config, fnc);
-		throw;
+			return encoder<3, 16>(image, config, Bc7Fnc());
+		return encoder<4, 16>(image, config, Bc7Fnc());
+	}
+
+	Holder<PointerRange<Holder<PointerRange<char>>>> imageBc1Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config)
+	{
+		checkChannels(images, 3, 3, "invalid number of channels for bc1 encoding");
+		initRgbcx();
+		return encoder<8>(images, config, Bc1Fnc());
+	}
+
+	Holder<PointerRange<Holder<PointerRange<char>>>> imageBc3Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config)
+	{
+		checkChannels(images, 4, 4, "invalid number of channels for bc3 encoding");
+		initRgbcx();
+		return encoder<16>(images, config, Bc3Fnc());
+	}
+
+	Holder<PointerRange<Holder<PointerRange<char>>>> imageBc4Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config)
+	{
+		checkChannels(images, 1, 1, "invalid number of channels for bc4 encoding");
+		initRgbcx();
+		return encoder<8>(images, config, Bc4Fnc());
+	}
+
+	Holder<PointerRange<Holder<PointerRange<char>>>> imageBc5Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config)
+	{
+		checkChannels(images, 2, 2, "invalid number of channels for bc5 encoding");
+		initRgbcx();
+		return encoder<16>(images, config, Bc5Fnc());
+	}
+
+	Holder<PointerRange<Holder<PointerRange<char>>>> imageBc7Encode(PointerRange<const Image *const> images, const ImageBcnEncodeConfig &config)
+	{
+		checkChannels(images, 3, 4, "invalid number of channels for bc7 encoding");
+		initBc7enc();
+		return encoder<16>(images, config, Bc7Fnc());
 	}
 
 	Holder<Image> imageBc1Decode(PointerRange<const char> buffer, const Vec2i &resolution)
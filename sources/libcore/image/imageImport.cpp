@@ -1,3 +1,5 @@
+#include <vector>
+
 #include <cage-core/files.h>
 #include <cage-core/imageAlgorithms.h>
 #include <cage-core/imageBlocks.h>
@@ -81,35 +83,61 @@ namespace cage
 
 	void imageImportConvertImagesToBcn(ImageImportResult &result, bool normals)
 	{
+		// all parts with same format are encoded in a single batch
+		std::vector<ImageImportPart *> parts[3];
 		for (ImageImportPart &part : result.parts)
 		{
 			if (part.image && !part.raw)
 			{
-				ImageImportRaw r;
-				r.colorConfig = part.image->colorConfig;
-				r.resolution = part.image->resolution();
-				r.channels = part.image->channels();
 				switch (part.image->channels())
 				{
 					case 1:
-						r.format = "bc4";
-						r.data = imageBc4Encode(+part.image, { normals });
+						parts[0].push_back(&part);
 						break;
 					case 2:
-						r.format = "bc5";
-						r.data = imageBc5Encode(+part.image, { normals });
+						parts[1].push_back(&part);
 						break;
 					case 3:
-						r.format = "bc7";
-						r.data = imageBc7Encode(+part.image, { normals });
-						break;
 					case 4:
-						r.format = "bc7";
-						r.data = imageBc7Encode(+part.image, { normals });
+						parts[2].push_back(&part);
 						break;
 					default:
 						CAGE_THROW_ERROR(Exception, "unsupported number of channels for image-to-bcn conversion");
 				}
+			}
+		}
+
+		for (uint32 f = 0; f < 3; f++)
+		{
+			if (parts[f].empty())
+				continue;
+			std::vector<const Image *> images;
+			images.reserve(parts[f].size());
+			for (const ImageImportPart *part : parts[f])
+				images.push_back(+part->image);
+			Holder<PointerRange<Holder<PointerRange<char>>>> datas;
+			switch (f)
+			{
+				case 0:
+					datas = imageBc4Encode(images, { normals });
+					break;
+				case 1:
+					datas = imageBc5Encode(images, { normals });
+					break;
+				case 2:
+					datas = imageBc7Encode(images, { normals });
+					break;
+			}
+			static constexpr const char *formats[3] = { "bc4", "bc5", "bc7" };
+			for (uint32 i = 0; i < parts[f].size(); i++)
+			{
+				ImageImportPart &part = *parts[f][i];
+				ImageImportRaw r;
+				r.format = formats[f];
+				r.colorConfig = part.image->colorConfig;
+				r.resolution = part.image->resolution();
+				r.channels = part.image->channels();
+				r.data = std::move(datas[i]);
 				CAGE_ASSERT(r.data);
 				part.raw = systemMemory().createHolder<ImageImportRaw>(std::move(r));
 				part.image.clear();
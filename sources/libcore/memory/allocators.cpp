@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include <cage-core/math.h> // max
@@ -34,7 +35,18 @@ namespace cage
 			{
 				CAGE_ASSERT(detail::isPowerOf2(alignment));
 				size = max(size, uintPtr(1));
-				CAGE_ASSERT(size + alignment <= config.blockSize);
+				if (size + alignment > config.blockSize)
+				{
+					// dedicated block, kept across flushes and reused for following large allocations
+					auto it = std::find_if(large.begin() + largeUsed, large.end(), [&](const MemoryBuffer &b) { return b.size() >= size + alignment; });
+					if (it == large.end())
+					{
+						large.emplace_back(size + alignment);
+						it = large.end() - 1;
+					}
+					std::swap(*it, large[largeUsed]);
+					return (void *)detail::roundUpTo((uintPtr)large[largeUsed++].data(), alignment);
+				}
 				const uintPtr p = detail::roundUpTo(where, alignment);
 				const uintPtr e = p + size;
 				if (e <= end)
@@ -46,10 +58,15 @@ namespace cage
 				return allocate(size, alignment);
 			}
 
-			void deallocate(void *ptr) { CAGE_THROW_ERROR(Exception, "linear memory allocator does not support individual deallocations"); }
+			void deallocate(void *ptr)
+			{
+				if (!config.ignoreDeallocations)
+					CAGE_THROW_ERROR(Exception, "linear memory allocator does not support individual deallocations");
+			}
 
 			void flush()
 			{
+				largeUsed = 0;
 				if (!blocks.empty())
 				{
 					index = 0;
@@ -60,6 +77,8 @@ namespace cage
 			MemoryArena arena = MemoryArena(this);
 			const MemoryAllocatorLinearCreateConfig config;
 			std::vector<MemoryBuffer> blocks;
+			std::vector<MemoryBuffer> large;
+			uint32 largeUsed = 0; // number of large blocks in use, the rest are available for reuse
 			uintPtr where = 0; // pointer inside the current buffer where next allocation should start
 			uintPtr end = 0; // pointer at the end of the capacity of the current buffer
 			uint32 index = m; // index of the current buffer
@@ -1,3 +1,6 @@
+#include <vector>
+
+#include <zdict.h>
 #include <zstd.h>
 
 #include <cage-core/math.h> // clamp
@@ -6,6 +9,239 @@
 
 namespace cage
 {
+	namespace
+	{
+		void checkError(std::size_t r)
+		{
+			if (ZSTD_isError(r))
+				CAGE_THROW_ERROR(Exception, StringPointer(ZSTD_getErrorName(r)));
+		}
+
+		int compressionLevel(sint32 preference)
+		{
+			return clamp(ZSTD_maxCLevel() * preference / 100, ZSTD_minCLevel(), ZSTD_maxCLevel());
+		}
+
+		ZSTD_CCtx *createCCtx()
+		{
+			ZSTD_CCtx *c = ZSTD_createCCtx();
+			if (!c)
+				CAGE_THROW_ERROR(Exception, "failed to create zstd compression context");
+			return c;
+		}
+
+		ZSTD_DCtx *createDCtx()
+		{
+			ZSTD_DCtx *d = ZSTD_createDCtx();
+			if (!d)
+				CAGE_THROW_ERROR(Exception, "failed to create zstd decompression context");
+			return d;
+		}
+
+		// contexts reused by the free functions on each thread
+		struct ThreadContexts : private Immovable
+		{
+			ZSTD_CCtx *c = nullptr;
+			ZSTD_DCtx *d = nullptr;
+
+			~ThreadContexts()
+			{
+				ZSTD_freeCCtx(c);
+				ZSTD_freeDCtx(d);
+			}
+
+			ZSTD_CCtx *compression()
+			{
+				if (!c)
+					c = createCCtx();
+				return c;
+			}
+
+			ZSTD_DCtx *decompression()
+			{
+				if (!d)
+					d = createDCtx();
+				return d;
+			}
+		};
+
+		thread_local ThreadContexts threadContexts;
+
+		void compressImpl(ZSTD_CCtx *ctx, const ZSTD_CDict *dict, int level, PointerRange<const char> input, PointerRange<char> &output)
+		{
+			const std::size_t r = dict ? ZSTD_compress_usingCDict(ctx, output.data(), output.size(), input.data(), input.size(), dict) : ZSTD_compressCCtx(ctx, output.data(), output.size(), input.data(), input.size(), level);
+			checkError(r);
+			CAGE_ASSERT(r <= output.size());
+			output = PointerRange<char>(output.data(), output.data() + r);
+		}
+
+		void decompressImpl(ZSTD_DCtx *ctx, const ZSTD_DDict *dict, PointerRange<const char> input, PointerRange<char> &output)
+		{
+			const std::size_t r = dict ? ZSTD_decompress_usingDDict(ctx, output.data(), output.size(), input.data(), input.size(), dict) : ZSTD_decompressDCtx(ctx, output.data(), output.size(), input.data(), input.size());
+			checkError(r);
+			CAGE_ASSERT(r <= output.size());
+			output = PointerRange<char>(output.data(), output.data() + r);
+		}
+
+		ZSTD_CDict *createCDict(PointerRange<const char> dictionary, int level)
+		{
+			if (dictionary.empty())
+				return nullptr;
+			ZSTD_CDict *d = ZSTD_createCDict(dictionary.data(), dictionary.size(), level);
+			if (!d)
+				CAGE_THROW_ERROR(Exception, "failed to create zstd compression dictionary");
+			return d;
+		}
+
+		ZSTD_DDict *createDDict(PointerRange<const char> dictionary)
+		{
+			if (dictionary.empty())
+				return nullptr;
+			ZSTD_DDict *d = ZSTD_createDDict(dictionary.data(), dictionary.size());
+			if (!d)
+				CAGE_THROW_ERROR(Exception, "failed to create zstd decompression dictionary");
+			return d;
+		}
+
+		class CompressorImpl : public Compressor
+		{
+		public:
+			MemoryBuffer dictionary;
+			const int level = 0;
+			ZSTD_CCtx *cctx = nullptr;
+			ZSTD_DCtx *dctx = nullptr;
+			ZSTD_CDict *cdict = nullptr;
+			ZSTD_DDict *ddict = nullptr;
+
+			CompressorImpl(const CompressorCreateConfig &config) : level(compressionLevel(config.preference))
+			{
+				dictionary.resize(config.dictionary.size());
+				if (!config.dictionary.empty())
+					detail::memcpy(dictionary.data(), config.dictionary.data(), config.dictionary.size());
+			}
+
+			~CompressorImpl()
+			{
+				ZSTD_freeCCtx(cctx);
+				ZSTD_freeDCtx(dctx);
+				ZSTD_freeCDict(cdict);
+				ZSTD_freeDDict(ddict);
+			}
+
+			// contexts and dictionaries are prepared lazily, the compressor is often used in one direction only
+			void compress(PointerRange<const char> input, PointerRange<char> &output)
+			{
+				if (!cctx)
+				{
+					cctx = createCCtx();
+					cdict = createCDict(dictionary, level);
+				}
+				compressImpl(cctx, cdict, level, input, output);
+			}
+
+			void decompress(PointerRange<const char> input, PointerRange<char> &output)
+			{
+				if (!dctx)
+				{
+					dctx = createDCtx();
+					ddict = createDDict(dictionary);
+				}
+				decompressImpl(dctx, ddict, input, output);
+			}
+		};
+
+		class CompressionStreamImpl : public CompressionStream
+		{
+		public:
+			ZSTD_CCtx *ctx = nullptr;
+			ZSTD_CDict *dict = nullptr;
+
+			CompressionStreamImpl(const CompressorCreateConfig &config)
+			{
+				const int level = compressionLevel(config.preference);
+				ctx = createCCtx();
+				dict = createCDict(config.dictionary, level);
+				checkError(ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, level));
+				if (dict)
+					checkError(ZSTD_CCtx_refCDict(ctx, dict));
+			}
+
+			~CompressionStreamImpl()
+			{
+				ZSTD_freeCCtx(ctx);
+				ZSTD_freeCDict(dict);
+			}
+
+			std::size_t process(ZSTD_inBuffer &in, MemoryBuffer &output, ZSTD_EndDirective mode)
+			{
+				const uintPtr off = output.size();
+				const uintPtr chunk = ZSTD_CStreamOutSize();
+				output.resizeSmart(off + chunk);
+				ZSTD_outBuffer out = { output.data() + off, chunk, 0 };
+				const std::size_t r = ZSTD_compressStream2(ctx, &out, &in, mode);
+				output.resize(off + out.pos);
+				checkError(r);
+				return r;
+			}
+
+			void compress(PointerRange<const char> input, MemoryBuffer &output)
+			{
+				ZSTD_inBuffer in = { input.data(), input.size(), 0 };
+				while (in.pos < in.size)
+					process(in, output, ZSTD_e_continue);
+			}
+
+			void finish(MemoryBuffer &output)
+			{
+				ZSTD_inBuffer in = { nullptr, 0, 0 };
+				while (process(in, output, ZSTD_e_end) != 0)
+					;
+			}
+		};
+
+		class DecompressionStreamImpl : public DecompressionStream
+		{
+		public:
+			ZSTD_DCtx *ctx = nullptr;
+			ZSTD_DDict *dict = nullptr;
+			bool complete = true;
+
+			DecompressionStreamImpl(const CompressorCreateConfig &config)
+			{
+				ctx = createDCtx();
+				dict = createDDict(config.dictionary);
+				if (dict)
+					checkError(ZSTD_DCtx_refDDict(ctx, dict));
+			}
+
+			~DecompressionStreamImpl()
+			{
+				ZSTD_freeDCtx(ctx);
+				ZSTD_freeDDict(dict);
+			}
+
+			bool decompress(PointerRange<const char> input, MemoryBuffer &output)
+			{
+				ZSTD_inBuffer in = { input.data(), input.size(), 0 };
+				while (true)
+				{
+					const uintPtr off = output.size();
+					const uintPtr chunk = ZSTD_DStreamOutSize();
+					output.resizeSmart(off + chunk);
+					ZSTD_outBuffer out = { output.data() + off, chunk, 0 };
+					const std::size_t r = ZSTD_decompressStream(ctx, &out, &in);
+					output.resize(off + out.pos);
+					checkError(r);
+					if (in.pos > 0)
+						complete = r == 0;
+					if (in.pos == in.size && out.pos < out.size)
+						break; // all input consumed and all output flushed
+				}
+				return complete;
+			}
+		};
+	}
+
 	Holder<PointerRange<char>> memoryCompress(PointerRange<const char> input, sint32 preference)
 	{
 		MemoryBuffer result(compressionBound(input.size()));
@@ -26,21 +262,12 @@ namespace cage
 
 	void memoryCompress(PointerRange<const char> input, PointerRange<char> &output, sint32 preference)
 	{
-		const int level = clamp(ZSTD_maxCLevel() * preference / 100, ZSTD_minCLevel(), ZSTD_maxCLevel());
-		const std::size_t r = ZSTD_compress(output.data(), output.size(), input.data(), input.size(), level);
-		if (ZSTD_isError(r))
-			CAGE_THROW_ERROR(Exception, StringPointer(ZSTD_getErrorName(r)));
-		CAGE_ASSERT(r <= output.size());
-		output = PointerRange<char>(output.data(), output.data() + r);
+		compressImpl(threadContexts.compression(), nullptr, compressionLevel(preference), input, output);
 	}
 
 	void memoryDecompress(PointerRange<const char> input, PointerRange<char> &output)
 	{
-		const std::size_t r = ZSTD_decompress(output.data(), output.size(), input.data(), input.size());
-		if (ZSTD_isError(r))
-			CAGE_THROW_ERROR(Exception, StringPointer(ZSTD_getErrorName(r)));
-		CAGE_ASSERT(r <= output.size());
-		output = PointerRange<char>(output.data(), output.data() + r);
+		decompressImpl(threadContexts.decompression(), nullptr, input, output);
 	}
 
 	uintPtr compressionBound(uintPtr size)
@@ -48,4 +275,94 @@ namespace cage
 		const std::size_t r = ZSTD_compressBound(size);
 		return r + r / 10 + 1000000; // additional capacity allows faster compression
 	}
+
+	Holder<PointerRange<char>> memoryCompressionTrainDictionary(PointerRange<const PointerRange<const char>> samples, uintPtr maxSize)
+	{
+		MemoryBuffer concatenated;
+		std::vector<std::size_t> sizes;
+		sizes.reserve(samples.size());
+		{
+			uintPtr total = 0;
+			for (const auto &s : samples)
+				total += s.size();
+			concatenated.reserve(total);
+		}
+		for (const auto &s : samples)
+		{
+			const uintPtr off = concatenated.size();
+			concatenated.resize(off + s.size());
+			if (!s.empty())
+				detail::memcpy(concatenated.data() + off, s.data(), s.size());
+			sizes.push_back(s.size());
+		}
+		MemoryBuffer result(maxSize);
+		const std::size_t r = ZDICT_trainFromBuffer(result.data(), result.size(), concatenated.data(), sizes.data(), numeric_cast<unsigned>(sizes.size()));
+		if (ZDICT_isError(r))
+			CAGE_THROW_ERROR(Exception, StringPointer(ZDICT_getErrorName(r)));
+		result.resize(r);
+		return std::move(result);
+	}
+
+	Holder<PointerRange<char>> Compressor::compress(PointerRange<const char> input)
+	{
+		MemoryBuffer result(compressionBound(input.size()));
+		PointerRange<char> output = result;
+		compress(input, output);
+		result.resize(output.size());
+		return std::move(result);
+	}
+
+	Holder<PointerRange<char>> Compressor::decompress(PointerRange<const char> input, uintPtr outputSize)
+	{
+		MemoryBuffer result(outputSize);
+		PointerRange<char> output = result;
+		decompress(input, output);
+		result.resize(output.size());
+		return std::move(result);
+	}
+
+	void Compressor::compress(PointerRange<const char> input, PointerRange<char> &output)
+	{
+		CompressorImpl *impl = (CompressorImpl *)this;
+		impl->compress(input, output);
+	}
+
+	void Compressor::decompress(PointerRange<const char> input, PointerRange<char> &output)
+	{
+		CompressorImpl *impl = (CompressorImpl *)this;
+		impl->decompress(input, output);
+	}
+
+	Holder<Compressor> newCompressor(const CompressorCreateConfig &config)
+	{
+		return systemMemory().createImpl<Compressor, CompressorImpl>(config);
+	}
+
+	void CompressionStream::compress(PointerRange<const char> input, MemoryBuffer &output)
+	{
+		CompressionStreamImpl *impl = (CompressionStreamImpl *)this;
+		impl->compress(input, output);
+	}
+
+	void CompressionStream::finish(MemoryBuffer &output)
+	{
+		CompressionStreamImpl *impl = (CompressionStreamImpl *)this;
+		impl->finish(output);
+	}
+
+	Holder<CompressionStream> newCompressionStream(const CompressorCreateConfig &config)
+	{
+		return systemMemory().createImpl<CompressionStream, CompressionStreamImpl>(config);
+	}
+
+	bool DecompressionStream::decompress(PointerRange<const char> input, MemoryBuffer &output)
+	{
+		DecompressionStreamImpl *impl = (DecompressionStreamImpl *)this;
+		return impl->decompress(input, output);
+	}
+
+	Holder<DecompressionStream> newDecompressionStream(const CompressorCreateConfig &config)
+	{
+		return systemMemory().createImpl<DecompressionStream, DecompressionStreamImpl>(config);
+	}
 }
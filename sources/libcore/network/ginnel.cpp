@@ -1,8 +1,15 @@
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <memory>
+#include <optional>
 #include <vector>
 
+#ifdef CAGE_SYSTEM_LINUX
+	#include <sys/epoll.h>
+	#include <sys/eventfd.h>
+#endif
+
 #include <unordered_dense.h>
 
 #include "net.h"
@@ -13,6 +20,8 @@
 #include <cage-core/flatSet.h>
 #include <cage-core/math.h> // random
 #include <cage-core/networkGinnel.h>
+#include <cage-core/pointerRangeHolder.h>
+#include <cage-core/random.h>
 #include <cage-core/serialization.h>
 
 namespace cage
@@ -27,8 +36,17 @@ namespace cage
 		using namespace privat;
 
 		const ConfigUint32 logLevel("cage/ginnel/logLevel", 0);
-		const ConfigFloat confSimulatedPacketLoss("cage/ginnel/simulatedPacketLoss", 0);
 		const ConfigUint32 confBufferSize("cage/ginnel/systemBufferSize", 1024 * 1024);
+		const ConfigUint64 confSimSeed("cage/ginnel/simulation/seed", 0);
+		const ConfigUint64 confSimLatency("cage/ginnel/simulation/latency", 0);
+		const ConfigUint64 confSimJitter("cage/ginnel/simulation/jitter", 0);
+		const ConfigUint64 confSimReorderDelay("cage/ginnel/simulation/reorderDelay", 0);
+		const ConfigUint64 confSimBandwidth("cage/ginnel/simulation/bandwidth", 0);
+		const ConfigUint64 confSimQueueSize("cage/ginnel/simulation/queueSize", 64 * 1024);
+		const ConfigFloat confSimLoss("cage/ginnel/simulation/loss", 0);
+		const ConfigFloat confSimDuplicate("cage/ginnel/simulation/duplicate", 0);
+		const ConfigFloat confSimReorder("cage/ginnel/simulation/reorder", 0);
+		const ConfigFloat confSimulatedPacketLoss("cage/ginnel/simulatedPacketLoss", 0); // deprecated, use cage/ginnel/simulation/loss
 
 #define UDP_LOG(LEVEL, MSG) \
 	{ \
@@ -71,6 +89,60 @@ namespace cage
 			uintPtr size = 0;
 		};
 
+		// reusable buffers for received packets, shared by all connections of a sock group
+		struct PacketsPool : private Immovable, public std::enable_shared_from_this<PacketsPool>
+		{
+			static constexpr uintPtr PacketCapacity = 2048; // ginnel packets are limited by mtu
+			static constexpr uintPtr MaxAvailable = 4096;
+
+			struct Packet : public privat::HolderControlBase
+			{
+				MemoryBuffer buffer = MemoryBuffer(PacketCapacity);
+				std::shared_ptr<PacketsPool> pool; // keeps the pool alive while the packet is in use
+			};
+
+			std::vector<Packet *> available;
+			Holder<Mutex> mut = newMutex();
+
+			~PacketsPool()
+			{
+				for (Packet *p : available)
+					systemMemory().destroy<Packet>(p);
+			}
+
+			Holder<MemoryBuffer> acquire()
+			{
+				Packet *p = nullptr;
+				{
+					ScopeLock lock(mut);
+					if (!available.empty())
+					{
+						p = available.back();
+						available.pop_back();
+					}
+				}
+				if (!p)
+				{
+					p = systemMemory().createObject<Packet>();
+					p->deletee = p;
+					p->deleter.bind<&PacketsPool::release>();
+				}
+				p->pool = shared_from_this();
+				return Holder<MemoryBuffer>(&p->buffer, p);
+			}
+
+			static void release(void *ptr)
+			{
+				Packet *p = (Packet *)ptr;
+				std::shared_ptr<PacketsPool> pool = std::move(p->pool);
+				ScopeLock lock(pool->mut);
+				if (pool->available.size() < MaxAvailable)
+					pool->available.push_back(p);
+				else
+					systemMemory().destroy<Packet>(p);
+			}
+		};
+
 		struct SockGroup : private Immovable
 		{
 			struct Receiver : private Immovable
@@ -84,6 +156,11 @@ namespace cage
 			ankerl::unordered_dense::map<uint64, std::weak_ptr<Receiver>> receivers;
 			std::weak_ptr<std::vector<std::shared_ptr<Receiver>>> accepting;
 			std::vector<Sock> socks;
+			std::shared_ptr<PacketsPool> pool = std::make_shared<PacketsPool>();
+			std::array<Holder<MemoryBuffer>, MaxBatchDatagrams> spares; // buffers ready for receiving
+			std::array<Sock::Datagram, MaxBatchDatagrams> datagrams;
+			std::vector<uint64> touched; // connection ids that received packets, used by server io threads
+			bool trackTouched = false;
 			Holder<Mutex> mut = newMutex();
 
 			void applyBufferSizes()
@@ -92,6 +169,56 @@ namespace cage
 					s.setBufferSize(confBufferSize);
 			}
 
+			void handlePacket(uint32 sockIndex, const Addr &adr, MemView mv)
+			{
+				if (mv.size < 12)
+				{
+					UDP_LOG(7, "received invalid packet (too small)");
+					return;
+				}
+				Deserializer des = mv.des();
+				{ // read signature
+					uint32 sign = 0;
+					des >> sign;
+					if (sign != CageMagic)
+					{
+						UDP_LOG(7, "received invalid packet (wrong signature)");
+						return;
+					}
+				}
+				uint64 connId;
+				des >> connId;
+				auto r = receivers[connId].lock();
+				if (r)
+				{
+					r->packets.push_back(std::move(mv));
+					if (trackTouched)
+						touched.push_back(connId);
+					if (r->sockIndex == m)
+					{
+						// set preferred socket and address for responding
+						r->sockIndex = sockIndex;
+						r->address = adr;
+					}
+				}
+				else
+				{
+					auto ac = accepting.lock();
+					if (!ac)
+					{
+						UDP_LOG(7, "received invalid packet (unknown connection id)");
+						return;
+					}
+					auto s = std::make_shared<Receiver>();
+					s->address = adr;
+					s->connId = connId;
+					s->packets.push_back(std::move(mv));
+					s->sockIndex = sockIndex;
+					receivers[connId] = s;
+					ac->push_back(s);
+				}
+			}
+
 			void readAll()
 			{
 				for (uint32 sockIndex = 0; sockIndex < numeric_cast<uint32>(socks.size()); sockIndex++)
@@ -101,67 +228,27 @@ namespace cage
 						continue;
 					try
 					{
-						Addr adr;
 						while (true)
 						{
-							auto avail = s.available();
-							if (avail < 12)
-								break;
-							Holder<MemoryBuffer> buff = systemMemory().createHolder<MemoryBuffer>();
-							buff->resize(avail);
-							uintPtr off = 0;
-							while (avail)
+							for (uint32 i = 0; i < MaxBatchDatagrams; i++)
 							{
-								uintPtr siz = s.recvFrom(buff->data() + off, avail, adr);
-								CAGE_ASSERT(siz <= avail);
-								MemView mv(buff.share(), off, siz);
-								avail -= siz;
-								off += siz;
-								if (siz < 12)
+								if (!spares[i])
+									spares[i] = pool->acquire();
+								datagrams[i].buffer = *spares[i];
+							}
+							const uint32 cnt = s.recvBatch(datagrams);
+							for (uint32 i = 0; i < cnt; i++)
+							{
+								const Sock::Datagram &d = datagrams[i];
+								if (d.truncated)
 								{
-									UDP_LOG(7, "received invalid packet (too small)");
+									UDP_LOG(7, "received invalid packet (too large)");
 									continue;
 								}
-								Deserializer des = mv.des();
-								{ // read signature
-									uint32 sign = 0;
-									des >> sign;
-									if (sign != CageMagic)
-									{
-										UDP_LOG(7, "received invalid packet (wrong signature)");
-										continue;
-									}
-								}
-								uint64 connId;
-								des >> connId;
-								auto r = receivers[connId].lock();
-								if (r)
-								{
-									r->packets.push_back(mv);
-									if (r->sockIndex == m)
-									{
-										// set preferred socket and address for responding
-										r->sockIndex = sockIndex;
-										r->address = adr;
-									}
-								}
-								else
-								{
-									auto ac = accepting.lock();
-									if (!ac)
-									{
-										UDP_LOG(7, "received invalid packet (unknown connection id)");
-										continue;
-									}
-									auto s = std::make_shared<Receiver>();
-									s->address = adr;
-									s->connId = connId;
-									s->packets.push_back(mv);
-									s->sockIndex = sockIndex;
-									receivers[connId] = s;
-									ac->push_back(s);
-								}
+								handlePacket(sockIndex, d.address, MemView(std::move(spares[i]), 0, d.size));
 							}
+							if (cnt < MaxBatchDatagrams)
+								break;
 						}
 					}
 					catch (...)
@@ -179,6 +266,111 @@ namespace cage
 			}
 		};
 
+		bool simulationEnabled(const GinnelSimulationConfig &c)
+		{
+			return c.latency || c.jitter || c.reorderDelay || c.bandwidth || c.lossChance > 0 || c.duplicateChance > 0 || c.reorderChance > 0;
+		}
+
+		GinnelSimulationConfig simulationEffective(const GinnelSimulationConfig &config)
+		{
+			if (simulationEnabled(config))
+				return config;
+			GinnelSimulationConfig c;
+			c.seed = confSimSeed;
+			c.latency = confSimLatency;
+			c.jitter = confSimJitter;
+			c.reorderDelay = confSimReorderDelay;
+			c.bandwidth = confSimBandwidth;
+			c.queueSize = confSimQueueSize;
+			c.lossChance = max((float)confSimLoss, (float)confSimulatedPacketLoss);
+			c.duplicateChance = (float)confSimDuplicate;
+			c.reorderChance = (float)confSimReorder;
+			return c;
+		}
+
+		// deterministic network conditions simulation for testing
+		struct Simulation : private Noncopyable
+		{
+			struct Delayed
+			{
+				MemoryBuffer data;
+				uint64 time = 0;
+				uint64 order = 0; // keeps packets with same time in order
+
+				bool operator<(const Delayed &other) const // reversed for min-heap
+				{
+					if (time == other.time)
+						return order > other.order;
+					return time > other.time;
+				}
+			};
+
+			const GinnelSimulationConfig config;
+			RandomGenerator rng;
+			std::vector<Delayed> delayed; // heap
+			std::vector<MemoryBuffer> released;
+			uint64 linkFree = 0; // time at which the simulated link will have transmitted all accepted packets
+			uint64 lastDelivery = 0;
+			uint64 order = 0;
+			const bool enabled = false;
+
+			explicit Simulation(const GinnelSimulationConfig &config) : config(simulationEffective(config)), rng((this->config.seed ^ 0x9E3779B97F4A7C15) | 1, (this->config.seed * 0xBF58476D1CE4E5B9) | 1), enabled(simulationEnabled(this->config)) {}
+
+			void schedule(PointerRange<const char> packet, uint64 now)
+			{
+				if (rng.randomChance() < config.lossChance)
+				{
+					UDP_LOG(4, "dropping packet due to simulated packet loss");
+					return;
+				}
+				const uint32 copies = rng.randomChance() < config.duplicateChance ? 2 : 1;
+				for (uint32 i = 0; i < copies; i++)
+				{
+					uint64 t = now;
+					if (config.bandwidth)
+					{
+						const uint64 start = max(linkFree, now);
+						if ((start - now) * config.bandwidth / 1000000 > config.queueSize)
+						{
+							UDP_LOG(4, "dropping packet due to simulated bandwidth");
+							continue;
+						}
+						linkFree = start + packet.size() * 1000000 / config.bandwidth;
+						t = linkFree;
+					}
+					t += config.latency;
+					if (config.jitter)
+						t += rng.randomRange(uint64(0), config.jitter + 1);
+					if (config.reorderChance > 0 && rng.randomChance() < config.reorderChance)
+						t += config.reorderDelay; // later packets overtake this one
+					else
+					{
+						t = max(t, lastDelivery); // jitter alone does not reorder packets
+						lastDelivery = t;
+					}
+					Delayed d;
+					d.data.resize(packet.size());
+					detail::memcpy(d.data.data(), packet.data(), packet.size());
+					d.time = t;
+					d.order = order++;
+					delayed.push_back(std::move(d));
+					std::push_heap(delayed.begin(), delayed.end());
+				}
+			}
+
+			// moves all packets due at the time into released
+			void release(uint64 now)
+			{
+				released.clear();
+				while (!delayed.empty() && delayed.front().time <= now)
+				{
+					std::pop_heap(delayed.begin(), delayed.end());
+					released.push_back(std::move(delayed.back().data));
+					delayed.pop_back();
+				}
+			}
+		};
+
 		// compare sequence numbers with correct wrapping
 		// semantically: return a < b
 		constexpr bool comp(uint16 a, uint16 b)
@@ -270,10 +462,25 @@ namespace cage
 			return (totalSize + LongSize - 1) / LongSize;
 		}
 
+		class GinnelConnectionImpl;
+		struct Multiplexer;
+
+		// shared between an accepted connection and the server io threads
+		struct ManagedConnection : private Immovable
+		{
+			Holder<Mutex> mut = newMutex(); // guards the connection
+			GinnelConnectionImpl *conn = nullptr; // null after the connection is destroyed
+			uint64 connId = 0;
+			uint64 scheduledTick = 0; // guarded by the multiplexer mutex, as are all the flags below
+			bool registered = false;
+			bool queued = false;
+			bool ready = false;
+		};
+
 		class GinnelConnectionImpl : public GinnelConnection
 		{
 		public:
-			GinnelConnectionImpl(const String &address, uint16 port, uint64 timeout) : connId(randomRange((uint64)1, (uint64)m - 1))
+			GinnelConnectionImpl(const String &address, uint16 port, uint64 timeout, const GinnelSimulationConfig &simulation) : simulation(simulation), connId(randomRange((uint64)1, (uint64)m - 1))
 			{
 				UDP_LOG(1, "creating new connection to address: '" + address + "', port: " + port + ", timeout: " + timeout);
 				detail::OverrideBreakpoint ob;
@@ -295,7 +502,7 @@ namespace cage
 				initializationCompletion(timeout);
 			}
 
-			GinnelConnectionImpl(const String &localAddress, uint16 localPort, const String &remoteAddress, uint16 remotePort, uint64 connId, uint64 timeout) : connId(connId)
+			GinnelConnectionImpl(const String &localAddress, uint16 localPort, const String &remoteAddress, uint16 remotePort, uint64 connId, uint64 timeout) : simulation({}), connId(connId)
 			{
 				CAGE_ASSERT(connId != 0 && connId != m);
 				UDP_LOG(1, "creating new connection to remote address: '" + remoteAddress + "', remote port: " + remotePort + ", at local address: '" + localAddress + "', local port: '" + localPort + "', timeout: " + timeout);
@@ -324,7 +531,7 @@ namespace cage
 				initializationCompletion(timeout);
 			}
 
-			GinnelConnectionImpl(Sock &&sock, uint64 connId, uint64 timeout) : connId(connId)
+			GinnelConnectionImpl(Sock &&sock, uint64 connId, uint64 timeout) : simulation({}), connId(connId)
 			{
 				CAGE_ASSERT(connId != 0 && connId != m);
 				CAGE_ASSERT(sock.isValid());
@@ -365,7 +572,7 @@ namespace cage
 				}
 			}
 
-			GinnelConnectionImpl(std::shared_ptr<SockGroup> sg, std::shared_ptr<SockGroup::Receiver> rec) : sockGroup(sg), sockReceiver(rec), connId(rec->connId)
+			GinnelConnectionImpl(std::shared_ptr<SockGroup> sg, std::shared_ptr<SockGroup::Receiver> rec, std::shared_ptr<Multiplexer> mux, const GinnelSimulationConfig &simulation) : sockGroup(sg), sockReceiver(rec), multiplexer(mux), simulation(simulation), connId(rec->connId)
 			{
 				CAGE_ASSERT(rec->sockIndex < sg->socks.size());
 				CAGE_ASSERT(!sg->socks[rec->sockIndex].getConnected());
@@ -375,11 +582,13 @@ namespace cage
 			~GinnelConnectionImpl()
 			{
 				UDP_LOG(2, "destroying connection");
+				managedUnregister();
 
 				// send connection closed packet
 				if (established)
 				{
 					detail::OverrideBreakpoint ob;
+					closing = true;
 					try
 					{
 						sending.cmds.clear();
@@ -397,19 +606,39 @@ namespace cage
 
 			// SENDING
 
-			void dispatchPacket(const void *data, uintPtr size)
+			struct Composing
 			{
-				stats.bytesSentTotal += size;
-				stats.packetsSentTotal++;
+				MemoryBuffer buffer; // all packets composed in one service call
+				std::vector<uintPtr> ends; // end offsets of individual packets in the buffer
+				std::vector<PointerRange<const char>> packets;
+			} composing;
 
-				{ // simulated packet loss for testing purposes
-					const float ch = confSimulatedPacketLoss;
-					if (ch > 0 && randomChance() < ch)
-					{
-						UDP_LOG(4, "dropping packet due to simulated packet loss");
-						return;
-					}
+			void dispatchPackets()
+			{
+				Composing &c = composing;
+				c.packets.clear();
+				uintPtr start = 0;
+				for (const uintPtr end : c.ends)
+				{
+					const PointerRange<const char> p = { c.buffer.data() + start, c.buffer.data() + end };
+					start = end;
+
+					stats.bytesSentTotal += p.size();
+					stats.packetsSentTotal++;
+
+					if (simulation.enabled)
+						simulation.schedule(p, currentServiceTime);
+					else
+						c.packets.push_back(p);
 				}
+				if (simulation.enabled)
+				{
+					simulation.release(closing ? m : currentServiceTime);
+					for (const MemoryBuffer &b : simulation.released)
+						c.packets.push_back(b);
+				}
+				if (c.packets.empty())
+					return;
 
 				// sending does not need to be under mutex
 				if (sockReceiver->sockIndex == m)
@@ -420,7 +649,7 @@ namespace cage
 						if (!s.isValid())
 							continue;
 						CAGE_ASSERT(s.getConnected());
-						s.send(data, size);
+						s.sendBatch(c.packets);
 					}
 				}
 				else
@@ -428,12 +657,7 @@ namespace cage
 					// server-side of a connection
 					Sock &s = sockGroup->socks[sockReceiver->sockIndex];
 					if (s.isValid())
-					{
-						if (s.getConnected())
-							s.send(data, size);
-						else
-							s.sendTo(data, size, sockReceiver->address);
-					}
+						s.sendBatch(c.packets, s.getConnected() ? nullptr : &sockReceiver->address);
 				}
 			}
 
@@ -690,26 +914,26 @@ namespace cage
 			void composePackets()
 			{
 				static constexpr uint32 mtu = 1450;
-				MemoryBuffer buff;
-				buff.reserve(mtu);
+				MemoryBuffer &buff = composing.buffer;
+				buff.resize(0);
+				composing.ends.clear();
 				Serializer ser(buff);
+				uintPtr start = 0; // offset of current packet
 				uint16 currentPacketSeqn = 0;
 				bool empty = true;
 				for (const Sending::Command &cmd : sending.cmds)
 				{
 					const uint32 cmdSize = numeric_cast<uint32>(cmd.msgData.size) + 10;
 
-					// send current packet
-					if (!empty && buff.size() + cmdSize > mtu)
+					// finish current packet
+					if (!empty && buff.size() - start + cmdSize > mtu)
 					{
-						dispatchPacket(buff.data(), buff.size());
-						buff.resize(0);
-						ser = Serializer(buff);
-						//empty = true;
+						composing.ends.push_back(buff.size());
+						start = buff.size();
 					}
 
 					// generate packet header
-					if (buff.size() == 0)
+					if (buff.size() == start)
 					{
 						currentPacketSeqn = sending.packetSeqn++;
 						ser << CageMagic << connId << currentPacketSeqn;
@@ -722,7 +946,10 @@ namespace cage
 					empty = false;
 				}
 				if (!empty)
-					dispatchPacket(buff.data(), buff.size());
+					composing.ends.push_back(buff.size());
+
+				// send all packets at once
+				dispatchPackets();
 			}
 
 			void serviceSending()
@@ -1063,9 +1290,11 @@ namespace cage
 				std::vector<MemView> packets;
 				{
 					ScopeLock lock(sockGroup->mut);
-					sockGroup->readAll();
+					if (!multiplexer)
+						sockGroup->readAll(); // io threads of the server read the sockets otherwise
 					sockReceiver->packets.swap(packets);
 				}
+				receivedPackets = !packets.empty();
 				try
 				{
 					for (MemView &b : packets)
@@ -1133,12 +1362,18 @@ namespace cage
 			GinnelStatistics stats;
 			std::shared_ptr<SockGroup> sockGroup;
 			std::shared_ptr<SockGroup::Receiver> sockReceiver;
+			std::shared_ptr<Multiplexer> multiplexer; // the server that updates this connection
+			std::shared_ptr<ManagedConnection> managed;
+			std::optional<Disconnected> disconnected; // thrown by update in the server io thread
+			Simulation simulation;
 			const uint64 startTime = applicationTime();
 			const uint64 connId = m;
 			uint64 lastStatsSendTime = 0;
 			uint64 currentServiceTime = 0; // time at which this service has started
 			uint64 deltaTime = 0; // time elapsed since last service
 			bool established = false;
+			bool receivedPackets = false; // in last service
+			bool closing = false;
 
 			// API
 
@@ -1184,14 +1419,484 @@ namespace cage
 				serviceSending();
 				serviceWriteBandwidth();
 			}
+
+			// MANAGED
+
+			// connections that need frequent updates
+			bool inFlight() const { return !established || receivedPackets || !sending.relMsgs.empty() || !simulation.delayed.empty(); }
+
+			// the connection is accessed from the application and from the server io threads
+			template<class F>
+			auto guarded(F &&f)
+			{
+				if (!managed)
+					return f();
+				ScopeLock lock(managed->mut);
+				if (disconnected)
+					throw *disconnected;
+				return f();
+			}
+
+			// same as guarded, but for reading the state only, does not throw
+			template<class F>
+			auto observed(F &&f) const
+			{
+				if (!managed)
+					return f();
+				ScopeLock lock(managed->mut);
+				return f();
+			}
+
+			void managedRequestService();
+			void managedUnregister();
+		};
+
+#ifndef CAGE_SYSTEM_LINUX
+		// wakes threads waiting in poll, on systems without eventfd
+		// a udp socket connected to itself on the loopback
+		struct LoopbackWaker : private Immovable
+		{
+			Sock sock;
+
+			LoopbackWaker()
+			{
+				AddrList lst("127.0.0.1", 0, AF_INET, SOCK_DGRAM, IPPROTO_UDP, AI_NUMERICHOST);
+				if (!lst.valid())
+					CAGE_THROW_ERROR(Exception, "no loopback address for waking io threads");
+				sock = lst.sock();
+				sock.setBlocking(false);
+				sock.bind(lst.address());
+				sock.connect(sock.getLocalAddress());
+			}
+
+			void signal()
+			{
+				try
+				{
+					const char c = 0;
+					sock.send(&c, 1);
+				}
+				catch (...)
+				{
+					// the socket buffer is full, the waiters will wake up anyway
+				}
+			}
+
+			void drain()
+			{
+				char buf[64];
+				while (sock.recv(buf, sizeof(buf)) > 0)
+					;
+			}
 		};
+#endif // CAGE_SYSTEM_LINUX
+
+		// services all connections accepted by a server from a pool of io threads
+		// the sockets are waited on with epoll (poll elsewhere), and the connections are updated when they received packets or when their timer expires
+		struct Multiplexer : private Immovable
+		{
+			struct TimerWheel
+			{
+				static constexpr uint32 Slots = 256;
+				std::array<std::vector<std::pair<std::shared_ptr<ManagedConnection>, uint64>>, Slots> slots;
+				uint64 granularity = 1000; // microseconds per slot
+				uint64 tick = 0; // last processed tick
+				uint64 entries = 0; // including invalidated
+
+				void schedule(const std::shared_ptr<ManagedConnection> &mc, uint64 time)
+				{
+					const uint64 t = clamp(time / granularity, tick + 1, tick + Slots - 1);
+					mc->scheduledTick = t; // invalidates any previous scheduling of the connection
+					slots[t % Slots].push_back({ mc, t });
+					entries++;
+				}
+
+				template<class F>
+				void advance(uint64 now, F &&expired)
+				{
+					const uint64 target = now / granularity;
+					const uint64 cnt = min(target - min(target, tick), uint64(Slots));
+					for (uint64 i = 1; i <= cnt; i++)
+					{
+						auto &slot = slots[(tick + i) % Slots];
+						for (auto &it : slot)
+							if (it.first->scheduledTick == it.second)
+								expired(it.first);
+						entries -= slot.size();
+						slot.clear();
+					}
+					tick = max(tick, target);
+				}
+
+				// time of the earliest valid entry, invalidated entries are removed on the way
+				uint64 next()
+				{
+					for (uint64 i = 1; i < Slots && entries > 0; i++)
+					{
+						auto &slot = slots[(tick + i) % Slots];
+						entries -= std::erase_if(slot, [](const auto &it) { return it.first->scheduledTick != it.second; });
+						if (!slot.empty())
+							return (tick + i) * granularity;
+					}
+					return m;
+				}
+			};
+
+			const GinnelServerCreateConfig config;
+			std::shared_ptr<SockGroup> sockGroup;
+			Holder<Mutex> mut = newMutex();
+			ankerl::unordered_dense::map<uint64, std::shared_ptr<ManagedConnection>> connections;
+			std::vector<std::shared_ptr<ManagedConnection>> queue; // connections to update now
+			std::vector<std::shared_ptr<ManagedConnection>> ready; // connections with messages for the application
+			TimerWheel wheel;
+			bool acceptPending = false;
+			std::atomic<bool> stopping = false;
+			std::vector<Holder<Thread>> threads;
+#ifdef CAGE_SYSTEM_LINUX
+			int epoll = -1;
+			int wakeEvent = -1; // wakes an io thread
+			int readyEvent = -1; // wakes the application
+#else
+			LoopbackWaker wakeEvent; // wakes io threads
+			LoopbackWaker readyEvent; // wakes the application
+#endif // CAGE_SYSTEM_LINUX
+
+			Multiplexer(const GinnelServerCreateConfig &config, std::shared_ptr<SockGroup> sg) : config(config), sockGroup(sg)
+			{
+				CAGE_ASSERT(config.ioThreads > 0);
+				CAGE_ASSERT(config.activePeriod > 0 && config.idlePeriod >= config.activePeriod);
+				wheel.granularity = max(config.idlePeriod / (TimerWheel::Slots / 2), uint64(1000));
+				wheel.tick = applicationTime() / wheel.granularity;
+				sockGroup->trackTouched = true;
+#ifdef CAGE_SYSTEM_LINUX
+				epoll = epoll_create1(EPOLL_CLOEXEC);
+				if (epoll < 0)
+					CAGE_THROW_ERROR(SystemError, "failed to create epoll", errno);
+				wakeEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+				readyEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+				if (wakeEvent < 0 || readyEvent < 0)
+				{
+					const int err = errno;
+					closeDescriptors();
+					CAGE_THROW_ERROR(SystemError, "failed to create eventfd", err);
+				}
+				for (uint32 i = 0; i < sockGroup->socks.size(); i++)
+					control(EPOLL_CTL_ADD, sockGroup->socks[i].getSocket(), i);
+				control(EPOLL_CTL_ADD, wakeEvent, m);
+#endif // CAGE_SYSTEM_LINUX
+				threads.reserve(config.ioThreads);
+				for (uint32 i = 0; i < config.ioThreads; i++)
+					threads.push_back(newThread(Delegate<void()>().bind<Multiplexer, &Multiplexer::threadEntry>(this), Stringizer() + "ginnel io " + i));
+			}
+
+			~Multiplexer()
+			{
+				stopping = true;
+				wake();
+				threads.clear();
+				closeDescriptors();
+			}
+
+#ifdef CAGE_SYSTEM_LINUX
+			void control(int op, int fd, uint32 index)
+			{
+				epoll_event ev = {};
+				ev.events = EPOLLIN | EPOLLONESHOT; // only one thread handles each readiness
+				ev.data.u32 = index;
+				if (epoll_ctl(epoll, op, fd, &ev) != 0)
+					CAGE_THROW_ERROR(SystemError, "failed to update epoll", errno);
+			}
+
+			static void drain(int fd)
+			{
+				uint64 v = 0;
+				while (::read(fd, &v, sizeof(v)) > 0)
+					;
+			}
+
+			static void signal(int fd)
+			{
+				const uint64 v = 1;
+				[[maybe_unused]] auto r = ::write(fd, &v, sizeof(v));
+			}
+#endif // CAGE_SYSTEM_LINUX
+
+			void closeDescriptors()
+			{
+#ifdef CAGE_SYSTEM_LINUX
+				for (int *fd : { &epoll, &wakeEvent, &readyEvent })
+				{
+					if (*fd >= 0)
+						::close(*fd);
+					*fd = -1;
+				}
+#endif // CAGE_SYSTEM_LINUX
+			}
+
+			void wake()
+			{
+#ifdef CAGE_SYSTEM_LINUX
+				signal(wakeEvent);
+#else
+				wakeEvent.signal();
+#endif // CAGE_SYSTEM_LINUX
+			}
+
+			// requires the mutex
+			bool enqueue(const std::shared_ptr<ManagedConnection> &mc)
+			{
+				if (!mc->registered || mc->queued)
+					return false;
+				mc->queued = true;
+				queue.push_back(mc);
+				return true;
+			}
+
+			void add(const std::shared_ptr<ManagedConnection> &mc)
+			{
+				{
+					ScopeLock lock(mut);
+					mc->registered = true;
+					connections[mc->connId] = mc;
+					enqueue(mc); // process packets received before the registration
+				}
+				wake();
+			}
+
+			void remove(const std::shared_ptr<ManagedConnection> &mc)
+			{
+				ScopeLock lock(mut);
+				mc->registered = false;
+				connections.erase(mc->connId);
+				std::erase(ready, mc);
+				mc->ready = false;
+			}
+
+			void readSockets(std::vector<uint64> &touched)
+			{
+				ScopeLock lock(sockGroup->mut);
+				sockGroup->readAll();
+				std::swap(touched, sockGroup->touched);
+				auto ac = sockGroup->accepting.lock();
+				if (ac && !ac->empty())
+				{
+					{
+						ScopeLock lck(mut);
+						acceptPending = true;
+					}
+					signalReady();
+				}
+			}
+
+			void waitEvents(std::vector<uint64> &touched)
+			{
+				sint32 timeout = -1; // milliseconds, wait indefinitely if there are no timers
+				{
+					ScopeLock lock(mut);
+					const uint64 now = applicationTime();
+					const uint64 next = wheel.next();
+					if (next != m)
+						timeout = numeric_cast<sint32>(next > now ? (next - now + 999) / 1000 : 0);
+				}
+#ifdef CAGE_SYSTEM_LINUX
+				std::array<epoll_event, 8> events;
+				const int cnt = epoll_wait(epoll, events.data(), numeric_cast<int>(events.size()), timeout);
+				if (cnt <= 0)
+					return; // timeout or interrupted
+				std::vector<uint32> fired;
+				for (int i = 0; i < cnt; i++)
+				{
+					const uint32 index = events[i].data.u32;
+					if (index == m)
+					{
+						drain(wakeEvent);
+						control(EPOLL_CTL_MOD, wakeEvent, m);
+					}
+					else
+						fired.push_back(index);
+				}
+				if (fired.empty())
+					return;
+				readSockets(touched);
+				for (uint32 index : fired)
+					control(EPOLL_CTL_MOD, sockGroup->socks[index].getSocket(), index);
+#else
+				std::vector<pollfd> fds;
+				for (const Sock &s : sockGroup->socks)
+					fds.push_back({ s.getSocket(), POLLIN, 0 });
+				fds.push_back({ wakeEvent.sock.getSocket(), POLLIN, 0 });
+				if (WSAPoll(fds.data(), numeric_cast<uint32>(fds.size()), timeout) <= 0)
+					return; // timeout or interrupted
+				if (fds.back().revents)
+					wakeEvent.drain();
+				fds.pop_back();
+				if (std::any_of(fds.begin(), fds.end(), [](const pollfd &p) { return p.revents != 0; }))
+					readSockets(touched);
+#endif // CAGE_SYSTEM_LINUX
+			}
+
+			std::shared_ptr<ManagedConnection> dequeue()
+			{
+				ScopeLock lock(mut);
+				if (queue.empty())
+					return {};
+				std::shared_ptr<ManagedConnection> mc = std::move(queue.back());
+				queue.pop_back();
+				return mc;
+			}
+
+			void service(const std::shared_ptr<ManagedConnection> &mc)
+			{
+				ScopeLock lock(mc->mut);
+				{
+					ScopeLock lck(mut);
+					mc->queued = false; // packets received from now on will schedule another update
+				}
+				GinnelConnectionImpl *c = mc->conn;
+				if (!c || c->disconnected)
+					return;
+				try
+				{
+					c->service();
+				}
+				catch (const Disconnected &e)
+				{
+					c->disconnected = e;
+				}
+				catch (...)
+				{
+					detail::logCurrentCaughtException();
+				}
+				const bool readable = !c->receiving.messages.empty() || c->disconnected;
+				bool notify = false;
+				{
+					ScopeLock lck(mut);
+					if (!c->disconnected)
+						wheel.schedule(mc, applicationTime() + (c->inFlight() ? config.activePeriod : config.idlePeriod));
+					if (readable && !mc->ready)
+					{
+						mc->ready = true;
+						ready.push_back(mc);
+						notify = true;
+					}
+				}
+				if (notify)
+					signalReady();
+			}
+
+			void threadEntry()
+			{
+				std::vector<uint64> touched;
+				while (!stopping)
+				{
+					try
+					{
+						waitEvents(touched);
+					}
+					catch (...)
+					{
+						detail::logCurrentCaughtException();
+					}
+					bool more = false;
+					{
+						ScopeLock lock(mut);
+						for (uint64 id : touched)
+						{
+							auto it = connections.find(id);
+							if (it != connections.end())
+								enqueue(it->second);
+						}
+						wheel.advance(applicationTime(), [&](const std::shared_ptr<ManagedConnection> &mc) { enqueue(mc); });
+						more = queue.size() > 1;
+					}
+					touched.clear();
+					if (more)
+						wake(); // let another thread help
+					while (auto mc = dequeue())
+						service(mc);
+				}
+				wake(); // pass the stopping to another thread
+			}
+
+			void signalReady()
+			{
+#ifdef CAGE_SYSTEM_LINUX
+				signal(readyEvent);
+#else
+				readyEvent.signal();
+#endif // CAGE_SYSTEM_LINUX
+			}
+
+			void waitReady(uint64 timeout)
+			{
+#ifdef CAGE_SYSTEM_LINUX
+				pollfd p = { readyEvent, POLLIN, 0 };
+				if (poll(&p, 1, numeric_cast<int>((timeout + 999) / 1000)) > 0)
+					drain(readyEvent);
+#else
+				pollfd p = { readyEvent.sock.getSocket(), POLLIN, 0 };
+				if (WSAPoll(&p, 1, numeric_cast<int>((timeout + 999) / 1000)) > 0)
+					readyEvent.drain();
+#endif // CAGE_SYSTEM_LINUX
+			}
+
+			Holder<PointerRange<GinnelConnection *>> wait(uint64 timeout)
+			{
+				const uint64 end = applicationTime() + timeout;
+				while (true)
+				{
+					{
+						ScopeLock lock(mut);
+						if (!ready.empty() || acceptPending)
+						{
+							PointerRangeHolder<GinnelConnection *> res;
+							res.reserve(ready.size());
+							for (const auto &mc : ready)
+							{
+								mc->ready = false;
+								res.push_back(mc->conn);
+							}
+							ready.clear();
+							acceptPending = false;
+							return res;
+						}
+					}
+					const uint64 now = applicationTime();
+					if (now >= end)
+						return {};
+					waitReady(end - now);
+				}
+			}
+		};
+
+		void GinnelConnectionImpl::managedRequestService()
+		{
+			CAGE_ASSERT(managed);
+			bool added = false;
+			{
+				ScopeLock lock(multiplexer->mut);
+				added = multiplexer->enqueue(managed);
+			}
+			if (added)
+				multiplexer->wake();
+		}
+
+		void GinnelConnectionImpl::managedUnregister()
+		{
+			if (!managed)
+				return;
+			ScopeLock lock(managed->mut); // waits for io thread to finish updating this connection
+			multiplexer->remove(managed);
+			managed->conn = nullptr;
+		}
 
 		class GinnelServerImpl : public GinnelServer
 		{
 		public:
-			GinnelServerImpl(uint16 port)
+			GinnelServerImpl(const GinnelServerCreateConfig &config) : simulation(config.simulation)
 			{
-				UDP_LOG(1, "creating new server on port " + port);
+				const uint16 port = config.port;
+				UDP_LOG(1, "creating new server on port " + port + ", io threads: " + config.ioThreads);
 				detail::OverrideBreakpoint ob;
 				sockGroup = std::make_shared<SockGroup>();
 				for (AddrList lst(nullptr, port, AF_UNSPEC, SOCK_DGRAM, IPPROTO_UDP, AI_PASSIVE); lst.valid(); lst.next())
@@ -1215,6 +1920,8 @@ namespace cage
 				accepting = std::make_shared<std::vector<std::shared_ptr<SockGroup::Receiver>>>();
 				sockGroup->accepting = accepting;
 				UDP_LOG(2, "listening on " + sockGroup->socks.size() + " sockets");
+				if (config.ioThreads > 0)
+					multiplexer = std::make_shared<Multiplexer>(config, sockGroup);
 			}
 
 			~GinnelServerImpl() { UDP_LOG(2, "destroying server"); }
@@ -1225,7 +1932,8 @@ namespace cage
 				std::shared_ptr<SockGroup::Receiver> acc;
 				{
 					ScopeLock lock(sockGroup->mut);
-					sockGroup->readAll();
+					if (!multiplexer)
+						sockGroup->readAll();
 					if (accepting->empty())
 						return {};
 					acc = accepting->back();
@@ -1233,13 +1941,20 @@ namespace cage
 				}
 				try
 				{
-					auto c = systemMemory().createHolder<GinnelConnectionImpl>(sockGroup, acc);
+					auto c = systemMemory().createHolder<GinnelConnectionImpl>(sockGroup, acc, multiplexer, simulation);
 					c->serviceReceiving();
 					if (!c->established)
 					{
 						UDP_LOG(2, "received packets failed to initialize new connection");
 						return {};
 					}
+					if (multiplexer)
+					{
+						c->managed = std::make_shared<ManagedConnection>();
+						c->managed->conn = +c;
+						c->managed->connId = c->connId;
+						multiplexer->add(c->managed);
+					}
 					return std::move(c).cast<GinnelConnection>();
 				}
 				catch (...)
@@ -1250,6 +1965,8 @@ namespace cage
 
 			std::shared_ptr<SockGroup> sockGroup;
 			std::shared_ptr<std::vector<std::shared_ptr<SockGroup::Receiver>>> accepting;
+			std::shared_ptr<Multiplexer> multiplexer;
+			const GinnelSimulationConfig simulation;
 		};
 	}
 
@@ -1298,6 +2015,11 @@ namespace cage
 	Holder<PointerRange<char>> GinnelConnection::read(uint32 &channel, bool &reliable)
 	{
 		GinnelConnectionImpl *impl = (GinnelConnectionImpl *)this;
+		if (!impl->managed)
+			return impl->read(channel, reliable);
+		ScopeLock lock(impl->managed->mut);
+		if (impl->receiving.messages.empty() && impl->disconnected)
+			throw *impl->disconnected;
 		return impl->read(channel, reliable);
 	}
 
@@ -1313,31 +2035,33 @@ namespace cage
 		GinnelConnectionImpl *impl = (GinnelConnectionImpl *)this;
 		MemoryBuffer b(buffer.size());
 		detail::memcpy(b.data(), buffer.data(), b.size());
-		impl->write(std::move(b), channel, reliable);
+		impl->guarded([&]() { impl->write(std::move(b), channel, reliable); });
+		if (impl->managed)
+			impl->managedRequestService(); // send promptly
 	}
 
 	sint64 GinnelConnection::capacity() const
 	{
 		const GinnelConnectionImpl *impl = (const GinnelConnectionImpl *)this;
-		return impl->writeBandwidth.capacity;
+		return impl->observed([&]() { return impl->writeBandwidth.capacity; });
 	}
 
 	void GinnelConnection::update()
 	{
 		GinnelConnectionImpl *impl = (GinnelConnectionImpl *)this;
-		impl->service();
+		impl->guarded([&]() { impl->service(); });
 	}
 
-	const GinnelStatistics &GinnelConnection::statistics() const
+	GinnelStatistics GinnelConnection::statistics() const
 	{
 		const GinnelConnectionImpl *impl = (const GinnelConnectionImpl *)this;
-		return impl->stats;
+		return impl->observed([&]() { return impl->stats; });
 	}
 
 	bool GinnelConnection::established() const
 	{
 		const GinnelConnectionImpl *impl = (const GinnelConnectionImpl *)this;
-		return impl->established;
+		return impl->observed([&]() { return impl->established; });
 	}
 
 	GinnelRemoteInfo GinnelConnection::remoteInfo() const
@@ -1363,19 +2087,39 @@ namespace cage
 		return impl->accept();
 	}
 
-	Holder<GinnelConnection> newGinnelConnection(const String &address, uint16 port, uint64 timeout)
+	Holder<PointerRange<GinnelConnection *>> GinnelServer::wait(uint64 timeout)
+	{
+		GinnelServerImpl *impl = (GinnelServerImpl *)this;
+		if (!impl->multiplexer)
+			CAGE_THROW_ERROR(Exception, "ginnel server wait requires io threads");
+		return impl->multiplexer->wait(timeout);
+	}
+
+	Holder<GinnelConnection> newGinnelConnection(const String &address, uint16 port, uint64 timeout, const GinnelSimulationConfig &simulation)
 	{
 #ifdef CAGE_SYSTEM_MAC
 		CAGE_LOG(SeverityEnum::Warning, "ginnel", "ginnel on macos might be broken - it is excluded from tests");
 #endif // CAGE_SYSTEM_MAC
-		return systemMemory().createImpl<GinnelConnection, GinnelConnectionImpl>(address, port, timeout);
+		return systemMemory().createImpl<GinnelConnection, GinnelConnectionImpl>(address, port, timeout, simulation);
 	}
 
-	Holder<GinnelServer> newGinnelServer(uint16 port)
+	Holder<GinnelConnection> newGinnelConnection(const String &address, uint16 port, uint64 timeout)
+	{
+		return newGinnelConnection(address, port, timeout, {});
+	}
+
+	Holder<GinnelServer> newGinnelServer(const GinnelServerCreateConfig &config)
 	{
 #ifdef CAGE_SYSTEM_MAC
 		CAGE_LOG(SeverityEnum::Warning, "ginnel", "ginnel on macos might be broken - it is excluded from tests");
 #endif // CAGE_SYSTEM_MAC
-		return systemMemory().createImpl<GinnelServer, GinnelServerImpl>(port);
+		return systemMemory().createImpl<GinnelServer, GinnelServerImpl>(config);
+	}
+
+	Holder<GinnelServer> newGinnelServer(uint16 port)
+	{
+		GinnelServerCreateConfig cfg;
+		cfg.port = port;
+		return newGinnelServer(cfg);
 	}
 }
@@ -268,7 +268,7 @@ namespace cage
 
 		Sock::Sock(int family, int type, int protocol, SOCKET desc, bool connected) : descriptor(desc), family(family), type(type), protocol(protocol), connected(connected) {}
 
-		Sock::Sock(Sock &&other) : descriptor(other.descriptor), family(other.family), type(other.type), protocol(other.protocol), connected(other.connected)
+		Sock::Sock(Sock &&other) : descriptor(other.descriptor), family(other.family), type(other.type), protocol(other.protocol), connected(other.connected), segmentationUnsupported(other.segmentationUnsupported)
 		{
 			other.descriptor = INVALID_SOCKET;
 		}
@@ -284,6 +284,7 @@ namespace cage
 			type = other.type;
 			protocol = other.protocol;
 			connected = other.connected;
+			segmentationUnsupported = other.segmentationUnsupported;
 			other.descriptor = INVALID_SOCKET;
 		}
 
@@ -476,5 +477,156 @@ namespace cage
 			}
 			return rtn;
 		}
+
+		uint32 Sock::recvBatch(PointerRange<Datagram> datagrams)
+		{
+			CAGE_ASSERT(datagrams.size() <= MaxBatchDatagrams);
+#ifdef CAGE_SYSTEM_LINUX
+			std::array<mmsghdr, MaxBatchDatagrams> msgs = {};
+			std::array<iovec, MaxBatchDatagrams> iovs = {};
+			const uint32 cnt = numeric_cast<uint32>(datagrams.size());
+			for (uint32 i = 0; i < cnt; i++)
+			{
+				Datagram &d = datagrams[i];
+				iovs[i].iov_base = d.buffer.data();
+				iovs[i].iov_len = d.buffer.size();
+				msgs[i].msg_hdr.msg_iov = &iovs[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+				msgs[i].msg_hdr.msg_name = &d.address.storage;
+				msgs[i].msg_hdr.msg_namelen = sizeof(d.address.storage);
+			}
+			const int rtn = ::recvmmsg(descriptor, msgs.data(), cnt, MSG_DONTWAIT, nullptr);
+			if (rtn < 0)
+			{
+				int err = WSAGetLastError();
+				if (err != WSAEWOULDBLOCK && (err != WSAECONNRESET || protocol != IPPROTO_UDP))
+					CAGE_THROW_ERROR(SystemError, "received failed (recvmmsg)", err);
+				return 0;
+			}
+			for (uint32 i = 0; i < (uint32)rtn; i++)
+			{
+				Datagram &d = datagrams[i];
+				d.size = msgs[i].msg_len;
+				d.address.addrlen = msgs[i].msg_hdr.msg_namelen;
+				d.truncated = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+			}
+			return rtn;
+#else
+			uint32 cnt = 0;
+			for (Datagram &d : datagrams)
+			{
+				d.size = recvFrom(d.buffer.data(), d.buffer.size(), d.address);
+				d.truncated = false;
+				if (d.size == 0)
+					break;
+				cnt++;
+			}
+			return cnt;
+#endif // CAGE_SYSTEM_LINUX
+		}
+
+		void Sock::sendBatch(PointerRange<const PointerRange<const char>> datagrams, const Addr *remoteAddress)
+		{
+			CAGE_ASSERT(connected == !remoteAddress);
+			CAGE_ASSERT(!remoteAddress || remoteAddress->getFamily() == family);
+			while (!datagrams.empty())
+			{
+				const uintPtr cnt = std::min(datagrams.size(), (uintPtr)MaxBatchDatagrams);
+				sendBatchImpl({ datagrams.begin(), datagrams.begin() + cnt }, remoteAddress);
+				datagrams = { datagrams.begin() + cnt, datagrams.end() };
+			}
+		}
+
+		void Sock::sendBatchImpl(PointerRange<const PointerRange<const char>> datagrams, const Addr *remoteAddress)
+		{
+			CAGE_ASSERT(datagrams.size() <= MaxBatchDatagrams);
+#ifdef CAGE_SYSTEM_LINUX
+			union Control
+			{
+				char buf[CMSG_SPACE(sizeof(uint16))];
+				cmsghdr align;
+			};
+			std::array<mmsghdr, MaxBatchDatagrams> msgs = {};
+			std::array<iovec, MaxBatchDatagrams> iovs = {};
+			std::array<Control, MaxBatchDatagrams> controls = {};
+			std::array<uint32, MaxBatchDatagrams> firsts = {}; // index of first datagram of each message
+			const uint32 total = numeric_cast<uint32>(datagrams.size());
+			for (uint32 i = 0; i < total; i++)
+			{
+				iovs[i].iov_base = (void *)datagrams[i].data();
+				iovs[i].iov_len = datagrams[i].size();
+			}
+
+			uint32 cnt = 0;
+			for (uint32 i = 0; i < total;)
+			{
+				// find a run of datagrams that can be sent as single segmented message - all of the same size, except the last one, which may be smaller
+				uint32 j = i + 1;
+	#ifdef UDP_SEGMENT
+				if (!segmentationUnsupported)
+				{
+					const uintPtr seg = datagrams[i].size();
+					uintPtr sum = seg;
+					while (j < total && sum + datagrams[j].size() <= 65000 && datagrams[j].size() <= seg && seg > 0)
+					{
+						sum += datagrams[j].size();
+						if (datagrams[j++].size() < seg)
+							break;
+					}
+				}
+	#endif // UDP_SEGMENT
+				mmsghdr &m = msgs[cnt];
+				if (remoteAddress)
+				{
+					m.msg_hdr.msg_name = (void *)&remoteAddress->storage;
+					m.msg_hdr.msg_namelen = remoteAddress->addrlen;
+				}
+				m.msg_hdr.msg_iov = &iovs[i];
+				m.msg_hdr.msg_iovlen = j - i;
+	#ifdef UDP_SEGMENT
+				if (j - i > 1)
+				{
+					m.msg_hdr.msg_control = controls[cnt].buf;
+					m.msg_hdr.msg_controllen = sizeof(controls[cnt].buf);
+					cmsghdr *c = CMSG_FIRSTHDR(&m.msg_hdr);
+					c->cmsg_level = SOL_UDP;
+					c->cmsg_type = UDP_SEGMENT;
+					c->cmsg_len = CMSG_LEN(sizeof(uint16));
+					const uint16 seg = numeric_cast<uint16>(datagrams[i].size());
+					detail::memcpy(CMSG_DATA(c), &seg, sizeof(seg));
+				}
+	#endif // UDP_SEGMENT
+				firsts[cnt++] = i;
+				i = j;
+			}
+
+			uint32 sent = 0;
+			while (sent < cnt)
+			{
+				const int rtn = ::sendmmsg(descriptor, msgs.data() + sent, cnt - sent, MSG_NOSIGNAL);
+				if (rtn < 0)
+				{
+					const int err = WSAGetLastError();
+					if (msgs[sent].msg_hdr.msg_iovlen > 1 && (err == EIO || err == EINVAL || err == ENOPROTOOPT || err == EOPNOTSUPP))
+					{
+						// the segmentation offload is not available (eg. old kernel or the device does not support it)
+						segmentationUnsupported = true;
+						sendBatchImpl({ datagrams.begin() + firsts[sent], datagrams.end() }, remoteAddress);
+						return;
+					}
+					CAGE_THROW_ERROR(SystemError, "send failed (sendmmsg)", err);
+				}
+				sent += rtn;
+			}
+#else
+			for (const PointerRange<const char> &d : datagrams)
+			{
+				if (remoteAddress)
+					sendTo(d.data(), d.size(), *remoteAddress);
+				else
+					send(d.data(), d.size());
+			}
+#endif // CAGE_SYSTEM_LINUX
+		}
 	}
 }
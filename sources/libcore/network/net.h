@@ -21,6 +21,7 @@ typedef char raw_type;
 	#include <fcntl.h>
 	#include <netdb.h>
 	#include <netinet/in.h>
+	#include <netinet/udp.h>
 	#include <poll.h>
 	#include <sys/ioctl.h>
 	#include <sys/socket.h>
@@ -67,6 +68,9 @@ namespace cage
 		struct Sock;
 		struct AddrList;
 
+		// maximum number of datagrams transferred in single batch (system call)
+		constexpr uint32 MaxBatchDatagrams = 64;
+
 		struct Addr
 		{
 			Addr() = default;
@@ -160,6 +164,17 @@ namespace cage
 			uintPtr recv(void *buffer, uintPtr bufferSize, int flags = 0);
 			uintPtr recvFrom(void *buffer, uintPtr bufferSize, Addr &remoteAddress, int flags = 0);
 
+			// batched datagrams (uses recvmmsg/sendmmsg and udp segmentation offload where available)
+			struct Datagram
+			{
+				PointerRange<char> buffer; // capacity
+				uintPtr size = 0; // received bytes
+				Addr address;
+				bool truncated = false; // the datagram did not fit into the buffer
+			};
+			uint32 recvBatch(PointerRange<Datagram> datagrams); // returns number of received datagrams
+			void sendBatch(PointerRange<const PointerRange<const char>> datagrams, const Addr *remoteAddress = nullptr); // remoteAddress is required for unconnected socket
+
 			bool operator<(const Sock &other) const // fast comparison
 			{
 				return descriptor < other.descriptor;
@@ -175,6 +190,9 @@ namespace cage
 			SOCKET descriptor = INVALID_SOCKET;
 			int family = -1, type = -1, protocol = -1;
 			bool connected = false;
+			bool segmentationUnsupported = false;
+
+			void sendBatchImpl(PointerRange<const PointerRange<const char>> datagrams, const Addr *remoteAddress);
 		};
 	}
 }
@@ -1,6 +1,8 @@
 #ifdef CAGE_PROFILING_ENABLED
 
 	#include <atomic>
+	#include <chrono>
+	#include <semaphore>
 	#include <string>
 	#include <unordered_map>
 	#include <vector>
@@ -15,7 +17,6 @@
 	#include <cage-core/process.h>
 	#include <cage-core/profiling.h>
 	#include <cage-core/stdHash.h>
-	#include <cage-core/ringBuffer.h>
 
 cage::PointerRange<const cage::uint8> profiling_html();
 
@@ -50,10 +51,9 @@ namespace cage
 
 	namespace
 	{
-		constexpr uint64 ThreadNameSpecifier = (uint64)-2;
-
 		ConfigBool confEnabled("cage/profiling/enabled", false);
 		const ConfigBool confAutoStartClient("cage/profiling/autoStartClient", true);
+		const ConfigUint32 confQueueCapacity("cage/profiling/queueCapacity", 8192); // events are dropped when the queue is full, each event takes about 1 KB
 
 		uint64 timestamp() noexcept
 		{
@@ -86,14 +86,45 @@ namespace cage
 			bool framing = false;
 		};
 
-		using QueueType = ConcurrentQueue<QueueItem, RingBuffer>;
+		using QueueType = ConcurrentBoundedQueue<QueueItem>;
 
 		QueueType &queue()
 		{
-			static QueueType *q = new QueueType(); // intentional memory leak
+			static QueueType *q = new QueueType(max((uint32)confQueueCapacity, 1024u)); // intentional memory leak
 			return *q;
 		}
 
+		// thread names are kept outside of the queue so that they are never dropped
+		struct ThreadNames : private Immovable
+		{
+			Holder<Mutex> mutex = newMutex();
+			std::unordered_map<uint64, String> names;
+		};
+
+		ThreadNames &threadNames()
+		{
+			static ThreadNames *n = new ThreadNames(); // intentional memory leak
+			return *n;
+		}
+
+		std::atomic<uint64> droppedEvents = 0;
+		std::atomic<bool> wakeRequested = false;
+
+		std::counting_semaphore<> &wakeSemaphore()
+		{
+			static std::counting_semaphore<> *s = new std::counting_semaphore<>(0); // intentional memory leak
+			return *s;
+		}
+
+		// never blocks the producer, the event is dropped when the queue is full
+		void enqueue(QueueItem &&qi)
+		{
+			if (!queue().tryPush(std::move(qi)))
+				droppedEvents++;
+			if (queue().estimatedSize() >= queue().capacity() / 2 && !wakeRequested.exchange(true))
+				wakeSemaphore().release();
+		}
+
 		constexpr String sanitize(const String &s)
 		{
 			String r;
@@ -118,7 +149,6 @@ namespace cage
 		private:
 			struct Runner : private Immovable
 			{
-				std::unordered_map<uint64, String> threadNames;
 				Holder<Provider> provider;
 				Holder<WebsocketServer> server;
 				Holder<WebsocketConnection> connection;
@@ -127,10 +157,7 @@ namespace cage
 				{
 					QueueItem qi;
 					while (queue().tryPop(qi))
-					{
-						if (qi.startTime == ThreadNameSpecifier && qi.endTime == ThreadNameSpecifier)
-							threadNames[qi.threadId] = sanitize(qi.data);
-					}
+						;
 				}
 
 				void updateConnected()
@@ -178,18 +205,19 @@ namespace cage
 					QueueItem qi;
 					while (queue().tryPop(qi))
 					{
-						if (qi.startTime == ThreadNameSpecifier && qi.endTime == ThreadNameSpecifier)
-							threadNames[qi.threadId] = sanitize(qi.data);
-						else
-						{
-							const String s = Stringizer() + "[" + names.index(qi.name) + ",\"" + sanitize(qi.data) + "\"," + qi.startTime + "," + (qi.endTime - qi.startTime) + (qi.framing ? ",1" : "") + "], ";
-							data[qi.threadId].events += s.c_str();
-						}
+						const String s = Stringizer() + "[" + names.index(qi.name) + ",\"" + sanitize(qi.data) + "\"," + qi.startTime + "," + (qi.endTime - qi.startTime) + (qi.framing ? ",1" : "") + "], ";
+						data[qi.threadId].events += s.c_str();
 					}
 
 					std::string str = "{\"names\":[";
 					str += names.mapping();
 					str += "],\n\"threads\":{\n";
+					std::unordered_map<uint64, String> threads;
+					{
+						ThreadNames &tn = threadNames();
+						ScopeLock lock(tn.mutex);
+						threads = tn.names;
+					}
 					bool comma = false;
 					for (const auto &thr : data)
 					{
@@ -199,7 +227,7 @@ namespace cage
 							comma = true;
 						str += (Stringizer() + "\"" + thr.first + "\":").value.c_str();
 						str += "{\n\"name\":\"";
-						str += threadNames[thr.first].c_str();
+						str += sanitize(threads[thr.first]).c_str();
 						str += "\",\n\"events\":[";
 						str += thr.second.events;
 						str += "[]\n]}\n";
@@ -272,7 +300,11 @@ namespace cage
 							}
 							else
 								updateDisabled();
-							threadSleep(100'000);
+							if (const uint64 d = droppedEvents.exchange(0))
+								CAGE_LOG(SeverityEnum::Warning, "profiling", Stringizer() + "dropped profiling events: " + d);
+							// wake up early if the queue is filling up
+							(void)wakeSemaphore().try_acquire_for(std::chrono::milliseconds(100));
+							wakeRequested = false;
 						}
 						catch (...)
 						{
@@ -300,6 +332,7 @@ namespace cage
 			~Dispatcher()
 			{
 				queue().terminate();
+				wakeSemaphore().release();
 				try
 				{
 					if (thread)
@@ -326,11 +359,9 @@ namespace cage
 		{
 			try
 			{
-				QueueItem qi;
-				qi.data = currentThreadName();
-				qi.threadId = currentThreadId();
-				qi.startTime = qi.endTime = ThreadNameSpecifier;
-				queue().push(qi);
+				ThreadNames &tn = threadNames();
+				ScopeLock lock(tn.mutex);
+				tn.names[currentThreadId()] = currentThreadName();
 			}
 			catch (...)
 			{
@@ -378,7 +409,7 @@ namespace cage
 			qi.endTime = timestamp();
 			qi.threadId = currentThreadId();
 			qi.framing = ev.framing;
-			queue().push(qi);
+			enqueue(std::move(qi));
 		}
 		catch (...)
 		{
@@ -403,7 +434,7 @@ namespace cage
 			qi.endTime = ev.startTime + duration;
 			qi.threadId = 0;
 			qi.framing = ev.framing;
-			queue().push(qi);
+			enqueue(std::move(qi));
 		}
 		catch (...)
 		{
@@ -28,21 +28,33 @@ namespace cage
 		}
 	}
 
+	namespace
+	{
+		// approximate vertical size of the object on screen, in pixels
+		Real projectedSize(const LodSelection &lod, const Vec3 position, const RenderObject *object)
+		{
+			Real d = 1;
+			if (!lod.orthographic)
+				d = distance(position, lod.center);
+			return lod.screenSize * object->worldSize / d;
+		}
+	}
+
 	uint32 LodSelection::selectLod(const Vec3 position, const RenderObject *object) const
 	{
 		CAGE_ASSERT(object->lodsCount() > 0);
 		uint32 preferredLod = 0;
 		if (object->lodsCount() > 1)
-		{
-			Real d = 1;
-			if (!orthographic)
-				d = distance(position, center);
-			const Real f = screenSize * object->worldSize / (d * object->pixelsSize);
-			preferredLod = object->lodSelect(f);
-		}
+			preferredLod = object->lodSelect(projectedSize(*this, position, object) / object->pixelsSize);
 		return preferredLod;
 	}
 
+	sint32 LodSelection::loadPriority(const Vec3 position, const RenderObject *object, bool fallbackAvailable) const
+	{
+		const sint32 p = numeric_cast<sint32>(clamp(log2(max(projectedSize(*this, position, object), 1)), 0, 30).value);
+		return fallbackAvailable ? p - 31 : p;
+	}
+
 	void LodSelection::selectModels(std::vector<Holder<Model>> &outModels, const Vec3 position, const RenderObject *object, AssetsOnDemand *assets) const
 	{
 		CAGE_ASSERT(center.valid());
@@ -50,29 +62,34 @@ namespace cage
 
 		const uint32 preferredLod = selectLod(position, object);
 
-		// try load the preferred lod
+		// try acquire the preferred lod
 		bool ok = true;
-		const auto &fetch = [&](uint32 lod, bool load)
+		const auto &fetch = [&](uint32 lod)
 		{
 			outModels.clear();
 			ok = true;
 			for (uint32 it : object->models(lod))
 			{
-				if (auto md = assets->get<AssetSchemeIndexModel, Model>(it, load))
+				if (auto md = assets->get<AssetSchemeIndexModel, Model>(it, false))
 					outModels.push_back(std::move(md));
 				else
 					ok = false;
 			}
 		};
-		fetch(preferredLod, true);
+		fetch(preferredLod);
+		if (ok)
+			return;
 
 		// try acquire one level coarser
 		if (!ok && preferredLod + 1 < object->lodsCount())
-			fetch(preferredLod + 1, false);
+			fetch(preferredLod + 1);
 
 		// try acquire one level finer
 		if (!ok && preferredLod > 0)
-			fetch(preferredLod - 1, false);
+			fetch(preferredLod - 1);
+
+		// load the preferred lod, objects with nothing to show are loaded first
+		assets->preload(object->models(preferredLod), loadPriority(position, object, ok));
 	}
 
 	void LodSelection::selectModels(std::vector<Holder<Model>> &outModels, const Vec3 position, const RenderObject *object, const AssetsManager *assets) const
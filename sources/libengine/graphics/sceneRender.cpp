@@ -11,16 +11,19 @@
 #include <cage-core/assetsSchemes.h>
 #include <cage-core/camera.h>
 #include <cage-core/color.h>
+#include <cage-core/concurrent.h>
 #include <cage-core/config.h>
 #include <cage-core/entitiesVisitor.h>
 #include <cage-core/geometry.h>
 #include <cage-core/hashString.h>
+#include <cage-core/memoryAllocators.h>
 #include <cage-core/meshIoCommon.h>
 #include <cage-core/pointerRangeHolder.h>
 #include <cage-core/profiling.h>
 #include <cage-core/scopeGuard.h>
 #include <cage-core/skeletalAnimation.h>
 #include <cage-core/skeletalAnimationPreparator.h>
+#include <cage-core/spatialStructure.h>
 #include <cage-core/stdHash.h>
 #include <cage-core/tasks.h>
 #include <cage-core/texts.h>
@@ -348,25 +351,80 @@ namespace cage
 			Color,
 		};
 
+		// linear arenas for temporary data of one frame, reused across frames
+		// each arena is used by one thread at a time and is flushed when returned to the pool
+		struct FrameArenasPool : private Immovable
+		{
+			Holder<Mutex> mutex = newMutex();
+			std::vector<Holder<MemoryArena>> arenas;
+
+			static FrameArenasPool &instance()
+			{
+				static FrameArenasPool pool;
+				return pool;
+			}
+		};
+
+		struct FrameArena : private Noncopyable
+		{
+			Holder<MemoryArena> arena;
+
+			FrameArena()
+			{
+				FrameArenasPool &pool = FrameArenasPool::instance();
+				{
+					ScopeLock lock(pool.mutex);
+					if (!pool.arenas.empty())
+					{
+						arena = std::move(pool.arenas.back());
+						pool.arenas.pop_back();
+						return;
+					}
+				}
+				arena = newMemoryAllocatorLinear({ .blockSize = 256 * 1024, .ignoreDeallocations = true });
+			}
+
+			FrameArena(FrameArena &&) = default;
+
+			~FrameArena()
+			{
+				if (!arena)
+					return;
+				arena->flush();
+				FrameArenasPool &pool = FrameArenasPool::instance();
+				ScopeLock lock(pool.mutex);
+				pool.arenas.push_back(std::move(arena));
+			}
+
+			template<class T>
+			CAGE_FORCE_INLINE MemoryAllocatorStd<T> allocator() const
+			{
+				return MemoryAllocatorStd<T>(*arena);
+			}
+		};
+
+		template<class T>
+		using FrameVector = std::vector<T, MemoryAllocatorStd<T>>;
+
 		std::atomic<uintPtr> ItemsContainerReservation = 0;
 
 		// container with stable pointers to items
 		// never realocates
 		// voids inserted items when full
 		template<class T>
-		struct ItemsContainer : private std::vector<T>, Immovable
+		struct ItemsContainer : private FrameVector<T>, Immovable
 		{
-			ItemsContainer() { reserve(ItemsContainerReservation); }
+			explicit ItemsContainer(const FrameArena &arena) : FrameVector<T>(arena.allocator<T>()) { reserve(ItemsContainerReservation); }
 
 			~ItemsContainer() { ItemsContainerReservation = std::max((uintPtr)ItemsContainerReservation, (uintPtr)capacity()); }
 
-			using typename std::vector<T>::value_type;
-			using std::vector<T>::operator[];
-			using std::vector<T>::begin;
-			using std::vector<T>::end;
-			using std::vector<T>::data;
-			using std::vector<T>::size;
-			using std::vector<T>::capacity;
+			using typename FrameVector<T>::value_type;
+			using FrameVector<T>::operator[];
+			using FrameVector<T>::begin;
+			using FrameVector<T>::end;
+			using FrameVector<T>::data;
+			using FrameVector<T>::size;
+			using FrameVector<T>::capacity;
 
 			template<class U>
 			CAGE_FORCE_INLINE T *push_back(U &&v)
@@ -376,14 +434,14 @@ namespace cage
 					ItemsContainerReservation++;
 					return nullptr;
 				}
-				std::vector<T>::push_back(std::forward<U>(v));
-				return &std::vector<T>::back();
+				FrameVector<T>::push_back(std::forward<U>(v));
+				return &FrameVector<T>::back();
 			}
 
 			CAGE_FORCE_INLINE void reserve(uintPtr v)
 			{
-				if (std::vector<T>::empty() && v > capacity())
-					std::vector<T>::reserve(v);
+				if (FrameVector<T>::empty() && v > capacity())
+					FrameVector<T>::reserve(v);
 			}
 
 			template<class Tst>
@@ -474,7 +532,7 @@ namespace cage
 			return uni;
 		}
 
-		void filterLightsOverLimit(std::vector<UniLight> &lights, uint32 limit)
+		void filterLightsOverLimit(FrameVector<UniLight> &lights, uint32 limit)
 		{
 			std::sort(lights.begin(), lights.end(), [&](const UniLight &a, const UniLight &b) { return std::pair(a.direction[3], a.position[3]) > std::pair(b.direction[3], b.position[3]); });
 			if (lights.size() > limit)
@@ -631,9 +689,61 @@ namespace cage
 
 		struct RenderBaseBase;
 
+		struct PreparedItem
+		{
+			SceneItem item;
+			RenderBaseBase *target = nullptr; // nullptr to distribute to all renderers
+			uint32 sceneMask = 0;
+		};
+
+		// infinite or invalid (nan) boxes cannot be inserted into the spatial structure
+		CAGE_FORCE_INLINE bool cullable(const Aabb &box)
+		{
+			if (!box.valid())
+				return false;
+			for (uint32 i = 0; i < 3; i++)
+				if (!box.a[i].finite() || !box.b[i].finite())
+					return false;
+			return true;
+		}
+
+		struct ItemDistribution
+		{
+			const RenderBaseBase *target = nullptr;
+			uint32 sceneMask = 0;
+		};
+
+		// items and assets prepared by one task, merged into the scene afterwards
+		struct PrepareBuffer
+		{
+			FrameArena frameArena;
+			FrameVector<PreparedItem> items{ frameArena.allocator<PreparedItem>() };
+			std::vector<Holder<void>> assets;
+			RenderBaseBase *target = nullptr;
+
+			// temporary caches
+			std::vector<Holder<Model>> modelsHolders;
+
+			template<class T>
+			CAGE_FORCE_INLINE T *shareAsset(Holder<T> &&asset)
+			{
+				T *ret = +asset;
+				if (asset)
+					assets.push_back(std::move(asset).template cast<void>());
+				return ret;
+			}
+
+			CAGE_FORCE_INLINE void distribute(SceneItem &&item)
+			{
+				const uint32 msk = item.e->getOrDefault<SceneComponent>().sceneMask;
+				items.push_back({ std::move(item), target, msk });
+			}
+		};
+
 		struct SceneImpl : private Immovable
 		{
 			const SceneRenderConfig &config;
+			FrameArena frameArena;
 
 			Model *modelSquare = nullptr, *modelBone = nullptr, *modelSprite = nullptr;
 			Shader *shaderBlitPixels = nullptr, *shaderBlitScaled = nullptr;
@@ -645,15 +755,15 @@ namespace cage
 			ankerl::unordered_dense::set<Holder<void>> sharedAssetsCache;
 			Holder<SkeletalAnimationPreparatorCollection> skeletonPreparatorCollection;
 			std::vector<Holder<RenderBaseBase>> renderers;
-			ItemsContainer<SceneItem> items; // ensure that this does not reallocate once
-			RenderBaseBase *distOverride = nullptr;
+			ItemsContainer<SceneItem> items{ frameArena }; // ensure that this does not reallocate once
+			FrameVector<ItemDistribution> distribution{ frameArena.allocator<ItemDistribution>() }; // one for each item, models are given to renderers after culling
+			std::vector<PrepareBuffer> prepareBuffers; // one for each task of the parallel prepare
+			Holder<SpatialStructure> cullingStructure; // bounding boxes of models, named by index into items
+			Holder<SpatialQuery> cullingQuery;
+			FrameVector<uint32> unboundedModels{ frameArena.allocator<uint32>() }; // models that cannot be culled (e.g. meshes with noCulling have universe bounding box), visible in all renderers
 			const bool cnfRenderMissingModels = confGlobalRenderMissingModels;
 			const bool cnfRenderSkeletonBones = confGlobalRenderSkeletonBones;
 
-			// temporary caches
-			std::vector<Model *> prepareModelsRaw;
-			std::vector<Holder<Model>> prepareModelsHolders;
-
 			SceneImpl(const SceneRenderConfig &config) : config(config)
 			{
 				transformComponent = config.shared.scene->component<TransformComponent>();
@@ -702,7 +812,7 @@ namespace cage
 				CAGE_ASSERT(shaderText);
 			}
 
-			void prepareModelBones(const SceneItem &rd)
+			void prepareModelBones(PrepareBuffer &buf, const SceneItem &rd)
 			{
 				const SceneModel &rm = rd.data.model();
 				CAGE_ASSERT(rm.mesh);
@@ -721,11 +831,11 @@ namespace cage
 					SceneModel r;
 					r.mesh = modelBone;
 					d.data.assign(std::move(r));
-					distribute(std::move(d));
+					buf.distribute(std::move(d));
 				}
 			}
 
-			Holder<SkeletalAnimationPreparatorInstance> prepareSkeleton(void *object, const uint64 startTime, const SkeletalAnimationComponent &ps, const Model *mesh)
+			Holder<SkeletalAnimationPreparatorInstance> prepareSkeleton(PrepareBuffer &buf, void *object, const uint64 startTime, const SkeletalAnimationComponent &ps, const Model *mesh)
 			{
 				static_assert(std::extent_v<decltype(SkeletalAnimationPreparatorConfig::animations)> == std::extent_v<decltype(SkeletalAnimationComponent::animations)>);
 				static_assert(decltype(SkeletalAnimationLayer::maskName)::MaxLength == SkeletalAnimationMaskLabel::MaxLength);
@@ -738,7 +848,7 @@ namespace cage
 					auto &output = cnf.animations[i];
 					if (!input.animation)
 						continue;
-					output.animation = shareAsset(config.shared.assets->get<AssetSchemeIndexSkeletalAnimation, SkeletalAnimation>(input.animation));
+					output.animation = buf.shareAsset(config.shared.assets->get<AssetSchemeIndexSkeletalAnimation, SkeletalAnimation>(input.animation));
 					if (!output.animation)
 						return {};
 					CAGE_ASSERT(output.animation->bonesCount() == mesh->bonesCount);
@@ -749,7 +859,7 @@ namespace cage
 					if (!input.maskName.empty())
 					{
 						if (!skeleton)
-							skeleton = shareAsset(config.shared.assets->get<AssetSchemeIndexSkeletonRig, SkeletonRig>(output.animation->skeletonName));
+							skeleton = buf.shareAsset(config.shared.assets->get<AssetSchemeIndexSkeletonRig, SkeletonRig>(output.animation->skeletonName));
 						CAGE_ASSERT(skeleton);
 						output.mask = skeleton->namedMask(input.maskName);
 					}
@@ -776,7 +886,7 @@ namespace cage
 				return skeletonPreparatorCollection->create(std::move(cnf));
 			}
 
-			void prepareModel(SceneItem &rd, const RenderObject *parent = {})
+			void prepareModel(PrepareBuffer &buf, SceneItem &rd, const RenderObject *parent = {})
 			{
 				SceneModel &rm = rd.data.model();
 				CAGE_ASSERT(rm.mesh);
@@ -805,7 +915,7 @@ namespace cage
 					ps.reset();
 				if (ps)
 				{
-					rm.skeletalAnimation = prepareSkeleton(rd.e, startTime, *ps, rm.mesh);
+					rm.skeletalAnimation = prepareSkeleton(buf, rd.e, startTime, *ps, rm.mesh);
 					if (!rm.skeletalAnimation)
 						ps.reset();
 				}
@@ -819,12 +929,12 @@ namespace cage
 				rd.orderDependent &= none(rm.mesh->renderFlags & MeshRenderFlags::OrderIndependent);
 
 				if (rm.skeletalAnimation && cnfRenderSkeletonBones)
-					prepareModelBones(rd);
+					prepareModelBones(buf, rd);
 				else
-					distribute(std::move(rd));
+					buf.distribute(std::move(rd));
 			}
 
-			void prepareSprite(Entity *e, Texture *tex, Model *mesh)
+			void prepareSprite(PrepareBuffer &buf, Entity *e, Texture *tex, Model *mesh)
 			{
 				const SpriteComponent &ic = e->value<SpriteComponent>();
 				SceneSprite ri;
@@ -843,17 +953,17 @@ namespace cage
 				rd.orderDependent = rd.blending = any(ri.mesh->renderFlags & (MeshRenderFlags::Transparent | MeshRenderFlags::Fade)) || rd.color[3] < 1;
 				rd.orderDependent &= none(ri.mesh->renderFlags & MeshRenderFlags::OrderIndependent);
 				rd.data.assign(std::move(ri));
-				distribute(std::move(rd));
+				buf.distribute(std::move(rd));
 			}
 
-			void prepareText(Entity *e, TextComponent tc)
+			void prepareText(PrepareBuffer &buf, Entity *e, TextComponent tc)
 			{
 				if (!tc.fontId)
 					tc.fontId = detail::GuiTextFontDefault;
 				if (!tc.fontId)
 					tc.fontId = HashString("cage/fonts/ubuntu/regular.ttf");
 				SceneText rt;
-				rt.font = shareAsset(config.shared.assets->get<AssetSchemeIndexFont, Font>(tc.fontId));
+				rt.font = buf.shareAsset(config.shared.assets->get<AssetSchemeIndexFont, Font>(tc.fontId));
 				if (!rt.font)
 					return;
 				FontFormat format;
@@ -873,10 +983,10 @@ namespace cage
 				rd.orderDependent = true;
 				rd.blending = true;
 				rd.data.assign(std::move(rt));
-				distribute(std::move(rd));
+				buf.distribute(std::move(rd));
 			}
 
-			void prepareCustomDraw(Entity *e, const CustomDrawComponent &cdc)
+			void prepareCustomDraw(PrepareBuffer &buf, Entity *e, const CustomDrawComponent &cdc)
 			{
 				CAGE_ASSERT(cdc.callback);
 				SceneCustom rc;
@@ -889,17 +999,60 @@ namespace cage
 				rd.orderDependent = true;
 				rd.blending = false;
 				rd.data.assign(std::move(rc));
-				distribute(std::move(rd));
+				buf.distribute(std::move(rd));
+			}
+
+			// invokes the function for each input item on multiple threads, each task writes into its own prepare buffer
+			template<class T, class Function>
+			void prepareParallel(PointerRange<T> input, const Function &function)
+			{
+				struct Job
+				{
+					SceneImpl *scene = nullptr;
+					const Function &function;
+					PointerRange<T> input;
+					uint32 groups = 0;
+
+					void operator()(uint32 idx)
+					{
+						PrepareBuffer &buf = scene->prepareBuffers[idx];
+						const auto r = tasksSplit(idx, groups, numeric_cast<uint32>(input.size()));
+						for (uint32 i = r.first; i < r.second; i++)
+							function(buf, input[i]);
+					}
+				};
+
+				static constexpr uint32 MinGroupSize = 64;
+				const uint32 groups = std::min(numeric_cast<uint32>((input.size() + MinGroupSize - 1) / MinGroupSize), processorsCount() * 4);
+				if (groups == 0)
+					return;
+				if (prepareBuffers.size() < groups)
+					prepareBuffers.resize(groups);
+				Job job{ this, function, input, groups };
+				if (groups == 1)
+					job(0);
+				else
+					tasksRunBlocking<Job>("prepare entities", job, groups);
 			}
 
 			void prepareEntitiesModels()
 			{
 				ProfilingScope profiling("models");
 
+				// assets are resolved once per unique model id, the entities are prepared in parallel
+				struct Group
+				{
+					std::vector<Model *> meshes;
+					RenderObject *object = nullptr; // parent for objects with single lod, or the object for lods selection
+					bool lods = false;
+				};
+				std::vector<Group> groups;
+
 				struct Data
 				{
 					Entity *e = nullptr;
 					uint32 id = 0;
+					uint32 group = m;
 				};
 				std::vector<Data> data;
 				data.reserve(config.shared.scene->component<ModelComponent>()->count());
@@ -916,80 +1069,73 @@ namespace cage
 				std::sort(data.begin(), data.end(), [](const Data &a, const Data &b) { return a.id < b.id; });
 
 				const auto &mark = [](const Data &data) { return data.id; };
-				const auto &output = [&](PointerRange<const Data> data)
+				const auto &output = [&](PointerRange<Data> data)
 				{
 					CAGE_ASSERT(data.size() > 0);
+					Group g;
 
 					if (Holder<RenderObject> obj = config.shared.assets->get<AssetSchemeIndexRenderObject, RenderObject>(data[0].id))
 					{
 						CAGE_ASSERT(obj->lodsCount() > 0);
 						if (obj->lodsCount() == 1)
 						{
-							prepareModelsRaw.clear();
 							for (uint32 id : obj->models(0))
 							{
 								if (Model *mesh = shareAsset(config.shared.onDemand->get<AssetSchemeIndexModel, Model>(id)))
-									prepareModelsRaw.push_back(std::move(mesh));
+									g.meshes.push_back(mesh);
 							}
-							if (prepareModelsRaw.empty())
+							if (g.meshes.empty())
 								return;
-							for (const auto &it : data)
-							{
-								const Transform tr = modelTransform(it.e);
-								for (const auto &mesh : prepareModelsRaw)
-								{
-									SceneModel rm;
-									rm.mesh = mesh;
-									SceneItem rd;
-									rd.e = it.e;
-									rd.transform = tr;
-									rd.data.assign(std::move(rm));
-									prepareModel(rd, +obj);
-								}
-							}
-							return;
 						}
-
-						// we must direct the objects individually into all cameras/shadowmaps
-						RenderObject *o = shareAsset(std::move(obj));
-						for (const auto &it : data)
-							prepareEntitiesModelsLod(it.e, o);
-						return;
-					}
-
-					if (Model *mesh = shareAsset(config.shared.assets->get<AssetSchemeIndexModel, Model>(data[0].id)))
-					{
-						for (const auto &it : data)
+						else
 						{
-							SceneModel rm;
-							rm.mesh = mesh;
-							SceneItem rd;
-							rd.e = it.e;
-							rd.transform = modelTransform(it.e);
-							rd.data.assign(std::move(rm));
-							prepareModel(rd);
+							// we must direct the objects individually into all cameras/shadowmaps
+							g.lods = true;
 						}
-						return;
+						g.object = shareAsset(std::move(obj));
+					}
+					else if (Model *mesh = shareAsset(config.shared.assets->get<AssetSchemeIndexModel, Model>(data[0].id)))
+						g.meshes.push_back(mesh);
+					else if (cnfRenderMissingModels)
+					{
+						Model *fake = shareAsset(config.shared.assets->get<AssetSchemeIndexModel, Model>(HashString("cage/models/fake.obj")));
+						if (!fake)
+							return;
+						g.meshes.push_back(fake);
 					}
+					else
+						return;
 
-					if (cnfRenderMissingModels)
+					const uint32 gi = numeric_cast<uint32>(groups.size());
+					groups.push_back(std::move(g));
+					for (Data &it : data)
+						it.group = gi;
+				};
+				partition(PointerRange<Data>(data), mark, output);
+
+				prepareParallel(PointerRange<const Data>(data),
+					[&](PrepareBuffer &buf, const Data &it)
 					{
-						Model *mesh = shareAsset(config.shared.assets->get<AssetSchemeIndexModel, Model>(HashString("cage/models/fake.obj")));
-						if (!mesh)
+						if (it.group == m)
 							return;
-						for (const auto &it : data)
+						const Group &g = groups[it.group];
+						if (g.lods)
+						{
+							prepareEntitiesModelsLod(buf, it.e, g.object);
+							return;
+						}
+						const Transform tr = modelTransform(it.e);
+						for (Model *mesh : g.meshes)
 						{
 							SceneModel rm;
 							rm.mesh = mesh;
 							SceneItem rd;
 							rd.e = it.e;
-							rd.transform = modelTransform(it.e);
+							rd.transform = tr;
 							rd.data.assign(std::move(rm));
-							prepareModel(rd);
+							prepareModel(buf, rd, g.object);
 						}
-					}
-				};
-				partition(PointerRange<const Data>(data), mark, output);
+					});
 			}
 
 			void prepareEntitiesSprites()
@@ -1000,6 +1146,8 @@ namespace cage
 				{
 					SpriteComponent ic;
 					Entity *e = nullptr;
+					Texture *tex = nullptr;
+					Model *mesh = nullptr;
 				};
 				std::vector<Data> data;
 				data.reserve(config.shared.scene->component<SpriteComponent>()->count());
@@ -1016,7 +1164,7 @@ namespace cage
 				std::sort(data.begin(), data.end(), [](const Data &a, const Data &b) { return std::pair{ a.ic.spriteId, a.ic.modelId } < std::pair{ b.ic.spriteId, b.ic.modelId }; });
 
 				const auto &mark = [](const Data &data) { return std::pair{ data.ic.spriteId, data.ic.modelId }; };
-				const auto &output = [&](PointerRange<const Data> data)
+				const auto &output = [&](PointerRange<Data> data)
 				{
 					CAGE_ASSERT(data.size() > 0);
 					Texture *tex = shareAsset(config.shared.assets->get<AssetSchemeIndexTexture, Texture>(data[0].ic.spriteId));
@@ -1025,41 +1173,96 @@ namespace cage
 					Model *mesh = data[0].ic.modelId ? shareAsset(config.shared.assets->get<AssetSchemeIndexModel, Model>(data[0].ic.modelId)) : modelSprite;
 					if (!mesh)
 						return;
-					for (const auto &it : data)
-						prepareSprite(it.e, tex, mesh);
+					for (Data &it : data)
+					{
+						it.tex = tex;
+						it.mesh = mesh;
+					}
 				};
-				partition(PointerRange<const Data>(data), mark, output);
+				partition(PointerRange<Data>(data), mark, output);
+
+				prepareParallel(PointerRange<const Data>(data),
+					[&](PrepareBuffer &buf, const Data &it)
+					{
+						if (it.tex)
+							prepareSprite(buf, it.e, it.tex, it.mesh);
+					});
 			}
 
-			void prepareEntities()
+			void prepareEntitiesTexts()
 			{
-				ProfilingScope profiling("prepare entities");
-				profiling.set(Stringizer() + "entities: " + config.shared.scene->count());
+				ProfilingScope profiling("texts");
 
-				prepareEntitiesModels();
-				prepareEntitiesSprites();
+				struct Data
+				{
+					TextComponent tc;
+					Entity *e = nullptr;
+				};
+				std::vector<Data> data;
+				data.reserve(config.shared.scene->component<TextComponent>()->count());
 
 				entitiesVisitor(
 					[&](Entity *e, const TextComponent &tc)
 					{
 						if (emptyMask(e))
 							return;
-						prepareText(e, tc);
+						data.push_back({ tc, e });
 					},
 					+config.shared.scene, false);
+				profiling.set(Stringizer() + "texts: " + data.size());
 
+				prepareParallel(PointerRange<const Data>(data), [&](PrepareBuffer &buf, const Data &it) { prepareText(buf, it.e, it.tc); });
+			}
+
+			void prepareEntitiesCustomDraws()
+			{
+				if (prepareBuffers.empty())
+					prepareBuffers.resize(1);
 				entitiesVisitor(
 					[&](Entity *e, const CustomDrawComponent &cdc)
 					{
 						if (emptyMask(e))
 							return;
-						prepareCustomDraw(e, cdc);
+						prepareCustomDraw(prepareBuffers[0], e, cdc);
 					},
 					+config.shared.scene, false);
 			}
 
-			void prepareEntitiesModelsLod(Entity *e, RenderObject *object);
-			void distribute(SceneItem &&item);
+			// sorts all items by the view-independent part of the rendering order, once for all renderers
+			// the renderers receive the items in this order and need to sort only the order-dependent items (see RenderBaseBase::orderItems)
+			void mergePrepared()
+			{
+				ProfilingScope profiling("merge items");
+				FrameVector<PreparedItem *> sorted{ frameArena.allocator<PreparedItem *>() };
+				for (PrepareBuffer &b : prepareBuffers)
+				{
+					for (PreparedItem &it : b.items)
+						sorted.push_back(&it);
+					for (Holder<void> &a : b.assets)
+						sharedAssetsCache.insert(std::move(a));
+				}
+				profiling.set(Stringizer() + "items: " + sorted.size());
+				std::sort(sorted.begin(), sorted.end(), [](const PreparedItem *a, const PreparedItem *b) { return RenderItem{ .base = &a->item }.cmp() < RenderItem{ .base = &b->item }.cmp(); });
+				for (PreparedItem *it : sorted)
+					distribute(std::move(*it));
+				prepareBuffers.clear();
+			}
+
+			void prepareEntities()
+			{
+				ProfilingScope profiling("prepare entities");
+				profiling.set(Stringizer() + "entities: " + config.shared.scene->count());
+
+				prepareEntitiesModels();
+				prepareEntitiesSprites();
+				prepareEntitiesTexts();
+				prepareEntitiesCustomDraws();
+				mergePrepared();
+			}
+
+			void prepareEntitiesModelsLod(PrepareBuffer &buf, Entity *e, RenderObject *object);
+			void distribute(PreparedItem &&prepared);
+			void cullItems();
 			void generateRenderers();
 			void dispatchRenders();
 		};
@@ -1081,12 +1284,14 @@ namespace cage
 			Holder<GraphicsAggregateBuffer> aggregate;
 			Holder<GraphicsBuffer> buffViewport, buffProjection;
 
-			ItemsContainer<RenderItem> items;
+			FrameArena frameArena;
+			ItemsContainer<RenderItem> items{ frameArena };
+			PointerRange<const uint32> visibleModels; // indices of scene items that intersect the frustum (unordered), see SceneImpl::cullItems
 
 			// temporary caches
-			std::vector<UniMesh> uniMeshes;
-			std::vector<Mat3x4> uniArmatures;
-			std::vector<float> uniCustomData;
+			FrameVector<UniMesh> uniMeshes{ frameArena.allocator<UniMesh>() };
+			FrameVector<Mat3x4> uniArmatures{ frameArena.allocator<Mat3x4>() };
+			FrameVector<float> uniCustomData{ frameArena.allocator<float>() };
 
 			RenderBaseBase(const SceneImpl &scene, const SceneRenderCamera &camera) : scene(scene), camera(camera) {}
 
@@ -1100,6 +1305,15 @@ namespace cage
 				return (c & camera.cameraSceneMask) == 0;
 			}
 
+			CAGE_FORCE_INLINE bool accepts(const SceneItem &item, const ItemDistribution &d) const
+			{
+				if (d.target && d.target != this)
+					return false;
+				if (isShadowmap && !item.shadowCast)
+					return false;
+				return (camera.cameraSceneMask & d.sceneMask) != 0;
+			}
+
 			CAGE_FORCE_INLINE void appendShaderCustomData(Entity *e, uint32 customDataCount)
 			{
 				if (!customDataCount)
@@ -1121,14 +1335,19 @@ namespace cage
 			void frustumCullItems()
 			{
 				ProfilingScope profiling("frustum cull items");
-				items.erase_if(
-					[this](const RenderItem &it) -> bool
-					{
-						if (it->data.index != VariantEnum::Model)
-							return false;
-						const auto &mod = it->data.model();
-						return !intersects(mod.mesh->boundingBox * it->transform, frustum);
-					});
+				// the scene items are sorted, the visible models are merged with the other items by their position in the scene
+				FrameVector<uint32> visible(visibleModels.begin(), visibleModels.end(), frameArena.allocator<uint32>());
+				visible.insert(visible.end(), scene.unboundedModels.begin(), scene.unboundedModels.end());
+				std::sort(visible.begin(), visible.end());
+				const uintPtr others = items.size();
+				for (uint32 i : visible)
+				{
+					const SceneItem &it = scene.items[i];
+					if (accepts(it, scene.distribution[i]))
+						items.push_back(RenderItem{ .base = &it });
+				}
+				std::inplace_merge(items.begin(), items.begin() + others, items.end(), [](const RenderItem &a, const RenderItem &b) { return a.base < b.base; });
+				profiling.set(Stringizer() + "visible: " + (items.size() - others));
 			}
 
 			void orderItems()
@@ -1136,13 +1355,27 @@ namespace cage
 				ProfilingScope profiling("order items");
 				profiling.set(Stringizer() + "count: " + items.size());
 
-				for (RenderItem &it : items)
+				// the items were distributed already sorted, except for the depth, which is specific to each view
+				CAGE_ASSERT(std::is_sorted(items.begin(), items.end(), [](const RenderItem &a, const RenderItem &b) { return a.cmp() < b.cmp(); }));
+				auto it = items.begin();
+				const auto et = items.end();
+				while (it != et)
 				{
-					if (it->orderDependent)
-						it.depth = (viewProj * Vec4(it->transform.position, 1))[2] * -1;
+					if (!(*it)->orderDependent)
+					{
+						it++;
+						continue;
+					}
+					const sint32 layer = (*it)->renderLayer;
+					auto i = it;
+					while (i != et && (*i)->orderDependent && (*i)->renderLayer == layer)
+					{
+						i->depth = (viewProj * Vec4((*i)->transform.position, 1))[2] * -1;
+						i++;
+					}
+					std::sort(it, i, [](const RenderItem &a, const RenderItem &b) { return a.cmp() < b.cmp(); });
+					it = i;
 				}
-
-				std::sort(items.begin(), items.end(), [](const RenderItem &a, const RenderItem &b) { return a.cmp() < b.cmp(); });
 			}
 
 			void orderInstances(PointerRange<RenderItem> insts)
@@ -1633,6 +1866,7 @@ namespace cage
 				model = Mat4(camera.transform);
 				view = inverse(model);
 				viewProj = camera.projection * view;
+				frustum = Frustum(viewProj);
 
 				{
 					UniViewport viewport;
@@ -1737,7 +1971,6 @@ namespace cage
 
 			void entry() override
 			{
-				frustum = Frustum(viewProj);
 				frustumCullItems();
 				orderItems();
 				prepareLights();
@@ -1954,7 +2187,7 @@ namespace cage
 				ProfilingScope profiling("prepare lights");
 
 				{ // add unshadowed lights
-					std::vector<UniLight> lights;
+					FrameVector<UniLight> lights{ frameArena.allocator<UniLight>() };
 					lights.reserve(100);
 					entitiesVisitor(
 						[&](Entity *e, const LightComponent &lc)
@@ -1978,7 +2211,7 @@ namespace cage
 				}
 
 				{ // add shadowed lights
-					std::vector<UniShadowedLight> shadows;
+					FrameVector<UniShadowedLight> shadows{ frameArena.allocator<UniShadowedLight>() };
 					uint32 tex2dCount = 0, texCubeCount = 0;
 					shadows.reserve(10);
 					for (auto &sh : shadowmaps)
@@ -2051,47 +2284,47 @@ namespace cage
 			}
 		};
 
-		void SceneImpl::prepareEntitiesModelsLod(Entity *e, RenderObject *object)
+		void SceneImpl::prepareEntitiesModelsLod(PrepareBuffer &buf, Entity *e, RenderObject *object)
 		{
 			const Transform transform = modelTransform(e);
-			for (Holder<RenderBaseBase> &renderer : renderers)
+			for (const Holder<RenderBaseBase> &renderer : renderers)
 			{
-				distOverride = +renderer;
-				prepareModelsHolders.clear();
-				renderer->camera.lodSelection.selectModels(prepareModelsHolders, transform.position, object, config.shared.onDemand);
-				for (auto &mesh : prepareModelsHolders)
+				buf.target = +renderer;
+				buf.modelsHolders.clear();
+				renderer->camera.lodSelection.selectModels(buf.modelsHolders, transform.position, object, config.shared.onDemand);
+				for (auto &mesh : buf.modelsHolders)
 				{
 					SceneModel rm;
-					rm.mesh = shareAsset(std::move(mesh));
+					rm.mesh = buf.shareAsset(std::move(mesh));
 					SceneItem rd;
 					rd.e = e;
 					rd.transform = transform;
 					rd.data.assign(std::move(rm));
-					prepareModel(rd, object);
+					prepareModel(buf, rd, object);
 				}
 			}
-			distOverride = nullptr;
+			buf.target = nullptr;
 		}
 
-		void SceneImpl::distribute(SceneItem &&item)
+		void SceneImpl::distribute(PreparedItem &&prepared)
 		{
-			const auto msk = item.e->getOrDefault<SceneComponent>().sceneMask;
-			RenderItem rd{ .base = items.push_back(std::move(item)) };
+			const uint32 msk = prepared.sceneMask;
+			RenderItem rd{ .base = items.push_back(std::move(prepared.item)) };
 			if (!rd.base)
 				return; // exhausted capacity
+			distribution.push_back({ prepared.target, msk });
+			if (rd->data.index == VariantEnum::Model)
+				return; // models are given to the renderers after culling, see RenderBaseBase::frustumCullItems
 
 			const auto &put = [&](RenderBaseBase *r)
 			{
-				if (r->isShadowmap && !item.shadowCast)
-					return;
-				if ((r->camera.cameraSceneMask & msk) == 0)
-					return;
-				r->items.push_back(rd);
+				if (r->accepts(*rd.base, distribution.back()))
+					r->items.push_back(rd);
 			};
 
-			if (distOverride)
+			if (prepared.target)
 			{
-				put(distOverride);
+				put(prepared.target);
 			}
 			else
 			{
@@ -2100,6 +2333,55 @@ namespace cage
 			}
 		}
 
+		void SceneImpl::cullItems()
+		{
+			ProfilingScope profiling("cull items");
+
+			cullingStructure = newSpatialStructure({ .reserve = numeric_cast<uint32>(items.size()) });
+			for (uint32 i = 0; i < items.size(); i++)
+			{
+				const SceneItem &it = items[i];
+				if (it.data.index != VariantEnum::Model)
+					continue;
+				const Aabb box = it.data.model().mesh->boundingBox * it.transform;
+				if (cullable(box))
+					cullingStructure->update(i, box);
+				else
+					unboundedModels.push_back(i);
+			}
+			cullingStructure->rebuild();
+			profiling.set(Stringizer() + "models: " + cullingStructure->statistics().items + ", unbounded: " + unboundedModels.size() + ", views: " + renderers.size());
+
+			// one batched query for all renderers, the tree is traversed with packets of four frustums at once
+			// cascades of one light are kept within one packet
+			std::vector<Frustum> frustums;
+			std::vector<uint32> indices;
+			frustums.reserve(renderers.size() * 2);
+			indices.reserve(renderers.size());
+			for (const auto &r : renderers)
+			{
+				uint32 group = 1;
+				if (r->isShadowmap)
+				{
+					const ShadowRender *sr = (const ShadowRender *)+r;
+					if (sr->lightComponent.lightType == LightTypeEnum::Directional)
+						group = sr->cascade == 0 ? sr->shadowmapComponent.cascadesCount : 0;
+				}
+				if (group > 0 && (frustums.size() % 4) + group > 4)
+				{
+					while (frustums.size() % 4)
+						frustums.push_back(frustums.back()); // padding, the results are ignored
+				}
+				indices.push_back(numeric_cast<uint32>(frustums.size()));
+				frustums.push_back(r->frustum);
+			}
+
+			cullingQuery = newSpatialQuery(cullingStructure.share());
+			cullingQuery->intersection(PointerRange<const Frustum>(frustums), true);
+			for (uint32 i = 0; i < renderers.size(); i++)
+				renderers[i]->visibleModels = cullingQuery->result(indices[i]);
+		}
+
 		void SceneImpl::generateRenderers()
 		{
 			const ProfilingScope profiling("generate renderers");
@@ -2157,6 +2439,7 @@ namespace cage
 		impl.loadBasicAssets();
 		impl.generateRenderers();
 		impl.prepareEntities();
+		impl.cullItems();
 		impl.dispatchRenders();
 
 		PointerRangeHolder<Holder<GraphicsEncoder>> res;
@@ -21,15 +21,19 @@ namespace cage
 				sampleRate = stream->sampleRate();
 			}
 
-			void decodeOne(PointerRange<float> buffer, sintPtr bufferOffset, sintPtr streamOffset, sintPtr frames) const
+			void decodeOne(PointerRange<float> buffer, sintPtr bufferOffset, sintPtr streamOffset, sintPtr frames, AudioDecoder *decoder) const
 			{
 				CAGE_ASSERT(bufferOffset >= 0 && streamOffset >= 0 && frames >= 0);
 				CAGE_ASSERT(streamOffset + frames <= length);
 				CAGE_ASSERT((bufferOffset + frames) * channels <= numeric_cast<sintPtr>(buffer.size()));
-				stream->decode(streamOffset, { buffer.data() + channels * bufferOffset, buffer.data() + channels * (bufferOffset + frames) });
+				const PointerRange<float> range = { buffer.data() + channels * bufferOffset, buffer.data() + channels * (bufferOffset + frames) };
+				if (decoder)
+					decoder->decode(streamOffset, range);
+				else
+					stream->decode(streamOffset, range);
 			}
 
-			void decodeLoop(PointerRange<float> buffer, sintPtr bufferOffset, sintPtr streamOffset, sintPtr frames) const
+			void decodeLoop(PointerRange<float> buffer, sintPtr bufferOffset, sintPtr streamOffset, sintPtr frames, AudioDecoder *decoder) const
 			{
 				CAGE_ASSERT(bufferOffset >= 0 && frames >= 0);
 				CAGE_ASSERT((bufferOffset + frames) * channels <= numeric_cast<sintPtr>(buffer.size()));
@@ -41,7 +45,7 @@ namespace cage
 					streamOffset %= length;
 					const sintPtr f = min(streamOffset + frames, length) - streamOffset;
 					CAGE_ASSERT(f > 0 && f <= frames && streamOffset + f <= length);
-					decodeOne(buffer, bufferOffset, streamOffset, f);
+					decodeOne(buffer, bufferOffset, streamOffset, f, decoder);
 					bufferOffset += f;
 					streamOffset += f;
 					frames -= f;
@@ -55,7 +59,7 @@ namespace cage
 				detail::memset(buffer.data() + channels * bufferOffset, 0, channels * frames * sizeof(float));
 			}
 
-			void resolveLooping(PointerRange<float> buffer, sintPtr startFrame, sintPtr frames, bool loop) const
+			void resolveLooping(PointerRange<float> buffer, sintPtr startFrame, sintPtr frames, bool loop, AudioDecoder *decoder) const
 			{
 				CAGE_ASSERT(frames >= 0);
 				CAGE_ASSERT(frames * channels == numeric_cast<sintPtr>(buffer.size()));
@@ -66,7 +70,7 @@ namespace cage
 				{ // before start
 					const sintPtr r = min(-startFrame, frames);
 					if (loop)
-						decodeLoop(buffer, bufferOffset, startFrame, r);
+						decodeLoop(buffer, bufferOffset, startFrame, r, decoder);
 					else
 						zeroFill(buffer, bufferOffset, r);
 					bufferOffset += r;
@@ -77,7 +81,7 @@ namespace cage
 				if (startFrame < length && frames)
 				{ // inside
 					const sintPtr r = min(length - startFrame, frames);
-					decodeOne(buffer, bufferOffset, startFrame, r);
+					decodeOne(buffer, bufferOffset, startFrame, r, decoder);
 					bufferOffset += r;
 					frames -= r;
 					startFrame += r;
@@ -87,7 +91,7 @@ namespace cage
 				{ // after end
 					const sintPtr r = frames;
 					if (loop)
-						decodeLoop(buffer, bufferOffset, startFrame, r);
+						decodeLoop(buffer, bufferOffset, startFrame, r, decoder);
 					else
 						zeroFill(buffer, bufferOffset, r);
 					bufferOffset += r;
@@ -99,17 +103,17 @@ namespace cage
 				CAGE_ASSERT(frames == 0);
 			}
 
-			void decode(sintPtr startFrame, PointerRange<float> buffer, bool loop) const
+			void decode(sintPtr startFrame, PointerRange<float> buffer, bool loop, AudioDecoder *decoder) const
 			{
 				CAGE_ASSERT(buffer.size() % channels == 0);
-				resolveLooping(buffer, startFrame, buffer.size() / channels, loop);
+				resolveLooping(buffer, startFrame, buffer.size() / channels, loop, decoder);
 			}
 
 			void process(const SoundCallbackData &data, bool loop) const
 			{
 				if (data.channels != channels || data.sampleRate != sampleRate)
 					CAGE_THROW_ERROR(Exception, "unmatched channels or sample rate");
-				resolveLooping(data.buffer, numeric_cast<sintPtr>(data.time * sampleRate / 1'000'000), data.frames, loop);
+				resolveLooping(data.buffer, numeric_cast<sintPtr>(data.time * sampleRate / 1'000'000), data.frames, loop, nullptr);
 			}
 		};
 	}
@@ -148,10 +152,16 @@ namespace cage
 		return (uint64)1'000'000 * frames() / sampleRate();
 	}
 
-	void Sound::decode(sintPtr startFrame, PointerRange<float> buffer, bool loop) const
+	Holder<AudioDecoder> Sound::newDecoder() const
+	{
+		const SoundImpl *impl = (const SoundImpl *)this;
+		return newAudioDecoder(impl->stream.share());
+	}
+
+	void Sound::decode(sintPtr startFrame, PointerRange<float> buffer, bool loop, AudioDecoder *decoder) const
 	{
 		SoundImpl *impl = (SoundImpl *)this;
-		impl->decode(startFrame, buffer, loop);
+		impl->decode(startFrame, buffer, loop, decoder);
 	}
 
 	void Sound::process(const SoundCallbackData &data, bool loop) const
@@ -2,6 +2,7 @@
 #include <variant>
 
 #include <cage-core/assetsOnDemand.h>
+#include <cage-core/audio.h>
 #include <cage-core/audioChannelsConverter.h>
 #include <cage-core/sampleRateConverter.h>
 #include <cage-core/swapBufferGuard.h>
@@ -21,6 +22,7 @@ namespace cage
 		{
 			SoundsQueueImpl *impl = nullptr;
 			Holder<Sound> sound;
+			Holder<AudioDecoder> decoder;
 			sint64 startTime = m;
 			sint64 endTime = m;
 			uint32 name = 0;
@@ -138,7 +140,9 @@ namespace cage
 				const sintPtr startFrame = numeric_cast<sintPtr>((data.time - v.startTime) * sampleRate / 1'000'000);
 				const uintPtr frames = numeric_cast<uintPtr>(uint64(data.frames) * sampleRate / data.sampleRate);
 				tmp1.resize(frames * channels);
-				v.sound->decode(startFrame, tmp1, false);
+				if (!v.decoder)
+					v.decoder = v.sound->newDecoder();
+				v.sound->decode(startFrame, tmp1, false, +v.decoder);
 
 				// convert channels
 				if (channels != data.channels)
@@ -159,10 +163,7 @@ namespace cage
 
 				// add the result to accumulation buffer
 				CAGE_ASSERT(tmp1.size() == data.buffer.size());
-				auto src = tmp1.begin();
-				const float g = v.effectiveGain.value;
-				for (float &dst : data.buffer)
-					dst += *src++ * g;
+				chansConv->accumulate(tmp1, data.buffer, data.channels, data.channels, v.effectiveGain);
 			}
 
 			void process(const SoundCallbackData &data)
@@ -1,6 +1,8 @@
+#include <cage-core/audio.h>
 #include <cage-core/audioChannelsConverter.h>
 #include <cage-core/audioDirectionalConverter.h>
 #include <cage-core/sampleRateConverter.h>
+#include <cage-core/tasks.h>
 #include <cage-engine/sound.h>
 #include <cage-engine/soundsVoices.h>
 
@@ -16,6 +18,11 @@ namespace cage
 		{
 		public:
 			VoicesMixerImpl *mixer = nullptr;
+			Holder<Sound> decoderSound; // keeps the sound alive for the decoder
+			Holder<AudioDecoder> decoder;
+			Holder<SampleRateConverter> rateConv;
+			std::vector<float> tmp1, tmp2;
+			std::vector<float> mixed; // the output of this voice when mixing in parallel
 			Real effectiveGain = 0;
 
 			VoiceImpl(VoicesMixerImpl *mixer);
@@ -27,10 +34,10 @@ namespace cage
 		{
 		public:
 			std::vector<VoiceImpl *> voices;
-			Holder<SampleRateConverter> rateConv1, rateConvT;
+			std::vector<VoiceImpl *> audible;
 			Holder<AudioDirectionalConverter> dirConv;
 			Holder<AudioChannelsConverter> chansConv;
-			std::vector<float> tmp1, tmp2;
+			const SoundCallbackData *currentData = nullptr;
 
 			~VoicesMixerImpl()
 			{
@@ -50,25 +57,28 @@ namespace cage
 				updateEffectiveGains(this, voices);
 			}
 
-			void processVoice(VoiceImpl &v, const SoundCallbackData &data)
+			// the converters shared by all voices are stateless, all other state is in the voice
+			void processVoice(VoiceImpl &v, const SoundCallbackData &data, PointerRange<float> output)
 			{
 				CAGE_ASSERT(!v.callback != !v.sound);
+				CAGE_ASSERT(output.size() == data.buffer.size());
 
 				const bool spatial = v.position.valid() && v.spatial;
+				const Real g = v.effectiveGain;
+				uint32 channels = spatial ? 1 : data.channels; // channels in tmp1
 
 				// decode source
 				if (v.callback)
 				{
 					SoundCallbackData d = data;
-					if (spatial)
-						d.channels = 1;
+					d.channels = channels;
 					if (v.effectiveGain < 1e-5)
 					{
 						// callbacks must be processed even if muted, but do not need the data
 						d.frames = 0;
 					}
-					tmp1.resize(d.frames * d.channels);
-					d.buffer = tmp1;
+					v.tmp1.resize(d.frames * d.channels);
+					d.buffer = v.tmp1;
 					v.callback(d);
 					if (d.frames == 0)
 						return;
@@ -78,66 +88,67 @@ namespace cage
 					if (v.effectiveGain < 1e-5)
 						return;
 
-					const uint32 channels = v.sound->channels();
+					const uint32 srcChannels = v.sound->channels();
 					const uint32 sampleRate = v.sound->sampleRate();
 					const sintPtr startFrame = numeric_cast<sintPtr>((data.time - v.startTime) * sampleRate / 1'000'000);
 					const uintPtr frames = numeric_cast<uintPtr>(uint64(data.frames) * sampleRate / data.sampleRate);
-					tmp1.resize(frames * channels);
-					v.sound->decode(startFrame, tmp1, v.loop);
+					v.tmp1.resize(frames * srcChannels);
+					if (+v.decoderSound != +v.sound)
+					{
+						v.decoder = v.sound->newDecoder();
+						v.decoderSound = v.sound.share();
+					}
+					v.sound->decode(startFrame, v.tmp1, v.loop, +v.decoder);
 
-					// convert to 1 channel for spatial sound and to output channels otherwise
-					if (spatial && channels != 1)
+					if (sampleRate == data.sampleRate && !spatial)
 					{
-						tmp2.resize(frames * 1);
-						chansConv->convert(tmp1, tmp2, channels, 1);
-						std::swap(tmp1, tmp2);
+						// fused channels conversion, gain and accumulation
+						chansConv->accumulate(v.tmp1, output, srcChannels, data.channels, g);
+						return;
 					}
-					if (!spatial && channels != data.channels)
+
+					// convert to 1 channel for spatial sound and to output channels otherwise
+					if (srcChannels != channels)
 					{
-						tmp2.resize(frames * data.channels);
-						chansConv->convert(tmp1, tmp2, channels, data.channels);
-						std::swap(tmp1, tmp2);
+						v.tmp2.resize(frames * channels);
+						chansConv->convert(v.tmp1, v.tmp2, srcChannels, channels);
+						std::swap(v.tmp1, v.tmp2);
 					}
-					CAGE_ASSERT((tmp1.size() % (v.position.valid() ? 1 : data.channels)) == 0);
 
 					// convert sample rate
 					if (sampleRate != data.sampleRate)
 					{
-						if (spatial)
-						{
-							tmp2.resize(data.frames * 1);
-							rateConv1->convert(tmp1, tmp2, data.sampleRate / (double)sampleRate);
-						}
-						else
-						{
-							tmp2.resize(data.frames * data.channels);
-							rateConvT->convert(tmp1, tmp2, data.sampleRate / (double)sampleRate);
-						}
-						std::swap(tmp1, tmp2);
+						if (!v.rateConv || v.rateConv->channels() != channels)
+							v.rateConv = newSampleRateConverter(channels);
+						v.tmp2.resize(data.frames * channels);
+						v.rateConv->convert(v.tmp1, v.tmp2, data.sampleRate / (double)sampleRate);
+						std::swap(v.tmp1, v.tmp2);
 					}
 				}
 				else
 					return;
 
-				// apply spatial conversion
+				CAGE_ASSERT(v.tmp1.size() == data.frames * channels);
+
+				// fused spatial conversion, gain and accumulation
 				if (spatial && data.channels > 1)
 				{
-					CAGE_ASSERT(tmp1.size() == data.frames);
-					tmp2.resize(data.frames * data.channels);
 					AudioDirectionalProcessConfig cfg;
 					cfg.listenerOrientation = this->orientation;
 					cfg.listenerPosition = this->position;
 					cfg.sourcePosition = v.position;
-					dirConv->process(tmp1, tmp2, cfg);
-					std::swap(tmp1, tmp2);
+					dirConv->accumulate(v.tmp1, output, cfg, g);
 				}
+				else
+					chansConv->accumulate(v.tmp1, output, channels, data.channels, g);
+			}
 
-				// add the result to accumulation buffer
-				CAGE_ASSERT(tmp1.size() == data.buffer.size());
-				auto src = tmp1.begin();
-				const float g = v.effectiveGain.value;
-				for (float &dst : data.buffer)
-					dst += *src++ * g;
+			void operator()(uint32 index)
+			{
+				VoiceImpl &v = *audible[index];
+				v.mixed.resize(currentData->buffer.size());
+				detail::memset(v.mixed.data(), 0, v.mixed.size() * sizeof(float));
+				processVoice(v, *currentData, v.mixed);
 			}
 
 			void process(const SoundCallbackData &data)
@@ -152,17 +163,29 @@ namespace cage
 				if (voices.empty())
 					return;
 
-				if (!rateConv1)
-					rateConv1 = newSampleRateConverter(1);
-				if (!rateConvT || rateConvT->channels() != data.channels)
-					rateConvT = newSampleRateConverter(data.channels);
 				if (!dirConv || dirConv->channels() != data.channels)
 					dirConv = newAudioDirectionalConverter(data.channels);
 				if (!chansConv)
 					chansConv = newAudioChannelsConverter();
 
-				for (VoiceImpl *v : voices)
-					processVoice(*v, data);
+				if (parallelVoices > 0 && voices.size() >= parallelVoices)
+				{
+					// callbacks must be processed even if muted
+					audible.clear();
+					for (VoiceImpl *v : voices)
+						if (v->callback || v->effectiveGain >= 1e-5)
+							audible.push_back(v);
+					currentData = &data;
+					tasksRunBlocking<VoicesMixerImpl>("sound voices", *this, numeric_cast<uint32>(audible.size()));
+					currentData = nullptr;
+					for (VoiceImpl *v : audible)
+						chansConv->accumulate(v->mixed, data.buffer, data.channels, data.channels);
+				}
+				else
+				{
+					for (VoiceImpl *v : voices)
+						processVoice(*v, data, data.buffer);
+				}
 			}
 		};
 
@@ -1,4 +1,5 @@
 #include <atomic>
+#include <vector>
 
 #include <cage-core/assetContext.h>
 #include <cage-core/assetHeader.h>
@@ -86,12 +87,11 @@ namespace
 		makeAssetCounter(name, {});
 	}
 
-	Holder<AssetsManager> instantiate()
+	Holder<AssetsManager> instantiate(AssetsManagerCreateConfig cfg = {})
 	{
 		CAGE_TEST(AssetCounter::counter == 0);
 		pathRemove(AssetsPath);
 		pathCreateDirectories(AssetsPath);
-		AssetsManagerCreateConfig cfg;
 		cfg.assetsFolderName = AssetsPath;
 		Holder<AssetsManager> man = newAssetsManager(cfg);
 		man->defineScheme<AssetSchemeIndexPack, AssetPack>(genAssetSchemePack());
@@ -306,6 +306,57 @@ void testAssetManager()
 		man->waitTillEmpty();
 	}
 
+	{
+		CAGE_TESTCASE("priorities");
+		AssetsManagerCreateConfig cfg;
+		cfg.diskLoadingThreads = 1;
+		cfg.backgroundBandwidth = 1'000'000;
+		Holder<AssetsManager> man = instantiate(cfg);
+		for (uint32 i = 1; i < 7; i++)
+			makeAssetCounter(i);
+		struct Tracker
+		{
+			Holder<Mutex> mut = newMutex();
+			std::vector<uint32> order;
+			std::atomic<bool> release = false;
+		} t;
+		EventListener<bool(uint32, String &, Holder<File> &)> listener(
+			[tt = &t](uint32 id, String &, Holder<File> &)
+			{
+				{
+					ScopeLock lock(tt->mut);
+					tt->order.push_back(id);
+				}
+				while (id == 1 && !tt->release)
+					threadYield();
+			},
+			man->findAsset);
+		man->load(1); // blocks the loading thread
+		while (true)
+		{
+			ScopeLock lock(t.mut);
+			if (!t.order.empty())
+				break;
+			lock.clear();
+			threadYield();
+		}
+		man->load(2, -5);
+		man->load(3);
+		man->load(4, 10);
+		man->load(5, -1);
+		man->load(6, -2);
+		man->prioritize(2, 20);
+		man->load(6, -10); // loading again does not lower the priority
+		t.release = true;
+		waitProcessing(man);
+		CAGE_TEST(AssetCounter::counter == 6);
+		CAGE_TEST((t.order == std::vector<uint32>{ 1, 2, 4, 3, 5, 6 }));
+		for (uint32 i = 1; i < 7; i++)
+			man->unload(i);
+		man->unload(6); // was loaded twice
+		man->waitTillEmpty();
+	}
+
 	{
 		CAGE_TESTCASE("holding asset after remove");
 		Holder<AssetsManager> man = instantiate();
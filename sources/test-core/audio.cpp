@@ -237,6 +237,32 @@ void testAudio()
 		CAGE_TEST_THROWN(audioBlit(+src, +dst, 120'000, 120'000, 240'000));
 	}
 
+	{
+		CAGE_TESTCASE("streaming decoder");
+		Holder<Audio> snd = newAudio();
+		generateStereo(+snd, 440);
+		audioConvertFormat(+snd, AudioFormatEnum::Vorbis);
+		Holder<AudioDecoder> dec = newAudioDecoder(snd.share());
+		std::vector<float> a, b;
+		const auto &compare = [&](uintPtr start, uintPtr frames)
+		{
+			a.resize(frames * 2);
+			b.resize(frames * 2);
+			dec->decode(start, a);
+			snd->decode(start, b);
+			for (uintPtr i = 0; i < a.size(); i++)
+				test(a[i], b[i]);
+		};
+		compare(0, 1000); // sequential
+		compare(1000, 1000);
+		compare(2000, 480);
+		compare(3000, 480); // short gap
+		compare(100'000, 480); // jump forward
+		compare(50'000, 480); // jump backward
+		compare(479'000, 1000); // end
+		compare(0, 480); // loop
+	}
+
 	{
 		CAGE_TESTCASE("sample rate conversion to 44100");
 		Holder<Audio> snd = newAudio();
@@ -1,6 +1,10 @@
+#include <algorithm>
+#include <vector>
+
 #include <cage-core/collider.h>
 #include <cage-core/geometry.h>
 #include <cage-core/memoryBuffer.h>
+#include <cage-core/timer.h>
 
 #include "main.h"
 
@@ -453,6 +457,129 @@ namespace
 			}
 		}
 	}
+
+	Holder<Collider> makeTerrain(uint32 size, Real scale)
+	{
+		Holder<Collider> c = newCollider();
+		const auto &height = [&](uint32 x, uint32 y) { return Vec3(x, sin(Rads(x * 0.3)) * cos(Rads(y * 0.2)) * 3, y) * scale; };
+		for (uint32 y = 0; y < size; y++)
+		{
+			for (uint32 x = 0; x < size; x++)
+			{
+				c->addTriangle(Triangle(height(x, y), height(x, y + 1), height(x + 1, y)));
+				c->addTriangle(Triangle(height(x + 1, y), height(x, y + 1), height(x + 1, y + 1)));
+			}
+		}
+		return c;
+	}
+
+	void largeColliders()
+	{
+		CAGE_TESTCASE("large colliders");
+
+		Holder<Collider> terrain = makeTerrain(100, 1);
+		terrain->rebuild();
+
+		{
+			CAGE_TESTCASE("lines");
+			for (uint32 round = 0; round < 50; round++)
+			{
+				const Transform tr = Transform(randomDirection3() * 10, Quat(Degs(randomRange(-10, 10)), Degs(randomRange(0, 360)), Degs()), randomRange(0.5, 2.0));
+				const Vec3 a = Vec3(randomRange(0, 100), 10, randomRange(0, 100)) * tr;
+				const Vec3 b = Vec3(randomRange(0, 100), -10, randomRange(0, 100)) * tr;
+				const Line l = round % 2 ? makeSegment(a, b) : makeRay(a, b);
+				const Line ll = l * inverse(tr); // brute force in the space of the collider to avoid differences in rounding
+				Real best = Real::Infinity();
+				uint32 bestIndex = m;
+				uint32 index = 0;
+				for (const Triangle &t : terrain->triangles())
+				{
+					const Vec3 p = intersection(ll, t);
+					if (p.valid() && distance(p, ll.origin) < best)
+					{
+						best = distance(p, ll.origin);
+						bestIndex = index;
+					}
+					index++;
+				}
+				CAGE_TEST(intersects(l, +terrain, tr) == (bestIndex != m));
+				uint32 ti = m;
+				const Vec3 p = intersection(l, +terrain, tr, ti);
+				CAGE_TEST(p.valid() == (bestIndex != m));
+				if (bestIndex != m)
+				{
+					CAGE_TEST(abs(distance(p, l.origin) - best * tr.scale) < 1e-3);
+					CAGE_TEST(ti < terrain->triangles().size());
+				}
+			}
+		}
+
+		{
+			CAGE_TESTCASE("shapes");
+			for (uint32 round = 0; round < 50; round++)
+			{
+				const Sphere s = Sphere(Vec3(randomRange(0, 100), randomRange(-5, 5), randomRange(0, 100)), randomRange(0.1, 3.0));
+				const Aabb b = Aabb(s);
+				bool es = false, eb = false;
+				for (const Triangle &t : terrain->triangles())
+				{
+					es = es || intersects(s, t);
+					eb = eb || intersects(b, t);
+				}
+				CAGE_TEST(intersects(s, +terrain, Transform()) == es);
+				CAGE_TEST(intersects(b, +terrain, Transform()) == eb);
+			}
+		}
+
+		{
+			CAGE_TESTCASE("collisions");
+			Holder<Collider> small = makeTerrain(10, 0.7);
+			small->rebuild();
+			for (uint32 round = 0; round < 10; round++)
+			{
+				const Transform tr = Transform(Vec3(randomRange(0, 90), randomRange(-3, 3), randomRange(0, 90)), Quat(Degs(randomRange(-30, 30)), Degs(randomRange(0, 360)), Degs()));
+				std::vector<std::pair<uint32, uint32>> expected;
+				for (uint32 i = 0; i < terrain->triangles().size(); i++)
+				{
+					const Triangle a = terrain->triangles()[i];
+					if (!intersects(Aabb(a), small->box() * tr))
+						continue;
+					for (uint32 j = 0; j < small->triangles().size(); j++)
+						if (intersects(a, small->triangles()[j] * tr))
+							expected.push_back({ i, j });
+				}
+				for (bool swap : { false, true })
+				{
+					CollisionDetectionConfig p = swap ? CollisionDetectionConfig(+small, +terrain, tr, Transform()) : CollisionDetectionConfig(+terrain, +small, Transform(), tr);
+					CAGE_TEST(collisionDetection(p) == !expected.empty());
+					std::vector<std::pair<uint32, uint32>> found;
+					for (const CollisionPair &c : p.collisionPairs)
+						found.push_back(swap ? std::pair(c.b, c.a) : std::pair(c.a, c.b));
+					std::sort(found.begin(), found.end());
+					CAGE_TEST(found == expected);
+				}
+			}
+		}
+
+		{
+			CAGE_TESTCASE("serialization");
+			Holder<Collider> big = makeTerrain(300, 1);
+			Holder<Timer> tmr = newTimer();
+			big->rebuild();
+			const uint64 rebuild = tmr->duration();
+			Holder<PointerRange<char>> buff = big->exportBuffer();
+			tmr->reset();
+			Holder<Collider> c = newCollider();
+			c->importBuffer(buff);
+			const uint64 import = tmr->duration();
+			CAGE_TEST(!c->needsRebuild());
+			CAGE_TEST(c->box() == big->box());
+			CAGE_TEST(c->triangles().size() == big->triangles().size());
+			const Line l = makeRay(Vec3(150, 10, 150), Vec3(151, -10, 149));
+			CAGE_TEST(intersection(l, +c, Transform()) == intersection(l, +big, Transform()));
+			CAGE_LOG(SeverityEnum::Info, "collider", Stringizer() + "triangles: " + big->triangles().size() + ", rebuild: " + rebuild + " us, import: " + import + " us, buffer: " + buff.size() + " bytes");
+		}
+	}
 }
 
 void testColliders()
@@ -464,4 +591,5 @@ void testColliders()
 	distances();
 	randomizedCollisionsWithTriangles();
 	randomizedTestsWithLines();
+	largeColliders();
 }
@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <initializer_list>
+#include <utility>
+#include <vector>
 
 #include <cage-core/collider.h>
 #include <cage-core/collisionStructure.h>
@@ -403,4 +406,58 @@ void testCollisionStructure()
 			}
 		}
 	}
+
+	{
+		CAGE_TESTCASE("all pairs");
+
+		constexpr uint32 count = 300;
+		std::vector<Transform> trs;
+		Holder<CollisionStructure> data = newCollisionStructure(CollisionStructureCreateConfig());
+		for (uint32 i = 0; i < count; i++)
+		{
+			trs.push_back(Transform(randomRange3(-15, 15), randomDirectionQuat(), randomRange(1, 3)));
+			data->update(i, c3.share(), trs.back());
+		}
+		data->rebuild();
+
+		std::vector<std::pair<uint32, uint32>> broad, exact;
+		for (uint32 i = 0; i < count; i++)
+		{
+			for (uint32 j = i + 1; j < count; j++)
+			{
+				if (!intersects(c3->box() * trs[i], c3->box() * trs[j]))
+					continue;
+				broad.push_back({ i, j });
+				if (intersects(+c3, +c3, trs[i], trs[j]))
+					exact.push_back({ i, j });
+			}
+		}
+		CAGE_TEST(exact.size() > 0);
+		CAGE_TEST(broad.size() > exact.size());
+
+		const auto &toVector = [](PointerRange<const CollisionStructurePair> pairs)
+		{
+			std::vector<std::pair<uint32, uint32>> r;
+			for (const CollisionStructurePair &p : pairs)
+			{
+				CAGE_TEST(p.a < p.b);
+				r.push_back({ p.a, p.b });
+			}
+			std::sort(r.begin(), r.end());
+			return r;
+		};
+
+		Holder<CollisionQuery> query = newCollisionQuery(data.share());
+		for (bool parallel : { false, true })
+		{
+			CAGE_TEST(query->queryPairs(false, parallel));
+			CAGE_TEST(toVector(query->structurePairs()) == broad);
+			for (const CollisionStructurePair &p : query->structurePairs())
+				CAGE_TEST(p.collisionPairs.empty());
+			CAGE_TEST(query->queryPairs(true, parallel));
+			CAGE_TEST(toVector(query->structurePairs()) == exact);
+			for (const CollisionStructurePair &p : query->structurePairs())
+				CAGE_TEST(!p.collisionPairs.empty());
+		}
+	}
 }
@@ -6,6 +6,7 @@
 #include <cage-core/ringBuffer.h>
 #include <cage-core/slidingBuffer.h>
 #include <cage-core/threadPool.h>
+#include <cage-core/timer.h>
 
 #include "main.h"
 
@@ -67,7 +68,7 @@ namespace
 		bool alive = false;
 	};
 
-	template<template<class...> class Container>
+	template<class Queue>
 	class Tester
 	{
 	public:
@@ -183,19 +184,20 @@ namespace
 
 		const uint32 produceItems;
 		const uint32 produceFinals;
-		ConcurrentQueue<Task, Container> queue;
+		Queue queue;
 	};
 
-	template<template<class...> class Container>
+	template<class Queue, bool MultipleProducersConsumers = true>
 	void testQueue()
 	{
+		using Tst = Tester<Queue>;
 		CAGE_TEST(itemsCounter == 0); // sanity check
 
 		{
 			CAGE_TESTCASE("single producer single consumer (blocking)");
-			Tester<Container> t;
-			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Tester<Container>, &Tester<Container>::consumeBlocking>(&t), "consumer");
-			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Tester<Container>, &Tester<Container>::produceBlocking>(&t), "producer");
+			Tst t;
+			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Tst, &Tst::consumeBlocking>(&t), "consumer");
+			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Tst, &Tst::produceBlocking>(&t), "producer");
 			t1->wait();
 			t2->wait();
 		}
@@ -203,37 +205,39 @@ namespace
 
 		{
 			CAGE_TESTCASE("single producer single consumer (polling)");
-			Tester<Container> t;
-			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Tester<Container>, &Tester<Container>::consumePolling>(&t), "consumer");
-			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Tester<Container>, &Tester<Container>::producePolling>(&t), "producer");
+			Tst t;
+			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Tst, &Tst::consumePolling>(&t), "consumer");
+			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Tst, &Tst::producePolling>(&t), "producer");
 			t1->wait();
 			t2->wait();
 		}
 		CAGE_TEST(itemsCounter == 0);
 
+		if constexpr (MultipleProducersConsumers)
 		{
 			CAGE_TESTCASE("multiple producers multiple consumers (blocking)");
-			Tester<Container> t;
+			Tst t;
 			Holder<ThreadPool> t1 = newThreadPool("pool_", 6);
-			t1->function = Delegate<void(uint32, uint32)>().bind<Tester<Container>, &Tester<Container>::poolBlocking>(&t);
+			t1->function = Delegate<void(uint32, uint32)>().bind<Tst, &Tst::poolBlocking>(&t);
 			t1->run();
 		}
 		CAGE_TEST(itemsCounter == 0);
 
+		if constexpr (MultipleProducersConsumers)
 		{
 			CAGE_TESTCASE("multiple producers multiple consumers (polling)");
-			Tester<Container> t;
+			Tst t;
 			Holder<ThreadPool> t1 = newThreadPool("pool_", 6);
-			t1->function = Delegate<void(uint32, uint32)>().bind<Tester<Container>, &Tester<Container>::poolPolling>(&t);
+			t1->function = Delegate<void(uint32, uint32)>().bind<Tst, &Tst::poolPolling>(&t);
 			t1->run();
 		}
 		CAGE_TEST(itemsCounter == 0);
 
 		{
 			CAGE_TESTCASE("termination (blocking)");
-			Tester<Container> t;
-			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Tester<Container>, &Tester<Container>::consumeBlocking>(&t), "consumer");
-			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Tester<Container>, &Tester<Container>::produceBlocking>(&t), "producer");
+			Tst t;
+			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Tst, &Tst::consumeBlocking>(&t), "consumer");
+			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Tst, &Tst::produceBlocking>(&t), "producer");
 			threadSleep(10);
 			t.queue.terminate();
 			t1->wait();
@@ -243,9 +247,9 @@ namespace
 
 		{
 			CAGE_TESTCASE("termination (polling)");
-			Tester<Container> t;
-			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Tester<Container>, &Tester<Container>::consumePolling>(&t), "consumer");
-			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Tester<Container>, &Tester<Container>::producePolling>(&t), "producer");
+			Tst t;
+			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Tst, &Tst::consumePolling>(&t), "consumer");
+			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Tst, &Tst::producePolling>(&t), "producer");
 			threadSleep(10);
 			t.queue.terminate();
 			t1->wait();
@@ -255,20 +259,100 @@ namespace
 	}
 }
 
+namespace
+{
+	template<class Queue>
+	struct Benchmark
+	{
+		static constexpr uint32 Count = 200000;
+		Queue queue{ 1000 };
+		uint64 sum = 0;
+
+		void produce()
+		{
+			for (uint32 i = 0; i < Count; i++)
+				queue.push(i);
+		}
+
+		void consume()
+		{
+			for (uint32 i = 0; i < Count; i++)
+			{
+				uint32 v = 0;
+				queue.pop(v);
+				sum += v;
+			}
+		}
+	};
+
+	template<class Queue>
+	void benchmark(const String &name)
+	{
+		Benchmark<Queue> b;
+		Holder<Timer> tmr = newTimer();
+		{
+			Holder<Thread> t1 = newThread(Delegate<void()>().bind<Benchmark<Queue>, &Benchmark<Queue>::consume>(&b), "consumer");
+			Holder<Thread> t2 = newThread(Delegate<void()>().bind<Benchmark<Queue>, &Benchmark<Queue>::produce>(&b), "producer");
+			t1->wait();
+			t2->wait();
+		}
+		CAGE_TEST(b.sum == uint64(Benchmark<Queue>::Count) * (Benchmark<Queue>::Count - 1) / 2);
+		CAGE_LOG(SeverityEnum::Info, "concurrent queue", Stringizer() + name + ": " + (tmr->duration() / 1000) + " ms");
+	}
+}
+
 void testConcurrentQueue()
 {
 	CAGE_TESTCASE("concurrent queue");
 
 	{
 		CAGE_TESTCASE("with vector");
-		testQueue<std::vector>();
+		testQueue<ConcurrentQueue<Task, std::vector>>();
 	}
 	{
 		CAGE_TESTCASE("with ring buffer");
-		testQueue<RingBuffer>();
+		testQueue<ConcurrentQueue<Task, RingBuffer>>();
 	}
 	{
 		CAGE_TESTCASE("with sliding buffer");
-		testQueue<SlidingBuffer>();
+		testQueue<ConcurrentQueue<Task, SlidingBuffer>>();
+	}
+	{
+		CAGE_TESTCASE("bounded");
+		testQueue<ConcurrentBoundedQueue<Task>>();
+	}
+	{
+		CAGE_TESTCASE("bounded single producer single consumer");
+		testQueue<ConcurrentBoundedQueue<Task, true>, false>();
+	}
+	{
+		CAGE_TESTCASE("bounded basics");
+		ConcurrentBoundedQueue<uint32> q(5);
+		CAGE_TEST(q.capacity() == 8);
+		uint32 v = 0;
+		CAGE_TEST(!q.tryPop(v));
+		for (uint32 i = 0; i < 8; i++)
+			CAGE_TEST(q.tryPush(i));
+		CAGE_TEST(!q.tryPush(42));
+		CAGE_TEST(q.estimatedSize() == 8);
+		for (uint32 i = 0; i < 8; i++)
+		{
+			CAGE_TEST(q.tryPop(v));
+			CAGE_TEST(v == i);
+		}
+		CAGE_TEST(!q.tryPop(v));
+		q.push(13);
+		q.terminate();
+		CAGE_TEST(q.stopped());
+		CAGE_TEST_THROWN(q.push(5));
+		CAGE_TEST_THROWN(q.pop(v));
+		q.pop(v, true);
+		CAGE_TEST(v == 13);
+	}
+	{
+		CAGE_TESTCASE("performance");
+		benchmark<ConcurrentQueue<uint32, RingBuffer>>("ring buffer");
+		benchmark<ConcurrentBoundedQueue<uint32>>("bounded");
+		benchmark<ConcurrentBoundedQueue<uint32, true>>("bounded spsc");
 	}
 }
@@ -196,7 +196,7 @@ namespace
 		CAGE_TEST(manCbs.removed == 20);
 	}
 
-	void randomizedTests()
+	void randomizedTests(const EntityManagerCreateConfig &config)
 	{
 		CAGE_TESTCASE("randomized test");
 
@@ -210,7 +210,7 @@ namespace
 		constexpr uint32 TotalComponents = 15;
 #endif
 
-		Holder<EntityManager> manager = newEntityManager();
+		Holder<EntityManager> manager = newEntityManager(config);
 
 		for (uint32 i = 0; i < TotalComponents; i++)
 			manager->defineComponent(Vec3());
@@ -334,6 +334,157 @@ namespace
 		}
 	}
 
+	void archetypes()
+	{
+		CAGE_TESTCASE("archetypes");
+
+		Holder<EntityManager> manager = newEntityManager({ .archetypes = true });
+		CAGE_TEST(manager->archetypes());
+
+		struct alignas(32) S
+		{
+			Vec3 data;
+		};
+
+		EntityComponent *position = manager->defineComponent(Vec3());
+		EntityComponent *index = manager->defineComponent(uint32(42));
+		EntityComponent *aligned = manager->defineComponent(S());
+
+		const auto &validate = [&]()
+		{
+			for (Entity *e : manager->entities())
+			{
+				const uint32 n = e->id();
+				CAGE_TEST(e->has(position) == (n % 2 == 0));
+				CAGE_TEST(e->has(index) == (n % 3 == 0));
+				CAGE_TEST(e->has(aligned) == (n % 5 == 0));
+				if (e->has(position))
+					CAGE_TEST(e->value<Vec3>(position) == Vec3(n));
+				if (e->has(index))
+					CAGE_TEST(e->value<uint32>(index) == n);
+				if (e->has(aligned))
+				{
+					CAGE_TEST(((uintPtr)&e->value<S>(aligned) % alignof(S)) == 0);
+					CAGE_TEST(e->value<S>(aligned).data == Vec3(n * 2));
+				}
+			}
+		};
+
+		// add components in various orders
+		for (uint32 n = 1; n < 3000; n++)
+		{
+			Entity *e = manager->create(n);
+			if (n % 5 == 0)
+				e->value<S>(aligned).data = Vec3(n * 2);
+			if (n % 3 == 0)
+			{
+				CAGE_TEST(e->value<uint32>(index) == 42);
+				e->value<uint32>(index) = n;
+			}
+			if (n % 2 == 0)
+				e->value<Vec3>(position) = Vec3(n);
+		}
+		validate();
+		CAGE_TEST(position->count() == 1499);
+		CAGE_TEST(index->count() == 999);
+
+		// chunks
+		{
+			const EntityComponent *cs[] = { position, index };
+			uint32 cnt = 0;
+			for (const EntitiesChunk &ch : manager->chunks(cs))
+			{
+				const Vec3 *ps = ch.values<Vec3>(position);
+				const uint32 *is = ch.values<uint32>(index);
+				for (uint32 i = 0; i < ch.entities.size(); i++)
+				{
+					CAGE_TEST(ps[i] == Vec3(ch.entities[i]->id()));
+					CAGE_TEST(is[i] == ch.entities[i]->id());
+				}
+				cnt += numeric_cast<uint32>(ch.entities.size());
+			}
+			CAGE_TEST(cnt == 499);
+		}
+
+		// moving entities between archetypes
+		for (uint32 n = 1; n < 3000; n += 7)
+		{
+			Entity *e = manager->get(n);
+			e->remove(index);
+			e->remove(position);
+			if (n % 3 == 0)
+				e->value<uint32>(index) = n;
+			if (n % 2 == 0)
+				e->value<Vec3>(position) = Vec3(n);
+		}
+		validate();
+
+		// destroying entities
+		for (uint32 n = 1; n < 3000; n += 3)
+			manager->get(n)->destroy();
+		validate();
+		aligned->destroy();
+		CAGE_TEST(aligned->count() == 0);
+		validate();
+
+		manager->purge();
+		CAGE_TEST(manager->count() == 0);
+		CAGE_TEST(position->count() == 0);
+	}
+
+	void changesTracking(const EntityManagerCreateConfig &config)
+	{
+		CAGE_TESTCASE("changes tracking");
+
+		Holder<EntityManager> manager = newEntityManager(config);
+		EntityComponent *position = manager->defineComponent(Vec3());
+		EntityComponent *index = manager->defineComponent(uint32(42));
+		position->enableChangesTracking();
+		CAGE_TEST(position->changesTracking());
+		CAGE_TEST(!index->changesTracking());
+
+		for (uint32 n = 1; n < 100; n++)
+		{
+			Entity *e = manager->create(n);
+			e->value<uint32>(index) = n;
+			if (n % 2 == 0)
+				e->value<Vec3>(position) = Vec3(n);
+		}
+		CAGE_TEST(position->changed(0).size() == 49); // added components count as changes
+		CAGE_TEST_THROWN(index->changed(0));
+		CAGE_TEST_THROWN(index->enableChangesTracking());
+
+		const uint32 v1 = manager->changesCheckpoint();
+		CAGE_TEST(position->changed(v1).empty());
+		for (uint32 n = 10; n < 20; n++)
+			manager->get(n)->write<Vec3>(position) += Vec3(1); // adds the component to odd entities
+		manager->get(30)->value<Vec3>(position) = Vec3(); // not marked
+		manager->get(40)->remove(position);
+		{
+			const auto ch = position->changed(v1);
+			CAGE_TEST(ch.size() == 10);
+			for (Entity *e : ch)
+				CAGE_TEST(e->id() >= 10 && e->id() < 20);
+		}
+
+		const uint32 v2 = manager->changesCheckpoint();
+		CAGE_TEST(position->changed(v2).empty());
+		manager->get(50)->markChanged(position);
+		{
+			const auto ch = position->changed(v2);
+			CAGE_TEST(ch.size() == 1);
+			CAGE_TEST(ch[0]->id() == 50);
+		}
+		CAGE_TEST(position->changed(v1).size() == 11); // older checkpoints remain valid
+		CAGE_TEST(position->changed(0).size() == 53);
+
+		// copy keeps tracking and marks everything as changed
+		Holder<EntityManager> copy = newEntityManager(config);
+		entitiesCopy({ +manager, +copy });
+		CAGE_TEST(copy->componentByDefinition(0)->changesTracking());
+		CAGE_TEST(copy->componentByDefinition(0)->changed(0).size() == 53);
+	}
+
 	void performanceTypeVsComponent()
 	{
 		CAGE_TESTCASE("performance type vs component");
@@ -485,7 +636,11 @@ void testEntities()
 	componentsWithAlignment();
 	multipleComponentsOfSameType();
 	callbacks();
-	randomizedTests();
+	randomizedTests({});
+	randomizedTests({ .archetypes = true });
+	archetypes();
+	changesTracking({});
+	changesTracking({ .archetypes = true });
 	performanceTypeVsComponent();
 	performanceSimulationTest();
 }
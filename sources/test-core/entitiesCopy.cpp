@@ -146,4 +146,21 @@ void testEntitiesCopy()
 		entitiesCopy({ +am, +bm, true, true });
 		check(+am, +bm);
 	}
+
+	{
+		CAGE_TESTCASE("archetypes");
+		Holder<EntityManager> cm = newEntityManager({ .archetypes = true });
+		Holder<EntityManager> dm = newEntityManager({ .archetypes = true });
+		for (uint32 round = 0; round < 20; round++)
+		{
+			changeEntities(+am);
+			entitiesCopy({ +am, +cm, true, true }); // plain -> archetypes
+			check(+am, +cm);
+			changeEntities(+cm);
+			entitiesCopy({ +cm, +dm, true, true }); // archetypes -> archetypes
+			check(+cm, +dm);
+			entitiesCopy({ +dm, +bm }); // archetypes -> plain
+			check(+dm, +bm);
+		}
+	}
 }
@@ -1,3 +1,5 @@
+#include <vector>
+
 #include <cage-core/entities.h>
 #include <cage-core/entitiesSerialization.h>
 #include <cage-core/math.h>
@@ -77,6 +79,111 @@ namespace
 	}
 }
 
+namespace
+{
+	void checkExact(EntityManager *a, EntityManager *b)
+	{
+		check(a, b);
+		for (Entity *eb : b->entities())
+		{
+			CAGE_TEST(a->exists(eb->id()));
+			Entity *ea = a->get(eb->id());
+			for (uint32 i = 0; i < 3; i++)
+				CAGE_TEST(ea->has(a->componentByDefinition(i)) == eb->has(b->componentByDefinition(i)));
+		}
+	}
+
+	void modifyEntities(EntityManager *man)
+	{
+		for (Entity *e : man->entities())
+		{
+			if (randomChance() < 0.9)
+				continue;
+			if (e->has<Vec3>())
+				e->value<Vec3>()[1] += 1; // modify part of the value only
+			else if (randomChance() < 0.5)
+				e->value<Vec3>() = Vec3(1, 2, 3);
+			if (e->has<float>() && randomChance() < 0.5)
+				e->remove<float>();
+		}
+	}
+
+	void testDelta(bool compress)
+	{
+		Holder<EntityManager> manA = newEntityManager();
+		defineManager(+manA);
+		Holder<EntityManager> manB = newEntityManager();
+		defineManager(+manB);
+		EntitiesDeltaExporterCreateConfig cfg;
+		cfg.compress = compress;
+		Holder<EntitiesDeltaExporter> exporter = newEntitiesDeltaExporter(cfg);
+		EntityComponent *components[3] = { manA->componentByDefinition(0), manA->componentByDefinition(1), manA->componentByDefinition(2) };
+		uint32 fullSize = 0;
+		for (uint32 round = 0; round < 10; round++)
+		{
+			if (round % 3 == 0)
+				changeEntities(+manA);
+			modifyEntities(+manA);
+			Holder<PointerRange<char>> buf = exporter->exportBuffer(manA->entities(), components);
+			if (round == 0)
+				fullSize = numeric_cast<uint32>(buf.size());
+			entitiesImportDelta(buf, +manB);
+			checkExact(+manA, +manB);
+		}
+
+		{
+			CAGE_TESTCASE("no changes");
+			Holder<PointerRange<char>> buf = exporter->exportBuffer(manA->entities(), components);
+			CAGE_TEST(buf.empty());
+		}
+
+		{
+			CAGE_TESTCASE("small change");
+			for (Entity *e : manA->entities())
+			{
+				if (e->id() != 0 && e->has<int>()) // anonymous entities are not exported
+				{
+					e->value<int>() += 1;
+					break;
+				}
+			}
+			Holder<PointerRange<char>> buf = exporter->exportBuffer(manA->entities(), components);
+			CAGE_TEST(buf.size() > 0 && buf.size() * 10 < fullSize);
+			entitiesImportDelta(buf, +manB);
+			checkExact(+manA, +manB);
+		}
+
+		{
+			CAGE_TESTCASE("reset");
+			exporter->reset();
+			// changes made after the reset are not known to the exporter, the snapshot must still remove them in the importer
+			uint32 destroyed = 0;
+			for (uint32 id = 1; id < 500 && destroyed < 10; id++)
+			{
+				if (manA->exists(id))
+				{
+					manA->get(id)->destroy();
+					destroyed++;
+				}
+			}
+			CAGE_TEST(destroyed > 0);
+			std::vector<Entity *> withInt;
+			for (Entity *e : manA->component<int>()->entities())
+				withInt.push_back(e);
+			CAGE_TEST(!withInt.empty());
+			for (Entity *e : withInt)
+				e->remove<int>();
+			Holder<PointerRange<char>> buf = exporter->exportBuffer(manA->entities(), components);
+			entitiesImportDelta(buf, +manB);
+			checkExact(+manA, +manB);
+			Holder<EntityManager> manC = newEntityManager();
+			defineManager(+manC);
+			entitiesImportDelta(buf, +manC);
+			checkExact(+manA, +manC);
+		}
+	}
+}
+
 void testEntitiesSerialization()
 {
 	CAGE_TESTCASE("entities serialization");
@@ -95,4 +202,14 @@ void testEntitiesSerialization()
 		sync(+manA, +manB);
 		check(+manA, +manB);
 	}
+
+	{
+		CAGE_TESTCASE("delta");
+		testDelta(false);
+	}
+
+	{
+		CAGE_TESTCASE("delta compressed");
+		testDelta(true);
+	}
 }
@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include <cage-core/entitiesVisitor.h>
 #include <cage-core/math.h>
 #include <cage-core/timer.h>
@@ -6,11 +8,11 @@
 
 namespace
 {
-	void visitorBasics()
+	void visitorBasics(const EntityManagerCreateConfig &config)
 	{
 		CAGE_TESTCASE("visitor basics");
 
-		Holder<EntityManager> man = newEntityManager();
+		Holder<EntityManager> man = newEntityManager(config);
 
 		man->defineComponent(Vec3());
 		man->defineComponent(Real());
@@ -44,11 +46,11 @@ namespace
 		CAGE_TEST_THROWN(entitiesVisitor([](Entity *, Quat &, Real &) {}, +man, false));
 	}
 
-	void visitorWithEntity()
+	void visitorWithEntity(const EntityManagerCreateConfig &config)
 	{
 		CAGE_TESTCASE("visitor with entity");
 
-		Holder<EntityManager> man = newEntityManager();
+		Holder<EntityManager> man = newEntityManager(config);
 
 		man->defineComponent(Real());
 		man->defineComponent(uint32());
@@ -74,11 +76,11 @@ namespace
 		CAGE_TEST(cnt == man->count());
 	}
 
-	void visitorWithModifications()
+	void visitorWithModifications(const EntityManagerCreateConfig &config)
 	{
 		CAGE_TESTCASE("visitor with modifications");
 
-		Holder<EntityManager> man = newEntityManager();
+		Holder<EntityManager> man = newEntityManager(config);
 
 		man->defineComponent(Real());
 		man->defineComponent(uint32());
@@ -119,7 +121,57 @@ namespace
 		CAGE_TEST(man->count() == 3);
 	}
 
-	void performanceTest()
+	void visitorParallel(const EntityManagerCreateConfig &config)
+	{
+		CAGE_TESTCASE("parallel visitor");
+
+		Holder<EntityManager> man = newEntityManager(config);
+
+		man->defineComponent(Vec3());
+		man->defineComponent(Real());
+		man->defineComponent(uint32());
+
+		static constexpr uint32 Count = 10000;
+		for (uint32 i = 0; i < Count; i++)
+		{
+			Entity *e = man->create(i + 1);
+			e->value<uint32>() = i;
+			if ((i % 3) == 0)
+				e->value<Real>() = 2;
+			if ((i % 5) == 0)
+				e->value<Vec3>() = Vec3(1);
+		}
+
+		entitiesVisitorParallel([](uint32 &u) { u *= 2; }, +man);
+		entitiesVisitorParallel([](Vec3 &v, const Real &r) { v *= r; }, +man, 10);
+		entitiesVisitorParallel([](Entity *e, uint32 &u, const Vec3 &) { CAGE_TEST(e->id() == u / 2 + 1); u++; }, +man, 1);
+		std::atomic<uint32> visited = 0;
+		entitiesVisitorParallel([&](Entity *) { visited++; }, +man);
+		CAGE_TEST(visited == Count);
+
+		for (uint32 i = 0; i < Count; i++)
+		{
+			Entity *e = man->get(i + 1);
+			CAGE_TEST(e->value<uint32>() == i * 2 + ((i % 5) == 0 ? 1 : 0));
+			if ((i % 5) == 0)
+				CAGE_TEST(e->value<Vec3>() == Vec3((i % 3) == 0 ? 2 : 1));
+		}
+
+		CAGE_TEST_THROWN(entitiesVisitorParallel([](Quat &) {}, +man));
+		CAGE_TEST_THROWN(entitiesVisitorParallel(
+			[](uint32 &u)
+			{
+				if (u == 42)
+					CAGE_THROW_ERROR(Exception, "test exception");
+			},
+			+man));
+
+		Holder<EntityManager> empty = newEntityManager(config);
+		empty->defineComponent(Real());
+		entitiesVisitorParallel([](Real &) { CAGE_TEST(false); }, +empty);
+	}
+
+	void performanceTest(const EntityManagerCreateConfig &config)
 	{
 		CAGE_TESTCASE("performance");
 
@@ -131,7 +183,7 @@ namespace
 		constexpr uint32 TotalEntities = 50000;
 #endif
 
-		Holder<EntityManager> man = newEntityManager();
+		Holder<EntityManager> man = newEntityManager(config);
 
 		man->defineComponent(Vec3());
 		man->defineComponent(Real());
@@ -164,6 +216,22 @@ namespace
 		}
 
 		CAGE_LOG(SeverityEnum::Info, "visitor performance", Stringizer() + "visitor avg time per cycle: " + (tmr->duration() / TotalCycles) + " us");
+
+		tmr->reset();
+		for (uint32 cycle = 0; cycle < TotalCycles; cycle++)
+		{
+			entitiesVisitorParallel([](Vec3 &v, const Real &r) { v[1] += r; }, +man);
+			entitiesVisitorParallel(
+				[](Vec3 &v, const Real &r, uint32 &u)
+				{
+					v[0] += r;
+					u++;
+				},
+				+man);
+			entitiesVisitorParallel([](uint32 &u) { u++; }, +man);
+		}
+
+		CAGE_LOG(SeverityEnum::Info, "visitor performance", Stringizer() + "parallel visitor avg time per cycle: " + (tmr->duration() / TotalCycles) + " us");
 	}
 }
 
@@ -171,8 +239,13 @@ void testEntitiesVisitor()
 {
 	CAGE_TESTCASE("entities visitor");
 
-	visitorBasics();
-	visitorWithEntity();
-	visitorWithModifications();
-	performanceTest();
+	for (const EntityManagerCreateConfig &config : { EntityManagerCreateConfig(), EntityManagerCreateConfig{ .archetypes = true } })
+	{
+		CAGE_TESTCASE(Stringizer() + "archetypes: " + config.archetypes);
+		visitorBasics(config);
+		visitorWithEntity(config);
+		visitorWithModifications(config);
+		visitorParallel(config);
+		performanceTest(config);
+	}
 }
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <filesystem>
 #include <set>
+#include <vector>
 
 #include <cage-core/concurrent.h>
 #include <cage-core/files.h>
@@ -726,6 +729,103 @@ void testFilesCarch()
 		}
 	}
 
+	{
+		CAGE_TESTCASE("large files views");
+		pathCreateArchiveCarch("testdir/arch6.carch");
+		MemoryBuffer data;
+		{
+			Serializer ser(data);
+			for (uint32 i = 0; i < 100000; i++)
+				ser << randomRange(0u, m);
+			Holder<File> f = writeFile("testdir/arch6.carch/large.bin");
+			f->write(data);
+			f->close();
+		}
+		Holder<PointerRange<char>> a, b;
+		{
+			Holder<File> f = readFile("testdir/arch6.carch/large.bin");
+			a = f->readAll();
+			f->close();
+		}
+		{
+			Holder<File> f = readFile("testdir/arch6.carch/large.bin");
+			f->seek(1000);
+			b = f->read(200000);
+			f->close(); // the view outlives the file
+		}
+		testBuffers(a, data);
+		testBuffers(b, PointerRange<const char>(data).subRange(1000, 200000));
+		a[1000] = ~a[1000]; // views are private
+		testBuffers(b, PointerRange<const char>(data).subRange(1000, 200000));
+		{
+			Holder<File> f = readFile("testdir/arch6.carch/large.bin");
+			testBuffers(f->readAll(), data);
+		}
+		{
+			// rewriting the archive reuses the space of the removed file
+			pathRemove("testdir/arch6.carch/large.bin");
+			MemoryBuffer other;
+			other.resize(data.size());
+			Holder<File> f = writeFile("testdir/arch6.carch/other.bin");
+			f->write(other);
+			f->close();
+		}
+		testBuffers(b, PointerRange<const char>(data).subRange(1000, 200000)); // views are not affected by modifications of the archive
+	}
+
+	{
+		CAGE_TESTCASE("reading truncated archive");
+		pathCreateArchiveCarch("testdir/arch8.carch");
+		MemoryBuffer data;
+		data.resize(300000);
+		data.zero();
+		writeFile("testdir/arch8.carch/large.bin")->write(data);
+		Holder<File> f = readFile("testdir/arch8.carch/large.bin");
+		std::filesystem::resize_file("testdir/arch8.carch", 1000); // simulates modification by another process
+		CAGE_TEST_THROWN(f->read(data.size())); // must not map pages past the end of the file
+	}
+
+	{
+		CAGE_TESTCASE("batched reads");
+		pathCreateArchiveCarch("testdir/arch7.carch");
+		std::vector<MemoryBuffer> contents;
+		std::vector<Holder<File>> files;
+		for (uint32 i = 0; i < 5; i++)
+		{
+			MemoryBuffer data;
+			Serializer ser(data);
+			for (uint32 j = 0, e = randomRange(1000u, 50000u); j < e; j++)
+				ser << randomRange(0u, m);
+			const String name = Stringizer() + (i < 3 ? "testdir/arch7.carch/" : "testdir/batched/") + i;
+			writeFile(name)->write(data);
+			files.push_back(readFile(name));
+			contents.push_back(std::move(data));
+		}
+		contents.push_back(contents[0].copy());
+		files.push_back(newFileBuffer(contents.back().copy()));
+		files.back()->seek(10);
+		std::vector<FileReadRequest> requests;
+		std::vector<MemoryBuffer> buffers;
+		buffers.reserve(200);
+		for (uint32 i = 0; i < 200; i++) // more requests than submitted at once
+		{
+			const uint32 k = randomRange(0u, numeric_cast<uint32>(files.size()));
+			const uint64 s = contents[k].size();
+			const uint64 a = randomRange(uint64(0), s);
+			const uint64 b = randomRange(a, s + 1);
+			buffers.push_back(MemoryBuffer(b - a));
+			requests.push_back({ +files[k], buffers.back(), a });
+		}
+		filesReadBatch(requests);
+		for (uint32 i = 0; i < 200; i++)
+		{
+			const uint32 k = std::find_if(files.begin(), files.end(), [&](const Holder<File> &f) { return +f == requests[i].file; }) - files.begin();
+			testBuffers(buffers[i], PointerRange<const char>(contents[k]).subRange(requests[i].at, buffers[i].size()));
+		}
+		CAGE_TEST(files.back()->tell() == 10);
+		CAGE_TEST(files[0]->tell() == 0);
+	}
+
 	{
 		CAGE_TESTCASE("concurrent randomized archive files");
 		ConcurrentTester tester;
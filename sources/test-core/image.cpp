@@ -1,4 +1,5 @@
 #include <initializer_list>
+#include <vector>
 
 #include <cage-core/color.h>
 #include <cage-core/image.h>
@@ -354,6 +355,35 @@ namespace
 			compare(+img, +res);
 			res->exportFile("images/formats/bc7-403x301.png");
 		}
+
+		{
+			CAGE_TESTCASE("bc7 - batch of mipmaps");
+			std::vector<Holder<Image>> imgs;
+			std::vector<const Image *> ptrs;
+			Vec2i res = Vec2i(223, 161);
+			while (true)
+			{
+				Holder<Image> img = newImage();
+				img->initialize(res, imgs.size() % 2 ? 3 : 4);
+				drawCircle(+img);
+				ptrs.push_back(+img);
+				imgs.push_back(std::move(img));
+				if (res == Vec2i(1))
+					break;
+				res = max(res / 2, 1);
+			}
+			const auto buffs = imageBc7Encode(ptrs);
+			CAGE_TEST(buffs.size() == imgs.size());
+			for (uint32 i = 0; i < imgs.size(); i++)
+			{
+				const auto single = imageBc7Encode(+imgs[i]);
+				CAGE_TEST(buffs[i].size() == single.size());
+				CAGE_TEST(detail::memcmp(buffs[i].data(), single.data(), single.size()) == 0);
+				Holder<Image> dec = imageBc7Decode(buffs[i], imgs[i]->resolution());
+				CAGE_TEST(dec->resolution() == imgs[i]->resolution());
+				CAGE_TEST(dec->channels() == 4);
+			}
+		}
 	}
 
 	void conversions()
@@ -151,6 +151,47 @@ namespace
 				arena->flush();
 			}
 		}
+
+		{
+			CAGE_TESTCASE("allocations larger than block size");
+			MemoryAllocatorLinearCreateConfig cfg;
+			cfg.blockSize = 4096;
+			Holder<MemoryArena> arena = newMemoryAllocatorLinear(cfg);
+			uint8 *first = nullptr;
+			for (uint32 round = 0; round < 3; round++)
+			{
+				uint8 *a = (uint8 *)arena->allocate(100, 16);
+				uint8 *b = (uint8 *)arena->allocate(10000, 64);
+				CAGE_TEST(((uintPtr)b % 64) == 0);
+				if (round == 0)
+					first = b;
+				CAGE_TEST(b == first); // the large block is reused after flush
+				uint8 *c = (uint8 *)arena->allocate(5000, 16);
+				CAGE_TEST(c != b);
+				construct(a, 100);
+				construct(b, 10000);
+				destruct(a, 100);
+				destruct(b, 10000);
+				arena->flush();
+			}
+		}
+
+		{
+			CAGE_TESTCASE("ignored deallocations in std vector");
+			Holder<MemoryArena> arena = newMemoryAllocatorLinear({ .blockSize = 4096, .ignoreDeallocations = true });
+			CAGE_TEST_THROWN(newMemoryAllocatorLinear({})->deallocate(nullptr));
+			for (uint32 round = 0; round < 3; round++)
+			{
+				{
+					std::vector<uint32, MemoryAllocatorStd<uint32>> vec((MemoryAllocatorStd<uint32>(*arena)));
+					for (uint32 i = 0; i < 10000; i++)
+						vec.push_back(i);
+					for (uint32 i = 0; i < 10000; i++)
+						CAGE_TEST(vec[i] == i);
+				}
+				arena->flush();
+			}
+		}
 	}
 
 	void testStream()
@@ -1,3 +1,6 @@
+#include <vector>
+
+#include <cage-core/math.h>
 #include <cage-core/memoryBuffer.h>
 #include <cage-core/memoryCompression.h>
 #include <cage-core/stdBufferStream.h>
@@ -77,6 +80,96 @@ void testMemoryBuffers()
 		}
 	}
 
+	{
+		CAGE_TESTCASE("reusable compressor");
+		Holder<Compressor> cmp = newCompressor();
+		for (uint32 round = 0; round < 5; round++)
+		{
+			MemoryBuffer b1(randomRange(100, 10000));
+			for (uintPtr i = 0, e = b1.size(); i < e; i++)
+				((uint8 *)b1.data())[i] = (uint8)(i / 7 + round);
+			Holder<PointerRange<char>> b2 = cmp->compress(b1);
+			CAGE_TEST(b2.size() < b1.size());
+			Holder<PointerRange<char>> b3 = cmp->decompress(b2, b1.size());
+			CAGE_TEST(b3.size() == b1.size());
+			CAGE_TEST(detail::memcmp(b3.data(), b1.data(), b1.size()) == 0);
+			Holder<PointerRange<char>> b4 = memoryDecompress(b2, b1.size()); // compatible with the free functions
+			CAGE_TEST(detail::memcmp(b4.data(), b1.data(), b1.size()) == 0);
+		}
+	}
+
+	{
+		CAGE_TESTCASE("compression dictionary");
+		const auto &generate = [](uint32 i) -> MemoryBuffer
+		{
+			const String s = Stringizer() + "{ \"name\": \"entity_" + i + "\", \"position\": [" + randomRange(-100, 100) + ", " + randomRange(-100, 100) + ", 0], \"health\": " + randomRange(0, 100) + ", \"team\": \"" + (i % 2 ? "red" : "blue") + "\" }";
+			MemoryBuffer b(s.length());
+			detail::memcpy(b.data(), s.c_str(), s.length());
+			return b;
+		};
+		std::vector<MemoryBuffer> samples;
+		for (uint32 i = 0; i < 2000; i++)
+			samples.push_back(generate(i));
+		std::vector<PointerRange<const char>> ranges;
+		for (const MemoryBuffer &b : samples)
+			ranges.push_back(b);
+		Holder<PointerRange<char>> dict = memoryCompressionTrainDictionary(ranges, 4000);
+		CAGE_TEST(dict.size() > 0 && dict.size() <= 4000);
+		Holder<Compressor> plain = newCompressor();
+		CompressorCreateConfig cfg;
+		cfg.dictionary = dict;
+		Holder<Compressor> dicted = newCompressor(cfg);
+		uintPtr plainSize = 0, dictedSize = 0;
+		for (uint32 i = 0; i < 20; i++)
+		{
+			const MemoryBuffer b1 = generate(5000 + i);
+			Holder<PointerRange<char>> b2 = dicted->compress(b1);
+			dictedSize += b2.size();
+			plainSize += plain->compress(b1).size();
+			Holder<PointerRange<char>> b3 = dicted->decompress(b2, b1.size());
+			CAGE_TEST(b3.size() == b1.size());
+			CAGE_TEST(detail::memcmp(b3.data(), b1.data(), b1.size()) == 0);
+			CAGE_TEST_THROWN(plain->decompress(b2, b1.size())); // the dictionary is required
+		}
+		CAGE_TEST(dictedSize * 2 < plainSize);
+	}
+
+	{
+		CAGE_TESTCASE("compression streams");
+		MemoryBuffer b1(1000000);
+		for (uintPtr i = 0, e = b1.size(); i < e; i++)
+			((uint8 *)b1.data())[i] = (uint8)(i / 13 + (i % 1000 == 0 ? randomRange(0, 256) : 0));
+		Holder<CompressionStream> cs = newCompressionStream();
+		Holder<DecompressionStream> ds = newDecompressionStream();
+		for (uint32 round = 0; round < 2; round++) // the streams are reusable
+		{
+			MemoryBuffer b2;
+			uintPtr off = 0;
+			while (off < b1.size())
+			{
+				const uintPtr s = min(uintPtr(randomRange(0, 100000)), b1.size() - off);
+				cs->compress(PointerRange<const char>(b1).subRange(off, s), b2);
+				off += s;
+			}
+			cs->finish(b2);
+			CAGE_TEST(b2.size() < b1.size() / 10);
+			CAGE_TEST(memoryDecompress(b2, b1.size()).size() == b1.size()); // single frame compatible with the free functions
+			MemoryBuffer b3;
+			off = 0;
+			bool complete = false;
+			while (off < b2.size())
+			{
+				const uintPtr s = min(uintPtr(randomRange(1, 1000)), b2.size() - off);
+				complete = ds->decompress(PointerRange<const char>(b2).subRange(off, s), b3);
+				CAGE_TEST(complete == (off + s == b2.size()));
+				off += s;
+			}
+			CAGE_TEST(complete);
+			CAGE_TEST(b3.size() == b1.size());
+			CAGE_TEST(detail::memcmp(b3.data(), b1.data(), b1.size()) == 0);
+		}
+	}
+
 	{
 		CAGE_TESTCASE("std buffer streams");
 
@@ -12,16 +12,26 @@
 namespace
 {
 	std::atomic<uint32> connectionsLeft;
+	GinnelSimulationConfig simulation; // applied to both server and clients
 
 	class ServerImpl
 	{
 	public:
-		Holder<GinnelServer> udp = newGinnelServer(3210);
+		Holder<GinnelServer> udp;
 		std::vector<Holder<GinnelConnection>> conns;
 		uint64 lastTime = applicationTime();
 		bool hadConnection = false;
 
-		bool service()
+		ServerImpl(uint32 ioThreads)
+		{
+			GinnelServerCreateConfig cfg;
+			cfg.port = 3210;
+			cfg.ioThreads = ioThreads;
+			cfg.simulation = simulation;
+			udp = newGinnelServer(cfg);
+		}
+
+		void accept()
 		{
 			while (true)
 			{
@@ -34,19 +44,28 @@ namespace
 				else
 					break;
 			}
+		}
 
+		void echo(GinnelConnection *c)
+		{
+			while (true)
+			{
+				uint32 ch;
+				bool r;
+				Holder<PointerRange<char>> b = c->read(ch, r);
+				if (!b)
+					break;
+				c->write(b, ch, r); // just repeat back the same message
+				lastTime = applicationTime();
+			}
+		}
+
+		bool service()
+		{
+			accept();
 			for (auto &c : conns)
 			{
-				while (true)
-				{
-					uint32 ch;
-					bool r;
-					Holder<PointerRange<char>> b = c->read(ch, r);
-					if (!b)
-						break;
-					c->write(b, ch, r); // just repeat back the same message
-					lastTime = applicationTime();
-				}
+				echo(+c);
 				try
 				{
 					c->update();
@@ -56,16 +75,40 @@ namespace
 					// ignore
 				}
 			}
+			return connectionsLeft > 0 || !hadConnection;
+		}
 
+		bool serviceThreaded()
+		{
+			auto ready = udp->wait(5000);
+			accept();
+			for (GinnelConnection *c : ready)
+			{
+				try
+				{
+					echo(c);
+				}
+				catch (const Disconnected &)
+				{
+					// ignore
+				}
+			}
 			return connectionsLeft > 0 || !hadConnection;
 		}
 
 		static void entry()
 		{
-			ServerImpl srv;
+			ServerImpl srv(0);
 			while (srv.service())
 				threadSleep(5000);
 		}
+
+		static void entryThreaded()
+		{
+			ServerImpl srv(2);
+			while (srv.serviceThreaded())
+				;
+		}
 	};
 
 	class ClientImpl
@@ -86,7 +129,7 @@ namespace
 					b.data()[i] = (char)randomRange(0u, 256u);
 				sends.push_back(std::move(b));
 			}
-			udp = newGinnelConnection("localhost", 3210, 0);
+			udp = newGinnelConnection("localhost", 3210, 0, simulation);
 		}
 
 		~ClientImpl()
@@ -129,6 +172,22 @@ namespace
 	};
 }
 
+namespace
+{
+	void runGinnelTest(Delegate<void()> serverEntry)
+	{
+		Holder<Thread> server = newThread(serverEntry, "server");
+		std::vector<Holder<Thread>> clients;
+		clients.resize(3);
+		uint32 index = 0;
+		for (auto &c : clients)
+			c = newThread(Delegate<void()>().bind<&ClientImpl::entry>(), Stringizer() + "client " + (index++));
+		server->wait();
+		for (auto &c : clients)
+			c->wait();
+	}
+}
+
 void testNetworkGinnel()
 {
 	CAGE_TESTCASE("network ginnel");
@@ -136,13 +195,27 @@ void testNetworkGinnel()
 	CAGE_LOG(SeverityEnum::Warning, "tests", "skipping the test - macos");
 	return;
 #endif
-	Holder<Thread> server = newThread(Delegate<void()>().bind<&ServerImpl::entry>(), "server");
-	std::vector<Holder<Thread>> clients;
-	clients.resize(3);
-	uint32 index = 0;
-	for (auto &c : clients)
-		c = newThread(Delegate<void()>().bind<&ClientImpl::entry>(), Stringizer() + "client " + (index++));
-	server->wait();
-	for (auto &c : clients)
-		c->wait();
+
+	{
+		CAGE_TESTCASE("polling server");
+		runGinnelTest(Delegate<void()>().bind<&ServerImpl::entry>());
+	}
+
+	{
+		CAGE_TESTCASE("server with io threads");
+		runGinnelTest(Delegate<void()>().bind<&ServerImpl::entryThreaded>());
+	}
+
+	{
+		CAGE_TESTCASE("simulated network conditions");
+		simulation.seed = 42;
+		simulation.latency = 20000;
+		simulation.jitter = 10000;
+		simulation.reorderDelay = 15000;
+		simulation.lossChance = 0.05;
+		simulation.duplicateChance = 0.05;
+		simulation.reorderChance = 0.05;
+		runGinnelTest(Delegate<void()>().bind<&ServerImpl::entry>());
+		simulation = {};
+	}
 }
@@ -2,6 +2,7 @@
 #include <set>
 #include <vector>
 
+#include <cage-core/camera.h>
 #include <cage-core/config.h>
 #include <cage-core/geometry.h>
 #include <cage-core/math.h>
@@ -28,6 +29,51 @@ namespace
 		return Aabb(generateRandomPoint(), generateRandomPoint());
 	}
 
+	Aabb smallBox()
+	{
+		const Vec3 c = generateRandomPoint();
+		const Vec3 s = randomRange3(0.1, 3);
+		return Aabb(c - s, c + s);
+	}
+
+	Aabb moved(Aabb b, Vec3 d)
+	{
+		return Aabb(b.a + d, b.b + d);
+	}
+
+	Line generateRandomSegment()
+	{
+		const Vec3 a = generateRandomPoint();
+		return makeSegment(a, a + randomDirection3() * randomRange(10, 200));
+	}
+
+	Frustum generateRandomFrustum()
+	{
+		return Frustum(Transform(generateRandomPoint(), randomDirectionQuat()), perspectiveProjection(Degs(60), 1, 1, randomRange(20, 100)));
+	}
+
+	template<class T>
+	void verifyBatch(SpatialQuery *query, PointerRange<const T> shapes, bool parallel)
+	{
+		query->intersection(shapes, parallel);
+		std::vector<std::vector<uint32>> batch;
+		uint32 total = 0;
+		for (uint32 i = 0; i < shapes.size(); i++)
+		{
+			const auto r = query->result(i);
+			batch.push_back(std::vector<uint32>(r.begin(), r.end()));
+			total += numeric_cast<uint32>(r.size());
+		}
+		CAGE_TEST(query->result().size() == total);
+		for (uint32 i = 0; i < shapes.size(); i++)
+		{
+			query->intersection(shapes[i]);
+			std::set<uint32> a(query->result().begin(), query->result().end());
+			std::set<uint32> b(batch[i].begin(), batch[i].end());
+			CAGE_TEST(a == b);
+		}
+	}
+
 	Aabb generateNonuniformBox()
 	{
 		Real x = randomRange(-120, 120);
@@ -205,6 +251,299 @@ void testSpatialStructure()
 		CAGE_TEST(query->result().size() == 34);
 	}
 
+	{
+		CAGE_TESTCASE("parallel build");
+		SpatialStructureCreateConfig cfg;
+		cfg.parallelBuildThreshold = 500;
+		Holder<SpatialStructure> data = newSpatialStructure(cfg);
+		std::vector<Aabb> elements;
+		for (uint32 k = 0; k < limit / 2; k++)
+		{
+			Aabb b = smallBox();
+			elements.push_back(b);
+			data->update(k, b);
+		}
+		data->rebuild();
+		verifiableQueries(elements.data(), numeric_cast<uint32>(elements.size()), data.share());
+		const SpatialStructureStatistics st = data->statistics();
+		CAGE_TEST(st.items == elements.size());
+		CAGE_TEST(st.leafs > 1);
+		CAGE_TEST(st.nodes == st.leafs * 2 - 1);
+		CAGE_TEST(st.fullRebuilds == 1);
+	}
+
+	{
+		CAGE_TESTCASE("incremental");
+		SpatialStructureCreateConfig cfg;
+		cfg.incremental = true;
+		Holder<SpatialStructure> data = newSpatialStructure(cfg);
+		std::vector<Aabb> elements;
+		for (uint32 k = 0; k < limit / 2; k++)
+		{
+			Aabb b = smallBox();
+			elements.push_back(b);
+			data->update(k, b);
+		}
+		data->rebuild();
+		CAGE_TEST(data->statistics().fullRebuilds == 1);
+		verifiableQueries(elements.data(), numeric_cast<uint32>(elements.size()), data.share());
+
+		// small movements are refitted
+		for (uint32 round = 0; round < 5; round++)
+		{
+			for (uint32 i = 0; i < limit / 20; i++)
+			{
+				uint32 k = randomRange(0u, numeric_cast<uint32>(elements.size()));
+				elements[k] = moved(elements[k], randomRange3(-1, 1));
+				data->update(k, elements[k]);
+			}
+			data->rebuild();
+			verifiableQueries(elements.data(), numeric_cast<uint32>(elements.size()), data.share());
+		}
+		{
+			const SpatialStructureStatistics st = data->statistics();
+			CAGE_TEST(st.fullRebuilds == 1);
+			CAGE_TEST(st.incrementalRebuilds == 5);
+			CAGE_TEST(st.lastRefittedNodes > 0);
+		}
+
+		// large movements degrade the tree and cause subtree rebuilds
+		for (uint32 round = 0; round < 5; round++)
+		{
+			for (uint32 i = 0; i < limit / 20; i++)
+			{
+				uint32 k = randomRange(0u, numeric_cast<uint32>(elements.size()));
+				elements[k] = smallBox();
+				data->update(k, elements[k]);
+			}
+			data->rebuild();
+			verifiableQueries(elements.data(), numeric_cast<uint32>(elements.size()), data.share());
+		}
+		{
+			const SpatialStructureStatistics st = data->statistics();
+			CAGE_TEST(st.subtreeRebuilds + st.fullRebuilds > 1);
+			CAGE_TEST(st.sahCost > 0);
+		}
+
+		// insertions and removals
+		for (uint32 i = 0; i < limit / 20; i++)
+		{
+			uint32 k = randomRange(0u, numeric_cast<uint32>(elements.size()));
+			elements[k] = Aabb();
+			data->remove(k);
+		}
+		data->update(numeric_cast<uint32>(elements.size()), Aabb(Vec3(1000), Vec3(1001)));
+		elements.push_back(Aabb(Vec3(1000), Vec3(1001)));
+		const uint32 fullRebuilds = data->statistics().fullRebuilds;
+		data->rebuild();
+		CAGE_TEST(data->statistics().fullRebuilds == fullRebuilds + 1);
+		verifiableQueries(elements.data(), numeric_cast<uint32>(elements.size()), data.share());
+	}
+
+	{
+		CAGE_TESTCASE("incremental performance");
+		for (bool incremental : { false, true })
+		{
+			SpatialStructureCreateConfig cfg;
+			cfg.incremental = incremental;
+			Holder<SpatialStructure> data = newSpatialStructure(cfg);
+			std::vector<Aabb> elements;
+			for (uint32 k = 0; k < limit; k++)
+			{
+				elements.push_back(generateNonuniformBox());
+				data->update(k, elements.back());
+			}
+			data->rebuild();
+			Holder<Timer> tmr = newTimer();
+			for (uint32 tick = 0; tick < 20; tick++)
+			{
+				for (uint32 i = 0; i < limit / 10; i++)
+				{
+					const uint32 k = randomRange(0u, limit);
+					elements[k] = moved(elements[k], randomRange3(-0.5, 0.5));
+					data->update(k, elements[k]);
+				}
+				data->rebuild();
+				randomQueries(data.share());
+			}
+			const SpatialStructureStatistics st = data->statistics();
+			CAGE_LOG(SeverityEnum::Info, "spatial performance", Stringizer() + "incremental: " + incremental + ", total time: " + tmr->duration() + " us, sah cost: " + st.sahCost + ", subtree rebuilds: " + st.subtreeRebuilds + ", full rebuilds: " + st.fullRebuilds);
+		}
+	}
+
+	{
+		CAGE_TESTCASE("batched queries");
+		Holder<SpatialStructure> data = newSpatialStructure(SpatialStructureCreateConfig());
+		for (uint32 k = 0; k < limit / 2; k++)
+			data->update(k, smallBox());
+		data->update(limit, Sphere(Vec3(), 20));
+		data->update(limit + 1, Vec3(7, 3, 2));
+		data->rebuild();
+		Holder<SpatialQuery> query = newSpatialQuery(data.share());
+		for (bool parallel : { false, true })
+		{
+			{
+				std::vector<Line> shapes;
+				for (uint32 i = 0; i < 103; i++)
+					shapes.push_back(generateRandomSegment());
+				verifyBatch<Line>(+query, shapes, parallel);
+			}
+			{
+				std::vector<Sphere> shapes;
+				for (uint32 i = 0; i < 102; i++)
+					shapes.push_back(Sphere(generateRandomPoint(), randomRange(1, 30)));
+				verifyBatch<Sphere>(+query, shapes, parallel);
+			}
+			{
+				std::vector<Aabb> shapes;
+				for (uint32 i = 0; i < 101; i++)
+					shapes.push_back(smallBox());
+				verifyBatch<Aabb>(+query, shapes, parallel);
+			}
+			{
+				std::vector<Frustum> shapes;
+				for (uint32 i = 0; i < 30; i++)
+					shapes.push_back(generateRandomFrustum());
+				verifyBatch<Frustum>(+query, shapes, parallel);
+			}
+		}
+		{
+			const Line shapes[1] = { makeRay(Vec3(-200, 3, 2), Vec3(200, 3, 2)) };
+			CAGE_TEST(query->intersection(PointerRange<const Line>(shapes)));
+			CAGE_TEST(query->result(0).size() > 0);
+			CAGE_TEST(!query->intersection(PointerRange<const Line>()));
+			CAGE_TEST(query->result().empty());
+		}
+	}
+
+	{
+		CAGE_TESTCASE("frustum culling with universe boxes");
+		// meshes with noCulling have universe bounding box, which is no longer valid after transformation
+		// such items cannot be inserted into the structure, the scene renderer adds them to the results of every view
+		std::vector<Aabb> elements;
+		std::vector<uint32> unbounded;
+		Holder<SpatialStructure> data = newSpatialStructure({});
+		for (uint32 k = 0; k < limit / 10; k++)
+		{
+			if ((k % 50) == 0)
+				elements.push_back(Aabb::Universe() * Transform(generateRandomPoint(), randomDirectionQuat()));
+			else
+				elements.push_back(smallBox());
+			if (elements.back().valid())
+				data->update(k, elements.back());
+			else
+				unbounded.push_back(k);
+		}
+		data->rebuild();
+		CAGE_TEST(unbounded.size() == limit / 10 / 50);
+		Holder<SpatialQuery> query = newSpatialQuery(data.share());
+		for (uint32 round = 0; round < 20; round++)
+		{
+			const Frustum frustum = generateRandomFrustum();
+			query->intersection(frustum);
+			std::vector<uint32> visible(query->result().begin(), query->result().end());
+			visible.insert(visible.end(), unbounded.begin(), unbounded.end());
+			std::sort(visible.begin(), visible.end());
+			std::vector<uint32> expected; // linear culling, as the renderer did before
+			for (uint32 k = 0; k < elements.size(); k++)
+				if (intersects(elements[k], frustum))
+					expected.push_back(k);
+			CAGE_TEST(visible == expected);
+		}
+	}
+
+	{
+		CAGE_TESTCASE("pairs");
+		Holder<SpatialStructure> data = newSpatialStructure(SpatialStructureCreateConfig());
+		std::vector<Aabb> elements;
+		for (uint32 k = 0; k < limit / 10; k++)
+		{
+			elements.push_back(smallBox());
+			data->update(k, elements.back());
+		}
+		data->rebuild();
+		std::vector<std::pair<uint32, uint32>> expected;
+		for (uint32 i = 0; i < elements.size(); i++)
+			for (uint32 j = i + 1; j < elements.size(); j++)
+				if (intersects(elements[i], elements[j]))
+					expected.push_back({ i, j });
+		CAGE_TEST(!expected.empty());
+		Holder<SpatialQuery> query = newSpatialQuery(data.share());
+		for (bool parallel : { false, true })
+		{
+			CAGE_TEST(query->pairs(parallel));
+			const auto res = query->result();
+			CAGE_TEST((res.size() % 2) == 0);
+			std::vector<std::pair<uint32, uint32>> found;
+			for (uint32 i = 0; i < res.size(); i += 2)
+			{
+				CAGE_TEST(res[i] < res[i + 1]);
+				found.push_back({ res[i], res[i + 1] });
+			}
+			std::sort(found.begin(), found.end());
+			CAGE_TEST(found == expected);
+		}
+	}
+
+	{
+		CAGE_TESTCASE("pairs performance");
+		Holder<SpatialStructure> data = newSpatialStructure(SpatialStructureCreateConfig());
+		std::vector<Aabb> elements;
+		for (uint32 k = 0; k < limit; k++)
+		{
+			elements.push_back(smallBox());
+			data->update(k, elements.back());
+		}
+		data->rebuild();
+		Holder<SpatialQuery> query = newSpatialQuery(data.share());
+		Holder<Timer> tmr = newTimer();
+		uint64 total = 0;
+		for (const Aabb &b : elements) // same work as the pairs query: each item against all others
+		{
+			query->intersection(b);
+			total += query->result().size();
+		}
+		const uint64 queries = tmr->duration();
+		tmr->reset();
+		query->pairs();
+		const uint64 pairs = tmr->duration();
+		CAGE_TEST(query->result().size() == total - limit); // individual queries find each pair twice and each item itself
+		tmr->reset();
+		query->pairs(true);
+		const uint64 parallel = tmr->duration();
+		CAGE_TEST(query->result().size() == total - limit);
+		CAGE_LOG(SeverityEnum::Info, "spatial performance", Stringizer() + "items: " + limit + ", individual queries: " + queries + " us, pairs: " + pairs + " us, parallel pairs: " + parallel + " us, pairs count: " + query->result().size() / 2);
+	}
+
+	{
+		CAGE_TESTCASE("batched queries performance");
+		Holder<SpatialStructure> data = newSpatialStructure(SpatialStructureCreateConfig());
+		for (uint32 k = 0; k < limit; k++)
+			data->update(k, generateNonuniformBox());
+		data->rebuild();
+		Holder<SpatialQuery> query = newSpatialQuery(data.share());
+		std::vector<Line> rays;
+		for (uint32 i = 0; i < limit / 2; i++)
+			rays.push_back(generateRandomSegment());
+		uint64 hits = 0;
+		Holder<Timer> tmr = newTimer();
+		for (const Line &l : rays)
+		{
+			query->intersection(l);
+			hits += query->result().size();
+		}
+		const uint64 single = tmr->duration();
+		tmr->reset();
+		query->intersection(PointerRange<const Line>(rays));
+		CAGE_TEST(query->result().size() == hits);
+		const uint64 batched = tmr->duration();
+		tmr->reset();
+		query->intersection(PointerRange<const Line>(rays), true);
+		CAGE_TEST(query->result().size() == hits);
+		const uint64 parallel = tmr->duration();
+		CAGE_LOG(SeverityEnum::Info, "spatial performance", Stringizer() + "rays: " + rays.size() + ", single: " + single + " us, batched: " + batched + " us, batched parallel: " + parallel + " us");
+	}
+
 	{
 		CAGE_TESTCASE("performance tests");
 		Holder<SpatialStructure> data = newSpatialStructure(SpatialStructureCreateConfig());
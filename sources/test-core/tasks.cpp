@@ -635,6 +635,67 @@ namespace
 		}
 	}
 
+	void testTasksHiddenChildren()
+	{
+		CAGE_TESTCASE("waiting for children hidden in queues");
+
+		struct Counter
+		{
+			std::atomic<uint32> runs = 0;
+
+			void operator()(uint32) { runs++; }
+		};
+
+		{
+			CAGE_TESTCASE("children overflowing the deque");
+			struct Parent
+			{
+				void operator()(uint32)
+				{
+					Holder<Counter> c = systemMemory().createHolder<Counter>();
+					std::vector<Holder<AsyncTask>> tasks;
+					for (uint32 i = 0; i < 3000; i++)
+						tasks.push_back(tasksRunAsync("child", c.share()));
+					for (auto it = tasks.rbegin(); it != tasks.rend(); it++) // the last children are in the injected queue
+						(*it)->wait();
+					CAGE_TEST(c->runs == 3000);
+				}
+			};
+			Parent p;
+			tasksRunBlocking<Parent>("parent", p, 1);
+		}
+
+		{
+			CAGE_TESTCASE("children below unrelated work");
+			struct Spawner
+			{
+				Holder<Counter> counter;
+				Holder<AsyncTask> grandchild;
+
+				void operator()(uint32) { grandchild = tasksRunAsync("grandchild", counter.share()); }
+			};
+			struct Parent
+			{
+				Holder<AsyncTask> grandchild;
+
+				void operator()(uint32)
+				{
+					Holder<Counter> c = systemMemory().createHolder<Counter>();
+					Holder<AsyncTask> child = tasksRunAsync("child", c.share());
+					// the grandchild is pushed above the child and does not match the filter of the parent
+					Spawner s;
+					s.counter = c.share();
+					tasksRunBlocking<Spawner>("spawner", s, 1);
+					grandchild = std::move(s.grandchild);
+					child->wait();
+				}
+			};
+			Parent p;
+			tasksRunBlocking<Parent>("parent", p, 1);
+			p.grandchild->wait();
+		}
+	}
+
 	void testPerformance()
 	{
 		CAGE_TESTCASE("performance (parallel merge sort)");
@@ -705,6 +766,79 @@ namespace
 		CAGE_LOG(SeverityEnum::Info, "tasks performance", Stringizer() + "parallel merge sort avg duration: " + durations[15] + " us"); // median
 	}
 
+	void testThroughput()
+	{
+		CAGE_TESTCASE("performance (throughput)");
+
+		struct Tiny
+		{
+			std::atomic<uint64> sum = 0;
+
+			void operator()(uint32 idx) { sum.fetch_add(idx, std::memory_order_relaxed); }
+		};
+
+		struct Nested
+		{
+			std::atomic<uint64> sum = 0;
+
+			void operator()(uint32)
+			{
+				Tiny t;
+				tasksRunBlocking<Tiny>("throughput nested", t, 64);
+				sum += t.sum;
+			}
+		};
+
+		struct Submitter
+		{
+			uint32 rounds = 0;
+
+			void run()
+			{
+				for (uint32 r = 0; r < rounds; r++)
+				{
+					Tiny t;
+					tasksRunBlocking<Tiny>("throughput", t, 1000);
+					CAGE_TEST(t.sum == 1000 * 999 / 2);
+				}
+			}
+		};
+
+#ifdef CAGE_DEBUG
+		constexpr uint32 Rounds = 20;
+#else
+		constexpr uint32 Rounds = 200;
+#endif
+
+		std::vector<uint32> counts = { 1, 2, 4, processorsCount() };
+		std::sort(counts.begin(), counts.end());
+		counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+		for (uint32 threadsCount : counts)
+		{
+			std::vector<Submitter> submitters;
+			submitters.resize(threadsCount);
+			std::vector<Holder<Thread>> threads;
+			Holder<Timer> tmr = newTimer();
+			for (Submitter &it : submitters)
+			{
+				it.rounds = Rounds;
+				threads.push_back(newThread(Delegate<void()>().bind<Submitter, &Submitter::run>(&it), "throughput submitter"));
+			}
+			threads.clear();
+			const uint64 duration = max(tmr->duration(), uint64(1));
+			CAGE_LOG(SeverityEnum::Info, "tasks performance", Stringizer() + "submitting threads: " + threadsCount + ", invocations per second: " + (uint64(threadsCount) * Rounds * 1000 * 1000000 / duration));
+		}
+
+		{
+			Nested n;
+			Holder<Timer> tmr = newTimer();
+			tasksRunBlocking<Nested>("throughput", n, Rounds * 10);
+			const uint64 duration = max(tmr->duration(), uint64(1));
+			CAGE_TEST(n.sum == uint64(Rounds) * 10 * (64 * 63 / 2));
+			CAGE_LOG(SeverityEnum::Info, "tasks performance", Stringizer() + "nested tasks, invocations per second: " + (uint64(Rounds) * 10 * 65 * 1000000 / duration));
+		}
+	}
+
 	struct StressTester : private Immovable
 	{
 		static inline std::atomic<sint32> counter = 0;
@@ -780,6 +914,8 @@ void testTasks()
 	testTasksSplit();
 	testTasksHolders();
 	testTasksAggregation();
+	testTasksHiddenChildren();
 	testPerformance();
+	testThroughput();
 	randomizedStressTest();
 }
@@ -45,10 +45,10 @@ using V9 = Value<3>;
 
 struct Performance
 {
-	Holder<EntityManager> man = newEntityManager();
+	Holder<EntityManager> man;
 	RandomGenerator rng = RandomGenerator(123457, 789159753);
 
-	Performance()
+	Performance(const EntityManagerCreateConfig &config) : man(newEntityManager(config))
 	{
 		man->defineComponent(V0());
 		man->defineComponent(V1());
@@ -478,17 +478,32 @@ struct Performance
 			remove();
 		}
 	}
+
+	// many entities, few structural changes - dominated by iterating
+	void runIterations()
+	{
+		static constexpr uint32 Initialization = CAGE_DEBUG_BOOL ? 1000 : 10000; // 10 entities each
+		static constexpr uint32 Iterations = CAGE_DEBUG_BOOL ? 20 : 200;
+		for (uint32 i = 0; i < Initialization; i++)
+			add();
+		for (uint32 i = 0; i < Iterations; i++)
+		{
+			access();
+			modify();
+		}
+	}
 };
 
-void performanceLoop()
+void performanceLoop(const EntityManagerCreateConfig &config, void (Performance::*run)(), const String &name)
 {
+	CAGE_LOG(SeverityEnum::Info, "performance", Stringizer() + name + ", archetypes: " + config.archetypes);
 	std::vector<uint64> timings;
 	Holder<Timer> timer = newTimer();
 	for (uint32 i = 0; i < 10; i++)
 	{
-		Performance p;
+		Performance p(config);
 		timer->reset();
-		p.run();
+		(p.*run)();
 		const uint64 d = timer->duration();
 		timings.push_back(d);
 		CAGE_LOG(SeverityEnum::Info, "performance", Stringizer() + "duration: " + d + " us");
@@ -510,7 +525,10 @@ int main(int argc, const char *args[])
 	initializeConsoleLogger();
 	try
 	{
-		performanceLoop();
+		performanceLoop({}, &Performance::run, "churn");
+		performanceLoop({ .archetypes = true }, &Performance::run, "churn");
+		performanceLoop({}, &Performance::runIterations, "iterations");
+		performanceLoop({ .archetypes = true }, &Performance::runIterations, "iterations");
 		return 0;
 	}
 	catch (...)
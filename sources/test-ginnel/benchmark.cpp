@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <vector>
+
+#include "common.h"
+
+#include <cage-core/concurrent.h>
+#include <cage-core/config.h>
+#include <cage-core/core.h>
+#include <cage-core/math.h>
+#include <cage-core/memoryBuffer.h>
+#include <cage-core/networkGinnel.h>
+#include <cage-core/serialization.h>
+
+namespace
+{
+	constexpr uint32 MessageSize = 1000;
+	constexpr uint64 Period = 5000;
+
+	uint64 percentile(const std::vector<uint64> &sorted, Real p)
+	{
+		if (sorted.empty())
+			return 0;
+		return sorted[numeric_cast<uint32>(min(p * sorted.size(), Real(sorted.size() - 1)))];
+	}
+}
+
+// runs server and client in this process, with the network conditions simulated by ginnel itself
+void runBenchmark()
+{
+	CAGE_LOG(SeverityEnum::Info, "config", Stringizer() + "running in benchmark mode");
+
+	ConfigUint32 port("port");
+	const uint64 maxBytesPerSecond = configGetUint64("maxBytesPerSecond");
+	const uint64 duration = configGetUint64("duration");
+	CAGE_LOG(SeverityEnum::Info, "config", Stringizer() + "limit: " + (maxBytesPerSecond / 1024) + " KB/s, duration: " + (duration / 1000) + " ms");
+	CAGE_LOG(SeverityEnum::Info, "config", Stringizer() + "seed: " + configGetUint64("cage/ginnel/simulation/seed") + ", latency: " + configGetUint64("cage/ginnel/simulation/latency") + " us, jitter: " + configGetUint64("cage/ginnel/simulation/jitter") + " us, bandwidth: " + (configGetUint64("cage/ginnel/simulation/bandwidth") / 1024) + " KB/s");
+	CAGE_LOG(SeverityEnum::Info, "config", Stringizer() + "loss: " + configGetFloat("cage/ginnel/simulation/loss") + ", duplicate: " + configGetFloat("cage/ginnel/simulation/duplicate") + ", reorder: " + configGetFloat("cage/ginnel/simulation/reorder") + ", reorder delay: " + configGetUint64("cage/ginnel/simulation/reorderDelay") + " us");
+
+	// empty simulation configs make both sides use the config variables
+	Holder<GinnelServer> server = newGinnelServer(numeric_cast<uint16>((uint32)port));
+	Holder<GinnelConnection> client = newGinnelConnection("localhost", numeric_cast<uint16>((uint32)port), 0);
+	Holder<GinnelConnection> accepted;
+
+	std::vector<uint64> latencies;
+	uint64 sendSeqn = 0, payloadSent = 0, payloadReceived = 0;
+	const uint64 start = applicationTime();
+	uint64 last = start;
+	uint64 end = start + duration;
+	bool sending = true;
+	while (true)
+	{
+		const uint64 now = applicationTime();
+		if (sending && now > end)
+		{
+			sending = false;
+			end = now + 5000000; // allow in-flight messages to arrive
+		}
+		if (now > end || (!sending && latencies.size() == sendSeqn))
+			break;
+
+		if (sending)
+		{
+			uint64 total = 0;
+			while (total < (now - last) * maxBytesPerSecond / 1000000 && client->capacity() >= MessageSize)
+			{
+				MemoryBuffer b;
+				Serializer s(b);
+				s << ++sendSeqn << applicationTime();
+				b.resize(MessageSize);
+				client->write(b, 0, true);
+				total += MessageSize;
+				payloadSent += MessageSize;
+			}
+		}
+		last = now;
+		client->update();
+
+		if (!accepted)
+			accepted = server->accept();
+		if (accepted)
+		{
+			accepted->update();
+			while (true)
+			{
+				Holder<PointerRange<char>> b = accepted->read();
+				if (!b)
+					break;
+				Deserializer d(b);
+				uint64 seqn, time;
+				d >> seqn >> time;
+				latencies.push_back(applicationTime() - time);
+				payloadReceived += b.size();
+			}
+		}
+
+		threadSleep(Period);
+	}
+
+	const GinnelStatistics stats = client->statistics();
+	const uint64 elapsed = max(applicationTime() - start, uint64(1));
+	std::sort(latencies.begin(), latencies.end());
+	CAGE_LOG(SeverityEnum::Info, "benchmark", Stringizer() + "messages sent: " + sendSeqn + ", received: " + latencies.size());
+	CAGE_LOG(SeverityEnum::Info, "benchmark", Stringizer() + "goodput: " + (payloadReceived * 1000000 / elapsed / 1024) + " KB/s");
+	CAGE_LOG(SeverityEnum::Info, "benchmark", Stringizer() + "latency p50: " + (percentile(latencies, 0.5) / 1000) + " ms, p90: " + (percentile(latencies, 0.9) / 1000) + " ms, p99: " + (percentile(latencies, 0.99) / 1000) + " ms, max: " + (latencies.empty() ? 0 : latencies.back() / 1000) + " ms");
+	CAGE_LOG(SeverityEnum::Info, "benchmark", Stringizer() + "packets sent: " + stats.packetsSentTotal + ", bytes sent: " + stats.bytesSentTotal + ", overhead: " + (Real(stats.bytesSentTotal) / max(payloadSent, uint64(1)) - 1) * 100 + " %");
+}
@@ -10,6 +10,7 @@
 
 void runServer();
 void runClient();
+void runBenchmark();
 
 namespace
 {
@@ -87,6 +88,7 @@ int main(int argc, const char *args[])
 		cmd->parseCmd(argc, args);
 		const bool modeServer = cmd->cmdBool('s', "server", false);
 		const bool modeClient = cmd->cmdBool('c', "client", false);
+		const bool modeBenchmark = cmd->cmdBool('b', "benchmark", false);
 		const String name = cmd->cmdString('n', "name", "");
 		ConfigString address("address", "localhost");
 		address = cmd->cmdString('a', "address", address);
@@ -94,12 +96,24 @@ int main(int argc, const char *args[])
 		port = cmd->cmdUint32('p', "port", port);
 		ConfigUint64 maxBytesPerSecond("maxBytesPerSecond");
 		maxBytesPerSecond = cmd->cmdUint64('l', "limit", MaxBytesPerSecond);
+		ConfigUint64 duration("duration");
+		duration = cmd->cmdUint64(0, "duration", 10000000);
+		{ // network conditions simulation
+			configSetUint64("cage/ginnel/simulation/seed", cmd->cmdUint64(0, "seed", 0));
+			configSetUint64("cage/ginnel/simulation/latency", cmd->cmdUint64(0, "latency", 0));
+			configSetUint64("cage/ginnel/simulation/jitter", cmd->cmdUint64(0, "jitter", 0));
+			configSetUint64("cage/ginnel/simulation/reorderDelay", cmd->cmdUint64(0, "reorderDelay", 0));
+			configSetUint64("cage/ginnel/simulation/bandwidth", cmd->cmdUint64(0, "bandwidth", 0));
+			configSetFloat("cage/ginnel/simulation/loss", cmd->cmdFloat(0, "loss", 0));
+			configSetFloat("cage/ginnel/simulation/duplicate", cmd->cmdFloat(0, "duplicate", 0));
+			configSetFloat("cage/ginnel/simulation/reorder", cmd->cmdFloat(0, "reorder", 0));
+		}
 		cmd->checkCmd();
 
 		if (port <= 1024 || port >= 65536)
 			CAGE_THROW_ERROR(Exception, "invalid port");
-		if (modeServer == modeClient)
-			CAGE_THROW_ERROR(Exception, "invalid mode (exactly one of -s or -c must be set)");
+		if (modeServer + modeClient + modeBenchmark != 1)
+			CAGE_THROW_ERROR(Exception, "invalid mode (exactly one of -s, -c or -b must be set)");
 
 		if (!name.empty())
 			initializeSecondaryLog(name + ".log");
@@ -107,6 +121,8 @@ int main(int argc, const char *args[])
 			runServer();
 		if (modeClient)
 			runClient();
+		if (modeBenchmark)
+			runBenchmark();
 
 		return 0;
 	}